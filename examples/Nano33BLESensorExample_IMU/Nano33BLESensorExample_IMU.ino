@@ -152,6 +152,14 @@ void loop()
          */
         while(central.connected())
         {    
+            /* 
+             * The accelerometer is read the fastest, so rather than spinning
+             * on pop() this thread sleeps until new accelerometer data is
+             * pushed. The timeout lets the connection be checked again even
+             * if no data arrives.
+             */
+            Accelerometer.waitForAtLeast(1, 100);
+
             /* 
              * sprintf is used to convert the read float value to a string 
              * which is stored in bleBuffer. This string is then written to 
@@ -0,0 +1,135 @@
+/*
+  Nano33BLESensorExample_coroutines.ino
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This program is an example program showing some of the cababilities of the
+  Nano33BLESensor Library. In this case each consumer of sensor data is a
+  C++20 coroutine that waits for the data it needs, rather than a loop()
+  that polls every sensor and delays. One coroutine prints each
+  accelerometer reading, one prints the average of every 32 microphone RMS
+  readings, and one prints the pressure once a second. The results are
+  output via serial.
+
+  Coroutines need a compiler with C++20 support (e.g. -std=gnu++20).
+  Without it this example only prints a message saying so.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INCLUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEPressure.h"
+#include "Nano33BLEMicrophoneRMS.h"
+#include "Nano33BLECoroutine.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define MICROPHONE_BATCH_SIZE       (32U)
+#define PRESSURE_PRINT_PERIOD_MS    (1000U)
+
+#ifdef COROUTINES_SUPPORTED
+/*****************************************************************************/
+/*COROUTINES                                                                 */
+/*****************************************************************************/
+Nano33BLETask printAccelerometer(void)
+{
+    Nano33BLEAccelerometerData accelerometerData;
+
+    while(1)
+    {
+        /* Suspended here until the accelerometer pushes new data */
+        accelerometerData = co_await Accelerometer.next();
+        Serial.print(accelerometerData.x);
+        Serial.print(",");
+        Serial.print(accelerometerData.y);
+        Serial.print(",");
+        Serial.println(accelerometerData.z);
+    }
+}
+
+Nano33BLETask printMicrophone(void)
+{
+    /* Kept in the coroutine's frame while it is suspended */
+    Nano33BLEMicrophoneRMSData microphoneData[MICROPHONE_BATCH_SIZE];
+    uint32_t count;
+    uint32_t sum;
+    uint32_t ii;
+
+    while(1)
+    {
+        count = co_await MicrophoneRMS.batch(microphoneData, MICROPHONE_BATCH_SIZE);
+        sum = 0;
+        for(ii = 0; ii < count; ii++)
+        {
+            sum += microphoneData[ii].RMSValue;
+        }
+        Serial.print("Microphone RMS average: ");
+        Serial.println(sum / count);
+    }
+}
+
+Nano33BLETask printPressure(void)
+{
+    Nano33BLEPressureData pressureData;
+    uint64_t wakeTime_ms;
+
+    wakeTime_ms = CoroutineScheduler.getTime();
+    while(1)
+    {
+        /* Deadlines a fixed period apart, so the prints do not drift */
+        wakeTime_ms += PRESSURE_PRINT_PERIOD_MS;
+        co_await CoroutineScheduler.sleepUntil(wakeTime_ms);
+        if(Pressure.pop(pressureData))
+        {
+            Serial.print("Pressure: ");
+            Serial.println(pressureData.barometricPressure);
+        }
+    }
+}
+#endif /* COROUTINES_SUPPORTED */
+
+/*****************************************************************************/
+/*SETUP (Initialisation)                                                          */
+/*****************************************************************************/
+void setup()
+{
+    /* Serial setup for UART debugging */
+    Serial.begin(115200);
+
+#ifdef COROUTINES_SUPPORTED
+    Accelerometer.begin();
+    MicrophoneRMS.begin();
+    Pressure.begin();
+
+    CoroutineScheduler.start(printAccelerometer());
+    CoroutineScheduler.start(printMicrophone());
+    CoroutineScheduler.start(printPressure());
+
+    /* Runs the coroutines from here on, so setup() never returns */
+    CoroutineScheduler.run();
+#endif /* COROUTINES_SUPPORTED */
+}
+
+/*****************************************************************************/
+/*LOOP (runtime super loop)                                                          */
+/*****************************************************************************/
+void loop()
+{
+    Serial.println("This example needs a compiler with C++20 coroutine support.");
+    delay(1000);
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+/*
+  Nano33BLESensorExample_customSensor.ino
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+  This program is an example program showing some of the cababilities of the 
+  Nano33BLESensor Library. In this case it shows how to add your own sensor
+  to the library using Nano33BLESensor, so it is read in its own Mbed OS 
+  thread and buffered exactly like the on board sensors. The sensor here is
+  simulated (a noisy sine wave) so it runs without any extra hardware, and 
+  its data is output via serial in a format that can be displayed on the 
+  Arduino IDE serial plotter. For a real I2C sensor, replace the contents of
+  init() and read() with Nano33BLEI2CDevice register accesses.
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/*****************************************************************************/
+/*INCLUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define SIMULATED_READ_PERIOD_MS                (20U)
+#define SIMULATED_THREAD_STACK_SIZE_BYTES       (1024U)
+/* Period of the simulated sine wave */
+#define SIMULATED_WAVE_PERIOD_MS                (2000U)
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * The data the simulated sensor gives us after each read. Like the on 
+ * board sensors it must have a timeStampMs member, which Nano33BLESensor
+ * fills in.
+ */
+class SimulatedSensorData
+{
+  public:
+    float value;
+    uint32_t timeStampMs;
+};
+
+/**
+ * Gives generic access to the values in SimulatedSensorData, so the sensor
+ * can be used with Nano33BLEWindowFeatures, Nano33BLEChangeFilter etc.
+ */
+template<>
+class Nano33BLESensorChannels<SimulatedSensorData>
+{
+  public:
+    enum { CHANNEL_COUNT = 1 };
+    static float get(const SimulatedSensorData& data, uint32_t channel)
+    {
+      (void)channel;
+      return data.value;
+    }
+};
+
+/**
+ * The simulated sensor. It only provides init() and read(), Nano33BLESensor
+ * does the rest.
+ */
+class SimulatedSensor: public Nano33BLESensor<SimulatedSensor, SimulatedSensorData>
+{
+  public:
+    SimulatedSensor() :
+      Nano33BLESensor<SimulatedSensor, SimulatedSensorData>(
+        "Simulated",
+        TRACE_ID_NONE,
+        SIMULATED_READ_PERIOD_MS,
+        0U,
+        osPriorityNormal,
+        SIMULATED_THREAD_STACK_SIZE_BYTES),
+      startTimeMs(0){};
+
+  private:
+    friend class Nano33BLESensor<SimulatedSensor, SimulatedSensorData>;
+
+    void init(void)
+    {
+      startTimeMs = millis();
+    }
+
+    void read(void)
+    {
+      SimulatedSensorData data;
+      float phase;
+
+      phase = (2.0F * PI * ((millis() - startTimeMs) % SIMULATED_WAVE_PERIOD_MS)) / 
+        SIMULATED_WAVE_PERIOD_MS;
+      data.value = sinf(phase) + (random(-100, 100) / 1000.0F);
+      publish(data);
+    }
+
+    uint32_t startTimeMs;
+};
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+SimulatedSensor Simulated;
+SimulatedSensorData simulatedData;
+
+/*****************************************************************************/
+/*SETUP (Initialisation)                                                     */
+/*****************************************************************************/
+void setup()
+{
+    /* 
+     * Serial setup. This will be used to transmit data for viewing on serial 
+     * plotter 
+     */
+    Serial.begin(115200);
+    while(!Serial);
+
+    /* 
+     * Initialises the simulated sensor, and starts the periodic reading of 
+     * the sensor using a Mbed OS thread, just like the on board sensors.
+     */
+    Simulated.begin();
+
+    /* Plots the legend on Serial Plotter */
+    Serial.println("Simulated\r\n");
+}
+
+/*****************************************************************************/
+/*LOOP (runtime super loop)                                                  */
+/*****************************************************************************/
+void loop()
+{
+    if(Simulated.popWait(simulatedData, 1000))
+    {
+        Serial.println(simulatedData.value);
+    }
+}
@@ -0,0 +1,182 @@
+/*
+  Nano33BLESensorExample_soaBenchmark.ino
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+  This program is an example program showing some of the cababilities of the 
+  Nano33BLESensor Library. In this case it times getting a window of 
+  accelerometer data into separate x[], y[] and z[] arrays (structure of
+  arrays) for DSP code, first by popping the data and transposing it, then
+  with popChannels(). It also times converting raw int16 samples to floats
+  with a plain loop and with Nano33BLESampleConvert. The buffer is filled
+  with made up data so the timings do not depend on the sensor. The results
+  are output via serial.
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/*****************************************************************************/
+/*INCLUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLESampleConvert.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Each timing is the total over this many repeats */
+#define BENCHMARK_REPEATS           (1000U)
+/* Raw samples converted per repeat, e.g. one microphone buffer */
+#define BENCHMARK_RAW_SAMPLES       (256U)
+/* LSM9DS1 sensitivity at +/-4g, in g per LSB */
+#define BENCHMARK_RAW_SCALE         (0.000122F)
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * An accelerometer buffer the benchmark can fill itself.
+ */
+class BenchmarkBuffer: public Nano33BLESensorBuffer<Nano33BLEAccelerometerData>
+{
+  public:
+    void fill(void)
+    {
+      Nano33BLEAccelerometerData data;
+      uint32_t ii;
+
+      for(ii = 0; ii < BUFFER_SIZE; ii++)
+      {
+        data.x = ii * 0.01F;
+        data.y = ii * -0.01F;
+        data.z = 1.0F;
+        data.timeStampMs = ii;
+        push(data);
+      }
+    }
+};
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+BenchmarkBuffer benchmarkBuffer;
+Nano33BLEAccelerometerData structs[BUFFER_SIZE];
+float x[BUFFER_SIZE];
+float y[BUFFER_SIZE];
+float z[BUFFER_SIZE];
+uint32_t timeStamps[BUFFER_SIZE];
+float* const channels[] = {x, y, z};
+
+int16_t rawSamples[BENCHMARK_RAW_SAMPLES];
+float convertedSamples[BENCHMARK_RAW_SAMPLES];
+
+/* Keeps the compiler from removing the benchmark loops */
+volatile float sink;
+
+/*****************************************************************************/
+/*SETUP (Initialisation)                                                     */
+/*****************************************************************************/
+void setup()
+{
+    uint32_t start;
+    uint32_t popTranspose_us;
+    uint32_t popChannels_us;
+    uint32_t loop_us;
+    uint32_t convert_us;
+    uint32_t repeat;
+    uint32_t count;
+    uint32_t ii;
+
+    Serial.begin(115200);
+    while(!Serial);
+
+    for(ii = 0; ii < BENCHMARK_RAW_SAMPLES; ii++)
+    {
+        rawSamples[ii] = (int16_t)((ii * 257U) - 32768);
+    }
+
+    /* Pop BUFFER_SIZE structs, then transpose them into x[], y[] and z[] */
+    popTranspose_us = 0;
+    for(repeat = 0; repeat < BENCHMARK_REPEATS; repeat++)
+    {
+        benchmarkBuffer.fill();
+        start = micros();
+        count = benchmarkBuffer.popMultiple(structs, BUFFER_SIZE);
+        for(ii = 0; ii < count; ii++)
+        {
+            x[ii] = structs[ii].x;
+            y[ii] = structs[ii].y;
+            z[ii] = structs[ii].z;
+            timeStamps[ii] = structs[ii].timeStampMs;
+        }
+        popTranspose_us += micros() - start;
+        sink = x[count - 1U];
+    }
+
+    /* Pop straight into x[], y[] and z[] */
+    popChannels_us = 0;
+    for(repeat = 0; repeat < BENCHMARK_REPEATS; repeat++)
+    {
+        benchmarkBuffer.fill();
+        start = micros();
+        count = benchmarkBuffer.popChannels(channels, timeStamps, BUFFER_SIZE);
+        popChannels_us += micros() - start;
+        sink = x[count - 1U];
+    }
+
+    /* Convert raw int16 samples one at a time */
+    start = micros();
+    for(repeat = 0; repeat < BENCHMARK_REPEATS; repeat++)
+    {
+        for(ii = 0; ii < BENCHMARK_RAW_SAMPLES; ii++)
+        {
+            convertedSamples[ii] = rawSamples[ii] * BENCHMARK_RAW_SCALE;
+        }
+        sink = convertedSamples[repeat % BENCHMARK_RAW_SAMPLES];
+    }
+    loop_us = micros() - start;
+
+    /* Convert them with the block kernel */
+    start = micros();
+    for(repeat = 0; repeat < BENCHMARK_REPEATS; repeat++)
+    {
+        Nano33BLESampleConvert::int16ToFloat(rawSamples, convertedSamples, 
+          BENCHMARK_RAW_SAMPLES, BENCHMARK_RAW_SCALE);
+        sink = convertedSamples[repeat % BENCHMARK_RAW_SAMPLES];
+    }
+    convert_us = micros() - start;
+
+    Serial.print("Pop and transpose of ");
+    Serial.print(BUFFER_SIZE);
+    Serial.print(" readings: ");
+    Serial.print((float)popTranspose_us / BENCHMARK_REPEATS);
+    Serial.println("us");
+    Serial.print("popChannels() of ");
+    Serial.print(BUFFER_SIZE);
+    Serial.print(" readings: ");
+    Serial.print((float)popChannels_us / BENCHMARK_REPEATS);
+    Serial.println("us");
+    Serial.print("Loop conversion of ");
+    Serial.print(BENCHMARK_RAW_SAMPLES);
+    Serial.print(" int16 samples: ");
+    Serial.print((float)loop_us / BENCHMARK_REPEATS);
+    Serial.println("us");
+    Serial.print("int16ToFloat() of ");
+    Serial.print(BENCHMARK_RAW_SAMPLES);
+    Serial.print(" int16 samples: ");
+    Serial.print((float)convert_us / BENCHMARK_REPEATS);
+    Serial.println("us");
+}
+
+/*****************************************************************************/
+/*LOOP (runtime super loop)                                                  */
+/*****************************************************************************/
+void loop()
+{
+}
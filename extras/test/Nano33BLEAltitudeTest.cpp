@@ -0,0 +1,272 @@
+/*
+  Nano33BLEAltitudeTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLEAltitude. The series pressureToAltitude() uses for the
+  barometric formula is checked against powf() over the documented range.
+  The Kalman filter is then run on a simulated climb: accelerometer 
+  readings with noise and a bias, and noisy pressure readings arriving in
+  LPS22HB FIFO bursts, are replayed into the sensors and Altitude.read() is
+  called for each accelerometer reading. The estimates must follow the
+  true altitude more closely than the pressure alone, and the true 
+  vertical speed.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLEAltitude.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define STANDARD_GRAVITY_MPS2       (9.80665F)
+#define BAROMETRIC_SCALE_M          (44330.0F)
+#define BAROMETRIC_EXPONENT         (0.190295F)
+/* The range pressureToAltitude() is documented for, as a ratio of p0, and
+ * its error there */
+#define PRESSURE_RATIO_MIN          (0.45F)
+#define PRESSURE_RATIO_MAX          (1.12F)
+#define PRESSURE_RATIO_STEPS        (10000U)
+#define ALTITUDE_MAX_ERROR_M        (0.04F)
+
+#define ACCELEROMETER_PERIOD_MS     (10U)
+#define PRESSURE_PERIOD_MS          (40U)
+/* How often the pressure FIFO is read */
+#define PRESSURE_BURST_PERIOD_MS    (100U)
+#define RUN_TIME_MS                 (30000U)
+/* At rest, then a climb and back down, then at rest */
+#define START_ALTITUDE_M            (50.0F)
+#define CLIMB_START_MS              (12000U)
+#define CLIMB_TIME_MS               (8000U)
+#define CLIMB_HEIGHT_M              (10.0F)
+/* How long the filter is given to settle before it is checked. The 
+ * accelerometer bias takes several seconds to learn from noisy pressure */
+#define SETTLE_TIME_MS              (10000U)
+/* Largest noise either side, and the accelerometer bias, in g */
+#define ACCELERATION_NOISE_G        (0.02F)
+#define ACCELERATION_BIAS_G         (0.01F)
+/* Largest noise either side of the pressure altitude, in m */
+#define PRESSURE_NOISE_M            (0.8F)
+/* The board is tilted, so gravity is not along one axis */
+#define TILT_RADIANS                (0.3F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static uint32_t seed = 0x2468ACE1U;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @return a repeatable random number from -1 to 1.
+ */
+static float noise(void)
+{
+  seed = (seed * 1664525U) + 1013904223U;
+  return (((float)(seed >> 8) / (float)(1U << 24)) * 2.0F) - 1.0F;
+}
+
+static float referenceAltitude(float pressure_kPa, float seaLevelPressure_kPa)
+{
+  return (float)(BAROMETRIC_SCALE_M * 
+    (1.0 - pow((double)pressure_kPa / seaLevelPressure_kPa, BAROMETRIC_EXPONENT)));
+}
+
+static float altitudeToPressure(float altitude_m, float seaLevelPressure_kPa)
+{
+  return (float)(seaLevelPressure_kPa * 
+    pow(1.0 - ((double)altitude_m / BAROMETRIC_SCALE_M), 1.0 / BAROMETRIC_EXPONENT));
+}
+
+/**
+ * @brief The true altitude, vertical speed and vertical acceleration at
+ * time_ms: a smooth climb of CLIMB_HEIGHT_M and back down.
+ */
+static void trajectory(uint32_t time_ms, float& altitude, float& speed, float& acceleration)
+{
+  float w;
+  float c;
+  float s;
+
+  /* (1 - cos)^2 so the acceleration starts and ends at 0 too */
+  altitude = START_ALTITUDE_M;
+  speed = 0.0F;
+  acceleration = 0.0F;
+  if((time_ms > CLIMB_START_MS) && (time_ms < (CLIMB_START_MS + CLIMB_TIME_MS)))
+  {
+    w = (2.0F * (float)M_PI) / (CLIMB_TIME_MS / 1000.0F);
+    c = cosf(w * ((time_ms - CLIMB_START_MS) / 1000.0F));
+    s = sinf(w * ((time_ms - CLIMB_START_MS) / 1000.0F));
+    altitude += (CLIMB_HEIGHT_M / 4.0F) * (1.0F - c) * (1.0F - c);
+    speed = (CLIMB_HEIGHT_M / 2.0F) * w * (1.0F - c) * s;
+    acceleration = (CLIMB_HEIGHT_M / 2.0F) * w * w * ((s * s) + ((1.0F - c) * c));
+  }
+  return;
+}
+
+static void testPressureToAltitude(void)
+{
+  const float seaLevelPressures[] = {DEFAULT_SEA_LEVEL_PRESSURE_KPA, 98.0F, 103.5F};
+  float seaLevelPressure;
+  float pressure;
+  float error;
+  float maxError;
+  uint32_t ii;
+  uint32_t jj;
+
+  maxError = 0.0F;
+  for(jj = 0; jj < (sizeof(seaLevelPressures) / sizeof(seaLevelPressures[0])); jj++)
+  {
+    seaLevelPressure = seaLevelPressures[jj];
+    CHECK(Nano33BLEAltitude::pressureToAltitude(seaLevelPressure, seaLevelPressure) == 0.0F);
+    for(ii = 0; ii <= PRESSURE_RATIO_STEPS; ii++)
+    {
+      pressure = seaLevelPressure * (PRESSURE_RATIO_MIN + 
+        (((PRESSURE_RATIO_MAX - PRESSURE_RATIO_MIN) * ii) / PRESSURE_RATIO_STEPS));
+      error = fabsf(Nano33BLEAltitude::pressureToAltitude(pressure, seaLevelPressure) - 
+        referenceAltitude(pressure, seaLevelPressure));
+      if(error > maxError)
+      {
+        maxError = error;
+      }
+    }
+  }
+  printf("pressure to altitude: %.4fm largest error\n", maxError);
+  CHECK(maxError <= ALTITUDE_MAX_ERROR_M);
+
+  /* A few known points of the standard atmosphere */
+  CHECK_NEAR(Nano33BLEAltitude::pressureToAltitude(89.876F, 101.325F), 1000.0F, 1.0F);
+  CHECK_NEAR(Nano33BLEAltitude::pressureToAltitude(79.501F, 101.325F), 2000.0F, 1.0F);
+  return;
+}
+
+static void testFilter(void)
+{
+  Nano33BLEAccelerometerData acceleration;
+  Nano33BLEPressureData pressure;
+  Nano33BLEAltitudeData estimate;
+  float altitude;
+  float speed;
+  float vertical;
+  float pressureAltitude;
+  float altitudeError;
+  float speedError;
+  float altitudeSquares;
+  float speedSquares;
+  float pressureSquares;
+  float maxAltitudeError;
+  float maxSpeedError;
+  uint32_t count;
+  uint32_t pressureCount;
+  uint32_t time_ms;
+  uint32_t sample_ms;
+
+  hostReset();
+  Altitude.setSeaLevelPressure(DEFAULT_SEA_LEVEL_PRESSURE_KPA);
+  while(Altitude.pop(estimate));
+
+  count = 0;
+  pressureCount = 0;
+  altitudeSquares = 0.0F;
+  speedSquares = 0.0F;
+  pressureSquares = 0.0F;
+  maxAltitudeError = 0.0F;
+  maxSpeedError = 0.0F;
+  sample_ms = 0;
+  for(time_ms = 0; time_ms < RUN_TIME_MS; time_ms += ACCELEROMETER_PERIOD_MS)
+  {
+    /* The FIFO is read every PRESSURE_BURST_PERIOD_MS, giving every sample
+     * taken since, each stamped with when it was taken */
+    if((time_ms % PRESSURE_BURST_PERIOD_MS) == 0U)
+    {
+      for(; sample_ms <= time_ms; sample_ms += PRESSURE_PERIOD_MS)
+      {
+        trajectory(sample_ms, altitude, speed, vertical);
+        pressureAltitude = altitude + (noise() * PRESSURE_NOISE_M);
+        pressure.barometricPressure = 
+          altitudeToPressure(pressureAltitude, DEFAULT_SEA_LEVEL_PRESSURE_KPA);
+        pressure.temperatureCelsius = 20.0F;
+        pressure.timeStampMs = sample_ms;
+        Pressure.replay(&pressure, sizeof(pressure));
+        if(sample_ms >= SETTLE_TIME_MS)
+        {
+          pressureSquares += (pressureAltitude - altitude) * (pressureAltitude - altitude);
+          pressureCount++;
+        }
+      }
+    }
+
+    /* Gravity and the vertical acceleration, tilted about x, plus noise */
+    trajectory(time_ms, altitude, speed, vertical);
+    vertical = 1.0F + (vertical / STANDARD_GRAVITY_MPS2) + ACCELERATION_BIAS_G;
+    acceleration.x = noise() * ACCELERATION_NOISE_G;
+    acceleration.y = (vertical * sinf(TILT_RADIANS)) + (noise() * ACCELERATION_NOISE_G);
+    acceleration.z = (vertical * cosf(TILT_RADIANS)) + (noise() * ACCELERATION_NOISE_G);
+    acceleration.timeStampMs = time_ms;
+    Accelerometer.replay(&acceleration, sizeof(acceleration));
+    hostRunUntil(time_ms);
+    Altitude.read();
+
+    while(Altitude.pop(estimate))
+    {
+      CHECK(estimate.timeStampMs == time_ms);
+      if(estimate.timeStampMs < SETTLE_TIME_MS)
+      {
+        continue;
+      }
+      altitudeError = fabsf(estimate.altitude - altitude);
+      speedError = fabsf(estimate.verticalSpeed - speed);
+      altitudeSquares += altitudeError * altitudeError;
+      speedSquares += speedError * speedError;
+      if(altitudeError > maxAltitudeError)
+      {
+        maxAltitudeError = altitudeError;
+      }
+      if(speedError > maxSpeedError)
+      {
+        maxSpeedError = speedError;
+      }
+      count++;
+    }
+  }
+
+  altitudeSquares = sqrtf(altitudeSquares / count);
+  speedSquares = sqrtf(speedSquares / count);
+  pressureSquares = sqrtf(pressureSquares / pressureCount);
+  printf("altitude filter: %u estimates, altitude %.3fm RMS (%.3fm largest), "
+    "speed %.3fm/s RMS (%.3fm/s largest), pressure alone %.3fm RMS\n",
+    count, altitudeSquares, maxAltitudeError, speedSquares, maxSpeedError, pressureSquares);
+  CHECK(count == ((RUN_TIME_MS - SETTLE_TIME_MS) / ACCELEROMETER_PERIOD_MS));
+  CHECK(altitudeSquares < (pressureSquares / 2.0F));
+  CHECK(maxAltitudeError < (PRESSURE_NOISE_M / 2.0F));
+  CHECK(speedSquares < 0.1F);
+  CHECK(maxSpeedError < 0.3F);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testPressureToAltitude();
+  testFilter();
+  return hostTestResult("Nano33BLEAltitudeTest");
+}
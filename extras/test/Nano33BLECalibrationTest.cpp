@@ -0,0 +1,221 @@
+/*
+  Nano33BLECalibrationTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLECalibration. Magnetometer readings of a distorted field
+  only gather sums on the read thread, and update() then finds the hard
+  and soft iron correction. The gyroscope bias is learned while the board
+  is still, but not during a slow steady turn or without accelerometer
+  readings to show the board is still.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "Nano33BLECalibration.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define FIELD_UT                    (50.0F)
+#define MAGNETIC_READING_COUNT      (300U)
+/* The gyroscope and accelerometer rate */
+#define READ_RATE_HZ                (119.0F)
+#define TURN_RATE_DPS               (5.0F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static const float hardIron[3] = {20.0F, -10.0F, 5.0F};
+static const float softIron[3][3] =
+{
+  {1.2F, 0.05F, 0.0F},
+  {0.05F, 0.9F, 0.02F},
+  {0.0F, 0.02F, 1.0F}
+};
+static const float bias[3] = {0.5F, -0.3F, 0.2F};
+static uint32_t randomState = 12345;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static float randomFloat(float minimum, float maximum)
+{
+  randomState = (randomState * 1664525U) + 1013904223U;
+  return minimum + ((maximum - minimum) * (float)(randomState >> 8) / (float)(1U << 24));
+}
+
+/**
+ * @brief Makes the raw reading of the field in direction index of
+ * MAGNETIC_READING_COUNT directions spread over a sphere.
+ */
+static void makeMagneticReading(uint32_t index, float* raw)
+{
+  float direction[3];
+  float z;
+  float radius;
+  float angle;
+  uint32_t ii;
+
+  z = 1.0F - ((2.0F * ((float)index + 0.5F)) / MAGNETIC_READING_COUNT);
+  radius = sqrtf(1.0F - (z * z));
+  angle = (float)index * 2.39996323F;
+  direction[0] = radius * cosf(angle);
+  direction[1] = radius * sinf(angle);
+  direction[2] = z;
+  for(ii = 0; ii < 3U; ii++)
+  {
+    raw[ii] = hardIron[ii] + (FIELD_UT * ((softIron[ii][0] * direction[0]) +
+      (softIron[ii][1] * direction[1]) + (softIron[ii][2] * direction[2])));
+  }
+  return;
+}
+
+static void testMagnetic(void)
+{
+  Nano33BLECalibration calibration;
+  Nano33BLECalibrationData data;
+  float raw[3];
+  float magnitude;
+  float minMagnitude;
+  float maxMagnitude;
+  uint32_t ii;
+
+  for(ii = 0; ii < MAGNETIC_READING_COUNT; ii++)
+  {
+    makeMagneticReading(ii, raw);
+    calibration.correctMagnetic(raw[0], raw[1], raw[2]);
+  }
+  CHECK(calibration.getMagneticSampleCount() >= MAGNETIC_CALIBRATION_MIN_SAMPLES);
+
+  /* The read thread only gathered the readings */
+  calibration.getData(data);
+  CHECK(data.magneticOffset[0] == 0.0F);
+  CHECK(data.magneticMatrix[0][0] == 1.0F);
+
+  CHECK(calibration.update());
+  CHECK(!calibration.update());
+  calibration.getData(data);
+  for(ii = 0; ii < 3U; ii++)
+  {
+    CHECK_NEAR(data.magneticOffset[ii], hardIron[ii], 0.1);
+  }
+
+  /* Corrected, every reading has the same size */
+  calibration.setLearning(false);
+  minMagnitude = 1000.0F;
+  maxMagnitude = 0.0F;
+  for(ii = 0; ii < MAGNETIC_READING_COUNT; ii++)
+  {
+    makeMagneticReading(ii, raw);
+    calibration.correctMagnetic(raw[0], raw[1], raw[2]);
+    magnitude = sqrtf((raw[0] * raw[0]) + (raw[1] * raw[1]) + (raw[2] * raw[2]));
+    minMagnitude = fminf(minMagnitude, magnitude);
+    maxMagnitude = fmaxf(maxMagnitude, magnitude);
+  }
+  printf("corrected field %.2f to %.2f uT\n", minMagnitude, maxMagnitude);
+  CHECK(maxMagnitude < (minMagnitude * 1.01F));
+  return;
+}
+
+/**
+ * @brief Feeds one gyroscope stillness window of readings, each after an
+ * accelerometer reading if withAccelerometer.
+ *
+ * @param turn_dps steady turn about the x axis, which also turns gravity.
+ */
+static void feedGyroscope(
+  Nano33BLECalibration& calibration,
+  float turn_dps,
+  bool withAccelerometer,
+  float& time_s)
+{
+  Nano33BLEAccelerometerData acceleration;
+  float rate[3];
+  float angle;
+  uint32_t ii;
+
+  for(ii = 0; ii < GYROSCOPE_CALIBRATION_WINDOW_SIZE; ii++)
+  {
+    if(withAccelerometer)
+    {
+      angle = turn_dps * time_s * (float)PI / 180.0F;
+      acceleration.x = randomFloat(-0.001F, 0.001F);
+      acceleration.y = sinf(angle) + randomFloat(-0.001F, 0.001F);
+      acceleration.z = cosf(angle) + randomFloat(-0.001F, 0.001F);
+      acceleration.timeStampMs = (uint32_t)(time_s * 1000.0F);
+      Accelerometer.replay(&acceleration, sizeof(acceleration));
+    }
+
+    rate[0] = bias[0] + turn_dps + randomFloat(-0.05F, 0.05F);
+    rate[1] = bias[1] + randomFloat(-0.05F, 0.05F);
+    rate[2] = bias[2] + randomFloat(-0.05F, 0.05F);
+    calibration.correctGyroscope(rate[0], rate[1], rate[2]);
+    time_s += 1.0F / READ_RATE_HZ;
+  }
+  return;
+}
+
+static void testGyroscope(void)
+{
+  Nano33BLECalibration calibration;
+  Nano33BLECalibrationData data;
+  float time_s;
+  uint32_t ii;
+
+  /* Still, with the accelerometer to show it */
+  time_s = 0.0F;
+  feedGyroscope(calibration, 0.0F, true, time_s);
+  calibration.getData(data);
+  for(ii = 0; ii < 3U; ii++)
+  {
+    CHECK_NEAR(data.gyroscopeBias[ii], bias[ii], 0.02);
+  }
+
+  /* A slow steady turn barely changes the rate, but is not bias */
+  for(ii = 0; ii < 10U; ii++)
+  {
+    feedGyroscope(calibration, TURN_RATE_DPS, true, time_s);
+  }
+  calibration.getData(data);
+  CHECK_NEAR(data.gyroscopeBias[0], bias[0], 0.02);
+  return;
+}
+
+static void testGyroscopeWithoutAccelerometer(void)
+{
+  Nano33BLECalibration calibration;
+  Nano33BLECalibrationData data;
+  float time_s;
+
+  time_s = 0.0F;
+  feedGyroscope(calibration, 0.0F, false, time_s);
+  calibration.getData(data);
+  CHECK(data.gyroscopeBias[0] == 0.0F);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testMagnetic();
+  testGyroscope();
+  testGyroscopeWithoutAccelerometer();
+  return hostTestResult("Nano33BLECalibrationTest");
+}
@@ -0,0 +1,214 @@
+/*
+  Nano33BLEClassifierTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests the accuracy and inference time of the reference motion models on
+  simulated accelerometer windows of each class, with random tilt, tap
+  size, shake amplitude and frequency, and noise. Features are calculated
+  the same way Nano33BLEWindowFeatures does. The inference time is of the
+  host, so only shows the relative cost of the models.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEClassifier.h"
+#include <chrono>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define WINDOW_SIZE                 (64U)
+#define WINDOWS_PER_CLASS           (250U)
+#define MIN_ACCURACY                (0.98)
+/* Generous, as the host may be slow or busy */
+#define MAX_INFERENCE_TIME_US       (20.0)
+#define NOISE_G                     (0.01F)
+
+typedef Nano33BLEWindowFeaturesData<3> Features;
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static const char* const classNames[MOTION_CLASS_COUNT] = {"still", "tilted", "tap", "shake"};
+static uint32_t randomState = 12345;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @return a repeatable random number from minimum to maximum.
+ */
+static float randomFloat(float minimum, float maximum)
+{
+  randomState = (randomState * 1664525U) + 1013904223U;
+  return minimum + ((maximum - minimum) * (float)(randomState >> 8) / (float)(1U << 24));
+}
+
+/**
+ * @brief Simulates one window of accelerometer readings of a class and
+ * calculates its features.
+ */
+static Features makeWindow(uint32_t motionClass)
+{
+  Nano33BLEWindowChannel<WINDOW_SIZE> channels[3];
+  Features features;
+  float tilt;
+  float tap_g;
+  uint32_t tapIndex;
+  float amplitude_g;
+  float cycles;
+  float x;
+  float z;
+  uint32_t ii;
+
+  tilt = randomFloat(40.0F, 80.0F) * (float)PI / 180.0F;
+  tap_g = randomFloat(0.6F, 1.0F);
+  tapIndex = (uint32_t)randomFloat(0.0F, (float)WINDOW_SIZE);
+  amplitude_g = randomFloat(0.4F, 1.0F);
+  cycles = randomFloat(2.0F, 8.0F);
+  for(ii = 0; ii < WINDOW_SIZE; ii++)
+  {
+    x = 0.0F;
+    z = 1.0F;
+    if(motionClass == MOTION_CLASS_TILTED)
+    {
+      x = sinf(tilt);
+      z = cosf(tilt);
+    }
+    else if((motionClass == MOTION_CLASS_TAP) && (ii == tapIndex))
+    {
+      z += tap_g;
+    }
+    else if(motionClass == MOTION_CLASS_SHAKE)
+    {
+      z += amplitude_g * sinf(2.0F * (float)PI * cycles * (float)ii / (float)WINDOW_SIZE);
+    }
+    channels[0].add(x + randomFloat(-NOISE_G, NOISE_G));
+    channels[1].add(randomFloat(-NOISE_G, NOISE_G));
+    channels[2].add(z + randomFloat(-NOISE_G, NOISE_G));
+  }
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    features.mean[ii] = channels[ii].getMean();
+    features.variance[ii] = channels[ii].getVariance();
+    features.min[ii] = channels[ii].getMin();
+    features.max[ii] = channels[ii].getMax();
+    features.rms[ii] = channels[ii].getRMS();
+    features.peakToPeak[ii] = features.max[ii] - features.min[ii];
+    features.zeroCrossings[ii] = channels[ii].getZeroCrossings();
+  }
+  features.timeStampMs = 0;
+  return features;
+}
+
+/**
+ * @brief Classifies WINDOWS_PER_CLASS windows of each class with a model,
+ * and checks the accuracy and inference time.
+ */
+static void checkModel(const char* name, const Nano33BLEClassifierModel& model)
+{
+  static Features windows[MOTION_CLASS_COUNT][WINDOWS_PER_CLASS];
+  uint32_t confusion[MOTION_CLASS_COUNT][MOTION_CLASS_COUNT];
+  std::chrono::steady_clock::time_point start;
+  double elapsed_us;
+  float confidence;
+  float confidenceSum;
+  uint32_t correct;
+  uint32_t label;
+  uint32_t motionClass;
+  uint32_t ii;
+
+  randomState = 12345;
+  for(motionClass = 0; motionClass < MOTION_CLASS_COUNT; motionClass++)
+  {
+    for(ii = 0; ii < WINDOWS_PER_CLASS; ii++)
+    {
+      windows[motionClass][ii] = makeWindow(motionClass);
+    }
+  }
+
+  memset(confusion, 0, sizeof(confusion));
+  correct = 0;
+  confidenceSum = 0.0F;
+  start = std::chrono::steady_clock::now();
+  for(motionClass = 0; motionClass < MOTION_CLASS_COUNT; motionClass++)
+  {
+    for(ii = 0; ii < WINDOWS_PER_CLASS; ii++)
+    {
+      label = Nano33BLEClassifier<3>::classify(model, windows[motionClass][ii], confidence);
+      CHECK(label < MOTION_CLASS_COUNT);
+      CHECK((confidence > 0.0F) && (confidence <= 1.0F));
+      if(label < MOTION_CLASS_COUNT)
+      {
+        confusion[motionClass][label]++;
+      }
+      if(label == motionClass)
+      {
+        correct++;
+        confidenceSum += confidence;
+      }
+    }
+  }
+  elapsed_us = std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - start).count() / (MOTION_CLASS_COUNT * WINDOWS_PER_CLASS);
+
+  printf("%s: accuracy %.3f, mean confidence when right %.2f, %.3fus per window\n",
+    name, (double)correct / (MOTION_CLASS_COUNT * WINDOWS_PER_CLASS),
+    confidenceSum / (float)correct, elapsed_us);
+  for(motionClass = 0; motionClass < MOTION_CLASS_COUNT; motionClass++)
+  {
+    printf("  %-6s:", classNames[motionClass]);
+    for(ii = 0; ii < MOTION_CLASS_COUNT; ii++)
+    {
+      printf(" %4u", confusion[motionClass][ii]);
+    }
+    printf("\n");
+    CHECK(confusion[motionClass][motionClass] >= (uint32_t)(MIN_ACCURACY * WINDOWS_PER_CLASS));
+  }
+  CHECK(elapsed_us < MAX_INFERENCE_TIME_US);
+  return;
+}
+
+static void testBadlyFormedDenseModel(void)
+{
+  Nano33BLEClassifierModel model;
+  Features features;
+  float confidence;
+
+  /* A dense model with no layers must not read scores it never set */
+  model = AccelerometerMotionDenseModel;
+  model.layerCount = 0;
+  memset(&features, 0, sizeof(features));
+  confidence = 1.0F;
+  CHECK(Nano33BLEClassifier<3>::classify(model, features, confidence) == 0U);
+  CHECK(confidence == 0.0F);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  checkModel("decision tree", AccelerometerMotionModel);
+  checkModel("dense", AccelerometerMotionDenseModel);
+  testBadlyFormedDenseModel();
+  return hostTestResult("Nano33BLEClassifierTest");
+}
\ No newline at end of file
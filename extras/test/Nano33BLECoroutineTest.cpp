@@ -0,0 +1,264 @@
+/*
+  Nano33BLECoroutineTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLECoroutineScheduler on the host build's simulated clock.
+  Coroutines co_await the accelerometer's next() and a reader's batch()
+  while readings are replayed into its buffer between runFor() calls, and
+  a periodic coroutine sleeps to fixed deadlines. Frames come from the
+  static pool and are given back when the coroutines finish.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLECoroutine.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define NEXT_COUNT                  (5U)
+#define BATCH_SIZE                  (8U)
+#define SLEEP_COUNT                 (5U)
+#define SLEEP_PERIOD_MS             (100U)
+#define STEP_MS                     (10U)
+
+#ifdef COROUTINES_SUPPORTED
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static uint32_t readingCount = 0;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Pushes readings to the accelerometer's buffer, each with x set to
+ * its number so the order they arrive in can be checked.
+ */
+static void pushReadings(uint32_t count)
+{
+  Nano33BLEAccelerometerData data;
+  uint32_t ii;
+
+  for(ii = 0; ii < count; ii++)
+  {
+    data.x = (float)readingCount;
+    data.y = 0.0F;
+    data.z = 1.0F;
+    data.timeStampMs = (uint32_t)CoroutineScheduler.getTime();
+    readingCount++;
+    Accelerometer.replay(&data, sizeof(data));
+  }
+  return;
+}
+
+static Nano33BLETask readNext(uint32_t count, float* values, uint32_t& received)
+{
+  Nano33BLEAccelerometerData data;
+
+  while(received < count)
+  {
+    data = co_await Accelerometer.next();
+    values[received] = data.x;
+    received++;
+  }
+}
+
+static Nano33BLETask readBatch(
+  Nano33BLESensorReader<Nano33BLEAccelerometerData>& reader,
+  Nano33BLEAccelerometerData* buffer,
+  uint32_t& popped)
+{
+  popped = co_await reader.batch(buffer, BATCH_SIZE);
+}
+
+static Nano33BLETask sleepPeriodically(uint64_t* wakeTimes, uint32_t& wakeCount)
+{
+  uint64_t deadline_ms;
+
+  deadline_ms = CoroutineScheduler.getTime();
+  while(wakeCount < SLEEP_COUNT)
+  {
+    wakeTimes[wakeCount] = CoroutineScheduler.getTime();
+    wakeCount++;
+    deadline_ms += SLEEP_PERIOD_MS;
+    co_await CoroutineScheduler.sleepUntil(deadline_ms);
+  }
+}
+
+static void testNext(void)
+{
+  float values[NEXT_COUNT];
+  uint32_t received;
+  uint32_t first;
+  uint32_t ii;
+
+  received = 0;
+  first = readingCount;
+  CHECK(CoroutineScheduler.start(readNext(NEXT_COUNT, values, received)));
+  CHECK(CoroutineScheduler.getTaskCount() == 1U);
+
+  /* Suspended until there is a reading */
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received == 0U);
+  pushReadings(1);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received == 1U);
+
+  /* Readings already there are taken without suspending again */
+  pushReadings(NEXT_COUNT - 2U);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received == (NEXT_COUNT - 1U));
+  CHECK(CoroutineScheduler.getTaskCount() == 1U);
+  pushReadings(1);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received == NEXT_COUNT);
+
+  for(ii = 0; ii < NEXT_COUNT; ii++)
+  {
+    CHECK(values[ii] == (float)(first + ii));
+  }
+  CHECK(CoroutineScheduler.getTaskCount() == 0U);
+  CHECK(Nano33BLECoroutineScheduler::getFramesUsed() == 0U);
+  return;
+}
+
+static void testBatch(void)
+{
+  Nano33BLESensorReader<Nano33BLEAccelerometerData> reader(Accelerometer);
+  Nano33BLEAccelerometerData buffer[BATCH_SIZE];
+  float values[1];
+  uint32_t popped;
+  uint32_t received;
+  uint32_t first;
+  uint32_t ii;
+
+  popped = 0;
+  received = 0;
+  first = readingCount;
+  CHECK(CoroutineScheduler.start(readBatch(reader, buffer, popped)));
+  CHECK(CoroutineScheduler.start(readNext(1, values, received)));
+  CHECK(CoroutineScheduler.getTaskCount() == 2U);
+
+  /* The reader and the buffer have their own cursors, so both get the
+   * first reading, and the batch waits until it is full */
+  pushReadings(BATCH_SIZE - 1U);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received == 1U);
+  CHECK(values[0] == (float)first);
+  CHECK(popped == 0U);
+  CHECK(CoroutineScheduler.getTaskCount() == 1U);
+
+  pushReadings(1);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(popped == BATCH_SIZE);
+  for(ii = 0; ii < BATCH_SIZE; ii++)
+  {
+    CHECK(buffer[ii].x == (float)(first + ii));
+  }
+  CHECK(reader.getOverrunCount() == 0U);
+  CHECK(CoroutineScheduler.getTaskCount() == 0U);
+  CHECK(Nano33BLECoroutineScheduler::getFramesUsed() == 0U);
+
+  /* Leave the buffer's own cursor at the end for the next test */
+  while(Accelerometer.popMultiple(buffer, BATCH_SIZE) > 0U)
+  {
+  }
+  return;
+}
+
+static void testSleep(void)
+{
+  uint64_t wakeTimes[SLEEP_COUNT];
+  uint64_t start_ms;
+  uint32_t wakeCount;
+  uint32_t ii;
+
+  wakeCount = 0;
+  start_ms = CoroutineScheduler.getTime();
+  CHECK(CoroutineScheduler.start(sleepPeriodically(wakeTimes, wakeCount)));
+
+  /* Time jumps from deadline to deadline, and stops at the end */
+  CoroutineScheduler.runFor((SLEEP_PERIOD_MS * 2U) + (SLEEP_PERIOD_MS / 2U));
+  CHECK(wakeCount == 3U);
+  CHECK(CoroutineScheduler.getTime() == (start_ms + (SLEEP_PERIOD_MS * 2U) + (SLEEP_PERIOD_MS / 2U)));
+
+  CoroutineScheduler.runFor(SLEEP_PERIOD_MS * SLEEP_COUNT);
+  CHECK(wakeCount == SLEEP_COUNT);
+  for(ii = 0; ii < SLEEP_COUNT; ii++)
+  {
+    CHECK(wakeTimes[ii] == (start_ms + (ii * SLEEP_PERIOD_MS)));
+  }
+  CHECK(CoroutineScheduler.getTaskCount() == 0U);
+  return;
+}
+
+static void testFramePool(void)
+{
+  float values[COROUTINE_FRAME_COUNT];
+  uint32_t received[COROUTINE_FRAME_COUNT + 1U];
+  uint32_t failures;
+  uint32_t ii;
+
+  failures = Nano33BLECoroutineScheduler::getFrameFailures();
+  for(ii = 0; ii < COROUTINE_FRAME_COUNT; ii++)
+  {
+    received[ii] = 0;
+    CHECK(CoroutineScheduler.start(readNext(1, &values[ii], received[ii])));
+  }
+  CHECK(Nano33BLECoroutineScheduler::getFramesUsed() == COROUTINE_FRAME_COUNT);
+
+  /* The pool is full */
+  received[COROUTINE_FRAME_COUNT] = 0;
+  CHECK(!CoroutineScheduler.start(readNext(1, values, received[COROUTINE_FRAME_COUNT])));
+  CHECK(Nano33BLECoroutineScheduler::getFrameFailures() == (failures + 1U));
+  CHECK(CoroutineScheduler.getTaskCount() == COROUTINE_FRAME_COUNT);
+
+  /* They share the buffer's cursor, so each takes a different reading */
+  pushReadings(COROUTINE_FRAME_COUNT);
+  CoroutineScheduler.runFor(STEP_MS);
+  for(ii = 0; ii < COROUTINE_FRAME_COUNT; ii++)
+  {
+    CHECK(received[ii] == 1U);
+  }
+  CHECK(CoroutineScheduler.getTaskCount() == 0U);
+  CHECK(Nano33BLECoroutineScheduler::getFramesUsed() == 0U);
+  CHECK(CoroutineScheduler.start(readNext(1, values, received[COROUTINE_FRAME_COUNT])));
+  pushReadings(1);
+  CoroutineScheduler.runFor(STEP_MS);
+  CHECK(received[COROUTINE_FRAME_COUNT] == 1U);
+  return;
+}
+#endif /* COROUTINES_SUPPORTED */
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+#ifdef COROUTINES_SUPPORTED
+  testNext();
+  testBatch();
+  testSleep();
+  testFramePool();
+#else
+  printf("no C++20 coroutine support, not tested\n");
+#endif /* COROUTINES_SUPPORTED */
+  return hostTestResult("Nano33BLECoroutineTest");
+}
@@ -0,0 +1,333 @@
+/*
+  Nano33BLECustomSensorTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The host reference for adding your own sensor to the library. A simple
+  external I2C sensor is simulated on Nano33BLESimulatedBus, and a driver
+  for it is built on Nano33BLESensor exactly as a real one would be. The
+  test runs the driver with poll() on the simulated clock, and checks what
+  it publishes, how it uses the bus, and that duty cycling powers it down.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLESimulatedBus.h"
+#include "Nano33BLEStackProfiler.h"
+#include <functional>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* The simulated sensor's I2C address and registers */
+#define CUSTOM_SENSOR_ADDRESS               (0x29U)
+#define CUSTOM_SENSOR_CONTROL               (0x00U)
+#define CUSTOM_SENSOR_CONTROL_ENABLE        (0x01U)
+#define CUSTOM_SENSOR_STATUS                (0x01U)
+#define CUSTOM_SENSOR_STATUS_READY          (0x01U)
+/* Output, low byte first, in hundredths */
+#define CUSTOM_SENSOR_OUTPUT_L              (0x02U)
+#define CUSTOM_SENSOR_OUTPUT_H              (0x03U)
+#define CUSTOM_SENSOR_RATE_HZ               (50.0F)
+#define CUSTOM_SENSOR_WAKE_UP_TIME_MS       (2U)
+
+#define CUSTOM_READ_PERIOD_MS               (20U)
+#define CUSTOM_THREAD_STACK_SIZE_BYTES      (1024U)
+#define RUN_TIME_MS                         (2000U)
+#define BURST_MS                            (200U)
+#define INTERVAL_MS                         (1000U)
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief The simulated sensor: once enabled it converts at
+ * CUSTOM_SENSOR_RATE_HZ and sets the ready flag, which is cleared when the
+ * high output byte is read. Addresses always auto increment.
+ */
+class SimulatedCustomDevice: public Nano33BLESimulatedDevice
+{
+  public:
+    SimulatedCustomDevice() :
+      Nano33BLESimulatedDevice(CUSTOM_SENSOR_ADDRESS),
+      disableCount(0){};
+
+    Nano33BLESimulatedSignal value;
+    /* The number of times it was switched off */
+    uint32_t disableCount;
+
+  protected:
+    void update(uint32_t now_ms)
+    {
+      bool enabled;
+
+      enabled = ((this->registers[CUSTOM_SENSOR_CONTROL] & CUSTOM_SENSOR_CONTROL_ENABLE) != 0U);
+      if(getSamplesDue(this->clock, now_ms, enabled ? CUSTOM_SENSOR_RATE_HZ : 0.0F) > 0U)
+      {
+        setInt16(CUSTOM_SENSOR_OUTPUT_L, this->value.get(now_ms) * 100.0F);
+        this->registers[CUSTOM_SENSOR_STATUS] |= CUSTOM_SENSOR_STATUS_READY;
+      }
+    }
+
+    bool decodeAddress(uint8_t& reg)
+    {
+      (void)reg;
+      return true;
+    }
+
+    uint8_t readRegister(uint8_t reg)
+    {
+      if(reg == CUSTOM_SENSOR_OUTPUT_H)
+      {
+        this->registers[CUSTOM_SENSOR_STATUS] &= (uint8_t)~CUSTOM_SENSOR_STATUS_READY;
+      }
+      return this->registers[reg];
+    }
+
+    void writeRegister(uint8_t reg, uint8_t value)
+    {
+      if((reg == CUSTOM_SENSOR_CONTROL) &&
+        ((this->registers[reg] & CUSTOM_SENSOR_CONTROL_ENABLE) != 0U) &&
+        ((value & CUSTOM_SENSOR_CONTROL_ENABLE) == 0U))
+      {
+        this->disableCount++;
+      }
+      this->registers[reg] = value;
+    }
+
+  private:
+    Nano33BLESimulatedClock clock;
+};
+
+/**
+ * The data the custom sensor gives after each read. Like the on board
+ * sensors it must have a timeStampMs member, which Nano33BLESensor fills in.
+ */
+class CustomSensorData
+{
+  public:
+    float value;
+    uint32_t timeStampMs;
+};
+
+template<>
+class Nano33BLESensorChannels<CustomSensorData>
+{
+  public:
+    enum { CHANNEL_COUNT = 1 };
+    static float get(const CustomSensorData& data, uint32_t channel)
+    {
+      (void)channel;
+      return data.value;
+    }
+};
+
+/**
+ * @brief The driver. It only provides init(), read() and the power
+ * callbacks; Nano33BLESensor does the scheduling, buffering and time
+ * stamping.
+ */
+class CustomSensor: public Nano33BLESensor<CustomSensor, CustomSensorData>
+{
+  public:
+    CustomSensor() :
+      Nano33BLESensor<CustomSensor, CustomSensorData>(
+        "Custom",
+        TRACE_ID_NONE,
+        CUSTOM_READ_PERIOD_MS,
+        CUSTOM_SENSOR_WAKE_UP_TIME_MS,
+        osPriorityNormal,
+        CUSTOM_THREAD_STACK_SIZE_BYTES),
+      device(CUSTOM_SENSOR_ADDRESS){};
+
+  private:
+    friend class Nano33BLESensor<CustomSensor, CustomSensorData>;
+
+    void init(void)
+    {
+      device.writeRegister(CUSTOM_SENSOR_CONTROL, CUSTOM_SENSOR_CONTROL_ENABLE);
+    }
+
+    void read(void)
+    {
+      CustomSensorData data;
+      uint8_t status;
+      uint8_t output[2];
+
+      /* Only read once a new value is ready, then read it in one burst */
+      if(device.readRegister(CUSTOM_SENSOR_STATUS, status) &&
+        ((status & CUSTOM_SENSOR_STATUS_READY) != 0U) &&
+        device.readRegisters(CUSTOM_SENSOR_OUTPUT_L, output, sizeof(output)))
+      {
+        data.value = (int16_t)((output[1] << 8) | output[0]) / 100.0F;
+        publish(data);
+      }
+    }
+
+    void powerDown(void)
+    {
+      device.updateRegister(CUSTOM_SENSOR_CONTROL, CUSTOM_SENSOR_CONTROL_ENABLE, 0);
+    }
+
+    void powerUp(void)
+    {
+      device.updateRegister(CUSTOM_SENSOR_CONTROL, CUSTOM_SENSOR_CONTROL_ENABLE, CUSTOM_SENSOR_CONTROL_ENABLE);
+    }
+
+    Nano33BLEI2CDevice device;
+};
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief What the read thread would do until until_ms, keeping the bus
+ * time with the simulated clock. Calls check before every read.
+ */
+static void runSensor(
+  CustomSensor& sensor,
+  Nano33BLESimulatedBus& bus,
+  uint64_t until_ms,
+  std::function<void()> check)
+{
+  while(hostGetTime() < until_ms)
+  {
+    bus.setTime((uint32_t)hostGetTime());
+    check();
+    sensor.poll();
+  }
+  return;
+}
+
+static void testReads(void)
+{
+  Nano33BLESimulatedBus bus;
+  SimulatedCustomDevice device;
+  CustomSensor sensor;
+  CustomSensorData data;
+  uint32_t count;
+  uint32_t wrongCount;
+  uint32_t last_ms;
+
+  hostReset();
+  bus.attach(device);
+  Nano33BLEI2CDevice::setBus(&bus);
+  device.value.set(21.5F);
+
+  sensor.beginPolled();
+  bus.resetCounts();
+  count = 0;
+  wrongCount = 0;
+  last_ms = 0;
+  runSensor(sensor, bus, RUN_TIME_MS, [&](){
+    while(sensor.pop(data))
+    {
+      /* Every value arrives, one read period after the one before */
+      if((data.value != 21.5F) ||
+        ((count > 0U) && (data.timeStampMs != (last_ms + CUSTOM_READ_PERIOD_MS))))
+      {
+        wrongCount++;
+      }
+      last_ms = data.timeStampMs;
+      count++;
+    }
+  });
+
+  printf("%u reads, %u published, %u bus transactions\n",
+    sensor.getReadCount(), sensor.getPublishCount(), bus.getTransactionCount());
+  CHECK(sensor.getReadCount() == (RUN_TIME_MS / CUSTOM_READ_PERIOD_MS));
+  /* The sensor converts at the read rate, so all but the first read get one */
+  CHECK(sensor.getPublishCount() >= (sensor.getReadCount() - 2U));
+  CHECK(count >= (sensor.getPublishCount() - 1U));
+  CHECK(wrongCount == 0U);
+  /* A status read, then one burst when there is a value */
+  CHECK(bus.getTransactionCount() == (sensor.getReadCount() + sensor.getPublishCount()));
+  CHECK(bus.getWriteCount() == 0U);
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+static void testDutyCycle(void)
+{
+  Nano33BLESimulatedBus bus;
+  SimulatedCustomDevice device;
+  CustomSensor sensor;
+  uint32_t poweredDownReads;
+
+  hostReset();
+  bus.attach(device);
+  Nano33BLEI2CDevice::setBus(&bus);
+  device.value.set(21.5F);
+
+  sensor.beginPolled();
+  sensor.getScheduler().setDutyCycle(BURST_MS, INTERVAL_MS);
+  poweredDownReads = 0;
+  runSensor(sensor, bus, RUN_TIME_MS, [&device, &poweredDownReads](){
+    if((device.peekRegister(CUSTOM_SENSOR_CONTROL) & CUSTOM_SENSOR_CONTROL_ENABLE) == 0U)
+    {
+      poweredDownReads++;
+    }
+  });
+
+  printf("duty cycled: %u reads, %u published, powered down %u times\n",
+    sensor.getReadCount(), sensor.getPublishCount(), device.disableCount);
+  CHECK(poweredDownReads == 0U);
+  CHECK(sensor.getReadCount() <= ((RUN_TIME_MS / INTERVAL_MS) * (BURST_MS / CUSTOM_READ_PERIOD_MS)));
+  CHECK(sensor.getPublishCount() >= ((sensor.getReadCount() * 3U) / 4U));
+  /* Powered down after each burst */
+  CHECK(device.disableCount == (RUN_TIME_MS / INTERVAL_MS));
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+static void testStackProfiling(void)
+{
+  CustomSensor sensor;
+
+  /* None of the library's global objects has a stack until it is started */
+  CHECK(StackProfiler.getCount() == 0U);
+  sensor.beginPolled();
+  CHECK(StackProfiler.getCount() == 0U);
+  CHECK(sensor.getStack().getPeakUsage() == 0U);
+  CHECK(sensor.getStack().getRecommendedSize() == STACK_MIN_RECOMMENDED_BYTES);
+
+  sensor.begin();
+  CHECK(StackProfiler.getCount() == 1U);
+  CHECK(StackProfiler.getStack(0) == &sensor.getStack());
+  hostReset();
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testReads();
+  testDutyCycle();
+  testStackProfiling();
+  CHECK(StackProfiler.getCount() == 0U);
+  return hostTestResult("Nano33BLECustomSensorTest");
+}
@@ -0,0 +1,501 @@
+/*
+  Nano33BLEDriverTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Runs the library's own register level drivers against the simulated
+  chips on Nano33BLESimulatedBus: the HTS221 reads of Nano33BLETemperature,
+  the LPS22HB FIFO of Nano33BLEPressure and the APDS9960 gesture FIFO of
+  Nano33BLEGesture. Each sensor is started with beginPolled() and read
+  with poll() on the simulated clock, and the test checks what it
+  publishes and the bus transactions each read takes. The same simulated
+  swipes are decoded in both gesture modes, which must agree, and the
+  LSM9DS1 output data rates set by Nano33BLEAccelerometer and
+  Nano33BLEGyroscope must only be written by their read threads.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLETemperature.h"
+#include "Nano33BLEPressure.h"
+#include "Nano33BLEGesture.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEGyroscope.h"
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLESimulatedDevices.h"
+#include <functional>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* HTS221 registers the test sets or checks */
+#define HTS221_CTRL_REG1                  (0x20U)
+#define HTS221_CTRL_REG1_PD               (0x80U)
+#define HTS221_CTRL_REG1_ODR_MASK         (0x03U)
+/* LPS22HB control register 1: ODR and low pass filter */
+#define LPS22HB_CTRL_REG1                 (0x10U)
+#define LPS22HB_CTRL_REG1_ODR_SHIFT       (4U)
+#define LPS22HB_CTRL_REG1_EN_LPFP         (0x08U)
+/* LSM9DS1 accelerometer and gyroscope control registers and their ODR bits */
+#define LSM9DS1_CTRL_REG1_G               (0x10U)
+#define LSM9DS1_CTRL_REG6_XL              (0x20U)
+#define LSM9DS1_ODR_MASK                  (0xE0U)
+#define LSM9DS1_ODR_SHIFT                 (5U)
+
+#define TEMPERATURE_RUN_TIME_MS           (20000U)
+#define TEMPERATURE_FAST_RATE_HZ          (7.0F)
+#define PRESSURE_RUN_TIME_MS              (10000U)
+#define PRESSURE_FAST_RATE_HZ             (50.0F)
+/* The LPS22HB ODR code for 50Hz */
+#define PRESSURE_FAST_RATE_CODE           (4U)
+#define GESTURE_IDLE_TIME_MS              (1000U)
+#define GESTURE_DURATION_MS               (300U)
+#define GESTURE_RUN_TIME_MS               (3000U)
+/* When a swipe starts after the gesture sensor is started, and how long to read */
+#define GESTURE_SWIPE_START_MS            (50U)
+#define GESTURE_SWIPE_RUN_TIME_MS         (500U)
+/* The accelerometer duty cycle, and when a new rate is set in it */
+#define IMU_BURST_MS                      (200U)
+#define IMU_INTERVAL_MS                   (1000U)
+#define IMU_SET_RATE_AT_MS                (500U)
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief What the read thread would do until until_ms, keeping the bus
+ * time with the simulated clock. Calls check before every read.
+ */
+template<class SENSOR>
+static void runSensor(
+  SENSOR& sensor,
+  Nano33BLESimulatedBus& bus,
+  uint64_t until_ms,
+  std::function<void()> check)
+{
+  while(hostGetTime() < until_ms)
+  {
+    bus.setTime((uint32_t)hostGetTime());
+    check();
+    sensor.poll();
+  }
+  return;
+}
+
+static void testTemperature(void)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedHTS221 hts;
+  Nano33BLEI2CDevice device(HTS221_ADDRESS);
+  Nano33BLETemperatureData data;
+  uint32_t wrongCount;
+  uint32_t transactions;
+  uint32_t reads;
+  uint32_t published;
+
+  hostReset();
+  bus.attach(hts);
+  Nano33BLEI2CDevice::setBus(&bus);
+  hts.temperature.set(22.0F);
+  hts.humidity.set(45.0F);
+  /* Powered up as HTS.begin() would */
+  device.writeRegister(HTS221_CTRL_REG1, HTS221_CTRL_REG1_PD);
+
+  /* One shot conversions at the default read period */
+  Temperature.beginPolled();
+  bus.resetCounts();
+  wrongCount = 0;
+  runSensor(Temperature, bus, TEMPERATURE_RUN_TIME_MS, [&](){
+    while(Temperature.pop(data))
+    {
+      if((fabsf(data.temperatureCelsius - 22.0F) > 0.1F) ||
+        (fabsf(data.humidity - 45.0F) > 0.5F))
+      {
+        wrongCount++;
+      }
+    }
+  });
+
+  printf("temperature one shot: %u reads, %u published, %u bus transactions\n",
+    Temperature.getReadCount(), Temperature.getPublishCount(), bus.getTransactionCount());
+  CHECK(Temperature.getReadCount() == (TEMPERATURE_RUN_TIME_MS / DEFAULT_TEMPERATURE_READ_PERIOD_MS));
+  CHECK(Temperature.getPublishCount() == Temperature.getReadCount());
+  CHECK(wrongCount == 0U);
+  /* The status, one burst of both values, and the next one shot */
+  CHECK(bus.getTransactionCount() == (3U * Temperature.getReadCount()));
+  CHECK(bus.getWriteCount() == Temperature.getReadCount());
+
+  /* A new rate is only written by the read thread */
+  bus.resetCounts();
+  CHECK(Temperature.setOutputDataRate(TEMPERATURE_FAST_RATE_HZ) == TEMPERATURE_FAST_RATE_HZ);
+  CHECK(bus.getTransactionCount() == 0U);
+  bus.setTime((uint32_t)hostGetTime());
+  Temperature.poll();
+  CHECK((hts.peekRegister(HTS221_CTRL_REG1) & HTS221_CTRL_REG1_ODR_MASK) == 2U);
+
+  /* Continuous conversions, so nothing is written to read */
+  bus.resetCounts();
+  reads = Temperature.getReadCount();
+  published = Temperature.getPublishCount();
+  runSensor(Temperature, bus, hostGetTime() + TEMPERATURE_RUN_TIME_MS, [&](){
+    while(Temperature.pop(data));
+  });
+  reads = Temperature.getReadCount() - reads;
+  published = Temperature.getPublishCount() - published;
+  transactions = bus.getTransactionCount();
+  printf("temperature at %.1fHz: %u reads, %u published, %u bus transactions\n",
+    TEMPERATURE_FAST_RATE_HZ, reads, published, transactions);
+  CHECK(published >= ((reads * 9U) / 10U));
+  CHECK(transactions == (reads + published));
+  CHECK(bus.getWriteCount() == 0U);
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+static void testPressure(void)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedLPS22HB lps;
+  Nano33BLEPressureData data;
+  uint32_t period_ms;
+  uint32_t last_ms;
+  uint32_t age_ms;
+  uint32_t maxAge_ms;
+  uint32_t count;
+  uint32_t wrongCount;
+  uint32_t gapCount;
+  uint32_t reads;
+  uint32_t published;
+  std::function<void()> check;
+
+  hostReset();
+  bus.attach(lps);
+  Nano33BLEI2CDevice::setBus(&bus);
+  lps.pressure.set(100.0F);
+  lps.temperature.set(24.0F);
+
+  /* The default read period is 25Hz, drained every PRESSURE_FIFO_MAX_LATENCY_MS */
+  Pressure.beginPolled();
+  period_ms = DEFAULT_PRESSURE_READ_PERIOD_MS;
+  bus.resetCounts();
+  last_ms = 0;
+  maxAge_ms = 0;
+  count = 0;
+  wrongCount = 0;
+  gapCount = 0;
+  check = [&](){
+    while(Pressure.pop(data))
+    {
+      if((fabsf(data.barometricPressure - 100.0F) > 0.001F) ||
+        (fabsf(data.temperatureCelsius - 24.0F) > 0.01F))
+      {
+        wrongCount++;
+      }
+      /* Every sample is time stamped with when it was taken */
+      if((count > 0U) && ((data.timeStampMs - last_ms) != period_ms))
+      {
+        gapCount++;
+      }
+      /* Popped one read period after the read that published it */
+      age_ms = (uint32_t)hostGetTime() - PRESSURE_FIFO_MAX_LATENCY_MS - data.timeStampMs;
+      if(age_ms > maxAge_ms)
+      {
+        maxAge_ms = age_ms;
+      }
+      last_ms = data.timeStampMs;
+      count++;
+    }
+  };
+  runSensor(Pressure, bus, PRESSURE_RUN_TIME_MS, check);
+
+  printf("pressure FIFO: %u reads, %u published, %u bus transactions, %u bytes, %ums old\n",
+    Pressure.getReadCount(), Pressure.getPublishCount(),
+    bus.getTransactionCount(), bus.getByteCount(), maxAge_ms);
+  /* The first read is straight after begin, before any samples, and the
+   * last a read period before the end */
+  CHECK(Pressure.getReadCount() == (PRESSURE_RUN_TIME_MS / PRESSURE_FIFO_MAX_LATENCY_MS));
+  CHECK(Pressure.getPublishCount() == 
+    (((Pressure.getReadCount() - 1U) * PRESSURE_FIFO_MAX_LATENCY_MS) / period_ms));
+  CHECK(count >= (Pressure.getPublishCount() - (PRESSURE_FIFO_MAX_LATENCY_MS / period_ms) - 1U));
+  CHECK(wrongCount == 0U);
+  /* 
+   * The first read cannot tell when in the last period the newest sample
+   * was taken, so the time stamps may be moved on once
+   */
+  CHECK(gapCount <= 1U);
+  /* No sample is older than the latency when it is published */
+  CHECK(maxAge_ms < PRESSURE_FIFO_MAX_LATENCY_MS);
+  CHECK(Pressure.getFifoOverrunCount() == 0U);
+  /* The FIFO level, then the whole FIFO in one burst */
+  CHECK(bus.getTransactionCount() == ((2U * Pressure.getReadCount()) - 1U));
+  CHECK(bus.getWriteCount() == 0U);
+
+  /* New settings are only written by the read thread, never mid burst */
+  bus.resetCounts();
+  CHECK(Pressure.setOutputDataRate(PRESSURE_FAST_RATE_HZ) == PRESSURE_FAST_RATE_HZ);
+  Pressure.setLowPassFilter(Nano33BLEPressure::PRESSURE_LPF_OFF);
+  CHECK(bus.getTransactionCount() == 0U);
+  bus.setTime((uint32_t)hostGetTime());
+  Pressure.poll();
+  CHECK((lps.peekRegister(LPS22HB_CTRL_REG1) >> LPS22HB_CTRL_REG1_ODR_SHIFT) == PRESSURE_FAST_RATE_CODE);
+  CHECK((lps.peekRegister(LPS22HB_CTRL_REG1) & LPS22HB_CTRL_REG1_EN_LPFP) == 0U);
+
+  /* Samples taken at the old rate were dropped with the FIFO */
+  while(Pressure.pop(data));
+  period_ms = (uint32_t)(1000.0F / PRESSURE_FAST_RATE_HZ);
+  bus.resetCounts();
+  reads = Pressure.getReadCount();
+  published = Pressure.getPublishCount();
+  maxAge_ms = 0;
+  gapCount = 0;
+  count = 0;
+  runSensor(Pressure, bus, hostGetTime() + PRESSURE_RUN_TIME_MS, check);
+  reads = Pressure.getReadCount() - reads;
+  published = Pressure.getPublishCount() - published;
+  printf("pressure FIFO at %.0fHz: %u reads, %u published, %u bus transactions\n",
+    PRESSURE_FAST_RATE_HZ, reads, published, bus.getTransactionCount());
+  /* The run starts with a read, and every read drains the same number */
+  CHECK(reads == (1U + ((PRESSURE_RUN_TIME_MS - 1U) / PRESSURE_FIFO_MAX_LATENCY_MS)));
+  CHECK(published == ((PRESSURE_FIFO_MAX_LATENCY_MS / period_ms) * reads));
+  CHECK(wrongCount == 0U);
+  CHECK(gapCount <= 1U);
+  CHECK(maxAge_ms < PRESSURE_FIFO_MAX_LATENCY_MS);
+  CHECK(Pressure.getFifoOverrunCount() == 0U);
+  CHECK(bus.getTransactionCount() == (2U * reads));
+  CHECK(bus.getWriteCount() == 0U);
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+static void testGesture(void)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedAPDS9960 apds;
+  Nano33BLEGestureData data;
+  Nano33BLEGestureFrameData frame;
+  Nano33BLESensorReader<Nano33BLEGestureFrameData> frameReader(Gesture.getFrames());
+  uint32_t gestureCount;
+  uint32_t frameCount;
+  uint32_t reads;
+
+  hostReset();
+  bus.attach(apds);
+  Nano33BLEI2CDevice::setBus(&bus);
+
+  Gesture.beginPolled();
+  bus.resetCounts();
+  runSensor(Gesture, bus, GESTURE_IDLE_TIME_MS, [](){});
+
+  /* With no hand in view each read is one register read */
+  printf("gesture idle: %u reads, %u bus transactions\n",
+    Gesture.getReadCount(), bus.getTransactionCount());
+  CHECK(Gesture.getReadCount() == (GESTURE_IDLE_TIME_MS / DEFAULT_GESTURE_READ_PERIOD_MS));
+  CHECK(bus.getTransactionCount() == Gesture.getReadCount());
+  CHECK(Gesture.getPublishCount() == 0U);
+
+  apds.injectGesture(Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE_UP,
+    (uint32_t)hostGetTime(), GESTURE_DURATION_MS);
+  bus.resetCounts();
+  reads = Gesture.getReadCount();
+  gestureCount = 0;
+  frameCount = 0;
+  runSensor(Gesture, bus, GESTURE_RUN_TIME_MS, [&](){
+    while(Gesture.pop(data))
+    {
+      CHECK(data.gesture == Nano33BLEGestureData::UP);
+      gestureCount++;
+    }
+    while(frameReader.pop(frame))
+    {
+      frameCount++;
+    }
+  });
+  reads = Gesture.getReadCount() - reads;
+
+  printf("gesture: %u reads, %u frames, %u bus transactions\n",
+    reads, frameCount, bus.getTransactionCount());
+  CHECK(gestureCount == 1U);
+  /* Nearly every frame, bar those as the engine starts and exits */
+  CHECK(frameCount >= ((GESTURE_DURATION_MS * (uint32_t)SIMULATED_APDS9960_GESTURE_RATE_HZ * 9U) / 10000U));
+  /* At most the level and one burst, or the level and the engine state */
+  CHECK(bus.getTransactionCount() <= (2U * reads));
+  CHECK(bus.getTransactionCount() <=
+    (reads + ((GESTURE_DURATION_MS / DEFAULT_GESTURE_READ_PERIOD_MS) + 2U)));
+  CHECK(bus.getWriteCount() == 0U);
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+/**
+ * @brief Passes one simulated swipe over a fresh APDS9960 and reads it in
+ * the given mode.
+ *
+ * @return the number of gestures published, and the last one in gesture.
+ */
+static uint32_t readSwipe(
+  enum Nano33BLEGesture::GESTURE_MODE mode,
+  enum Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE direction,
+  enum Nano33BLEGestureData::GESTURE& gesture)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedAPDS9960 apds;
+  Nano33BLEGestureData data;
+  uint32_t count;
+
+  hostReset();
+  bus.attach(apds);
+  Nano33BLEI2CDevice::setBus(&bus);
+
+  Gesture.setMode(mode);
+  Gesture.beginPolled();
+  apds.injectGesture(direction, GESTURE_SWIPE_START_MS, GESTURE_DURATION_MS);
+  count = 0;
+  runSensor(Gesture, bus, GESTURE_SWIPE_RUN_TIME_MS, [&](){
+    while(Gesture.pop(data))
+    {
+      gesture = data.gesture;
+      count++;
+    }
+  });
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return count;
+}
+
+static void testGestureModes(void)
+{
+  static const enum Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE swipes[4] =
+  {
+    Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE_UP,
+    Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE_DOWN,
+    Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE_LEFT,
+    Nano33BLESimulatedAPDS9960::SIMULATED_GESTURE_RIGHT
+  };
+  static const enum Nano33BLEGestureData::GESTURE expected[4] =
+  {
+    Nano33BLEGestureData::UP,
+    Nano33BLEGestureData::DOWN,
+    Nano33BLEGestureData::LEFT,
+    Nano33BLEGestureData::RIGHT
+  };
+  enum Nano33BLEGestureData::GESTURE fifoGesture;
+  enum Nano33BLEGestureData::GESTURE libraryGesture;
+  uint32_t ii;
+
+  /* The library's directions, so switching mode does not change them */
+  for(ii = 0; ii < 4U; ii++)
+  {
+    CHECK(readSwipe(Nano33BLEGesture::GESTURE_MODE_LIBRARY, swipes[ii], libraryGesture) == 1U);
+    CHECK(readSwipe(Nano33BLEGesture::GESTURE_MODE_FIFO, swipes[ii], fifoGesture) == 1U);
+    printf("swipe %u: library %d, FIFO %d\n", ii, (int)libraryGesture, (int)fifoGesture);
+    CHECK(libraryGesture == expected[ii]);
+    CHECK(fifoGesture == libraryGesture);
+  }
+  return;
+}
+
+static uint8_t readImuRate(Nano33BLESimulatedLSM9DS1& lsm, uint8_t reg)
+{
+  return (uint8_t)((lsm.peekRegister(reg) & LSM9DS1_ODR_MASK) >> LSM9DS1_ODR_SHIFT);
+}
+
+static void testImuOutputDataRate(void)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedLSM9DS1 lsm;
+  Nano33BLEI2CDevice device(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+  uint64_t start_ms;
+  uint8_t rateWhenSet;
+
+  hostReset();
+  bus.attach(lsm);
+  Nano33BLEI2CDevice::setBus(&bus);
+  /* Both at 119Hz as IMU.begin() would */
+  device.writeRegister(LSM9DS1_CTRL_REG1_G, (3U << LSM9DS1_ODR_SHIFT));
+  device.writeRegister(LSM9DS1_CTRL_REG6_XL, (3U << LSM9DS1_ODR_SHIFT));
+  Accelerometer.beginPolled();
+  Gyroscope.beginPolled();
+
+  /* The accelerometer follows the gyroscope's rate while it is powered, so
+   * a new accelerometer rate is written to both, each by its own thread */
+  bus.resetCounts();
+  CHECK(Accelerometer.setOutputDataRate(200.0F) == 238.0F);
+  CHECK(bus.getTransactionCount() == 0U);
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG6_XL) == 3U);
+  bus.setTime((uint32_t)hostGetTime());
+  Accelerometer.poll();
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG6_XL) == 4U);
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG1_G) == 3U);
+  CHECK(Gyroscope.getScheduler().getPeriod() == Accelerometer.getScheduler().getPeriod());
+  Gyroscope.poll();
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG1_G) == 4U);
+
+  bus.resetCounts();
+  CHECK(Gyroscope.setOutputDataRate(50.0F) == 59.5F);
+  CHECK(bus.getTransactionCount() == 0U);
+  Gyroscope.poll();
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG1_G) == 2U);
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG6_XL) == 4U);
+  CHECK(Accelerometer.getScheduler().getPeriod() == Gyroscope.getScheduler().getPeriod());
+  Accelerometer.poll();
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG6_XL) == 2U);
+
+  /* A rate set while the accelerometer is powered down by its duty cycle
+   * is the one it powers back up at. The gyroscope is off, as it has to be
+   * for the accelerometer to power down.
+   */
+  device.writeRegister(LSM9DS1_CTRL_REG1_G, 0U);
+  Accelerometer.getScheduler().setDutyCycle(IMU_BURST_MS, IMU_INTERVAL_MS);
+  start_ms = hostGetTime();
+  rateWhenSet = 0xFFU;
+  hostSchedule(start_ms + IMU_SET_RATE_AT_MS, [&](){
+    rateWhenSet = readImuRate(lsm, LSM9DS1_CTRL_REG6_XL);
+    Accelerometer.setOutputDataRate(952.0F);
+  });
+  runSensor(Accelerometer, bus, start_ms + IMU_INTERVAL_MS + (IMU_BURST_MS / 2U), [](){});
+  printf("accelerometer ODR code %u when set, %u after powering up\n",
+    rateWhenSet, readImuRate(lsm, LSM9DS1_CTRL_REG6_XL));
+  CHECK(rateWhenSet == 0U);
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG6_XL) == 6U);
+  CHECK(readImuRate(lsm, LSM9DS1_CTRL_REG1_G) == 0U);
+
+  Accelerometer.getScheduler().setDutyCycle(0, 0);
+  Nano33BLEI2CDevice::setBus(NULL);
+  hostReset();
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testTemperature();
+  testPressure();
+  testGesture();
+  testGestureModes();
+  testImuOutputDataRate();
+  return hostTestResult("Nano33BLEDriverTest");
+}
@@ -0,0 +1,299 @@
+/*
+  Nano33BLEHeadingTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLEHeading. atan2Fast() is checked against atan2() all the
+  way around. The board is then put in known orientations (heading, pitch
+  and roll) in known earth fields, the accelerometer and magnetometer 
+  readings it would give are replayed into the sensors, and the heading,
+  pitch and roll from Heading.read() must be the orientation, within the 
+  error of atan2Fast() and float rounding.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLEHeading.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEGREES_TO_RADIANS          ((float)M_PI / 180.0F)
+/* The documented error of atan2Fast() */
+#define ATAN2_MAX_ERROR_DEGREES     (0.001F)
+#define ATAN2_STEPS                 (36000U)
+/* atan2Fast() plus the rounding of the cross products and sqrt */
+#define ANGLE_MAX_ERROR_DEGREES     (0.002F)
+/* Readings per orientation, so the gravity filter has settled */
+#define SETTLE_READINGS             (200U)
+/* The LSM9DS1 magnetometer x axis points the opposite way to the 
+ * accelerometer's */
+#define MAGNETIC_X_SIGN             (-1.0F)
+#define DECLINATION_DEGREES         (12.5F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+/* Earth fields in microtesla, north and down: northern and southern 
+ * hemisphere, and the equator */
+static const float earthFields[][2] = 
+{
+  {18.0F, 48.0F},
+  {25.0F, -40.0F},
+  {30.0F, 0.0F},
+};
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @return the difference between two angles in degrees, from -180 to 180.
+ */
+static float angleDifference(float a, float b)
+{
+  float difference;
+
+  difference = fmodf(a - b, 360.0F);
+  if(difference > 180.0F)
+  {
+    difference -= 360.0F;
+  }
+  if(difference < -180.0F)
+  {
+    difference += 360.0F;
+  }
+  return difference;
+}
+
+static void testAtan2Fast(void)
+{
+  float angle;
+  float error;
+  float maxError;
+  uint32_t ii;
+
+  CHECK(Nano33BLEHeading::atan2Fast(0.0F, 0.0F) == 0.0F);
+  maxError = 0.0F;
+  for(ii = 0; ii < ATAN2_STEPS; ii++)
+  {
+    angle = ((360.0F * ii) / ATAN2_STEPS) * DEGREES_TO_RADIANS;
+    /* Lengths other than 1 give the same angle */
+    error = fabsf(angleDifference(
+      Nano33BLEHeading::atan2Fast(3.0F * sinf(angle), 3.0F * cosf(angle)) / DEGREES_TO_RADIANS,
+      atan2f(sinf(angle), cosf(angle)) / DEGREES_TO_RADIANS));
+    if(error > maxError)
+    {
+      maxError = error;
+    }
+  }
+  printf("atan2Fast: %.5f degrees largest error\n", maxError);
+  CHECK(maxError <= ATAN2_MAX_ERROR_DEGREES);
+  return;
+}
+
+/**
+ * @brief Works out the readings the board would give. The board's axes 
+ * are x forward, y left and z up, and the orientation turns it from level
+ * with x pointing north: heading clockwise about down, then pitch raising
+ * x, then roll raising y.
+ *
+ * @param field the earth field, north, east and down.
+ */
+static void orientationToReadings(
+  float heading,
+  float pitch,
+  float roll,
+  const float field[3],
+  Nano33BLEAccelerometerData& acceleration,
+  Nano33BLEMagneticData& magnetic)
+{
+  const float up[3] = {0.0F, 0.0F, -1.0F};
+  float axes[3][3];
+  float ch;
+  float sh;
+  float cp;
+  float sp;
+  float cr;
+  float sr;
+  float g[3];
+  float m[3];
+  uint32_t ii;
+  uint32_t jj;
+
+  ch = cosf(heading * DEGREES_TO_RADIANS);
+  sh = sinf(heading * DEGREES_TO_RADIANS);
+  cp = cosf(pitch * DEGREES_TO_RADIANS);
+  sp = sinf(pitch * DEGREES_TO_RADIANS);
+  cr = cosf(roll * DEGREES_TO_RADIANS);
+  sr = sinf(roll * DEGREES_TO_RADIANS);
+
+  /* Forward, right and down axes in north, east, down, then left and up
+   * are the opposite of right and down */
+  axes[0][0] = cp * ch;
+  axes[0][1] = cp * sh;
+  axes[0][2] = -sp;
+  axes[1][0] = -((sr * sp * ch) - (cr * sh));
+  axes[1][1] = -((sr * sp * sh) + (cr * ch));
+  axes[1][2] = -(sr * cp);
+  axes[2][0] = -((cr * sp * ch) + (sr * sh));
+  axes[2][1] = -((cr * sp * sh) - (sr * ch));
+  axes[2][2] = -(cr * cp);
+
+  /* At rest the accelerometer reads 1g up */
+  for(ii = 0; ii < 3U; ii++)
+  {
+    g[ii] = 0.0F;
+    m[ii] = 0.0F;
+    for(jj = 0; jj < 3U; jj++)
+    {
+      g[ii] += axes[ii][jj] * up[jj];
+      m[ii] += axes[ii][jj] * field[jj];
+    }
+  }
+  acceleration.x = g[0];
+  acceleration.y = g[1];
+  acceleration.z = g[2];
+  magnetic.x = MAGNETIC_X_SIGN * m[0];
+  magnetic.y = m[1];
+  magnetic.z = m[2];
+  return;
+}
+
+/**
+ * @brief Replays the readings for one orientation until the gravity 
+ * filter has settled.
+ *
+ * @return false if no heading was pushed.
+ */
+static bool readOrientation(
+  float heading,
+  float pitch,
+  float roll,
+  const float field[3],
+  Nano33BLEHeadingData& data)
+{
+  Nano33BLEAccelerometerData acceleration;
+  Nano33BLEMagneticData magnetic;
+  bool pushed;
+  uint32_t ii;
+
+  orientationToReadings(heading, pitch, roll, field, acceleration, magnetic);
+  pushed = false;
+  for(ii = 0; ii < SETTLE_READINGS; ii++)
+  {
+    hostAdvance(10U);
+    acceleration.timeStampMs = (uint32_t)hostGetTime();
+    magnetic.timeStampMs = (uint32_t)hostGetTime();
+    Accelerometer.replay(&acceleration, sizeof(acceleration));
+    Magnetic.replay(&magnetic, sizeof(magnetic));
+    Heading.read();
+    while(Heading.pop(data))
+    {
+      pushed = true;
+    }
+  }
+  return pushed;
+}
+
+static void testOrientations(void)
+{
+  const float pitches[] = {0.0F, 15.0F, -30.0F, 60.0F, -75.0F};
+  const float rolls[] = {0.0F, 20.0F, -45.0F, 120.0F, -170.0F};
+  Nano33BLEHeadingData data;
+  float field[3];
+  float heading;
+  float headingError;
+  float pitchError;
+  float rollError;
+  uint32_t count;
+  uint32_t ff;
+  uint32_t pp;
+  uint32_t rr;
+  uint32_t hh;
+
+  hostReset();
+  Heading.setDeclination(0.0F);
+  headingError = 0.0F;
+  pitchError = 0.0F;
+  rollError = 0.0F;
+  count = 0;
+  for(ff = 0; ff < (sizeof(earthFields) / sizeof(earthFields[0])); ff++)
+  {
+    field[0] = earthFields[ff][0];
+    field[1] = 0.0F;
+    field[2] = earthFields[ff][1];
+    for(pp = 0; pp < (sizeof(pitches) / sizeof(pitches[0])); pp++)
+    {
+      for(rr = 0; rr < (sizeof(rolls) / sizeof(rolls[0])); rr++)
+      {
+        for(hh = 0; hh < 360U; hh += 25U)
+        {
+          heading = (float)hh;
+          if(!CHECK(readOrientation(heading, pitches[pp], rolls[rr], field, data)))
+          {
+            continue;
+          }
+          CHECK((data.heading >= 0.0F) && (data.heading < 360.0F));
+          headingError = fmaxf(headingError, fabsf(angleDifference(data.heading, heading)));
+          pitchError = fmaxf(pitchError, fabsf(data.pitch - pitches[pp]));
+          rollError = fmaxf(rollError, fabsf(angleDifference(data.roll, rolls[rr])));
+          count++;
+        }
+      }
+    }
+  }
+
+  printf("heading: %u orientations, largest error heading %.5f, pitch %.5f, roll %.5f degrees\n",
+    count, headingError, pitchError, rollError);
+  CHECK(headingError <= ANGLE_MAX_ERROR_DEGREES);
+  CHECK(pitchError <= ANGLE_MAX_ERROR_DEGREES);
+  CHECK(rollError <= ANGLE_MAX_ERROR_DEGREES);
+  return;
+}
+
+static void testDeclination(void)
+{
+  Nano33BLEHeadingData data;
+  const float field[3] = {18.0F, 0.0F, 48.0F};
+
+  /* Magnetic north east of true north moves the heading clockwise, and it
+   * wraps around at 360 degrees */
+  Heading.setDeclination(DECLINATION_DEGREES);
+  CHECK(Heading.getDeclination() == DECLINATION_DEGREES);
+  CHECK(readOrientation(90.0F, 10.0F, 10.0F, field, data));
+  CHECK_NEAR(data.heading, 90.0F + DECLINATION_DEGREES, ANGLE_MAX_ERROR_DEGREES);
+  CHECK(readOrientation(355.0F, 0.0F, 0.0F, field, data));
+  CHECK_NEAR(data.heading, DECLINATION_DEGREES - 5.0F, ANGLE_MAX_ERROR_DEGREES);
+
+  Heading.setDeclination(-DECLINATION_DEGREES);
+  CHECK(readOrientation(5.0F, 0.0F, 0.0F, field, data));
+  CHECK_NEAR(data.heading, 365.0F - DECLINATION_DEGREES, ANGLE_MAX_ERROR_DEGREES);
+  Heading.setDeclination(0.0F);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testAtan2Fast();
+  testOrientations();
+  testDeclination();
+  return hostTestResult("Nano33BLEHeadingTest");
+}
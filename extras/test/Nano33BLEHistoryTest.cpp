@@ -0,0 +1,345 @@
+/*
+  Nano33BLEHistoryTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLEHistory with short tier periods. Pressure readings are 
+  replayed with a different number of readings in each tier 0 period, and
+  History::read() is called for each. Every aggregate kept in every tier
+  must match the min, count weighted mean and max of the raw readings in
+  its period, after the rings have wrapped. Range queries must include a
+  period that starts at from_ms and exclude one that starts at to_ms. Once
+  the readings stop, the open periods must be closed by time, through 
+  every tier.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLEHistory.h"
+#include "Nano33BLEPressure.h"
+#include <vector>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define RAW_SIZE                    (32U)
+#define TIER_SIZE                   (8U)
+#define TIER_0_PERIOD_MS            (100U)
+#define TIER_1_PERIOD_MS            (1000U)
+#define TIER_2_PERIOD_MS            (5000U)
+/* Readings start part way into the first tier 2 period */
+#define START_MS                    (1000U)
+#define END_MS                      (12000U)
+#define MAX_READINGS_PER_PERIOD     (5U)
+/* Far enough ahead to query everything, and still less than 2^31 ms on */
+#define QUERY_END_MS                (0x10000000U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+typedef Nano33BLEHistory<Nano33BLEPressureData, RAW_SIZE, TIER_SIZE> History;
+
+static History history(Pressure, TIER_0_PERIOD_MS, TIER_1_PERIOD_MS, TIER_2_PERIOD_MS);
+static std::vector<Nano33BLEPressureData> readings;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static const uint32_t periods_ms[HISTORY_TIER_COUNT] = 
+  {TIER_0_PERIOD_MS, TIER_1_PERIOD_MS, TIER_2_PERIOD_MS};
+
+/**
+ * @brief Works out the aggregate of the raw readings in one period.
+ *
+ * @param unweightedMean set to the mean of the tier 0 means in the period,
+ * which is what the mean would be if it were not weighted by count.
+ */
+static History::Aggregate expected(uint32_t start_ms, uint32_t period_ms, float& unweightedMean)
+{
+  History::Aggregate aggregate;
+  double sums[History::CHANNEL_COUNT];
+  double periodSum;
+  uint32_t periodCount;
+  uint32_t periodStart_ms;
+  uint32_t periodMeans;
+  float value;
+  uint32_t ii;
+  uint32_t jj;
+
+  aggregate.count = 0;
+  aggregate.startTimeMs = start_ms;
+  for(jj = 0; jj < History::CHANNEL_COUNT; jj++)
+  {
+    sums[jj] = 0.0;
+  }
+  unweightedMean = 0.0F;
+  periodSum = 0.0;
+  periodCount = 0;
+  periodMeans = 0;
+  periodStart_ms = 0;
+  for(ii = 0; ii < readings.size(); ii++)
+  {
+    if((readings[ii].timeStampMs < start_ms) || 
+      (readings[ii].timeStampMs >= (start_ms + period_ms)))
+    {
+      continue;
+    }
+    for(jj = 0; jj < History::CHANNEL_COUNT; jj++)
+    {
+      value = Nano33BLESensorChannels<Nano33BLEPressureData>::get(readings[ii], jj);
+      if((aggregate.count == 0U) || (value < aggregate.min[jj]))
+      {
+        aggregate.min[jj] = value;
+      }
+      if((aggregate.count == 0U) || (value > aggregate.max[jj]))
+      {
+        aggregate.max[jj] = value;
+      }
+      sums[jj] += value;
+    }
+    aggregate.count++;
+
+    /* The first channel's tier 0 means */
+    if((periodCount > 0U) && 
+      ((readings[ii].timeStampMs - periodStart_ms) >= TIER_0_PERIOD_MS))
+    {
+      unweightedMean += (float)(periodSum / periodCount);
+      periodMeans++;
+      periodSum = 0.0;
+      periodCount = 0;
+    }
+    if(periodCount == 0U)
+    {
+      periodStart_ms = readings[ii].timeStampMs - (readings[ii].timeStampMs % TIER_0_PERIOD_MS);
+    }
+    periodSum += readings[ii].barometricPressure;
+    periodCount++;
+  }
+  if(periodCount > 0U)
+  {
+    unweightedMean += (float)(periodSum / periodCount);
+    periodMeans++;
+  }
+  if(periodMeans > 0U)
+  {
+    unweightedMean /= periodMeans;
+  }
+
+  for(jj = 0; jj < History::CHANNEL_COUNT; jj++)
+  {
+    aggregate.mean[jj] = (aggregate.count > 0U) ? (float)(sums[jj] / aggregate.count) : 0.0F;
+  }
+  return aggregate;
+}
+
+/**
+ * @brief Checks every aggregate kept in a tier against the raw readings.
+ *
+ * @return the number of aggregates kept.
+ */
+static uint32_t checkTier(uint32_t tier, uint32_t& weightedCount)
+{
+  History::Aggregate stored[TIER_SIZE + 1U];
+  History::Aggregate reference;
+  float unweightedMean;
+  uint32_t count;
+  uint32_t ii;
+  uint32_t jj;
+
+  count = history.query(tier, 0, QUERY_END_MS, stored, TIER_SIZE + 1U);
+  for(ii = 0; ii < count; ii++)
+  {
+    CHECK((stored[ii].startTimeMs % periods_ms[tier]) == 0U);
+    if(ii > 0U)
+    {
+      CHECK(stored[ii].startTimeMs > stored[ii - 1U].startTimeMs);
+    }
+    reference = expected(stored[ii].startTimeMs, periods_ms[tier], unweightedMean);
+    CHECK(stored[ii].count == reference.count);
+    for(jj = 0; jj < History::CHANNEL_COUNT; jj++)
+    {
+      CHECK(stored[ii].min[jj] == reference.min[jj]);
+      CHECK(stored[ii].max[jj] == reference.max[jj]);
+      CHECK_NEAR(stored[ii].mean[jj], reference.mean[jj], 0.0001F);
+    }
+    /* Periods where weighting by count makes a difference */
+    if(fabsf(reference.mean[0] - unweightedMean) > 0.01F)
+    {
+      weightedCount++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Adds the readings of one tier 0 period. Each period has a 
+ * different number of readings, spread over it.
+ */
+static void addPeriod(uint32_t start_ms, uint32_t period)
+{
+  Nano33BLEPressureData data;
+  uint32_t count;
+  uint32_t ii;
+
+  count = 1U + ((period * 7U) % MAX_READINGS_PER_PERIOD);
+  for(ii = 0; ii < count; ii++)
+  {
+    data.timeStampMs = start_ms + ((ii * TIER_0_PERIOD_MS) / count);
+    data.barometricPressure = 100.0F + ((float)((data.timeStampMs * 37U) % 101U) / 10.0F);
+    data.temperatureCelsius = 20.0F - ((float)((data.timeStampMs * 13U) % 17U) / 4.0F);
+    hostRunUntil(data.timeStampMs);
+    Pressure.replay(&data, sizeof(data));
+    readings.push_back(data);
+    history.read();
+  }
+  return;
+}
+
+static void testTiers(void)
+{
+  uint32_t weightedCount;
+  uint32_t period;
+  uint32_t time_ms;
+  uint32_t counts[HISTORY_TIER_COUNT];
+  uint32_t tier;
+
+  hostReset();
+  hostRunUntil(START_MS);
+  period = 0;
+  for(time_ms = START_MS; time_ms < END_MS; time_ms += TIER_0_PERIOD_MS)
+  {
+    addPeriod(time_ms, period);
+    period++;
+  }
+
+  /* The rings have wrapped in tiers 0 and 1. The last period of each tier
+   * is still open, as is the second tier 2 period */
+  weightedCount = 0;
+  for(tier = 0; tier < HISTORY_TIER_COUNT; tier++)
+  {
+    counts[tier] = checkTier(tier, weightedCount);
+  }
+  printf("history: %u readings, tiers %u %u %u, %u means weighted by count\n",
+    (uint32_t)readings.size(), counts[0], counts[1], counts[2], weightedCount);
+  CHECK(counts[0] == TIER_SIZE);
+  CHECK(counts[1] == TIER_SIZE);
+  CHECK(counts[2] == 2U);
+  /* The test would not see an unweighted mean otherwise */
+  CHECK(weightedCount > 0U);
+  return;
+}
+
+static void testQueries(void)
+{
+  History::Aggregate stored[TIER_SIZE];
+  History::Aggregate found[TIER_SIZE];
+  Nano33BLEPressureData raw[RAW_SIZE];
+  uint32_t start_ms;
+  uint32_t count;
+  uint32_t ii;
+
+  count = history.query(0, 0, QUERY_END_MS, stored, TIER_SIZE);
+  CHECK(count == TIER_SIZE);
+  for(ii = 0; ii < count; ii++)
+  {
+    start_ms = stored[ii].startTimeMs;
+    /* A period starting at from_ms is included, and one at to_ms is not */
+    CHECK(history.query(0, start_ms, start_ms + TIER_0_PERIOD_MS, found, TIER_SIZE) == 1U);
+    CHECK(found[0].startTimeMs == start_ms);
+    CHECK(history.query(0, start_ms, start_ms, found, TIER_SIZE) == 0U);
+    CHECK(history.query(0, start_ms - 1U, start_ms + 1U, found, TIER_SIZE) == 1U);
+    CHECK(found[0].startTimeMs == start_ms);
+    CHECK(history.query(0, start_ms + 1U, QUERY_END_MS, found, TIER_SIZE) == (count - ii - 1U));
+    if(ii < (count - 1U))
+    {
+      CHECK(found[0].startTimeMs == stored[ii + 1U].startTimeMs);
+    }
+  }
+  /* Before the oldest kept, and after the newest */
+  CHECK(history.query(0, 0, stored[1].startTimeMs, found, TIER_SIZE) == 1U);
+  CHECK(found[0].startTimeMs == stored[0].startTimeMs);
+  CHECK(history.query(0, stored[count - 1U].startTimeMs + 1U, QUERY_END_MS, found, TIER_SIZE) == 0U);
+  /* At most size are copied */
+  CHECK(history.query(0, 0, QUERY_END_MS, found, 3U) == 3U);
+  CHECK(found[0].startTimeMs == stored[0].startTimeMs);
+  CHECK(history.query(HISTORY_TIER_COUNT, 0, QUERY_END_MS, found, TIER_SIZE) == 0U);
+
+  /* The raw ring holds the latest readings, found the same way */
+  count = history.queryRaw(0, QUERY_END_MS, raw, RAW_SIZE);
+  CHECK(count == RAW_SIZE);
+  CHECK(raw[count - 1U].timeStampMs == readings.back().timeStampMs);
+  CHECK(raw[0].timeStampMs == readings[readings.size() - RAW_SIZE].timeStampMs);
+  start_ms = raw[RAW_SIZE / 2U].timeStampMs;
+  CHECK(history.queryRaw(start_ms, QUERY_END_MS, raw, RAW_SIZE) == (RAW_SIZE / 2U));
+  CHECK(raw[0].timeStampMs == start_ms);
+  CHECK(history.queryRaw(0, start_ms, raw, RAW_SIZE) == (RAW_SIZE / 2U));
+  return;
+}
+
+static void testCloseByTime(void)
+{
+  History::Aggregate stored[TIER_SIZE];
+  uint32_t weightedCount;
+  uint32_t count;
+
+  /* One read timeout after the last reading the last tier 0 period has 
+   * ended, but late readings are still allowed for */
+  history.read();
+  CHECK(history.query(0, END_MS - TIER_0_PERIOD_MS, QUERY_END_MS, stored, TIER_SIZE) == 0U);
+
+  /* Then it closes, and the tier 1 period that ends with it */
+  while(hostGetTime() < (END_MS + (2U * HISTORY_READ_TIMEOUT_MS)))
+  {
+    history.read();
+  }
+  CHECK(history.query(0, END_MS - TIER_0_PERIOD_MS, QUERY_END_MS, stored, TIER_SIZE) == 1U);
+  CHECK(stored[0].startTimeMs == (END_MS - TIER_0_PERIOD_MS));
+  CHECK(history.query(1, END_MS - TIER_1_PERIOD_MS, QUERY_END_MS, stored, TIER_SIZE) == 1U);
+  CHECK(stored[0].startTimeMs == (END_MS - TIER_1_PERIOD_MS));
+  CHECK(history.query(2, 2U * TIER_2_PERIOD_MS, QUERY_END_MS, stored, TIER_SIZE) == 0U);
+
+  /* And the tier 2 period once it has ended */
+  while(hostGetTime() < ((3U * TIER_2_PERIOD_MS) + (2U * HISTORY_READ_TIMEOUT_MS)))
+  {
+    history.read();
+  }
+  count = history.query(2, 2U * TIER_2_PERIOD_MS, QUERY_END_MS, stored, TIER_SIZE);
+  CHECK(count == 1U);
+  CHECK(stored[0].startTimeMs == (2U * TIER_2_PERIOD_MS));
+
+  /* Everything closed by time matches the readings too, and each reading
+   * is counted once in every tier */
+  weightedCount = 0;
+  checkTier(0, weightedCount);
+  checkTier(1, weightedCount);
+  CHECK(checkTier(2, weightedCount) == 3U);
+  count = history.query(2, 0, QUERY_END_MS, stored, TIER_SIZE);
+  CHECK((stored[0].count + stored[1].count + stored[2].count) == readings.size());
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testTiers();
+  testQueries();
+  testCloseByTime();
+  return hostTestResult("Nano33BLEHistoryTest");
+}
@@ -0,0 +1,333 @@
+/*
+  Nano33BLELogTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests the log core, Nano33BLELog, on file backed storage: how fast
+  records are appended and how many bytes are programmed for them (write
+  amplification), and that the log comes back after power is lost at every
+  byte of a run of appends. This test is built without the host stand-ins
+  for Mbed OS, so it also checks the log core does not need them.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "host/HostTest.h"
+#include "Nano33BLELog.h"
+#include <chrono>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define STORAGE_PATH                "build/Nano33BLELogTest.flash"
+/* The size of an accelerometer reading, the most common record */
+#define THROUGHPUT_RECORD_SIZE      (16U)
+#define THROUGHPUT_RECORD_COUNT     (20000U)
+/* Generous, as the host may be slow or busy */
+#define MIN_RECORDS_PER_SECOND      (10000.0)
+/* Small sectors, so power loss is tested at sector changes too */
+#define POWER_LOSS_STORAGE_SIZE     (2048U)
+#define POWER_LOSS_SECTOR_SIZE      (256U)
+#define POWER_LOSS_RECORD_COUNT     (40U)
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @return the size of record index in the power loss tests, from 1 to 24
+ * bytes so records are padded by different amounts.
+ */
+static uint32_t recordSize(uint32_t index)
+{
+  return 1U + ((index * 7U) % 24U);
+}
+
+/**
+ * @brief Fills a record with data that identifies it.
+ */
+static void makeRecord(uint32_t index, uint8_t* data, uint32_t size)
+{
+  uint32_t ii;
+
+  for(ii = 0; ii < size; ii++)
+  {
+    data[ii] = (uint8_t)((index * 31U) + ii);
+  }
+  return;
+}
+
+/**
+ * @brief Reads the log from the oldest record and checks the records are
+ * complete and in order, with no gaps.
+ *
+ * @return the index of the last record read plus one, or 0 if the log is
+ * empty or a record was wrong.
+ */
+static uint32_t readBack(Nano33BLELog& log, uint32_t& count)
+{
+  uint8_t expected[LOGGER_MAX_RECORD_SIZE_BYTES];
+  uint8_t data[LOGGER_MAX_RECORD_SIZE_BYTES];
+  uint8_t streamId;
+  uint32_t index;
+  uint32_t size;
+  bool passed;
+
+  log.rewind();
+  count = 0;
+  index = 0;
+  passed = true;
+  while((size = log.readNext(streamId, data, sizeof(data))) != 0U)
+  {
+    /* The stream id holds the low byte of the index */
+    if(count == 0U)
+    {
+      index = streamId;
+    }
+    makeRecord(index, expected, recordSize(index));
+    passed = CHECK(streamId == (uint8_t)index) && passed;
+    passed = CHECK(size == recordSize(index)) && passed;
+    passed = CHECK(memcmp(data, expected, size) == 0) && passed;
+    index++;
+    count++;
+  }
+  return passed ? index : 0U;
+}
+
+static bool appendRecord(Nano33BLELog& log, uint32_t index)
+{
+  uint8_t data[LOGGER_MAX_RECORD_SIZE_BYTES];
+
+  makeRecord(index, data, recordSize(index));
+  return log.append((uint8_t)index, data, recordSize(index));
+}
+
+static void testPowerLossAtEnd(void)
+{
+  uint32_t data[2] = {0x12345678UL, 0x9ABCDEF0UL};
+
+  remove(STORAGE_PATH);
+  Nano33BLEFileStorage storage(STORAGE_PATH, POWER_LOSS_STORAGE_SIZE, POWER_LOSS_SECTOR_SIZE);
+  CHECK(storage.init());
+
+  /* A program that ends exactly where power is lost has been written */
+  storage.setPowerLossAfter(sizeof(data));
+  CHECK(storage.program(0, data, sizeof(data)));
+  CHECK(!storage.program(sizeof(data), data, sizeof(data)));
+  CHECK(!storage.erase(0, POWER_LOSS_SECTOR_SIZE));
+  CHECK(storage.getProgrammedBytes() == sizeof(data));
+
+  /* A program that goes past it is cut short */
+  remove(STORAGE_PATH);
+  Nano33BLEFileStorage cutStorage(STORAGE_PATH, POWER_LOSS_STORAGE_SIZE, POWER_LOSS_SECTOR_SIZE);
+  CHECK(cutStorage.init());
+  cutStorage.setPowerLossAfter(4);
+  CHECK(!cutStorage.program(0, data, sizeof(data)));
+  CHECK(cutStorage.getProgrammedBytes() == 4U);
+  return;
+}
+
+static void testThroughput(void)
+{
+  uint8_t data[THROUGHPUT_RECORD_SIZE];
+  std::chrono::steady_clock::time_point start;
+  double elapsed_s;
+  uint32_t appended;
+  uint32_t read;
+  uint32_t alignedSize;
+  uint32_t ii;
+  uint8_t streamId;
+  Nano33BLELog log;
+
+  remove(STORAGE_PATH);
+  Nano33BLEFileStorage storage(STORAGE_PATH,
+    64U * 1024U,
+    DEFAULT_FILE_STORAGE_SECTOR_SIZE_BYTES,
+    DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES);
+  CHECK(log.mount(storage));
+
+  appended = 0;
+  start = std::chrono::steady_clock::now();
+  for(ii = 0; ii < THROUGHPUT_RECORD_COUNT; ii++)
+  {
+    memcpy(data, &ii, sizeof(ii));
+    if(log.append(1, data, sizeof(data)))
+    {
+      appended++;
+    }
+  }
+  elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%u records of %u bytes: %.0f records/s, write amplification %.3f, %u sectors erased\n",
+    THROUGHPUT_RECORD_COUNT, THROUGHPUT_RECORD_SIZE, THROUGHPUT_RECORD_COUNT / elapsed_s,
+    (double)log.getBytesProgrammed() / log.getBytesLogged(), log.getEraseCount());
+  CHECK(appended == THROUGHPUT_RECORD_COUNT);
+  CHECK(log.getDroppedCount() == 0U);
+  CHECK((THROUGHPUT_RECORD_COUNT / elapsed_s) >= MIN_RECORDS_PER_SECOND);
+
+  /* Every programmed byte is a record (header and padding included) or a
+   * sector header, one for each sector erased.
+   */
+  alignedSize = ((8U + THROUGHPUT_RECORD_SIZE + DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES - 1U) /
+    DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES) * DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES;
+  CHECK(log.getBytesLogged() == (THROUGHPUT_RECORD_COUNT * THROUGHPUT_RECORD_SIZE));
+  CHECK(log.getBytesProgrammed() == ((THROUGHPUT_RECORD_COUNT * alignedSize) + (8U * log.getEraseCount())));
+  CHECK(log.getBytesProgrammed() == storage.getProgrammedBytes());
+  CHECK(log.getEraseCount() == storage.getEraseCount());
+
+  /* The log has wrapped, so holds the newest records, in order */
+  log.rewind();
+  read = 0;
+  ii = 0;
+  while(log.readNext(streamId, data, sizeof(data)) == sizeof(data))
+  {
+    if(read > 0U)
+    {
+      CHECK(memcmp(data, &ii, sizeof(ii)) == 0);
+    }
+    memcpy(&ii, data, sizeof(ii));
+    ii++;
+    read++;
+  }
+  CHECK(ii == THROUGHPUT_RECORD_COUNT);
+  CHECK(read >= ((15U * (DEFAULT_FILE_STORAGE_SECTOR_SIZE_BYTES - 8U)) / alignedSize));
+  return;
+}
+
+static void testWriteAmplification(void)
+{
+  static const uint32_t sizes[] = {1, 4, 12, 16, 64, LOGGER_MAX_RECORD_SIZE_BYTES};
+  static const uint32_t programSizes[] = {1, 4, 8};
+  uint8_t data[LOGGER_MAX_RECORD_SIZE_BYTES];
+  uint32_t alignedSize;
+  uint32_t ii;
+  uint32_t jj;
+  uint32_t kk;
+
+  memset(data, 0x5A, sizeof(data));
+  for(ii = 0; ii < (sizeof(programSizes) / sizeof(programSizes[0])); ii++)
+  {
+    for(jj = 0; jj < (sizeof(sizes) / sizeof(sizes[0])); jj++)
+    {
+      Nano33BLELog log;
+
+      remove(STORAGE_PATH);
+      Nano33BLEFileStorage storage(STORAGE_PATH, 16U * 1024U, 1024U, programSizes[ii]);
+      CHECK(log.mount(storage));
+      for(kk = 0; kk < 500U; kk++)
+      {
+        CHECK(log.append(2, data, sizes[jj]));
+      }
+
+      alignedSize = ((8U + sizes[jj] + programSizes[ii] - 1U) / programSizes[ii]) * programSizes[ii];
+      printf("program size %u, %3u byte records: write amplification %.3f\n",
+        programSizes[ii], sizes[jj], (double)log.getBytesProgrammed() / log.getBytesLogged());
+      CHECK(log.getBytesProgrammed() == ((500U * alignedSize) + (8U * log.getEraseCount())));
+      CHECK(log.getBytesProgrammed() == storage.getProgrammedBytes());
+    }
+  }
+  return;
+}
+
+/**
+ * @brief Appends POWER_LOSS_RECORD_COUNT records, losing power after cut
+ * bytes have been programmed, then powers back up and checks every record
+ * that was appended is there. Logging must then carry on after them.
+ *
+ * @return false once cut is past the end of the whole run.
+ */
+static bool checkPowerLoss(uint32_t cut)
+{
+  uint32_t appended;
+  uint32_t next;
+  uint32_t count;
+  bool passed;
+
+  remove(STORAGE_PATH);
+  appended = 0;
+  {
+    Nano33BLELog log;
+    Nano33BLEFileStorage storage(STORAGE_PATH, POWER_LOSS_STORAGE_SIZE, POWER_LOSS_SECTOR_SIZE);
+
+    if(!CHECK(log.mount(storage)))
+    {
+      return false;
+    }
+    storage.setPowerLossAfter(cut);
+    while((appended < POWER_LOSS_RECORD_COUNT) && appendRecord(log, appended))
+    {
+      appended++;
+    }
+  }
+
+  /* Power back up. A record that was cut short may still have landed if
+   * only its padding was lost, so it may be read back too.
+   */
+  passed = true;
+  {
+    Nano33BLELog log;
+    Nano33BLEFileStorage storage(STORAGE_PATH, POWER_LOSS_STORAGE_SIZE, POWER_LOSS_SECTOR_SIZE);
+
+    passed = CHECK(log.mount(storage)) && passed;
+    next = readBack(log, count);
+    passed = CHECK((next == appended) || (next == (appended + 1U))) && passed;
+    passed = CHECK(count == next) && passed;
+    if(next < POWER_LOSS_RECORD_COUNT)
+    {
+      passed = CHECK(appendRecord(log, next)) && passed;
+      next++;
+    }
+  }
+
+  {
+    Nano33BLELog log;
+    Nano33BLEFileStorage storage(STORAGE_PATH, POWER_LOSS_STORAGE_SIZE, POWER_LOSS_SECTOR_SIZE);
+
+    passed = CHECK(log.mount(storage)) && passed;
+    passed = CHECK(readBack(log, count) == next) && passed;
+  }
+
+  if(!passed)
+  {
+    printf("power lost after %u bytes: %u appended\n", cut, appended);
+  }
+  return (appended < POWER_LOSS_RECORD_COUNT);
+}
+
+static void testPowerLoss(void)
+{
+  uint32_t cut;
+
+  cut = 0;
+  while(checkPowerLoss(cut))
+  {
+    cut++;
+  }
+  printf("power lost after each of %u bytes\n", cut);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testPowerLossAtEnd();
+  testThroughput();
+  testWriteAmplification();
+  testPowerLoss();
+  remove(STORAGE_PATH);
+  return hostTestResult("Nano33BLELogTest");
+}
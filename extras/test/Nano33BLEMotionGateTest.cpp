@@ -0,0 +1,225 @@
+/*
+  Nano33BLEMotionGateTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests that Nano33BLEMotionGate slows an attached sensor down while the
+  board is still, and that the sensor is back to its full rate within one
+  of its read periods of motion. This is tested for a sensor read all of
+  the time and for a duty cycled one, both slowed down and suspended.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLEMotionGate.h"
+#include <vector>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define ACCELEROMETER_PERIOD_MS     (10U)
+#define STILL_TIME_MS               (500U)
+#define SENSOR_PERIOD_MS            (10U)
+#define SENSOR_WAKE_UP_MS           (5U)
+#define BURST_MS                    (100U)
+#define INTERVAL_MS                 (1000U)
+#define RUN_TIME_MS                 (5000U)
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static void powerChange(void)
+{
+  return;
+}
+
+/**
+ * @brief Runs a sensor attached to a motion gate for RUN_TIME_MS. The board
+ * is still apart from a vibration starting at motion_ms. The gate is run
+ * by the accelerometer events, and the sensor by this thread.
+ *
+ * @return the time of every sensor read.
+ */
+static std::vector<uint64_t> runGate(
+  uint32_t stillSlowdown,
+  bool dutyCycled,
+  uint64_t motion_ms,
+  Nano33BLEMotionGate& gate)
+{
+  Nano33BLEPeriodicScheduler scheduler(SENSOR_PERIOD_MS);
+  std::vector<uint64_t> reads;
+  std::function<void()> accelerometer;
+
+  hostReset();
+  gate.setStillTime(STILL_TIME_MS);
+  gate.setStillSlowdown(stillSlowdown);
+  CHECK(gate.attach(scheduler));
+  if(dutyCycled)
+  {
+    scheduler.setPowerCallbacks(
+      mbed::callback(powerChange), mbed::callback(powerChange), SENSOR_WAKE_UP_MS);
+    scheduler.setDutyCycle(BURST_MS, INTERVAL_MS);
+  }
+
+  /* What the accelerometer and the gate's thread do */
+  accelerometer = [&accelerometer, &gate, motion_ms](){
+    Nano33BLEAccelerometerData data;
+    uint64_t now_ms;
+
+    now_ms = hostGetTime();
+    data.x = 0.0F;
+    data.y = 0.0F;
+    data.z = 1.0F;
+    if((now_ms >= motion_ms) && (((now_ms / ACCELEROMETER_PERIOD_MS) % 2U) == 0U))
+    {
+      data.x = 0.5F;
+    }
+    data.timeStampMs = (uint32_t)now_ms;
+    Accelerometer.replay(&data, sizeof(data));
+    gate.read();
+    if(now_ms < RUN_TIME_MS)
+    {
+      hostSchedule(now_ms + ACCELEROMETER_PERIOD_MS, accelerometer);
+    }
+  };
+  hostSchedule(0, accelerometer);
+
+  scheduler.start();
+  while(hostGetTime() < RUN_TIME_MS)
+  {
+    scheduler.waitForNextPeriod();
+    reads.push_back(hostGetTime());
+  }
+  /* The events refer to this function's locals */
+  hostReset();
+  return reads;
+}
+
+/**
+ * @brief Checks the sensor was slowed down while still, and back to full
+ * rate within one read period (plus its wake up time, if it was powered
+ * down) of motion_ms.
+ */
+static void checkReads(
+  const std::vector<uint64_t>& reads,
+  uint64_t motion_ms,
+  uint32_t stillSlowdown,
+  uint32_t wakeUp_ms)
+{
+  uint64_t first_ms;
+  uint32_t stillReads;
+  uint32_t burstReads;
+  uint32_t ii;
+
+  /* The slowdown applies from the sensor's next deadline once the gate
+   * sees it is still, so the first read after that is not counted */
+  stillReads = 0;
+  for(ii = 0; (ii < reads.size()) && (reads[ii] < motion_ms); ii++)
+  {
+    if(reads[ii] > (STILL_TIME_MS + ACCELEROMETER_PERIOD_MS))
+    {
+      if((stillReads > 0U) && (stillSlowdown != 0U))
+      {
+        CHECK(reads[ii] >= (reads[ii - 1U] + (stillSlowdown * SENSOR_PERIOD_MS)));
+      }
+      stillReads++;
+    }
+  }
+  if(stillSlowdown == 0U)
+  {
+    CHECK(stillReads <= 1U);
+  }
+
+  CHECK(ii < reads.size());
+  if(ii >= reads.size())
+  {
+    return;
+  }
+  first_ms = reads[ii];
+  printf("  first read %llums after motion\n", (unsigned long long)(first_ms - motion_ms));
+  CHECK(first_ms <= (motion_ms + wakeUp_ms + SENSOR_PERIOD_MS));
+
+  /* Then a burst (or more) at full rate */
+  burstReads = 1;
+  for(ii++; (ii < reads.size()) && (reads[ii] < (first_ms + BURST_MS)); ii++)
+  {
+    CHECK(reads[ii] == (reads[ii - 1U] + SENSOR_PERIOD_MS));
+    burstReads++;
+  }
+  CHECK(burstReads == (BURST_MS / SENSOR_PERIOD_MS));
+  return;
+}
+
+static void testContinuous(void)
+{
+  Nano33BLEMotionGate gate;
+  std::vector<uint64_t> reads;
+
+  printf("continuous, slowed down:\n");
+  reads = runGate(4, false, 3333, gate);
+  checkReads(reads, 3333, 4, 0);
+  CHECK(gate.isMoving());
+  CHECK(gate.getTransitionCount() == 2U);
+  return;
+}
+
+static void testContinuousSuspended(void)
+{
+  Nano33BLEMotionGate gate;
+  std::vector<uint64_t> reads;
+
+  printf("continuous, suspended:\n");
+  reads = runGate(0, false, 3333, gate);
+  checkReads(reads, 3333, 0, 0);
+  return;
+}
+
+static void testDutyCycled(void)
+{
+  Nano33BLEMotionGate gate;
+  std::vector<uint64_t> reads;
+
+  /* Motion between two bursts, while the sensor is powered down */
+  printf("duty cycled, slowed down:\n");
+  reads = runGate(4, true, 3500, gate);
+  checkReads(reads, 3500, 4, SENSOR_WAKE_UP_MS);
+  return;
+}
+
+static void testDutyCycledSuspended(void)
+{
+  Nano33BLEMotionGate gate;
+  std::vector<uint64_t> reads;
+
+  printf("duty cycled, suspended:\n");
+  reads = runGate(0, true, 3500, gate);
+  checkReads(reads, 3500, 0, SENSOR_WAKE_UP_MS);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testContinuous();
+  testContinuousSuspended();
+  testDutyCycled();
+  testDutyCycledSuspended();
+  return hostTestResult("Nano33BLEMotionGateTest");
+}
\ No newline at end of file
@@ -0,0 +1,328 @@
+/*
+  Nano33BLEPeriodicSchedulerTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests that Nano33BLEPeriodicScheduler holds a sensor to its rate over a
+  long run on the simulated clock. Each read takes a varying time, as a
+  real read does, and the drift is the difference between when the last
+  read happened and when it should have, in parts per million of the run.
+  Also tests duty cycling, and that speeding the reads up with
+  setSlowdown() wakes a sleeping read thread, even between bursts.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLEPeriodicScheduler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* One hour of reads */
+#define RUN_TIME_MS                 (3600000U)
+/* The most drift allowed. One millisecond over the run is 0.28ppm. */
+#define MAX_DRIFT_PPM               (1.0)
+/* Longest a read takes. Reads are spread evenly from 0 to this. */
+#define MAX_READ_TIME_MS            (3U)
+
+/* Duty cycle used by the wake tests */
+#define DUTY_PERIOD_MS              (10U)
+#define DUTY_BURST_MS               (100U)
+#define DUTY_INTERVAL_MS            (1000U)
+#define DUTY_WAKE_UP_MS             (5U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static uint32_t powerDownCount;
+static uint32_t powerUpCount;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static void powerDown(void)
+{
+  powerDownCount++;
+  return;
+}
+
+static void powerUp(void)
+{
+  powerUpCount++;
+  return;
+}
+
+/**
+ * @brief Starts a scheduler duty cycled with the DUTY_ macros at time 0.
+ */
+static void startDutyCycle(Nano33BLEPeriodicScheduler& scheduler)
+{
+  hostReset();
+  powerDownCount = 0;
+  powerUpCount = 0;
+  scheduler.setPowerCallbacks(
+    mbed::callback(powerDown), mbed::callback(powerUp), DUTY_WAKE_UP_MS);
+  scheduler.setDutyCycle(DUTY_BURST_MS, DUTY_INTERVAL_MS);
+  scheduler.start();
+  return;
+}
+
+/**
+ * @return the time of the first read at or after from_ms.
+ */
+static uint64_t readFrom(Nano33BLEPeriodicScheduler& scheduler, uint64_t from_ms)
+{
+  while(hostGetTime() < from_ms)
+  {
+    scheduler.waitForNextPeriod();
+  }
+  return hostGetTime();
+}
+
+/**
+ * @brief Reads at rate_Hz for RUN_TIME_MS, with every stallEvery'th read
+ * taking stall_ms rather than a few milliseconds.
+ *
+ * @return the drift in ppm of the run.
+ */
+static double runScheduler(
+  float rate_Hz,
+  uint32_t stallEvery,
+  uint32_t stall_ms,
+  Nano33BLEPeriodicScheduler::OVERRUN_POLICY policy,
+  uint32_t& overrunCount)
+{
+  Nano33BLEPeriodicScheduler scheduler(1000, policy);
+  uint64_t start_ms;
+  uint64_t cycles;
+  uint64_t expected_ms;
+  uint64_t elapsed_ms;
+  uint32_t period_us;
+
+  hostReset();
+  /* Not started at 0, so nothing relies on the epoch being 0 */
+  hostAdvance(1234);
+  scheduler.setRate(rate_Hz);
+  scheduler.start();
+  start_ms = hostGetTime();
+  period_us = scheduler.getPeriod();
+
+  cycles = 0;
+  while((hostGetTime() - start_ms) < RUN_TIME_MS)
+  {
+    /* The read */
+    if((stallEvery != 0U) && ((cycles % stallEvery) == (stallEvery - 1U)))
+    {
+      hostAdvance(stall_ms);
+    }
+    else
+    {
+      hostAdvance((uint32_t)(cycles % (MAX_READ_TIME_MS + 1U)));
+    }
+    scheduler.waitForNextPeriod();
+    cycles++;
+  }
+
+  /*
+   * Every read but the skipped ones is on a deadline of the schedule set
+   * at the start, so the last read is due at a whole number of periods.
+   */
+  overrunCount = scheduler.getOverrunCount();
+  elapsed_ms = hostGetTime() - start_ms;
+  if(policy == Nano33BLEPeriodicScheduler::OVERRUN_SKIP)
+  {
+    cycles += overrunCount;
+  }
+  expected_ms = (cycles * period_us) / 1000U;
+  return (((double)elapsed_ms - (double)expected_ms) * 1000000.0) / (double)elapsed_ms;
+}
+
+static void testNoDrift(void)
+{
+  const float rates_Hz[] = {10.0F, 59.5F, 104.0F, 119.0F, 238.0F};
+  uint32_t overrunCount;
+  double drift_ppm;
+  uint32_t ii;
+
+  for(ii = 0; ii < (sizeof(rates_Hz) / sizeof(rates_Hz[0])); ii++)
+  {
+    drift_ppm = runScheduler(rates_Hz[ii], 0, 0,
+      Nano33BLEPeriodicScheduler::OVERRUN_SKIP, overrunCount);
+    printf("%7.1fHz: drift %+.3fppm, %u overruns\n", rates_Hz[ii], drift_ppm, overrunCount);
+    CHECK(fabs(drift_ppm) <= MAX_DRIFT_PPM);
+    CHECK(overrunCount == 0U);
+  }
+  return;
+}
+
+static void testNoDriftAfterOverruns(void)
+{
+  uint32_t overrunCount;
+  double drift_ppm;
+
+  /* A read every second takes 30ms, which is several 119Hz periods */
+  drift_ppm = runScheduler(119.0F, 119, 30,
+    Nano33BLEPeriodicScheduler::OVERRUN_SKIP, overrunCount);
+  printf("119.0Hz, skipping overruns: drift %+.3fppm, %u overruns\n", drift_ppm, overrunCount);
+  CHECK(fabs(drift_ppm) <= MAX_DRIFT_PPM);
+  CHECK(overrunCount >= 3600U);
+
+  drift_ppm = runScheduler(119.0F, 119, 30,
+    Nano33BLEPeriodicScheduler::OVERRUN_CATCH_UP, overrunCount);
+  printf("119.0Hz, catching up overruns: drift %+.3fppm, %u overruns\n", drift_ppm, overrunCount);
+  CHECK(fabs(drift_ppm) <= MAX_DRIFT_PPM);
+  CHECK(overrunCount >= 3600U);
+  return;
+}
+
+static void testRateChange(void)
+{
+  Nano33BLEPeriodicScheduler scheduler(10);
+  uint64_t changed_ms;
+  uint32_t ii;
+
+  hostReset();
+  scheduler.start();
+  for(ii = 0; ii < 10; ii++)
+  {
+    scheduler.waitForNextPeriod();
+  }
+  CHECK(hostGetTime() == 100U);
+
+  /* Applied from the deadline just passed, so there is no jump */
+  scheduler.setRate(50.0F);
+  changed_ms = hostGetTime();
+  for(ii = 0; ii < 500; ii++)
+  {
+    scheduler.waitForNextPeriod();
+  }
+  CHECK(hostGetTime() == (changed_ms + 10000U));
+  return;
+}
+
+static void testDutyCycle(void)
+{
+  Nano33BLEPeriodicScheduler scheduler(DUTY_PERIOD_MS);
+  uint32_t reads;
+
+  startDutyCycle(scheduler);
+  reads = 0;
+  while(hostGetTime() < (10U * DUTY_INTERVAL_MS))
+  {
+    scheduler.waitForNextPeriod();
+    CHECK((hostGetTime() % DUTY_INTERVAL_MS) < DUTY_BURST_MS);
+    reads++;
+  }
+  /* One read per period in each burst */
+  CHECK(reads == (10U * (DUTY_BURST_MS / DUTY_PERIOD_MS)));
+  CHECK(powerDownCount == 10U);
+  CHECK(powerUpCount == 10U);
+  /* Powered from one wake up time and period before each burst, to after
+   * its last read */
+  CHECK_NEAR(scheduler.getActiveRatio(), 0.105, 0.001);
+  return;
+}
+
+static void testSpeedUpWakesDutyCycle(void)
+{
+  Nano33BLEPeriodicScheduler scheduler(DUTY_PERIOD_MS);
+  uint64_t read_ms;
+  uint64_t first_ms;
+
+  startDutyCycle(scheduler);
+  scheduler.setSlowdown(4);
+  /* Speed up again halfway between two bursts */
+  hostSchedule(2500, [&scheduler](){ scheduler.setSlowdown(1); });
+
+  read_ms = readFrom(scheduler, 2100);
+  CHECK(read_ms <= (2500U + DUTY_WAKE_UP_MS));
+  CHECK(powerUpCount == 3U);
+
+  /* A whole burst at full rate follows */
+  first_ms = read_ms;
+  while(hostGetTime() < (first_ms + DUTY_BURST_MS))
+  {
+    scheduler.waitForNextPeriod();
+    if(hostGetTime() < (first_ms + DUTY_BURST_MS))
+    {
+      CHECK(hostGetTime() == (read_ms + DUTY_PERIOD_MS));
+    }
+    read_ms = hostGetTime();
+  }
+  /* The duty cycle carries on from the early burst */
+  CHECK(hostGetTime() == (first_ms + DUTY_INTERVAL_MS));
+  CHECK(powerDownCount == 4U);
+  return;
+}
+
+static void testNoEarlyWakeAfterSpeedUp(void)
+{
+  Nano33BLEPeriodicScheduler scheduler(DUTY_PERIOD_MS);
+  uint64_t read_ms;
+
+  startDutyCycle(scheduler);
+  scheduler.setSlowdown(2);
+  read_ms = readFrom(scheduler, 1);
+
+  /* Sped up during a read in a burst. This is applied from the deadline
+   * just passed, so must not leave a wake behind that cuts a later sleep
+   * short.
+   */
+  scheduler.setSlowdown(1);
+  scheduler.waitForNextPeriod();
+  CHECK(hostGetTime() == (read_ms + DUTY_PERIOD_MS));
+  read_ms = readFrom(scheduler, DUTY_BURST_MS);
+  CHECK(read_ms == DUTY_INTERVAL_MS);
+  read_ms = readFrom(scheduler, read_ms + 1U);
+  CHECK(read_ms == (DUTY_INTERVAL_MS + DUTY_PERIOD_MS));
+  return;
+}
+
+static void testSpeedUpWakesSlowRead(void)
+{
+  Nano33BLEPeriodicScheduler scheduler(DUTY_PERIOD_MS);
+  uint64_t read_ms;
+
+  hostReset();
+  scheduler.start();
+  scheduler.setSlowdown(100);
+  readFrom(scheduler, 1);
+  hostSchedule(1500, [&scheduler](){ scheduler.setSlowdown(1); });
+
+  /* Read straight away, then at full rate */
+  read_ms = readFrom(scheduler, 1001);
+  CHECK(read_ms == 1500U);
+  read_ms = readFrom(scheduler, read_ms + 1U);
+  CHECK(read_ms == (1500U + DUTY_PERIOD_MS));
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testNoDrift();
+  testNoDriftAfterOverruns();
+  testRateChange();
+  testDutyCycle();
+  testSpeedUpWakesDutyCycle();
+  testNoEarlyWakeAfterSpeedUp();
+  testSpeedUpWakesSlowRead();
+  return hostTestResult("Nano33BLEPeriodicSchedulerTest");
+}
\ No newline at end of file
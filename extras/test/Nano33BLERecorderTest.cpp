@@ -0,0 +1,229 @@
+/*
+  Nano33BLERecorderTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Records a simulated run of Nano33BLEPressure, read from the simulated
+  LPS22HB with poll(), into a log through Nano33BLERecorder, draining the
+  recorder as the logger thread would. The trace is then replayed back 
+  into the sensor with Nano33BLEReplay and every reading must come out as
+  it was recorded, with the recorded spacing and without being recorded 
+  again. Pushes made while the recorder's queue is full must be dropped 
+  and counted, and nothing is written to the log until it is drained.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "HostClock.h"
+#include "Nano33BLERecorder.h"
+#include "Nano33BLEPressure.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLESimulatedDevices.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define STORAGE_PATH                "build/Nano33BLERecorderTest.flash"
+#define STORAGE_SIZE_BYTES          (64U * 1024U)
+#define RECORD_RUN_TIME_MS          (5000U)
+/* More than the readings published in RECORD_RUN_TIME_MS */
+#define MAX_READINGS                (256U)
+/* How many pushes to make past a full queue */
+#define EXTRA_PUSHES                (5U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static Nano33BLEPressureData recorded[MAX_READINGS];
+static uint32_t recordedTimes[MAX_READINGS];
+static uint32_t recordedCount = 0;
+static uint32_t replayedCount = 0;
+static uint32_t replayWrongCount = 0;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static bool isSame(const Nano33BLEPressureData& a, const Nano33BLEPressureData& b)
+{
+  return ((a.barometricPressure == b.barometricPressure) &&
+    (a.temperatureCelsius == b.temperatureCelsius) &&
+    (a.timeStampMs == b.timeStampMs));
+}
+
+/**
+ * @brief Checks each replayed reading as it is pushed, as more are replayed
+ * than the sensor's buffer holds.
+ */
+static void checkReplayed(void)
+{
+  Nano33BLEPressureData data;
+
+  while(Pressure.pop(data))
+  {
+    if((replayedCount >= recordedCount) || !isSame(data, recorded[replayedCount]))
+    {
+      replayWrongCount++;
+    }
+    replayedCount++;
+  }
+  return;
+}
+
+static void testRecord(Nano33BLELogger& traceLog)
+{
+  Nano33BLESimulatedBus bus;
+  Nano33BLESimulatedLPS22HB lps;
+  Nano33BLEPressureData data;
+  uint32_t wrongCount;
+
+  hostReset();
+  bus.attach(lps);
+  Nano33BLEI2CDevice::setBus(&bus);
+  lps.pressure.set(100.0F, 2.0F, 1000U, 0.01F);
+  lps.temperature.set(24.0F, 1.0F, 3000U);
+
+  Recorder.begin(traceLog);
+  CHECK(TraceSink == &Recorder);
+  Pressure.beginPolled();
+  while(hostGetTime() < RECORD_RUN_TIME_MS)
+  {
+    bus.setTime((uint32_t)hostGetTime());
+    Pressure.poll();
+    while(Pressure.pop(data))
+    {
+      if(recordedCount < MAX_READINGS)
+      {
+        recorded[recordedCount] = data;
+        recordedTimes[recordedCount] = (uint32_t)hostGetTime();
+        recordedCount++;
+      }
+    }
+    /* The logger thread's drain */
+    traceLog.drain();
+  }
+
+  printf("recorded %u readings, %u records, %u dropped\n",
+    recordedCount, Recorder.getRecordedCount(), Recorder.getDroppedCount());
+  CHECK(recordedCount > (RECORD_RUN_TIME_MS / DEFAULT_PRESSURE_READ_PERIOD_MS / 2U));
+  CHECK(recordedCount < MAX_READINGS);
+  CHECK(Recorder.getRecordedCount() == recordedCount);
+  CHECK(Recorder.getDroppedCount() == 0U);
+  wrongCount = 0;
+  for(uint32_t ii = 1; ii < recordedCount; ii++)
+  {
+    if(recorded[ii].barometricPressure == recorded[ii - 1U].barometricPressure)
+    {
+      wrongCount++;
+    }
+  }
+  /* The readings change, so replaying the wrong ones would be seen */
+  CHECK(wrongCount < (recordedCount / 10U));
+
+  Nano33BLEI2CDevice::setBus(NULL);
+  return;
+}
+
+static void testReplay(Nano33BLELogger& traceLog)
+{
+  Nano33BLEPressureData data;
+  uint64_t start_ms;
+  uint32_t replayed;
+  uint32_t records;
+  uint32_t logged;
+
+  /* Recording is left on to check the replay does not record itself */
+  records = Recorder.getRecordedCount();
+  logged = traceLog.getBytesLogged();
+  CHECK(Replay.attach(Pressure));
+  while(Pressure.pop(data));
+  Pressure.onPush(mbed::callback(checkReplayed));
+
+  start_ms = hostGetTime();
+  replayed = Replay.replay(traceLog, 1.0F);
+  printf("replayed %u readings in %ums, recorded over %ums\n", replayed,
+    (uint32_t)(hostGetTime() - start_ms), 
+    recordedTimes[recordedCount - 1U] - recordedTimes[0]);
+  CHECK(replayed == recordedCount);
+  /* Pushed with the spacing they were recorded with */
+  CHECK((hostGetTime() - start_ms) == (recordedTimes[recordedCount - 1U] - recordedTimes[0]));
+
+  CHECK(replayedCount == recordedCount);
+  CHECK(replayWrongCount == 0U);
+  Pressure.onPush(NULL);
+
+  CHECK(TraceSink == &Recorder);
+  CHECK(traceLog.drain() == 0U);
+  CHECK(Recorder.getRecordedCount() == records);
+  CHECK(traceLog.getBytesLogged() == logged);
+  return;
+}
+
+static void testQueueFull(Nano33BLELogger& traceLog, Nano33BLEFileStorage& storage)
+{
+  Nano33BLEAccelerometerData data;
+  uint32_t programmed;
+  uint32_t records;
+  uint32_t dropped;
+  uint32_t ii;
+
+  records = Recorder.getRecordedCount();
+  dropped = Recorder.getDroppedCount();
+  programmed = storage.getProgrammedBytes();
+  data.y = 0.0F;
+  data.z = 1.0F;
+  for(ii = 0; ii < (RECORDER_QUEUE_SIZE + EXTRA_PUSHES); ii++)
+  {
+    data.x = (float)ii;
+    data.timeStampMs = (uint32_t)hostGetTime();
+    Accelerometer.replay(&data, sizeof(data));
+  }
+  /* The pushing thread never writes to the log */
+  CHECK(storage.getProgrammedBytes() == programmed);
+  CHECK(Recorder.getDroppedCount() == (dropped + EXTRA_PUSHES));
+
+  CHECK(traceLog.drain() == RECORDER_QUEUE_SIZE);
+  CHECK(Recorder.getRecordedCount() == (records + RECORDER_QUEUE_SIZE));
+  CHECK(storage.getProgrammedBytes() > programmed);
+
+  /* Not recorded once ended */
+  Recorder.end();
+  CHECK(TraceSink == NULL);
+  Accelerometer.replay(&data, sizeof(data));
+  CHECK(traceLog.drain() == 0U);
+  CHECK(Recorder.getRecordedCount() == (records + RECORDER_QUEUE_SIZE));
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  Nano33BLELogger traceLog;
+
+  remove(STORAGE_PATH);
+  Nano33BLEFileStorage storage(STORAGE_PATH, STORAGE_SIZE_BYTES);
+  if(CHECK(traceLog.mount(storage)))
+  {
+    testRecord(traceLog);
+    testReplay(traceLog);
+    testQueueFull(traceLog, storage);
+  }
+  remove(STORAGE_PATH);
+  return hostTestResult("Nano33BLERecorderTest");
+}
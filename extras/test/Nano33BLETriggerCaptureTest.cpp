@@ -0,0 +1,179 @@
+/*
+  Nano33BLETriggerCaptureTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests Nano33BLETriggerCapture with readings replayed into the
+  accelerometer's buffer. A level trigger freezes the readings from before
+  and after it, and readings the capture thread missed because it fell
+  behind the accelerometer's buffer are counted in the capture.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLETriggerCapture.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define PRE_SIZE                    (4U)
+#define POST_SIZE                   (4U)
+#define TRIGGER_LEVEL_G             (1.0F)
+/* Readings pushed while the capture thread is not reading */
+#define BEHIND_COUNT                (BUFFER_SIZE + 5U)
+
+typedef Nano33BLETriggerCapture<Nano33BLEAccelerometerData, PRE_SIZE, POST_SIZE> TestCapture;
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static uint32_t readingCount = 0;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Pushes a reading to the accelerometer's buffer, time stamped with
+ * its number so gaps in a capture can be seen.
+ */
+static void pushReading(float x)
+{
+  Nano33BLEAccelerometerData data;
+
+  data.x = x;
+  data.y = 0.0F;
+  data.z = 1.0F;
+  data.timeStampMs = readingCount;
+  readingCount++;
+  Accelerometer.replay(&data, sizeof(data));
+  return;
+}
+
+/**
+ * @brief Pushes a reading, and has the capture read it.
+ */
+static void addReading(TestCapture& capture, float x)
+{
+  pushReading(x);
+  capture.read();
+  return;
+}
+
+static void testCapture(void)
+{
+  TestCapture capture(Accelerometer);
+  Nano33BLEAccelerometerData readings[TestCapture::CAPTURE_SIZE];
+  uint32_t triggerReading;
+  uint32_t count;
+  uint32_t index;
+  uint32_t overruns;
+  uint32_t ii;
+
+  capture.setLevelTrigger(0, TRIGGER_LEVEL_G);
+  for(ii = 0; ii < 10U; ii++)
+  {
+    addReading(capture, 0.0F);
+  }
+  triggerReading = readingCount;
+  addReading(capture, 2.0F);
+  for(ii = 0; ii < (POST_SIZE - 1U); ii++)
+  {
+    addReading(capture, 2.0F);
+  }
+  CHECK(!capture.waitForCapture(0));
+  addReading(capture, 0.0F);
+  CHECK(capture.waitForCapture(0));
+
+  count = capture.getCapture(readings, TestCapture::CAPTURE_SIZE, index, overruns);
+  CHECK(count == TestCapture::CAPTURE_SIZE);
+  CHECK(index == PRE_SIZE);
+  CHECK(overruns == 0U);
+  CHECK(readings[index].timeStampMs == triggerReading);
+  for(ii = 1; ii < count; ii++)
+  {
+    CHECK(readings[ii].timeStampMs == (readings[ii - 1U].timeStampMs + 1U));
+  }
+  CHECK(capture.getTriggerCount() == 1U);
+  CHECK(capture.getMissedTriggerCount() == 0U);
+  CHECK(capture.getCapture(readings, TestCapture::CAPTURE_SIZE, index, overruns) == 0U);
+  return;
+}
+
+static void testOverrun(void)
+{
+  TestCapture capture(Accelerometer);
+  Nano33BLEAccelerometerData readings[TestCapture::CAPTURE_SIZE];
+  uint32_t count;
+  uint32_t index;
+  uint32_t overruns;
+  uint32_t ii;
+
+  capture.setLevelTrigger(0, TRIGGER_LEVEL_G);
+  for(ii = 0; ii < 10U; ii++)
+  {
+    addReading(capture, 0.0F);
+  }
+  addReading(capture, 2.0F);
+  addReading(capture, 2.0F);
+
+  /* The capture thread falls behind, and the oldest readings are lost */
+  for(ii = 0; ii < BEHIND_COUNT; ii++)
+  {
+    pushReading(2.0F);
+  }
+  while(!capture.waitForCapture(0))
+  {
+    capture.read();
+  }
+
+  count = capture.getCapture(readings, TestCapture::CAPTURE_SIZE, index, overruns);
+  printf("capture of %u readings, %u missing\n", count, overruns);
+  CHECK(count == TestCapture::CAPTURE_SIZE);
+  CHECK(index == PRE_SIZE);
+  CHECK(overruns == (BEHIND_COUNT - BUFFER_SIZE));
+  /* The capture spans the readings it has plus those it missed */
+  CHECK((readings[count - 1U].timeStampMs - readings[0].timeStampMs) == ((count - 1U) + overruns));
+
+  /* Catch up with the readings left after the rest of the capture */
+  for(ii = 0; ii < (BUFFER_SIZE - (POST_SIZE - 1U)); ii++)
+  {
+    capture.read();
+  }
+
+  /* The next capture is complete again */
+  addReading(capture, 0.0F);
+  for(ii = 0; ii < (PRE_SIZE + 1U + POST_SIZE); ii++)
+  {
+    addReading(capture, (ii == PRE_SIZE) ? 2.0F : 0.0F);
+  }
+  CHECK(capture.waitForCapture(0));
+  count = capture.getCapture(readings, TestCapture::CAPTURE_SIZE, index, overruns);
+  CHECK(count == TestCapture::CAPTURE_SIZE);
+  CHECK(overruns == 0U);
+  return;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  testCapture();
+  testOverrun();
+  return hostTestResult("Nano33BLETriggerCaptureTest");
+}
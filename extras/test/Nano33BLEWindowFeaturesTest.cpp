@@ -0,0 +1,117 @@
+/*
+  Nano33BLEWindowFeaturesTest.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Tests the sliding window statistics of Nano33BLEWindowChannel against a
+  brute force calculation over the same window, after every reading. Rising
+  and falling ramps fill the min and max deques completely, and a noisy
+  sine mixes short and long runs.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "HostTest.h"
+#include "Nano33BLEWindowFeatures.h"
+#include <functional>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define WINDOW_SIZE                 (16U)
+/* Enough readings for the window to slide a long way once full */
+#define READING_COUNT               (10U * WINDOW_SIZE)
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Adds READING_COUNT readings from signal to a channel, and checks
+ * its statistics against the brute force ones after each.
+ *
+ * @return false at the first reading that did not match.
+ */
+static bool checkSignal(const char* name, std::function<float(uint32_t)> signal)
+{
+  Nano33BLEWindowChannel<WINDOW_SIZE> channel;
+  float values[READING_COUNT];
+  float min;
+  float max;
+  float sum;
+  float sumOfSquares;
+  float mean;
+  uint32_t crossings;
+  uint32_t first;
+  uint32_t count;
+  uint32_t ii;
+  uint32_t jj;
+  bool passed;
+
+  passed = true;
+  for(ii = 0; (ii < READING_COUNT) && passed; ii++)
+  {
+    values[ii] = signal(ii);
+    channel.add(values[ii]);
+
+    count = (ii < WINDOW_SIZE) ? (ii + 1U) : WINDOW_SIZE;
+    first = ii + 1U - count;
+    min = values[first];
+    max = values[first];
+    sum = 0.0F;
+    sumOfSquares = 0.0F;
+    crossings = 0;
+    for(jj = first; jj <= ii; jj++)
+    {
+      min = fminf(min, values[jj]);
+      max = fmaxf(max, values[jj]);
+      sum += values[jj];
+      sumOfSquares += values[jj] * values[jj];
+      if((jj > first) && ((values[jj - 1U] < 0.0F) != (values[jj] < 0.0F)))
+      {
+        crossings++;
+      }
+    }
+    mean = sum / count;
+
+    passed = CHECK(channel.getMin() == min) && passed;
+    passed = CHECK(channel.getMax() == max) && passed;
+    passed = CHECK_NEAR(channel.getMean(), mean, 1e-4) && passed;
+    passed = CHECK_NEAR(channel.getRMS(), sqrtf(sumOfSquares / count), 1e-4) && passed;
+    passed = CHECK_NEAR(channel.getVariance(), fmaxf((sumOfSquares / count) - (mean * mean), 0.0F), 1e-3) && passed;
+    passed = CHECK(channel.getZeroCrossings() == crossings) && passed;
+    passed = CHECK(channel.isFull() == (count == WINDOW_SIZE)) && passed;
+  }
+
+  if(!passed)
+  {
+    printf("%s: wrong after reading %u\n", name, ii - 1U);
+  }
+  return passed;
+}
+
+/*****************************************************************************/
+/*MAIN                                                                       */
+/*****************************************************************************/
+int main(void)
+{
+  checkSignal("rising ramp", [](uint32_t ii) { return (float)ii; });
+  checkSignal("falling ramp", [](uint32_t ii) { return -(float)ii; });
+  checkSignal("constant", [](uint32_t ii) { (void)ii; return 1.5F; });
+  checkSignal("saw tooth", [](uint32_t ii) { return (float)(ii % (WINDOW_SIZE + 3U)) - 8.0F; });
+  checkSignal("noisy sine", [](uint32_t ii) {
+    return sinf((float)ii * 0.3F) + (0.25F * (float)((ii * 7919U) % 13U) / 13.0F) - 0.1F; });
+  return hostTestResult("Nano33BLEWindowFeaturesTest");
+}
\ No newline at end of file
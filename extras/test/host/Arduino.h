@@ -0,0 +1,147 @@
+/*
+  Arduino.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The parts of the Arduino core the library uses, for the host build of
+  the tests. Like the Mbed OS Arduino core, this includes mbed.h. Time is
+  the simulated time of HostClock.h, and Serial prints to stdout.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mbed.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#ifndef PI
+#define PI                          (3.1415926535897932384626433832795)
+#endif /* PI */
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief Formats what is printed and passes it to write(), which discards
+ * it unless overridden.
+ */
+class Print
+{
+  public:
+    virtual ~Print(){};
+
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+      (void)buffer;
+      return size;
+    }
+    size_t print(const char* text)
+    {
+      return write((const uint8_t*)text, strlen(text));
+    }
+    size_t print(char character)
+    {
+      return write((const uint8_t*)&character, 1);
+    }
+    size_t print(int value)
+    {
+      return print((long)value);
+    }
+    size_t print(unsigned int value)
+    {
+      return print((unsigned long)value);
+    }
+    size_t print(long value)
+    {
+      char text[24];
+
+      snprintf(text, sizeof(text), "%ld", value);
+      return print(text);
+    }
+    size_t print(unsigned long value)
+    {
+      char text[24];
+
+      snprintf(text, sizeof(text), "%lu", value);
+      return print(text);
+    }
+    size_t print(double value, int digits = 2)
+    {
+      char text[48];
+
+      snprintf(text, sizeof(text), "%.*f", digits, value);
+      return print(text);
+    }
+    template<typename T> size_t println(T value)
+    {
+      size_t size;
+
+      size = print(value);
+      return size + println();
+    }
+    size_t println(double value, int digits)
+    {
+      size_t size;
+
+      size = print(value, digits);
+      return size + println();
+    }
+    size_t println(void)
+    {
+      return print("\r\n");
+    }
+};
+
+class HardwareSerial: public Print
+{
+  public:
+    void begin(unsigned long baud)
+    {
+      (void)baud;
+    }
+    operator bool()
+    {
+      return true;
+    }
+    size_t write(const uint8_t* buffer, size_t size)
+    {
+      return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* HOST_ARDUINO_H_ */
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+  Arduino_APDS9960.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The Arduino library for the host build of the tests. Starting the sensor
+  always succeeds. Colour and proximity never have data, but gestures are
+  read from the gesture FIFO and decoded as the Arduino_APDS9960 library
+  does, so GESTURE_MODE_LIBRARY can be checked against GESTURE_MODE_FIFO.
+  Register level access goes through Nano33BLEI2CDevice and whatever bus
+  the test sets.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_ARDUINO_APDS9960_H_
+#define HOST_ARDUINO_APDS9960_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+enum
+{
+  GESTURE_NONE = -1,
+  GESTURE_UP = 0,
+  GESTURE_DOWN = 1,
+  GESTURE_LEFT = 2,
+  GESTURE_RIGHT = 3
+};
+
+class APDS9960
+{
+  public:
+    APDS9960() :
+      gestureSensitivity(20),
+      gestureEnabled(false),
+      detectedGesture(GESTURE_NONE),
+      gestureIn(false),
+      directionX(0),
+      directionY(0),
+      directionInX(0),
+      directionInY(0){};
+
+    bool begin(void)
+    {
+      gestureEnabled = false;
+      detectedGesture = GESTURE_NONE;
+      gestureIn = false;
+      directionX = directionY = directionInX = directionInY = 0;
+      return true;
+    }
+    void end(void){};
+    /**
+     * @brief Enables the gesture engine the first time, then drains the
+     * gesture FIFO like the library's handleGesture().
+     *
+     * @return 1 if a gesture was detected.
+     */
+    int gestureAvailable(void);
+    int readGesture(void)
+    {
+      int gesture;
+
+      gesture = detectedGesture;
+      detectedGesture = GESTURE_NONE;
+      return gesture;
+    }
+    int colorAvailable(void)
+    {
+      return 0;
+    }
+    bool readColor(int& r, int& g, int& b, int& c)
+    {
+      r = g = b = c = 0;
+      return false;
+    }
+    int proximityAvailable(void)
+    {
+      return 0;
+    }
+    int readProximity(void)
+    {
+      return -1;
+    }
+    bool setGestureSensitivity(uint8_t sensitivity)
+    {
+      if(sensitivity > 100U)
+      {
+        sensitivity = 100U;
+      }
+      gestureSensitivity = 100 - (int)sensitivity;
+      return true;
+    }
+    bool setLEDBoost(uint8_t boost)
+    {
+      (void)boost;
+      return true;
+    }
+
+  private:
+    /**
+     * @return the number of frames in the gesture FIFO, or 0 if they are
+     * not valid yet.
+     */
+    int gestureFifoAvailable(void);
+    void handleGesture(void);
+
+    int gestureSensitivity;
+    bool gestureEnabled;
+    int detectedGesture;
+    /* Whether the last frame had no hand in view, and the U - D and R - L
+     * of the last frame and the first frame after the hand came into view */
+    bool gestureIn;
+    int directionX;
+    int directionY;
+    int directionInX;
+    int directionInY;
+};
+
+extern APDS9960 APDS;
+
+#endif /* HOST_ARDUINO_APDS9960_H_ */
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+  Arduino_LSM9DS1.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The Arduino library for the host build of the tests. Starting the sensor
+  always succeeds, but it never has data. Register level access goes
+  through Nano33BLEI2CDevice and whatever bus the test sets.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_ARDUINO_LSM9DS1_H_
+#define HOST_ARDUINO_LSM9DS1_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+class LSM9DS1Class
+{
+  public:
+    int begin(void)
+    {
+      return 1;
+    }
+    void end(void){};
+    int accelerationAvailable(void)
+    {
+      return 0;
+    }
+    int readAcceleration(float& x, float& y, float& z)
+    {
+      x = y = z = 0.0F;
+      return 0;
+    }
+    int gyroscopeAvailable(void)
+    {
+      return 0;
+    }
+    int readGyroscope(float& x, float& y, float& z)
+    {
+      x = y = z = 0.0F;
+      return 0;
+    }
+    int magneticFieldAvailable(void)
+    {
+      return 0;
+    }
+    int readMagneticField(float& x, float& y, float& z)
+    {
+      x = y = z = 0.0F;
+      return 0;
+    }
+};
+
+extern LSM9DS1Class IMU;
+
+#endif /* HOST_ARDUINO_LSM9DS1_H_ */
\ No newline at end of file
@@ -0,0 +1,32 @@
+/*
+  ConditionVariable.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Mbed OS ConditionVariable for the host build of the tests. Everything is in mbed.h.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_CONDITION_VARIABLE_H_
+#define HOST_CONDITION_VARIABLE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "mbed.h"
+
+#endif /* HOST_CONDITION_VARIABLE_H_ */
\ No newline at end of file
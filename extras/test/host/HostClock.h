@@ -0,0 +1,81 @@
+/*
+  HostClock.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The simulated clock of the host build of the tests. Time starts at 0 and
+  only moves when the one thread waits or sleeps, or a test moves it. A
+  test schedules what the other threads and the sensors would do (e.g.
+  set a flag, push data) as events at a time, and any wait that reaches
+  that time runs them.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_CLOCK_H_
+#define HOST_CLOCK_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include <stdint.h>
+#include <functional>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define HOST_NO_DEADLINE            (UINT64_MAX)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+/**
+ * @return the simulated time in milliseconds.
+ */
+uint64_t hostGetTime(void);
+/**
+ * @brief Moves time on by elapsed_ms, running every event due by then.
+ *
+ */
+void hostAdvance(uint32_t elapsed_ms);
+/**
+ * @brief Runs every event due by time_ms, then moves time to time_ms if it
+ * is not there already.
+ *
+ */
+void hostRunUntil(uint64_t time_ms);
+/**
+ * @brief Runs the earliest event if it is due by deadline_ms, first moving
+ * time to it.
+ *
+ * @return false if there was no event due by deadline_ms.
+ */
+bool hostRunNextEvent(uint64_t deadline_ms);
+/**
+ * @brief Schedules an event. Events due at the same time run in the order
+ * they were scheduled.
+ *
+ * @param time_ms when to run the event. Times already passed run on the
+ * next wait.
+ */
+void hostSchedule(uint64_t time_ms, std::function<void()> event);
+/**
+ * @brief Drops every scheduled event and sets the time back to 0.
+ *
+ */
+void hostReset(void);
+
+#endif /* HOST_CLOCK_H_ */
\ No newline at end of file
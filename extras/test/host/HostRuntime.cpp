@@ -0,0 +1,377 @@
+/*
+  HostRuntime.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The simulated clock, Mbed OS waits and Arduino globals for the host
+  build of the tests.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "HostClock.h"
+#include "Arduino_LSM9DS1.h"
+#include "Arduino_LPS22HB.h"
+#include "Arduino_HTS221.h"
+#include "Arduino_APDS9960.h"
+#include "PDM.h"
+#include "Nano33BLEI2CDevice.h"
+#include <map>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* The APDS9960 registers the library's gesture handling uses */
+#define APDS9960_ENABLE                   (0x80U)
+#define APDS9960_ENABLE_GESTURE           (0x45U)
+#define APDS9960_GFLVL                    (0xAEU)
+#define APDS9960_GSTATUS                  (0xAFU)
+#define APDS9960_GSTATUS_GVALID           (0x01U)
+#define APDS9960_GFIFO_U                  (0xFCU)
+#define APDS9960_GFIFO_FRAME_SIZE         (4U)
+#define APDS9960_GFIFO_FRAMES             (32U)
+/* Frames with U, D, L and R all below this have no hand in view */
+#define APDS9960_GESTURE_THRESHOLD        (30)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+HardwareSerial Serial;
+LSM9DS1Class IMU;
+LPS22HBClass BARO;
+HTS221Class HTS;
+APDS9960 APDS;
+PDMClass PDM;
+
+static uint64_t time_ms = 0;
+/* multimap keeps events due at the same time in the order they were added */
+static std::multimap<uint64_t, std::function<void()>> events;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Called when the one thread waits forever for something that no
+ * scheduled event will ever do. On the board another thread could still
+ * wake it, but in a test this is a bug.
+ */
+static void deadlock(const char* waiter)
+{
+  fprintf(stderr, "%s waits forever at %llu ms: nothing is scheduled to wake it\n",
+    waiter, (unsigned long long)time_ms);
+  abort();
+}
+
+/*****************************************************************************/
+/*FUNCTION IMPLEMENTATION                                                    */
+/*****************************************************************************/
+uint64_t hostGetTime(void)
+{
+  return time_ms;
+}
+
+void hostAdvance(uint32_t elapsed_ms)
+{
+  hostRunUntil(time_ms + elapsed_ms);
+  return;
+}
+
+void hostRunUntil(uint64_t until_ms)
+{
+  while(hostRunNextEvent(until_ms))
+  {
+  }
+
+  if(until_ms > time_ms)
+  {
+    time_ms = until_ms;
+  }
+  return;
+}
+
+bool hostRunNextEvent(uint64_t deadline_ms)
+{
+  std::multimap<uint64_t, std::function<void()>>::iterator next;
+  std::function<void()> event;
+
+  next = events.begin();
+  if((next == events.end()) || (next->first > deadline_ms))
+  {
+    return false;
+  }
+
+  if(next->first > time_ms)
+  {
+    time_ms = next->first;
+  }
+  /* Taken off first, as the event may schedule more */
+  event = next->second;
+  events.erase(next);
+  event();
+  return true;
+}
+
+void hostSchedule(uint64_t at_ms, std::function<void()> event)
+{
+  events.insert(std::make_pair(at_ms, event));
+  return;
+}
+
+void hostReset(void)
+{
+  events.clear();
+  time_ms = 0;
+  return;
+}
+
+unsigned long millis(void)
+{
+  return (unsigned long)time_ms;
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)(time_ms * 1000U);
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvance(ms);
+  return;
+}
+
+osEvent osSignalWait(int32_t signals, uint32_t millisec)
+{
+  osEvent event;
+
+  (void)signals;
+  (void)millisec;
+  deadlock("osSignalWait");
+  event.status = osOK;
+  return event;
+}
+
+uint64_t rtos::Kernel::get_ms_count(void)
+{
+  return time_ms;
+}
+
+void rtos::ThisThread::sleep_for(uint32_t millisec)
+{
+  hostAdvance(millisec);
+  return;
+}
+
+void rtos::ThisThread::sleep_until(uint64_t millisec)
+{
+  hostRunUntil(millisec);
+  return;
+}
+
+void rtos::ConditionVariable::wait(void)
+{
+  if(!hostRunNextEvent(HOST_NO_DEADLINE))
+  {
+    deadlock("ConditionVariable::wait");
+  }
+  return;
+}
+
+bool rtos::ConditionVariable::wait_for(uint32_t millisec)
+{
+  uint64_t deadline_ms;
+
+  deadline_ms = time_ms + millisec;
+  if(!hostRunNextEvent(deadline_ms))
+  {
+    time_ms = deadline_ms;
+    return true;
+  }
+  return false;
+}
+
+void rtos::Semaphore::acquire(void)
+{
+  while(this->count <= 0)
+  {
+    if(!hostRunNextEvent(HOST_NO_DEADLINE))
+    {
+      deadlock("Semaphore::acquire");
+    }
+  }
+  this->count--;
+  return;
+}
+
+bool rtos::Semaphore::try_acquire(void)
+{
+  if(this->count <= 0)
+  {
+    return false;
+  }
+  this->count--;
+  return true;
+}
+
+bool rtos::Semaphore::try_acquire_for(uint32_t millisec)
+{
+  uint64_t deadline_ms;
+
+  deadline_ms = time_ms + millisec;
+  while(this->count <= 0)
+  {
+    if(!hostRunNextEvent(deadline_ms))
+    {
+      time_ms = deadline_ms;
+      return false;
+    }
+  }
+  this->count--;
+  return true;
+}
+
+uint32_t rtos::EventFlags::wait_any(uint32_t flags, uint32_t millisec, bool clear)
+{
+  uint64_t deadline_ms;
+  uint32_t set;
+
+  deadline_ms = (millisec == osWaitForever) ? HOST_NO_DEADLINE : (time_ms + millisec);
+  while((this->flags & flags) == 0U)
+  {
+    if(!hostRunNextEvent(deadline_ms))
+    {
+      if(millisec == osWaitForever)
+      {
+        deadlock("EventFlags::wait_any");
+      }
+      time_ms = deadline_ms;
+      return osFlagsErrorTimeout;
+    }
+  }
+
+  set = this->flags;
+  if(clear)
+  {
+    this->flags &= ~flags;
+  }
+  return set;
+}
+
+int APDS9960::gestureAvailable(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  if(!this->gestureEnabled)
+  {
+    apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_GESTURE, APDS9960_ENABLE_GESTURE);
+    this->gestureEnabled = true;
+  }
+  if(gestureFifoAvailable() <= 0)
+  {
+    return 0;
+  }
+  handleGesture();
+  return (this->detectedGesture == GESTURE_NONE) ? 0 : 1;
+}
+
+int APDS9960::gestureFifoAvailable(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+  uint8_t value;
+
+  if(!apds.readRegister(APDS9960_GSTATUS, value) || 
+    ((value & APDS9960_GSTATUS_GVALID) == 0U) ||
+    !apds.readRegister(APDS9960_GFLVL, value))
+  {
+    return 0;
+  }
+  return (int)value;
+}
+
+void APDS9960::handleGesture(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+  uint8_t fifo[APDS9960_GFIFO_FRAMES * APDS9960_GFIFO_FRAME_SIZE];
+  int available;
+  int totalX;
+  int totalY;
+  int u;
+  int d;
+  int l;
+  int r;
+  int ii;
+
+  while((available = gestureFifoAvailable()) > 0)
+  {
+    if(available > (int)APDS9960_GFIFO_FRAMES)
+    {
+      available = APDS9960_GFIFO_FRAMES;
+    }
+    if(!apds.readRegisters(APDS9960_GFIFO_U, fifo, available * APDS9960_GFIFO_FRAME_SIZE))
+    {
+      return;
+    }
+
+    for(ii = 0; ii < available; ii++)
+    {
+      u = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 0U];
+      d = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 1U];
+      l = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 2U];
+      r = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 3U];
+      if((u < APDS9960_GESTURE_THRESHOLD) && (d < APDS9960_GESTURE_THRESHOLD) &&
+        (l < APDS9960_GESTURE_THRESHOLD) && (r < APDS9960_GESTURE_THRESHOLD))
+      {
+        /* The hand has gone, so the gesture is the first frame less the last */
+        this->gestureIn = true;
+        if((this->directionInX != 0) || (this->directionInY != 0))
+        {
+          totalX = this->directionInX - this->directionX;
+          totalY = this->directionInY - this->directionY;
+          if(totalX < -this->gestureSensitivity)
+          {
+            this->detectedGesture = GESTURE_LEFT;
+          }
+          if(totalX > this->gestureSensitivity)
+          {
+            this->detectedGesture = GESTURE_RIGHT;
+          }
+          if(totalY < -this->gestureSensitivity)
+          {
+            this->detectedGesture = GESTURE_DOWN;
+          }
+          if(totalY > this->gestureSensitivity)
+          {
+            this->detectedGesture = GESTURE_UP;
+          }
+          this->directionX = this->directionY = 0;
+          this->directionInX = this->directionInY = 0;
+        }
+        continue;
+      }
+
+      this->directionX = r - l;
+      this->directionY = u - d;
+      if(this->gestureIn)
+      {
+        this->gestureIn = false;
+        this->directionInX = this->directionX;
+        this->directionInY = this->directionY;
+      }
+    }
+  }
+  return;
+}
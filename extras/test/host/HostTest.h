@@ -0,0 +1,74 @@
+/*
+  HostTest.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  Checks for the host tests. A failed check prints where it is and the
+  test carries on, and the test's main() returns hostTestResult().
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define CHECK(condition) \
+  hostCheck((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(value, expected, tolerance) \
+  hostCheck(fabs((double)(value) - (double)(expected)) <= (double)(tolerance), \
+    #value " is near " #expected, __FILE__, __LINE__)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static unsigned int hostCheckCount = 0;
+static unsigned int hostFailureCount = 0;
+
+/*****************************************************************************/
+/*FUNCTION IMPLEMENTATION                                                    */
+/*****************************************************************************/
+static inline bool hostCheck(bool passed, const char* condition, const char* file, int line)
+{
+  hostCheckCount++;
+  if(!passed)
+  {
+    hostFailureCount++;
+    printf("%s:%d: check failed: %s\n", file, line, condition);
+  }
+  return passed;
+}
+
+/**
+ * @brief Prints the result of a test.
+ *
+ * @return the exit code for main(): 0 if every check passed.
+ */
+static inline int hostTestResult(const char* name)
+{
+  printf("%s: %u checks, %u failed\n", name, hostCheckCount, hostFailureCount);
+  return (hostFailureCount == 0U) ? 0 : 1;
+}
+
+#endif /* HOST_TEST_H_ */
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+  PDM.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The PDM library for the host build of the tests. Starting the microphone
+  always succeeds, but it never has samples.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_PDM_H_
+#define HOST_PDM_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+class PDMClass
+{
+  public:
+    int begin(int channels, long sampleRate)
+    {
+      (void)channels;
+      (void)sampleRate;
+      return 1;
+    }
+    void end(void){};
+    int available(void)
+    {
+      return 0;
+    }
+    int read(void* buffer, size_t size)
+    {
+      (void)buffer;
+      (void)size;
+      return 0;
+    }
+    void onReceive(void (*function)(void))
+    {
+      (void)function;
+    }
+    void setGain(int gain)
+    {
+      (void)gain;
+    }
+};
+
+extern PDMClass PDM;
+
+#endif /* HOST_PDM_H_ */
\ No newline at end of file
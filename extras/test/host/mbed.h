@@ -0,0 +1,298 @@
+/*
+  mbed.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  The parts of Mbed OS the library uses, for the host build of the tests.
+  There is one thread. Threads are created but never run, and the tests
+  call what would run on them directly. Time is simulated: it only moves
+  when a wait or sleep needs it to, jumping to the next event scheduled
+  with hostSchedule() or to the end of the wait. Mutexes and critical
+  sections do nothing.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef HOST_MBED_H_
+#define HOST_MBED_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "HostClock.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define osWaitForever               (0xFFFFFFFFU)
+#define osOK                        (0)
+#define osFlagsError                (0x80000000U)
+#define osFlagsErrorTimeout         (0xFFFFFFFEU)
+#define OS_STACK_SIZE               (4096U)
+#define MBED_ASSERT(expression)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+typedef enum
+{
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48
+} osPriority;
+typedef int32_t osStatus;
+typedef struct
+{
+  osStatus status;
+} osEvent;
+
+/**
+ * @brief Only called when a sensor fails to start, which never happens on
+ * the host, so the test is stopped.
+ */
+osEvent osSignalWait(int32_t signals, uint32_t millisec);
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+namespace mbed
+{
+  template<typename F> class Callback;
+
+  template<typename R, typename... A> class Callback<R(A...)>
+  {
+    public:
+      Callback(){};
+      Callback(R (*function)(A...))
+      {
+        if(function != NULL)
+        {
+          this->function = function;
+        }
+      };
+      template<typename T, typename U> Callback(U* object, R (T::*method)(A...)) :
+        function([object, method](A... arguments) { return (object->*method)(arguments...); }){};
+      template<typename T, typename U> Callback(R (*function)(T*, A...), U* argument) :
+        function([function, argument](A... arguments) { return function(argument, arguments...); }){};
+
+      R call(A... arguments) const
+      {
+        return this->function(arguments...);
+      }
+      R operator()(A... arguments) const
+      {
+        return this->function(arguments...);
+      }
+      explicit operator bool() const
+      {
+        return (bool)this->function;
+      }
+
+    private:
+      std::function<R(A...)> function;
+  };
+
+  template<typename R, typename... A> Callback<R(A...)> callback(R (*function)(A...))
+  {
+    return Callback<R(A...)>(function);
+  }
+  template<typename T, typename U, typename R, typename... A> Callback<R(A...)> callback(
+    U* object, R (T::*method)(A...))
+  {
+    return Callback<R(A...)>(object, method);
+  }
+  template<typename T, typename U, typename R, typename... A> Callback<R(A...)> callback(
+    R (*function)(T*, A...), U* argument)
+  {
+    return Callback<R(A...)>(function, argument);
+  }
+
+  class CriticalSectionLock
+  {
+    public:
+      CriticalSectionLock(){};
+      ~CriticalSectionLock(){};
+  };
+}
+
+namespace rtos
+{
+  namespace Kernel
+  {
+    uint64_t get_ms_count(void);
+  }
+
+  namespace ThisThread
+  {
+    void sleep_for(uint32_t millisec);
+    void sleep_until(uint64_t millisec);
+  }
+
+  /**
+   * @brief Never runs. The task is kept so a test can run it itself.
+   */
+  class Thread
+  {
+    public:
+      Thread(
+        osPriority priority = osPriorityNormal,
+        uint32_t stack_size = OS_STACK_SIZE,
+        unsigned char* stack_mem = NULL,
+        const char* name = NULL) :
+          stackSize(stack_size),
+          threadName(name),
+          started(false)
+      {
+        (void)priority;
+        (void)stack_mem;
+      };
+
+      osStatus start(mbed::Callback<void()> task)
+      {
+        this->task = task;
+        this->started = true;
+        return osOK;
+      }
+      bool isStarted(void) const
+      {
+        return this->started;
+      }
+      mbed::Callback<void()> getTask(void) const
+      {
+        return this->task;
+      }
+      uint32_t stack_size(void) const
+      {
+        return this->started ? this->stackSize : 0U;
+      }
+      uint32_t free_stack(void) const
+      {
+        return stack_size();
+      }
+      uint32_t used_stack(void) const
+      {
+        return 0;
+      }
+      uint32_t max_stack(void) const
+      {
+        return 0;
+      }
+      const char* get_name(void) const
+      {
+        return this->threadName;
+      }
+
+    private:
+      uint32_t stackSize;
+      const char* threadName;
+      bool started;
+      mbed::Callback<void()> task;
+  };
+
+  class Mutex
+  {
+    public:
+      void lock(void){};
+      void unlock(void){};
+      bool trylock(void)
+      {
+        return true;
+      }
+  };
+
+  /**
+   * @brief A wait runs the next scheduled event, as that is the only thing
+   * that could have notified it.
+   */
+  class ConditionVariable
+  {
+    public:
+      ConditionVariable(Mutex& mutex)
+      {
+        (void)mutex;
+      };
+
+      void wait(void);
+      /**
+       * @return true if the wait timed out.
+       */
+      bool wait_for(uint32_t millisec);
+      void notify_one(void){};
+      void notify_all(void){};
+  };
+
+  class Semaphore
+  {
+    public:
+      Semaphore(int32_t count = 0) :
+        count(count){};
+
+      void acquire(void);
+      bool try_acquire(void);
+      bool try_acquire_for(uint32_t millisec);
+      osStatus release(void)
+      {
+        this->count++;
+        return osOK;
+      }
+
+    private:
+      int32_t count;
+  };
+
+  class EventFlags
+  {
+    public:
+      EventFlags() :
+        flags(0){};
+
+      uint32_t set(uint32_t flags)
+      {
+        this->flags |= flags;
+        return this->flags;
+      }
+      uint32_t clear(uint32_t flags = 0x7FFFFFFFU)
+      {
+        uint32_t previous;
+
+        previous = this->flags;
+        this->flags &= ~flags;
+        return previous;
+      }
+      uint32_t get(void) const
+      {
+        return this->flags;
+      }
+      /**
+       * @brief Runs scheduled events until one of the flags is set or the
+       * wait times out.
+       *
+       * @return the flags before they were cleared, or osFlagsErrorTimeout.
+       */
+      uint32_t wait_any(uint32_t flags = 0, uint32_t millisec = osWaitForever, bool clear = true);
+
+    private:
+      uint32_t flags;
+  };
+}
+
+#endif /* HOST_MBED_H_ */
\ No newline at end of file
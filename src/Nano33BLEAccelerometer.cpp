@@ -27,14 +27,24 @@
 #include "Nano33BLEAccelerometer.h"
 /* Place includes required for the initialisation and read of the sensor here*/
 #include <Arduino_LSM9DS1.h>
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLEGyroscope.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* LSM9DS1 registers used to set the accelerometer output data rate */
+#define LSM9DS1_CTRL_REG1_G         (0x10U)
+#define LSM9DS1_CTRL_REG6_XL        (0x20U)
+#define LSM9DS1_ODR_MASK            (0xE0U)
+#define LSM9DS1_ODR_SHIFT           (5U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
 /*****************************************************************************/
+/* LSM9DS1 accelerometer output data rates in Hz. Index + 1 is the ODR code */
+static const float accelerometerOutputDataRates[] = 
+  {14.9F, 59.5F, 119.0F, 238.0F, 476.0F, 952.0F};
 
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
@@ -61,6 +71,13 @@ void Nano33BLEAccelerometer::init()
     /* Something went wrong... Put this thread to sleep indefinetely. */
     osSignalWait(0x0001, osWaitForever);
   }
+  this->begun = true;
+  /* IMU.begin() sets its own default rate, so a rate set before begin has
+   * to be written after it */
+  if(this->configPending)
+  {
+    configure();
+  }
   return;
 }
 
@@ -84,17 +101,118 @@ void Nano33BLEAccelerometer::read(void)
    */
   Nano33BLEAccelerometerData data;
 
+  if(this->configPending)
+  {
+    configure();
+  }
+
   if(IMU.accelerationAvailable())
   {
     IMU.readAcceleration(data.x, data.y, data.z);
-    data.timeStampMs = millis();
-    push(data);
+    publish(data);
+  }
+
+  return;
+}
+
+float Nano33BLEAccelerometer::setOutputDataRate(float rate_Hz)
+{
+  const uint32_t rateCount = 
+    sizeof(accelerometerOutputDataRates)/sizeof(accelerometerOutputDataRates[0]);
+  uint8_t odr;
+  uint32_t ii;
+
+  /* Find the slowest supported rate that is at least as fast as requested */
+  for(ii = 0; ii < (rateCount - 1); ii++)
+  {
+    if(accelerometerOutputDataRates[ii] >= rate_Hz)
+    {
+      break;
+    }
+  }
+  odr = (uint8_t)((ii + 1) << LSM9DS1_ODR_SHIFT);
+
+  /* The read thread writes it, as it also powers the accelerometer down and
+   * up, and a write from here could be lost between the two */
+  this->pendingOutputDataRate = odr;
+  this->configPending = true;
+  this->scheduler.setRate(accelerometerOutputDataRates[ii]);
+  return accelerometerOutputDataRates[ii];
+}
+
+void Nano33BLEAccelerometer::configure(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+  uint8_t gyroscopeControl;
+  uint8_t odr;
+
+  /* Cleared first so a rate set while this runs is written next time */
+  this->configPending = false;
+  odr = this->pendingOutputDataRate;
+  this->poweredOutputDataRate = odr;
+
+  imu.updateRegister(LSM9DS1_CTRL_REG6_XL, LSM9DS1_ODR_MASK, odr);
+  /* While the gyroscope is powered the accelerometer runs at the gyroscope
+   * output data rate, so that has to be changed as well, along with the
+   * rate the gyroscope is read at so it keeps up with its new ODR.
+   */
+  if(imu.readRegister(LSM9DS1_CTRL_REG1_G, gyroscopeControl) &&
+    ((gyroscopeControl & LSM9DS1_ODR_MASK) != 0) &&
+    ((gyroscopeControl & LSM9DS1_ODR_MASK) != odr))
+  {
+    Gyroscope.followOutputDataRate(odr);
+  }
+  return;
+}
+
+void Nano33BLEAccelerometer::followOutputDataRate(uint8_t odr)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+
+  if(!this->begun)
+  {
+    /* Nothing else writes the register, so it can be written here */
+    imu.updateRegister(LSM9DS1_CTRL_REG6_XL, LSM9DS1_ODR_MASK, odr);
   }
+  else if(this->configPending || (this->poweredOutputDataRate != odr))
+  {
+    this->pendingOutputDataRate = odr;
+    this->configPending = true;
+  }
+  this->scheduler.setRate(
+    accelerometerOutputDataRates[(odr >> LSM9DS1_ODR_SHIFT) - 1U]);
+  return;
+}
+
+void Nano33BLEAccelerometer::powerDown(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+  uint8_t control;
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+  /* An ODR of 0 powers the accelerometer down. This only works while the
+   * gyroscope is powered down too, as the LSM9DS1 has no gyroscope only mode.
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  if(imu.readRegister(LSM9DS1_CTRL_REG6_XL, control))
+  {
+    this->poweredOutputDataRate = control & LSM9DS1_ODR_MASK;
+    imu.writeRegister(LSM9DS1_CTRL_REG6_XL, control & ~LSM9DS1_ODR_MASK);
+  }
+  return;
+}
+
+void Nano33BLEAccelerometer::powerUp(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+
+  /* A rate set while powered down is written instead of the saved one */
+  if(this->configPending)
+  {
+    configure();
+  }
+  else
+  {
+    imu.updateRegister(LSM9DS1_CTRL_REG6_XL, LSM9DS1_ODR_MASK, this->poweredOutputDataRate);
+  }
   return;
 }
 
@@ -30,8 +30,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -42,6 +42,8 @@
  */
 #define DEFAULT_ACCELEROMETER_READ_PERIOD_MS                (8U)
 #define DEFAULT_ACCELEROMETER_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* LSM9DS1 accelerometer turn on time, used when duty cycling the sensor */
+#define ACCELEROMETER_WAKE_UP_TIME_MS                    (20U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -64,35 +66,73 @@ class Nano33BLEAccelerometerData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEAccelerometerData.
+ * Channels in order: x, y, z.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEAccelerometerData>
+{
+  public:
+    enum { CHANNEL_COUNT = 3 };
+    static float get(const Nano33BLEAccelerometerData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.x;
+        case 1:
+          return (float)data.y;
+        default:
+          return (float)data.z;
+      }
+    }
+};
+
 /**
  * @brief This class reads accelerometer data from the on board Nano 33 BLE
  * Sense accelerometer using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
  */
-class Nano33BLEAccelerometer: public Nano33BLESensorBuffer<Nano33BLEAccelerometerData>
+class Nano33BLEAccelerometer: public Nano33BLESensor<Nano33BLEAccelerometer, Nano33BLEAccelerometerData>
 {
   public:
-    /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEAccelerometer::readFunction, this));
-    }
-
     Nano33BLEAccelerometer(
       uint32_t readPeriod_ms = DEFAULT_ACCELEROMETER_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_ACCELEROMETER_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEAccelerometer, Nano33BLEAccelerometerData>(
+          "Accelerometer",
+          TRACE_ID_ACCELEROMETER,
+          readPeriod_ms,
+          ACCELEROMETER_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize),
+        begun(false),
+        configPending(false),
+        pendingOutputDataRate(0),
+        poweredOutputDataRate(0){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running. The read thread writes
+     * it to the LSM9DS1 before its next read, or when it powers back up.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * closest rate the LSM9DS1 supports that is not slower than
+     * rate_Hz. The accelerometer and gyroscope share one output data rate
+     * while both are powered, so this also changes the gyroscope rate
+     * and the period the gyroscope is read at.
+     */
+    float setOutputDataRate(float rate_Hz);
 
   private:
+    friend class Nano33BLESensor<Nano33BLEAccelerometer, Nano33BLEAccelerometerData>;
+    friend class Nano33BLEGyroscope;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -104,17 +144,39 @@ class Nano33BLEAccelerometer: public Nano33BLESensorBuffer<Nano33BLEAcceleromete
      * 
      */
     void read(void);
-
-    static void readFunction(Nano33BLEAccelerometer *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Writes the pending output data rate. Only called from the read
+     * thread, which also powers the accelerometer down and up, so they never 
+     * write over each other.
+     * 
+     */
+    void configure(void);
+    /**
+     * @brief Changes the output data rate to match the gyroscope's, which 
+     * the two share while both are powered. The read thread writes it if 
+     * the accelerometer has begun, as it owns the register, and this writes it
+     * straight away otherwise.
+     * 
+     * @param odr the ODR bits of the LSM9DS1 control register.
+     */
+    void followOutputDataRate(uint8_t odr);
+
+    volatile bool begun;
+    /* The ODR bits from the setters, written by the read thread */
+    volatile bool configPending;
+    volatile uint8_t pendingOutputDataRate;
+    /* The ODR bits to restore when powering back up */
+    uint8_t poweredOutputDataRate;
 };
 
 extern Nano33BLEAccelerometer Accelerometer;
@@ -0,0 +1,264 @@
+/*
+  Nano33BLEAltitude.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class estimates altitude and vertical speed using Mbed OS, by fusing
+  the altitude from the barometric pressure with the vertical acceleration
+  from the accelerometer in a Kalman filter. It stores the results in a
+  ring buffer (within the Nano33BLESensorBuffer Class).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEAltitude.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define STANDARD_GRAVITY_MPS2                 (9.80665F)
+#define BAROMETRIC_SCALE_M                    (44330.0F)
+#define BAROMETRIC_EXPONENT                   (0.190295F)
+/* How long to wait for an accelerometer reading */
+#define ALTITUDE_READ_TIMEOUT_MS              (100U)
+/* Weight of each reading in the gravity direction estimate (about 1s at 
+ * the default accelerometer rate) */
+#define ALTITUDE_GRAVITY_WEIGHT               (0.008F)
+/* How fast the accelerometer bias may drift, in m/s^2 per sqrt(s) */
+#define ALTITUDE_BIAS_NOISE                   (0.02F)
+/* Longer gaps between readings restart the prediction */
+#define ALTITUDE_MAX_DT_S                     (0.5F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLEAltitude Altitude;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLEAltitude::setSeaLevelPressure(float pressure_kPa)
+{
+  this->seaLevelPressure_kPa = pressure_kPa;
+  return;
+}
+
+void Nano33BLEAltitude::setNoise(float accelerationNoise_mps2, float pressureNoise_m)
+{
+  this->accelerationNoise = accelerationNoise_mps2;
+  this->pressureNoise = pressureNoise_m;
+  return;
+}
+
+float Nano33BLEAltitude::pressureToAltitude(float pressure_kPa, float seaLevelPressure_kPa)
+{
+  float u;
+  float u2;
+  float y;
+  float power;
+
+  /* ln(x) = 2 atanh((x - 1) / (x + 1)), as an odd series in u */
+  u = (pressure_kPa - seaLevelPressure_kPa) / (pressure_kPa + seaLevelPressure_kPa);
+  u2 = u * u;
+  y = BAROMETRIC_EXPONENT * 2.0F * u * 
+    (1.0F + u2 * ((1.0F / 3.0F) + u2 * ((1.0F / 5.0F) + u2 * ((1.0F / 7.0F) + u2 * (1.0F / 9.0F)))));
+
+  /* x^exponent = exp(exponent * ln(x)), and |y| is small enough for a 
+   * short series */
+  power = 1.0F + y * (1.0F + y * ((1.0F / 2.0F) + y * ((1.0F / 6.0F) + 
+    y * ((1.0F / 24.0F) + y * (1.0F / 120.0F)))));
+
+  return BAROMETRIC_SCALE_M * (1.0F - power);
+}
+
+void Nano33BLEAltitude::read(void)
+{
+  Nano33BLEAccelerometerData acceleration;
+  Nano33BLEPressureData pressure;
+  Nano33BLEAltitudeData data;
+  float magnitude;
+  float vertical;
+  float measured;
+  float dt;
+  bool pressureValid;
+  uint32_t ii;
+
+  if(!this->accelerometerReader.popWait(acceleration, ALTITUDE_READ_TIMEOUT_MS))
+  {
+    return;
+  }
+
+  /* Track the direction of gravity */
+  if(!this->gravityValid)
+  {
+    this->gravity[0] = acceleration.x;
+    this->gravity[1] = acceleration.y;
+    this->gravity[2] = acceleration.z;
+    this->gravityValid = true;
+  }
+  else
+  {
+    this->gravity[0] += (acceleration.x - this->gravity[0]) * ALTITUDE_GRAVITY_WEIGHT;
+    this->gravity[1] += (acceleration.y - this->gravity[1]) * ALTITUDE_GRAVITY_WEIGHT;
+    this->gravity[2] += (acceleration.z - this->gravity[2]) * ALTITUDE_GRAVITY_WEIGHT;
+  }
+  magnitude = sqrtf((this->gravity[0] * this->gravity[0]) + 
+    (this->gravity[1] * this->gravity[1]) + (this->gravity[2] * this->gravity[2]));
+
+  if(this->initialised && (magnitude > 0.0F))
+  {
+    /* At rest the accelerometer reads 1g up, so remove it */
+    vertical = ((acceleration.x * this->gravity[0]) + (acceleration.y * this->gravity[1]) + 
+      (acceleration.z * this->gravity[2])) / magnitude;
+    vertical = (vertical - 1.0F) * STANDARD_GRAVITY_MPS2;
+
+    dt = (acceleration.timeStampMs - this->lastTimeStampMs) / 1000.0F;
+    if((dt > 0.0F) && (dt <= ALTITUDE_MAX_DT_S))
+    {
+      predict(vertical, dt);
+    }
+  }
+  this->lastTimeStampMs = acceleration.timeStampMs;
+
+  /* 
+   * Pressure arrives in bursts from the LPS22HB FIFO, already older than
+   * the state. Only the newest is used, as correcting with every sample 
+   * at once would weight them far too heavily, and it is moved to the 
+   * state's time with the vertical speed.
+   */
+  pressureValid = false;
+  while(this->pressureReader.pop(pressure))
+  {
+    pressureValid = true;
+  }
+
+  if(pressureValid)
+  {
+    measured = pressureToAltitude(pressure.barometricPressure, this->seaLevelPressure_kPa);
+    if(!this->initialised)
+    {
+      /* Start at the pressure altitude, not moving */
+      this->state[0] = measured;
+      this->state[1] = 0.0F;
+      this->state[2] = 0.0F;
+      memset(this->covariance, 0, sizeof(this->covariance));
+      for(ii = 0; ii < 3U; ii++)
+      {
+        this->covariance[ii][ii] = 1.0F;
+      }
+      this->initialised = true;
+    }
+    else
+    {
+      dt = (int32_t)(this->lastTimeStampMs - pressure.timeStampMs) / 1000.0F;
+      if((dt > 0.0F) && (dt <= ALTITUDE_MAX_DT_S))
+      {
+        measured += this->state[1] * dt;
+      }
+      correct(measured);
+    }
+  }
+
+  if(this->initialised)
+  {
+    data.altitude = this->state[0];
+    data.verticalSpeed = this->state[1];
+    data.timeStampMs = acceleration.timeStampMs;
+    push(data);
+  }
+  return;
+}
+
+void Nano33BLEAltitude::predict(float acceleration, float dt)
+{
+  float f[3][3];
+  float fp[3][3];
+  float g[3];
+  float accelerationVariance;
+  float halfDt2;
+  uint32_t ii;
+  uint32_t jj;
+  uint32_t kk;
+
+  halfDt2 = 0.5F * dt * dt;
+  acceleration -= this->state[2];
+  this->state[0] += (this->state[1] * dt) + (acceleration * halfDt2);
+  this->state[1] += acceleration * dt;
+
+  /* Covariance = F P F' + Q */
+  f[0][0] = 1.0F; f[0][1] = dt;   f[0][2] = -halfDt2;
+  f[1][0] = 0.0F; f[1][1] = 1.0F; f[1][2] = -dt;
+  f[2][0] = 0.0F; f[2][1] = 0.0F; f[2][2] = 1.0F;
+  for(ii = 0; ii < 3U; ii++)
+  {
+    for(jj = 0; jj < 3U; jj++)
+    {
+      fp[ii][jj] = 0.0F;
+      for(kk = 0; kk < 3U; kk++)
+      {
+        fp[ii][jj] += f[ii][kk] * this->covariance[kk][jj];
+      }
+    }
+  }
+
+  /* Acceleration noise enters through how it moves altitude and speed */
+  g[0] = halfDt2;
+  g[1] = dt;
+  g[2] = 0.0F;
+  accelerationVariance = this->accelerationNoise * this->accelerationNoise;
+  for(ii = 0; ii < 3U; ii++)
+  {
+    for(jj = 0; jj < 3U; jj++)
+    {
+      this->covariance[ii][jj] = g[ii] * g[jj] * accelerationVariance;
+      for(kk = 0; kk < 3U; kk++)
+      {
+        this->covariance[ii][jj] += fp[ii][kk] * f[jj][kk];
+      }
+    }
+  }
+  this->covariance[2][2] += ALTITUDE_BIAS_NOISE * ALTITUDE_BIAS_NOISE * dt;
+  return;
+}
+
+void Nano33BLEAltitude::correct(float altitude)
+{
+  float gain[3];
+  float firstRow[3];
+  float innovation;
+  float innovationVariance;
+  uint32_t ii;
+  uint32_t jj;
+
+  /* Only altitude is measured, so H = [1 0 0] */
+  innovation = altitude - this->state[0];
+  innovationVariance = this->covariance[0][0] + (this->pressureNoise * this->pressureNoise);
+  for(ii = 0; ii < 3U; ii++)
+  {
+    gain[ii] = this->covariance[ii][0] / innovationVariance;
+    firstRow[ii] = this->covariance[0][ii];
+  }
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    this->state[ii] += gain[ii] * innovation;
+    for(jj = 0; jj < 3U; jj++)
+    {
+      this->covariance[ii][jj] -= gain[ii] * firstRow[jj];
+    }
+  }
+  return;
+}
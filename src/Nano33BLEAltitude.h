@@ -0,0 +1,193 @@
+/*
+  Nano33BLEAltitude.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class estimates altitude and vertical speed using Mbed OS, by fusing
+  the altitude from the barometric pressure with the vertical acceleration
+  from the accelerometer in a Kalman filter. It stores the results in a
+  ring buffer (within the Nano33BLESensorBuffer Class).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEALTITUDE_H_
+#define NANO33BLEALTITUDE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEPressure.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_ALTITUDE_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* Standard sea level pressure */
+#define DEFAULT_SEA_LEVEL_PRESSURE_KPA                 (101.325F)
+/* Noise of the vertical acceleration, in m/s^2 */
+#define DEFAULT_ALTITUDE_ACCELERATION_NOISE            (0.35F)
+/* Noise of the altitude from pressure alone, in m */
+#define DEFAULT_ALTITUDE_PRESSURE_NOISE                (0.5F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * This class defines the data the altitude estimate gives.
+ */
+class Nano33BLEAltitudeData
+{
+  public:
+    /* Metres above the sea level pressure */
+    float altitude;
+    /* Metres per second, positive up */
+    float verticalSpeed;
+    uint32_t timeStampMs;
+};
+
+/**
+ * Gives generic access to the values in Nano33BLEAltitudeData.
+ * Channels in order: altitude, verticalSpeed.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEAltitudeData>
+{
+  public:
+    enum { CHANNEL_COUNT = 2 };
+    static float get(const Nano33BLEAltitudeData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.altitude;
+        default:
+          return (float)data.verticalSpeed;
+      }
+    }
+};
+
+/**
+ * @brief This class estimates altitude and vertical speed, and pushes a new
+ * estimate for every accelerometer reading. The filter state is altitude,
+ * vertical speed and accelerometer bias. Each accelerometer reading moves
+ * the state on using the vertical acceleration (the reading along the 
+ * direction of gravity, less 1g), and the newest pressure reading 
+ * corrects it with the altitude from pressure, moved on from when it was
+ * taken to the accelerometer reading's time. The direction of gravity is tracked by
+ * low pass filtering the accelerometer readings. Both the Accelerometer and
+ * Pressure must be started for this to work.
+ */
+class Nano33BLEAltitude: public Nano33BLESensorBuffer<Nano33BLEAltitudeData>
+{
+  public:
+    /**
+     * @brief Starts the Mbed OS Thread that runs the filter.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEAltitude::readFunction, this));
+    }
+
+    Nano33BLEAltitude(
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_ALTITUDE_THREAD_STACK_SIZE_BYTES) :
+        accelerometerReader(Accelerometer),
+        pressureReader(Pressure),
+        seaLevelPressure_kPa(DEFAULT_SEA_LEVEL_PRESSURE_KPA),
+        accelerationNoise(DEFAULT_ALTITUDE_ACCELERATION_NOISE),
+        pressureNoise(DEFAULT_ALTITUDE_PRESSURE_NOISE),
+        initialised(false),
+        gravityValid(false),
+        lastTimeStampMs(0),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "Altitude"),
+        readStack("Altitude", threadSize){};
+
+    /**
+     * @param pressure_kPa the pressure at altitude 0, e.g. the local sea 
+     * level pressure from a weather report, or the current pressure to 
+     * measure altitude relative to here.
+     */
+    void setSeaLevelPressure(float pressure_kPa);
+    /**
+     * @param accelerationNoise_mps2 how noisy the vertical acceleration is.
+     * @param pressureNoise_m how noisy the altitude from pressure is. 
+     * Larger values trust the accelerometer more.
+     */
+    void setNoise(float accelerationNoise_mps2, float pressureNoise_m);
+
+    /**
+     * @brief Converts pressure to altitude with the standard atmosphere
+     * barometric formula, 44330 * (1 - (p / p0)^0.1903), using a fast 
+     * approximation of the power that is within 4cm from 45% to 112% of 
+     * p0 (about 6km up to 900m below).
+     */
+    static float pressureToAltitude(float pressure_kPa, float seaLevelPressure_kPa);
+    /**
+     * @brief Waits up to 100ms for one accelerometer reading, applies the 
+     * newest new pressure reading, and pushes the new estimate. The 
+     * altitude thread calls this over and over once begun. It can be called
+     * from another thread instead of calling begin().
+     * 
+     */
+    void read(void);
+
+  private:
+    void predict(float acceleration, float dt);
+    void correct(float altitude);
+
+    static void readFunction(Nano33BLEAltitude *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<Nano33BLEAccelerometerData> accelerometerReader;
+    Nano33BLESensorReader<Nano33BLEPressureData> pressureReader;
+    volatile float seaLevelPressure_kPa;
+    volatile float accelerationNoise;
+    volatile float pressureNoise;
+
+    /* Altitude, vertical speed, accelerometer bias */
+    float state[3];
+    float covariance[3][3];
+    bool initialised;
+    float gravity[3];
+    bool gravityValid;
+    uint32_t lastTimeStampMs;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+extern Nano33BLEAltitude Altitude;
+
+#endif /* NANO33BLEALTITUDE_H_ */
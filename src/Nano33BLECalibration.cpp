@@ -0,0 +1,679 @@
+/*
+  Nano33BLECalibration.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class calibrates the magnetometer and gyroscope while they run. It
+  fits an ellipsoid to the magnetometer readings to find the hard iron 
+  offset and soft iron matrix, and estimates the gyroscope bias whenever
+  the board is still. The corrections are applied by the sensors before
+  their data is pushed, and can be saved to flash.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLECalibration.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Readings are divided by this before fitting, to keep the sums in range */
+#define MAGNETIC_CALIBRATION_SCALE_UT     (100.0F)
+#define CALIBRATION_RECORD_ID             (1U)
+#define JACOBI_MAX_SWEEPS                 (16U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLECalibration Calibration;
+#if defined(ARDUINO)
+Nano33BLEFlashStorage CalibrationStorage(CALIBRATION_STORAGE_SIZE_BYTES, DEFAULT_FLASH_STORAGE_SIZE_BYTES);
+#endif
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Solves the 9x9 system a x = b by Gaussian elimination with partial
+ * pivoting. a and b are overwritten.
+ * 
+ * @return false if a is singular.
+ */
+static bool solve9(double a[9][9], double b[9], double x[9])
+{
+  uint32_t row;
+  uint32_t column;
+  uint32_t pivot;
+  uint32_t ii;
+  double factor;
+  double swap;
+
+  for(column = 0; column < 9U; column++)
+  {
+    pivot = column;
+    for(row = column + 1U; row < 9U; row++)
+    {
+      if(fabs(a[row][column]) > fabs(a[pivot][column]))
+      {
+        pivot = row;
+      }
+    }
+    if(fabs(a[pivot][column]) < 1e-12)
+    {
+      return false;
+    }
+
+    if(pivot != column)
+    {
+      for(ii = 0; ii < 9U; ii++)
+      {
+        swap = a[column][ii];
+        a[column][ii] = a[pivot][ii];
+        a[pivot][ii] = swap;
+      }
+      swap = b[column];
+      b[column] = b[pivot];
+      b[pivot] = swap;
+    }
+
+    for(row = column + 1U; row < 9U; row++)
+    {
+      factor = a[row][column] / a[column][column];
+      for(ii = column; ii < 9U; ii++)
+      {
+        a[row][ii] -= factor * a[column][ii];
+      }
+      b[row] -= factor * b[column];
+    }
+  }
+
+  for(ii = 9U; ii > 0U; ii--)
+  {
+    row = ii - 1U;
+    x[row] = b[row];
+    for(column = row + 1U; column < 9U; column++)
+    {
+      x[row] -= a[row][column] * x[column];
+    }
+    x[row] /= a[row][row];
+  }
+  return true;
+}
+
+/**
+ * @brief Finds the eigenvalues and eigenvectors of a symmetric 3x3 matrix
+ * with Jacobi rotations. a is left holding the eigenvalues on its diagonal,
+ * and the columns of v are the eigenvectors.
+ */
+static void eigenSymmetric3(double a[3][3], double v[3][3])
+{
+  static const uint8_t pairs[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+  uint32_t sweep;
+  uint32_t pair;
+  uint32_t p;
+  uint32_t q;
+  uint32_t k;
+  double theta;
+  double t;
+  double c;
+  double s;
+  double first;
+  double second;
+
+  for(p = 0; p < 3U; p++)
+  {
+    for(q = 0; q < 3U; q++)
+    {
+      v[p][q] = (p == q) ? 1.0 : 0.0;
+    }
+  }
+
+  for(sweep = 0; sweep < JACOBI_MAX_SWEEPS; sweep++)
+  {
+    if(((a[0][1] * a[0][1]) + (a[0][2] * a[0][2]) + (a[1][2] * a[1][2])) < 1e-24)
+    {
+      break;
+    }
+
+    for(pair = 0; pair < 3U; pair++)
+    {
+      p = pairs[pair][0];
+      q = pairs[pair][1];
+      if(fabs(a[p][q]) < 1e-30)
+      {
+        continue;
+      }
+
+      /* Rotation that zeroes a[p][q] */
+      theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+      t = 1.0 / (fabs(theta) + sqrt((theta * theta) + 1.0));
+      if(theta < 0.0)
+      {
+        t = -t;
+      }
+      c = 1.0 / sqrt((t * t) + 1.0);
+      s = t * c;
+
+      for(k = 0; k < 3U; k++)
+      {
+        first = a[k][p];
+        second = a[k][q];
+        a[k][p] = (c * first) - (s * second);
+        a[k][q] = (s * first) + (c * second);
+      }
+      for(k = 0; k < 3U; k++)
+      {
+        first = a[p][k];
+        second = a[q][k];
+        a[p][k] = (c * first) - (s * second);
+        a[q][k] = (s * first) + (c * second);
+      }
+      for(k = 0; k < 3U; k++)
+      {
+        first = v[k][p];
+        second = v[k][q];
+        v[k][p] = (c * first) - (s * second);
+        v[k][q] = (s * first) + (c * second);
+      }
+    }
+  }
+  return;
+}
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+Nano33BLECalibration::Nano33BLECalibration() :
+  learning(true),
+  stillVariance(DEFAULT_GYROSCOPE_STILL_VARIANCE),
+  accelerometerReader(Accelerometer),
+  storeMounted(false)
+{
+  reset();
+}
+
+bool Nano33BLECalibration::begin(Nano33BLELogStorage& storage)
+{
+  Nano33BLECalibrationData saved;
+  Nano33BLECalibrationData loaded;
+  uint32_t size;
+  uint8_t id;
+  bool found;
+
+  this->storeMounted = this->store.mount(storage);
+  if(!this->storeMounted)
+  {
+    return false;
+  }
+
+  /* The newest saved calibration is the last record */
+  found = false;
+  this->store.rewind();
+  while((size = this->store.readNext(id, &loaded, sizeof(loaded))) != 0U)
+  {
+    if((id == CALIBRATION_RECORD_ID) && (size == sizeof(loaded)))
+    {
+      saved = loaded;
+      found = true;
+    }
+  }
+
+  if(found)
+  {
+    setData(saved);
+  }
+  return found;
+}
+
+bool Nano33BLECalibration::update(void)
+{
+  Nano33BLECalibrationData fitted;
+  uint32_t sampleCount;
+  uint32_t ii;
+  uint32_t jj;
+  bool success;
+
+  if(!this->magneticFitDue)
+  {
+    return false;
+  }
+
+  /* Copy the sums, so the read thread can carry on while the fit runs */
+  this->calibrationMutex.lock();
+  for(ii = 0; ii < 9U; ii++)
+  {
+    for(jj = 0; jj < 9U; jj++)
+    {
+      this->fitMatrix[ii][jj] = (jj >= ii) ? this->normalMatrix[ii][jj] : this->normalMatrix[jj][ii];
+    }
+    this->fitVector[ii] = this->normalVector[ii];
+  }
+  sampleCount = this->magneticSampleCount;
+  this->magneticFitDue = false;
+  this->calibrationMutex.unlock();
+
+  success = fitMagnetic(fitted);
+  if(success)
+  {
+    this->calibrationMutex.lock();
+    /* Not if reset() or setLearning(false) was called during the fit */
+    success = this->learning && (this->magneticSampleCount >= sampleCount);
+    if(success)
+    {
+      memcpy(this->parameters.magneticOffset, fitted.magneticOffset, sizeof(fitted.magneticOffset));
+      memcpy(this->parameters.magneticMatrix, fitted.magneticMatrix, sizeof(fitted.magneticMatrix));
+    }
+    this->calibrationMutex.unlock();
+  }
+  return success;
+}
+
+bool Nano33BLECalibration::save(void)
+{
+  Nano33BLECalibrationData data;
+
+  if(!this->storeMounted)
+  {
+    return false;
+  }
+
+  getData(data);
+  return this->store.append(CALIBRATION_RECORD_ID, &data, sizeof(data));
+}
+
+void Nano33BLECalibration::reset(void)
+{
+  uint32_t ii;
+  uint32_t jj;
+
+  this->calibrationMutex.lock();
+  for(ii = 0; ii < 3U; ii++)
+  {
+    this->parameters.magneticOffset[ii] = 0.0F;
+    this->parameters.gyroscopeBias[ii] = 0.0F;
+    for(jj = 0; jj < 3U; jj++)
+    {
+      this->parameters.magneticMatrix[ii][jj] = (ii == jj) ? 1.0F : 0.0F;
+    }
+    this->lastSample[ii] = 0.0F;
+    this->gyroscopeSum[ii] = 0.0F;
+    this->gyroscopeSumOfSquares[ii] = 0.0F;
+    this->accelerometerSum[ii] = 0.0F;
+    this->accelerometerSumOfSquares[ii] = 0.0F;
+  }
+  memset(this->normalMatrix, 0, sizeof(this->normalMatrix));
+  memset(this->normalVector, 0, sizeof(this->normalVector));
+  this->magneticSampleCount = 0;
+  this->magneticFitDue = false;
+  this->gyroscopeSampleCount = 0;
+  this->accelerometerSampleCount = 0;
+  this->gyroscopeBiasValid = false;
+  this->calibrationMutex.unlock();
+  return;
+}
+
+void Nano33BLECalibration::setLearning(bool learn)
+{
+  this->learning = learn;
+  return;
+}
+
+void Nano33BLECalibration::setStillVariance(float variance_dps2)
+{
+  this->stillVariance = variance_dps2;
+  return;
+}
+
+void Nano33BLECalibration::getData(Nano33BLECalibrationData& data)
+{
+  this->calibrationMutex.lock();
+  data = this->parameters;
+  this->calibrationMutex.unlock();
+  return;
+}
+
+void Nano33BLECalibration::setData(const Nano33BLECalibrationData& data)
+{
+  this->calibrationMutex.lock();
+  this->parameters = data;
+  /* A loaded bias is a good starting point for the bias estimate */
+  this->gyroscopeBiasValid = true;
+  this->calibrationMutex.unlock();
+  return;
+}
+
+uint32_t Nano33BLECalibration::getMagneticSampleCount(void)
+{
+  return this->magneticSampleCount;
+}
+
+void Nano33BLECalibration::correctMagnetic(float& x, float& y, float& z)
+{
+  float raw[3];
+  float centred[3];
+  uint32_t ii;
+
+  raw[0] = x;
+  raw[1] = y;
+  raw[2] = z;
+
+  this->calibrationMutex.lock();
+  if(this->learning)
+  {
+    addMagneticSample(raw);
+  }
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    centred[ii] = raw[ii] - this->parameters.magneticOffset[ii];
+  }
+  x = (this->parameters.magneticMatrix[0][0] * centred[0]) +
+    (this->parameters.magneticMatrix[0][1] * centred[1]) +
+    (this->parameters.magneticMatrix[0][2] * centred[2]);
+  y = (this->parameters.magneticMatrix[1][0] * centred[0]) +
+    (this->parameters.magneticMatrix[1][1] * centred[1]) +
+    (this->parameters.magneticMatrix[1][2] * centred[2]);
+  z = (this->parameters.magneticMatrix[2][0] * centred[0]) +
+    (this->parameters.magneticMatrix[2][1] * centred[1]) +
+    (this->parameters.magneticMatrix[2][2] * centred[2]);
+  this->calibrationMutex.unlock();
+  return;
+}
+
+void Nano33BLECalibration::correctGyroscope(float& x, float& y, float& z)
+{
+  float raw[3];
+
+  raw[0] = x;
+  raw[1] = y;
+  raw[2] = z;
+
+  this->calibrationMutex.lock();
+  if(this->learning)
+  {
+    addGyroscopeSample(raw);
+  }
+
+  x = raw[0] - this->parameters.gyroscopeBias[0];
+  y = raw[1] - this->parameters.gyroscopeBias[1];
+  z = raw[2] - this->parameters.gyroscopeBias[2];
+  this->calibrationMutex.unlock();
+  return;
+}
+
+void Nano33BLECalibration::addMagneticSample(const float* sample)
+{
+  double terms[9];
+  double x;
+  double y;
+  double z;
+  float distance;
+  uint32_t ii;
+  uint32_t jj;
+
+  distance = fabsf(sample[0] - this->lastSample[0]) + 
+    fabsf(sample[1] - this->lastSample[1]) + 
+    fabsf(sample[2] - this->lastSample[2]);
+  if(distance < MAGNETIC_CALIBRATION_MIN_SPACING_UT)
+  {
+    return;
+  }
+  this->lastSample[0] = sample[0];
+  this->lastSample[1] = sample[1];
+  this->lastSample[2] = sample[2];
+
+  x = sample[0] / MAGNETIC_CALIBRATION_SCALE_UT;
+  y = sample[1] / MAGNETIC_CALIBRATION_SCALE_UT;
+  z = sample[2] / MAGNETIC_CALIBRATION_SCALE_UT;
+  terms[0] = x * x;
+  terms[1] = y * y;
+  terms[2] = z * z;
+  terms[3] = 2.0 * x * y;
+  terms[4] = 2.0 * x * z;
+  terms[5] = 2.0 * y * z;
+  terms[6] = 2.0 * x;
+  terms[7] = 2.0 * y;
+  terms[8] = 2.0 * z;
+
+  for(ii = 0; ii < 9U; ii++)
+  {
+    for(jj = ii; jj < 9U; jj++)
+    {
+      this->normalMatrix[ii][jj] += terms[ii] * terms[jj];
+    }
+    this->normalVector[ii] += terms[ii];
+  }
+  this->magneticSampleCount++;
+
+  if((this->magneticSampleCount >= MAGNETIC_CALIBRATION_MIN_SAMPLES) &&
+    ((this->magneticSampleCount % MAGNETIC_CALIBRATION_UPDATE_INTERVAL) == 0U))
+  {
+    this->magneticFitDue = true;
+  }
+  return;
+}
+
+bool Nano33BLECalibration::fitMagnetic(Nano33BLECalibrationData& fitted)
+{
+  double p[9];
+  double shape[3][3];
+  double inverse[3][3];
+  double vectors[3][3];
+  double centre[3];
+  double scale[3];
+  double radius[3];
+  double determinant;
+  double k;
+  double field;
+  double minRadius;
+  double maxRadius;
+  uint32_t ii;
+  uint32_t jj;
+  uint32_t kk;
+
+  if(!solve9(this->fitMatrix, this->fitVector, p))
+  {
+    return false;
+  }
+
+  shape[0][0] = p[0];
+  shape[1][1] = p[1];
+  shape[2][2] = p[2];
+  shape[0][1] = p[3];
+  shape[1][0] = p[3];
+  shape[0][2] = p[4];
+  shape[2][0] = p[4];
+  shape[1][2] = p[5];
+  shape[2][1] = p[5];
+
+  /* Centre = -shape^-1 * (G, H, I) */
+  inverse[0][0] = (shape[1][1] * shape[2][2]) - (shape[1][2] * shape[2][1]);
+  inverse[0][1] = (shape[0][2] * shape[2][1]) - (shape[0][1] * shape[2][2]);
+  inverse[0][2] = (shape[0][1] * shape[1][2]) - (shape[0][2] * shape[1][1]);
+  inverse[1][0] = (shape[1][2] * shape[2][0]) - (shape[1][0] * shape[2][2]);
+  inverse[1][1] = (shape[0][0] * shape[2][2]) - (shape[0][2] * shape[2][0]);
+  inverse[1][2] = (shape[0][2] * shape[1][0]) - (shape[0][0] * shape[1][2]);
+  inverse[2][0] = (shape[1][0] * shape[2][1]) - (shape[1][1] * shape[2][0]);
+  inverse[2][1] = (shape[0][1] * shape[2][0]) - (shape[0][0] * shape[2][1]);
+  inverse[2][2] = (shape[0][0] * shape[1][1]) - (shape[0][1] * shape[1][0]);
+  determinant = (shape[0][0] * inverse[0][0]) + (shape[0][1] * inverse[1][0]) + 
+    (shape[0][2] * inverse[2][0]);
+  if(fabs(determinant) < 1e-30)
+  {
+    return false;
+  }
+  for(ii = 0; ii < 3U; ii++)
+  {
+    centre[ii] = -((inverse[ii][0] * p[6]) + (inverse[ii][1] * p[7]) + 
+      (inverse[ii][2] * p[8])) / determinant;
+  }
+
+  /* (v - centre)' shape (v - centre) = k */
+  k = 1.0;
+  for(ii = 0; ii < 3U; ii++)
+  {
+    for(jj = 0; jj < 3U; jj++)
+    {
+      k += centre[ii] * shape[ii][jj] * centre[jj];
+    }
+  }
+  if(k <= 0.0)
+  {
+    return false;
+  }
+  for(ii = 0; ii < 3U; ii++)
+  {
+    for(jj = 0; jj < 3U; jj++)
+    {
+      shape[ii][jj] /= k;
+    }
+  }
+
+  /* The eigenvalues are 1 / radius^2 along each axis of the ellipsoid */
+  eigenSymmetric3(shape, vectors);
+  for(ii = 0; ii < 3U; ii++)
+  {
+    if(shape[ii][ii] <= 0.0)
+    {
+      return false;
+    }
+    radius[ii] = 1.0 / sqrt(shape[ii][ii]);
+  }
+
+  /* Map to a sphere with the same volume as the ellipsoid */
+  field = cbrt(radius[0] * radius[1] * radius[2]);
+  minRadius = fmin(radius[0], fmin(radius[1], radius[2]));
+  maxRadius = fmax(radius[0], fmax(radius[1], radius[2]));
+  if(((field * MAGNETIC_CALIBRATION_SCALE_UT) < MAGNETIC_CALIBRATION_MIN_FIELD_UT) ||
+    ((field * MAGNETIC_CALIBRATION_SCALE_UT) > MAGNETIC_CALIBRATION_MAX_FIELD_UT) ||
+    (maxRadius > (minRadius * MAGNETIC_CALIBRATION_MAX_AXIS_RATIO)))
+  {
+    return false;
+  }
+  for(ii = 0; ii < 3U; ii++)
+  {
+    scale[ii] = field / radius[ii];
+  }
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    fitted.magneticOffset[ii] = (float)(centre[ii] * MAGNETIC_CALIBRATION_SCALE_UT);
+    for(jj = 0; jj < 3U; jj++)
+    {
+      fitted.magneticMatrix[ii][jj] = 0.0F;
+      for(kk = 0; kk < 3U; kk++)
+      {
+        fitted.magneticMatrix[ii][jj] += 
+          (float)(vectors[ii][kk] * scale[kk] * vectors[jj][kk]);
+      }
+    }
+  }
+  return true;
+}
+
+void Nano33BLECalibration::addGyroscopeSample(const float* sample)
+{
+  Nano33BLEAccelerometerData acceleration;
+  float axes[3];
+  float mean;
+  float variance;
+  bool still;
+  uint32_t ii;
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    this->gyroscopeSum[ii] += sample[ii];
+    this->gyroscopeSumOfSquares[ii] += sample[ii] * sample[ii];
+  }
+  this->gyroscopeSampleCount++;
+
+  /* Any accelerometer readings since the last gyroscope reading */
+  while(this->accelerometerReader.pop(acceleration))
+  {
+    axes[0] = acceleration.x;
+    axes[1] = acceleration.y;
+    axes[2] = acceleration.z;
+    for(ii = 0; ii < 3U; ii++)
+    {
+      this->accelerometerSum[ii] += axes[ii];
+      this->accelerometerSumOfSquares[ii] += axes[ii] * axes[ii];
+    }
+    this->accelerometerSampleCount++;
+  }
+
+  if(this->gyroscopeSampleCount < GYROSCOPE_CALIBRATION_WINDOW_SIZE)
+  {
+    return;
+  }
+
+  /* The board is still if the rate barely changed on every axis */
+  still = true;
+  for(ii = 0; ii < 3U; ii++)
+  {
+    mean = this->gyroscopeSum[ii] / GYROSCOPE_CALIBRATION_WINDOW_SIZE;
+    variance = (this->gyroscopeSumOfSquares[ii] / GYROSCOPE_CALIBRATION_WINDOW_SIZE) - 
+      (mean * mean);
+    if((variance > this->stillVariance) || (fabsf(mean) > GYROSCOPE_CALIBRATION_MAX_BIAS_DPS))
+    {
+      still = false;
+    }
+  }
+
+  /* A slow steady turn also barely changes the rate, but it does turn 
+   * gravity as the accelerometer sees it */
+  if(this->accelerometerSampleCount < GYROSCOPE_CALIBRATION_MIN_ACCELEROMETER_READINGS)
+  {
+    still = false;
+  }
+  for(ii = 0; (ii < 3U) && still; ii++)
+  {
+    mean = this->accelerometerSum[ii] / this->accelerometerSampleCount;
+    variance = (this->accelerometerSumOfSquares[ii] / this->accelerometerSampleCount) - 
+      (mean * mean);
+    if(variance > GYROSCOPE_CALIBRATION_ACCELEROMETER_VARIANCE)
+    {
+      still = false;
+    }
+  }
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    if(still)
+    {
+      mean = this->gyroscopeSum[ii] / GYROSCOPE_CALIBRATION_WINDOW_SIZE;
+      if(this->gyroscopeBiasValid)
+      {
+        this->parameters.gyroscopeBias[ii] += 
+          (mean - this->parameters.gyroscopeBias[ii]) * GYROSCOPE_CALIBRATION_BIAS_WEIGHT;
+      }
+      else
+      {
+        this->parameters.gyroscopeBias[ii] = mean;
+      }
+    }
+    this->gyroscopeSum[ii] = 0.0F;
+    this->gyroscopeSumOfSquares[ii] = 0.0F;
+    this->accelerometerSum[ii] = 0.0F;
+    this->accelerometerSumOfSquares[ii] = 0.0F;
+  }
+  if(still)
+  {
+    this->gyroscopeBiasValid = true;
+  }
+  this->gyroscopeSampleCount = 0;
+  this->accelerometerSampleCount = 0;
+  return;
+}
@@ -0,0 +1,210 @@
+/*
+  Nano33BLECalibration.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class calibrates the magnetometer and gyroscope while they run. It
+  fits an ellipsoid to the magnetometer readings to find the hard iron 
+  offset and soft iron matrix, and estimates the gyroscope bias whenever
+  the board is still (both the gyroscope and the accelerometer steady). The corrections are applied by the sensors before
+  their data is pushed, and can be saved to flash.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLECALIBRATION_H_
+#define NANO33BLECALIBRATION_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Mutex.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLELogger.h"
+#include "Nano33BLELogStorage.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Flash used to save the calibration, just below the log area */
+#define CALIBRATION_STORAGE_SIZE_BYTES            (8U * 1024U)
+/* Magnetometer readings closer than this to the last one used are ignored,
+ * so the fit is not swamped by readings from one orientation */
+#define MAGNETIC_CALIBRATION_MIN_SPACING_UT       (4.0F)
+/* Readings needed before the first fit */
+#define MAGNETIC_CALIBRATION_MIN_SAMPLES          (100U)
+/* Readings between each new fit, which update() then runs */
+#define MAGNETIC_CALIBRATION_UPDATE_INTERVAL      (25U)
+/* Fits outside these limits are not used */
+#define MAGNETIC_CALIBRATION_MIN_FIELD_UT         (15.0F)
+#define MAGNETIC_CALIBRATION_MAX_FIELD_UT         (100.0F)
+#define MAGNETIC_CALIBRATION_MAX_AXIS_RATIO       (2.0F)
+/* Gyroscope readings in each stillness check */
+#define GYROSCOPE_CALIBRATION_WINDOW_SIZE         (50U)
+/* Largest variance on every axis (dps^2) that counts as still */
+#define DEFAULT_GYROSCOPE_STILL_VARIANCE          (0.25F)
+/* Larger means are taken as motion rather than bias */
+#define GYROSCOPE_CALIBRATION_MAX_BIAS_DPS        (10.0F)
+/* Largest accelerometer variance on every axis (g^2) that counts as still,
+ * and the readings needed in each stillness check */
+#define GYROSCOPE_CALIBRATION_ACCELEROMETER_VARIANCE  (0.00002F)
+#define GYROSCOPE_CALIBRATION_MIN_ACCELEROMETER_READINGS (10U)
+/* How much each still window moves the bias estimate */
+#define GYROSCOPE_CALIBRATION_BIAS_WEIGHT         (0.25F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * This class holds the calibration parameters. Corrected magnetic field is
+ * magneticMatrix * (raw - magneticOffset), and corrected angular rate is
+ * raw - gyroscopeBias.
+ */
+class Nano33BLECalibrationData
+{
+  public:
+    float magneticOffset[3];
+    float magneticMatrix[3][3];
+    float gyroscopeBias[3];
+};
+
+/**
+ * @brief This class learns and applies the magnetometer and gyroscope 
+ * calibration. Magnetic and Gyroscope call it from their read threads, so
+ * every consumer gets corrected data. The read threads only add readings to
+ * running sums; the magnetometer fit needs more stack than they have, so it
+ * is run by update().
+ * 
+ * The board only counts as still for the gyroscope bias when the 
+ * accelerometer is steady too, so a slow steady turn is not taken as bias.
+ * The accelerometer must be running (Accelerometer.begin()) for the bias to
+ * be learned. A steady turn about the vertical axis cannot be told from 
+ * bias this way, so keep the board still while it learns if it may turn
+ * like that.
+ * 
+ * The magnetometer fit is a least squares fit of the readings to the 
+ * ellipsoid Ax^2 + By^2 + Cz^2 + 2Dxy + 2Exz + 2Fyz + 2Gx + 2Hy + 2Iz = 1.
+ * Each reading only adds to running sums (the normal equations), so the 
+ * fit is updated without keeping the readings. The centre of the ellipsoid
+ * is the hard iron offset, and the matrix that maps it to a sphere is the
+ * soft iron correction.
+ */
+class Nano33BLECalibration
+{
+  public:
+    Nano33BLECalibration();
+
+    /**
+     * @brief Mounts the calibration storage and loads the last saved 
+     * calibration, if there is one.
+     * 
+     * @return true if a saved calibration was loaded.
+     */
+    bool begin(Nano33BLELogStorage& storage);
+    /**
+     * @brief Runs the magnetometer fit if enough readings have been added
+     * since the last one. Call this regularly (e.g. from loop()) from one
+     * thread with at least 2KB of stack. The read threads carry on adding
+     * readings while the fit runs.
+     * 
+     * @return true if a new magnetometer calibration is being used.
+     */
+    bool update(void);
+    /**
+     * @brief Saves the current calibration to the storage given to begin().
+     */
+    bool save(void);
+    /**
+     * @brief Goes back to no correction and starts learning again.
+     */
+    void reset(void);
+    /**
+     * @param learn false to keep the current calibration fixed.
+     */
+    void setLearning(bool learn);
+    /**
+     * @param variance_dps2 largest variance on every axis that counts as
+     * the board being still.
+     */
+    void setStillVariance(float variance_dps2);
+    void getData(Nano33BLECalibrationData& data);
+    void setData(const Nano33BLECalibrationData& data);
+    /**
+     * @return the number of magnetometer readings used in the fit.
+     */
+    uint32_t getMagneticSampleCount(void);
+
+    /**
+     * @brief Learns from a raw magnetometer reading (in uT) and corrects it
+     * in place.
+     */
+    void correctMagnetic(float& x, float& y, float& z);
+    /**
+     * @brief Learns from a raw gyroscope reading (in dps) and corrects it 
+     * in place.
+     */
+    void correctGyroscope(float& x, float& y, float& z);
+
+  private:
+    void addMagneticSample(const float* sample);
+    /**
+     * @brief Fits the ellipsoid to the sums copied into fitMatrix and 
+     * fitVector, which it overwrites.
+     * 
+     * @return false if the fit is not usable.
+     */
+    bool fitMagnetic(Nano33BLECalibrationData& fitted);
+    void addGyroscopeSample(const float* sample);
+
+    Nano33BLECalibrationData parameters;
+    volatile bool learning;
+    volatile float stillVariance;
+
+    /* Upper triangle of the normal equations, in normalised units */
+    double normalMatrix[9][9];
+    double normalVector[9];
+    float lastSample[3];
+    uint32_t magneticSampleCount;
+    volatile bool magneticFitDue;
+    /* Only used by update(), so the fit does not run on the read thread */
+    double fitMatrix[9][9];
+    double fitVector[9];
+
+    float gyroscopeSum[3];
+    float gyroscopeSumOfSquares[3];
+    uint32_t gyroscopeSampleCount;
+    Nano33BLESensorReader<Nano33BLEAccelerometerData> accelerometerReader;
+    float accelerometerSum[3];
+    float accelerometerSumOfSquares[3];
+    uint32_t accelerometerSampleCount;
+    bool gyroscopeBiasValid;
+
+    Nano33BLELogger store;
+    bool storeMounted;
+    rtos::Mutex calibrationMutex;
+};
+
+extern Nano33BLECalibration Calibration;
+#if defined(ARDUINO)
+extern Nano33BLEFlashStorage CalibrationStorage;
+#endif
+
+#endif /* NANO33BLECALIBRATION_H_ */
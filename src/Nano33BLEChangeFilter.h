@@ -0,0 +1,230 @@
+/*
+  Nano33BLEChangeFilter.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements a change of value (deadband) filter for any
+  sensor's data. Attached to a sensor buffer it stops readings that have
+  not changed meaningfully from being stored, so slow sensors do not fill
+  their buffers (and whatever reads them) with duplicates.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLECHANGEFILTER_H_
+#define NANO33BLECHANGEFILTER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Kernel.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Longest time without a push before one is let through regardless */
+#define DEFAULT_CHANGE_FILTER_HEARTBEAT_MS     (5000U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class only lets a reading through when one of its channels
+ * (see Nano33BLESensorChannels) has moved outside a deadband around the
+ * value of that channel in the last reading let through. The deadband of
+ * each channel is the larger of an absolute amount and a fraction of the
+ * last value, so a relative deadband still has a floor near 0. A reading is
+ * also let through if nothing has been for the heartbeat time, so consumers
+ * can tell a steady sensor from a stopped one.
+ *
+ * Attach it to a sensor with setPushFilter(), e.g.
+ *
+ *   Nano33BLEChangeFilter<Nano33BLEPressureData> pressureFilter;
+ *   pressureFilter.setDeadband(0.01F, 0.0F);
+ *   Pressure.setPushFilter(&pressureFilter);
+ *
+ * By default only exact repeats are dropped.
+ */
+template<class T>
+class Nano33BLEChangeFilter: public Nano33BLEPushFilter<T>
+{
+  public:
+    enum { CHANNEL_COUNT = Nano33BLESensorChannels<T>::CHANNEL_COUNT };
+
+    Nano33BLEChangeFilter(uint32_t heartbeat_ms = DEFAULT_CHANGE_FILTER_HEARTBEAT_MS) :
+      heartbeat_ms(heartbeat_ms),
+      hasLast(false),
+      lastPassed_ms(0),
+      passedCount(0),
+      suppressedCount(0)
+    {
+      setDeadband(0.0F, 0.0F);
+    };
+
+    /**
+     * @brief Sets the deadband of one channel.
+     *
+     * @param channel the channel, in the order given by its
+     * Nano33BLESensorChannels specialisation.
+     * @param absolute the smallest change that is let through, in the
+     * channel's units.
+     * @param relative the smallest change that is let through as a fraction
+     * of the last value let through, e.g. 0.05 for 5%.
+     */
+    void setDeadband(uint32_t channel, float absolute, float relative)
+    {
+      if(channel < CHANNEL_COUNT)
+      {
+        this->absolute[channel] = absolute;
+        this->relative[channel] = relative;
+      }
+      return;
+    }
+
+    /**
+     * @brief Sets the same deadband on every channel.
+     *
+     */
+    void setDeadband(float absolute, float relative)
+    {
+      uint32_t ii;
+
+      for(ii = 0; ii < CHANNEL_COUNT; ii++)
+      {
+        setDeadband(ii, absolute, relative);
+      }
+      return;
+    }
+
+    /**
+     * @brief Sets the longest time without a push before a reading is let
+     * through even if it has not changed. 0 turns the heartbeat off.
+     *
+     */
+    void setHeartbeat(uint32_t heartbeat_ms)
+    {
+      this->heartbeat_ms = heartbeat_ms;
+      return;
+    }
+
+    /**
+     * @brief Forgets the last reading, so the next one is let through.
+     *
+     */
+    void reset(void)
+    {
+      this->hasLast = false;
+      return;
+    }
+
+    /**
+     * @return the number of readings let through.
+     */
+    uint32_t getPassedCount(void)
+    {
+      return this->passedCount;
+    }
+
+    /**
+     * @return the number of readings dropped.
+     */
+    uint32_t getSuppressedCount(void)
+    {
+      return this->suppressedCount;
+    }
+
+    /**
+     * @return the fraction of readings dropped, from 0 (none) to 1 (all).
+     */
+    float getSuppressionRatio(void)
+    {
+      uint32_t passed;
+      uint32_t suppressed;
+
+      passed = this->passedCount;
+      suppressed = this->suppressedCount;
+      if((passed + suppressed) == 0U)
+      {
+        return 0.0F;
+      }
+      return ((float)suppressed / (float)(passed + suppressed));
+    }
+
+    bool accept(const T& data)
+    {
+      uint64_t now_ms;
+      uint32_t ii;
+
+      now_ms = rtos::Kernel::get_ms_count();
+      if(!this->hasLast || changed(data) || 
+        ((this->heartbeat_ms != 0U) && 
+        ((now_ms - this->lastPassed_ms) >= this->heartbeat_ms)))
+      {
+        for(ii = 0; ii < CHANNEL_COUNT; ii++)
+        {
+          this->last[ii] = Nano33BLESensorChannels<T>::get(data, ii);
+        }
+        this->hasLast = true;
+        this->lastPassed_ms = now_ms;
+        this->passedCount++;
+        return true;
+      }
+
+      this->suppressedCount++;
+      return false;
+    }
+
+  private:
+    bool changed(const T& data)
+    {
+      uint32_t ii;
+      float deadband;
+      float relativeDeadband;
+
+      for(ii = 0; ii < CHANNEL_COUNT; ii++)
+      {
+        deadband = this->absolute[ii];
+        relativeDeadband = this->relative[ii] * fabsf(this->last[ii]);
+        if(relativeDeadband > deadband)
+        {
+          deadband = relativeDeadband;
+        }
+
+        if(fabsf(Nano33BLESensorChannels<T>::get(data, ii) - this->last[ii]) > deadband)
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    float absolute[CHANNEL_COUNT];
+    float relative[CHANNEL_COUNT];
+    float last[CHANNEL_COUNT];
+    volatile uint32_t heartbeat_ms;
+    volatile bool hasLast;
+    uint64_t lastPassed_ms;
+    volatile uint32_t passedCount;
+    volatile uint32_t suppressedCount;
+};
+
+#endif /* NANO33BLECHANGEFILTER_H_ */
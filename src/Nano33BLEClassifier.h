@@ -0,0 +1,258 @@
+/*
+  Nano33BLEClassifier.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class classifies windows of sensor data on the board (e.g. shakes,
+  taps and tilts) using Mbed OS, so only the class needs to be sent rather
+  than the raw data. It stores the results in a ring buffer (within the
+  Nano33BLESensorBuffer Class).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLECLASSIFIER_H_
+#define NANO33BLECLASSIFIER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLEWindowFeatures.h"
+#include "Nano33BLEClassifierModel.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_CLASSIFIER_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* How long to wait for features in one read */
+#define CLASSIFIER_READ_TIMEOUT_MS                       (1000U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * This class defines the result of one classification.
+ */
+class Nano33BLEClassifierData
+{
+  public:
+    uint8_t label;
+    /* 0.0 to 1.0 */
+    float confidence;
+    /* Time stamp of the newest reading in the window classified */
+    uint32_t timeStampMs;
+};
+
+/**
+ * Gives generic access to the values in Nano33BLEClassifierData.
+ * Channels in order: label, confidence.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEClassifierData>
+{
+  public:
+    enum { CHANNEL_COUNT = 2 };
+    static float get(const Nano33BLEClassifierData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.label;
+        default:
+          return (float)data.confidence;
+      }
+    }
+};
+
+/**
+ * @brief This class classifies each window of features from a 
+ * Nano33BLEWindowFeatures stage with an int8 model (see
+ * Nano33BLEClassifierModel), and pushes the class and confidence to this
+ * class's own buffer. The features are read through a Nano33BLESensorReader,
+ * so they can still be used by other consumers.
+ * 
+ * e.g. Nano33BLEWindowFeatures<Nano33BLEAccelerometerData, 64> 
+ *        accelerometerFeatures(Accelerometer, 32);
+ *      Nano33BLEClassifier<3> motionClassifier(accelerometerFeatures, 
+ *        AccelerometerMotionModel);
+ */
+template<uint32_t CHANNEL_COUNT>
+class Nano33BLEClassifier: public Nano33BLESensorBuffer<Nano33BLEClassifierData>
+{
+  public:
+    /**
+     * @brief Starts the Mbed OS Thread that classifies the features.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEClassifier::readFunction, this));
+    }
+
+    Nano33BLEClassifier(
+      Nano33BLESensorBuffer<Nano33BLEWindowFeaturesData<CHANNEL_COUNT> >& source,
+      const Nano33BLEClassifierModel& classifierModel,
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_CLASSIFIER_THREAD_STACK_SIZE_BYTES) :
+        sourceReader(source),
+        model(&classifierModel),
+        inferenceTime_us(0),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "Classifier"),
+        readStack("Classifier", threadSize){};
+
+    /**
+     * @brief Changes the model. This can be called from any thread, and 
+     * takes effect from the next window.
+     */
+    void setModel(const Nano33BLEClassifierModel& classifierModel)
+    {
+      model = &classifierModel;
+    }
+    /**
+     * @return how long the last classification took, including quantising
+     * the features.
+     */
+    uint32_t getInferenceTime(void)
+    {
+      return inferenceTime_us;
+    }
+
+    /**
+     * @brief Quantises the features a model uses and classifies them. Used
+     * by the classifier thread, but can also be called directly.
+     * 
+     * @return the class.
+     */
+    static uint8_t classify(
+      const Nano33BLEClassifierModel& model,
+      const Nano33BLEWindowFeaturesData<CHANNEL_COUNT>& features,
+      float& confidence);
+
+  private:
+    static float getFeature(
+      const Nano33BLEWindowFeaturesData<CHANNEL_COUNT>& features, 
+      uint32_t index);
+
+    /**
+     * @brief Waits for one window of features and classifies it.
+     * 
+     */
+    void read(void);
+
+    static void readFunction(Nano33BLEClassifier *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<Nano33BLEWindowFeaturesData<CHANNEL_COUNT> > sourceReader;
+    const Nano33BLEClassifierModel* volatile model;
+    volatile uint32_t inferenceTime_us;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+template<uint32_t CHANNEL_COUNT> uint8_t Nano33BLEClassifier<CHANNEL_COUNT>::classify(
+  const Nano33BLEClassifierModel& model,
+  const Nano33BLEWindowFeaturesData<CHANNEL_COUNT>& features,
+  float& confidence)
+{
+  int8_t inputs[CLASSIFIER_MAX_LAYER_SIZE];
+  float quantised;
+  uint32_t ii;
+
+  for(ii = 0; (ii < model.inputCount) && (ii < CLASSIFIER_MAX_LAYER_SIZE); ii++)
+  {
+    quantised = roundf(getFeature(features, model.inputFeatures[ii]) / model.inputScales[ii]) + 
+      model.inputZeroPoints[ii];
+    if(quantised > INT8_MAX)
+    {
+      quantised = INT8_MAX;
+    }
+    else if(quantised < INT8_MIN)
+    {
+      quantised = INT8_MIN;
+    }
+    inputs[ii] = (int8_t)quantised;
+  }
+
+  return model.classify(inputs, confidence);
+}
+
+template<uint32_t CHANNEL_COUNT> float Nano33BLEClassifier<CHANNEL_COUNT>::getFeature(
+  const Nano33BLEWindowFeaturesData<CHANNEL_COUNT>& features, 
+  uint32_t index)
+{
+  uint32_t channel;
+
+  channel = index % CHANNEL_COUNT;
+  switch(index / CHANNEL_COUNT)
+  {
+    case FEATURE_MEAN:
+      return features.mean[channel];
+    case FEATURE_VARIANCE:
+      return features.variance[channel];
+    case FEATURE_MIN:
+      return features.min[channel];
+    case FEATURE_MAX:
+      return features.max[channel];
+    case FEATURE_RMS:
+      return features.rms[channel];
+    case FEATURE_PEAK_TO_PEAK:
+      return features.peakToPeak[channel];
+    default:
+      return (float)features.zeroCrossings[channel];
+  }
+}
+
+template<uint32_t CHANNEL_COUNT> void Nano33BLEClassifier<CHANNEL_COUNT>::read(void)
+{
+  Nano33BLEWindowFeaturesData<CHANNEL_COUNT> features;
+  Nano33BLEClassifierData data;
+  uint32_t start_us;
+
+  if(!this->sourceReader.popWait(features, CLASSIFIER_READ_TIMEOUT_MS))
+  {
+    return;
+  }
+
+  start_us = micros();
+  data.label = classify(*this->model, features, data.confidence);
+  this->inferenceTime_us = micros() - start_us;
+
+  data.timeStampMs = features.timeStampMs;
+  this->push(data);
+  return;
+}
+
+#endif /* NANO33BLECLASSIFIER_H_ */
@@ -0,0 +1,272 @@
+/*
+  Nano33BLEClassifierModel.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file defines the compact int8 model format used by the
+  Nano33BLEClassifier class, the integer kernels that evaluate it, and
+  a reference model for classifying motion from accelerometer features.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEClassifierModel.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Window features of Nano33BLEAccelerometerData have 3 channels: x, y, z */
+#define MOTION_MODEL_CHANNEL_COUNT      (3U)
+#define MOTION_MODEL_CHANNEL_Z          (2U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+static const uint8_t motionModelInputFeatures[] = 
+{
+  CLASSIFIER_FEATURE_INDEX(FEATURE_PEAK_TO_PEAK, MOTION_MODEL_CHANNEL_Z, MOTION_MODEL_CHANNEL_COUNT),
+  CLASSIFIER_FEATURE_INDEX(FEATURE_MEAN, MOTION_MODEL_CHANNEL_Z, MOTION_MODEL_CHANNEL_COUNT),
+  CLASSIFIER_FEATURE_INDEX(FEATURE_VARIANCE, MOTION_MODEL_CHANNEL_Z, MOTION_MODEL_CHANNEL_COUNT)
+};
+
+/* Peak to peak 0 to 8g, mean -2 to 2g, variance 0 to 0.5g^2 */
+static const float motionModelInputScales[] = { 8.0F / 127.0F, 2.0F / 127.0F, 0.5F / 127.0F };
+static const int8_t motionModelInputZeroPoints[] = { 0, 0, 0 };
+
+static const Nano33BLEDecisionTreeNode motionModelNodes[] =
+{
+  /* 0: peak to peak of z <= 0.32g */
+  { 0, 5, 1, 2 },
+  /* 1: mean of z <= 0.85g */
+  { 1, 54, 3, 4 },
+  /* 2: variance of z <= 0.02g^2 */
+  { 2, 5, 5, 6 },
+  { DECISION_TREE_LEAF, 0, MOTION_CLASS_TILTED, 200 },
+  { DECISION_TREE_LEAF, 0, MOTION_CLASS_STILL, 230 },
+  { DECISION_TREE_LEAF, 0, MOTION_CLASS_TAP, 160 },
+  { DECISION_TREE_LEAF, 0, MOTION_CLASS_SHAKE, 210 }
+};
+
+const Nano33BLEClassifierModel AccelerometerMotionModel =
+{
+  Nano33BLEClassifierModel::MODEL_DECISION_TREE,
+  sizeof(motionModelInputFeatures),
+  motionModelInputFeatures,
+  motionModelInputScales,
+  motionModelInputZeroPoints,
+  MOTION_CLASS_COUNT,
+  motionModelNodes,
+  sizeof(motionModelNodes) / sizeof(motionModelNodes[0]),
+  NULL,
+  0,
+  0.0F
+};
+
+/*
+ * The dense model's hidden layer turns each input into a soft yes/no of
+ * whether it is past the same threshold as the decision tree: 0 to 127,
+ * crossing 64 at the threshold and saturating 4 quantisation steps from it.
+ * 0: peak to peak of z > 0.32g, 1: mean of z <= 0.85g,
+ * 2: variance of z > 0.02g^2
+ */
+static const int8_t motionDenseHiddenWeights[] =
+{
+  16, 0, 0,
+  0, -16, 0,
+  0, 0, 16
+};
+static const int32_t motionDenseHiddenBiases[] = { -24, 936, -24 };
+
+/*
+ * Each class score is 0 when its yes/no answers are all right, and at least
+ * 127 lower otherwise.
+ */
+static const int8_t motionDenseOutputWeights[] =
+{
+  /* MOTION_CLASS_STILL: not moving, not tilted */
+  -1, -1, 0,
+  /* MOTION_CLASS_TILTED: not moving, tilted */
+  -1, 1, 0,
+  /* MOTION_CLASS_TAP: moving, low variance */
+  1, 0, -1,
+  /* MOTION_CLASS_SHAKE: moving, high variance */
+  1, 0, 1
+};
+static const int32_t motionDenseOutputBiases[] = { 0, -127, -127, -254 };
+
+static const Nano33BLEDenseLayer motionDenseLayers[] =
+{
+  { 3, 3, motionDenseHiddenWeights, motionDenseHiddenBiases, 1, 0, true },
+  { 3, MOTION_CLASS_COUNT, motionDenseOutputWeights, motionDenseOutputBiases, 1, 0, false }
+};
+
+const Nano33BLEClassifierModel AccelerometerMotionDenseModel =
+{
+  Nano33BLEClassifierModel::MODEL_DENSE,
+  sizeof(motionModelInputFeatures),
+  motionModelInputFeatures,
+  motionModelInputScales,
+  motionModelInputZeroPoints,
+  MOTION_CLASS_COUNT,
+  NULL,
+  0,
+  motionDenseLayers,
+  sizeof(motionDenseLayers) / sizeof(motionDenseLayers[0]),
+  /* A clear window (score margin of 127) has a confidence of about 0.95 */
+  1.0F / 32.0F
+};
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+uint8_t Nano33BLEClassifierModel::classify(const int8_t* inputs, float& confidence) const
+{
+  if(this->type == MODEL_DECISION_TREE)
+  {
+    return classifyDecisionTree(inputs, confidence);
+  }
+  return classifyDense(inputs, confidence);
+}
+
+uint8_t Nano33BLEClassifierModel::classifyDecisionTree(const int8_t* inputs, float& confidence) const
+{
+  uint32_t node;
+  uint32_t depth;
+
+  node = 0;
+  for(depth = 0; depth < DECISION_TREE_MAX_DEPTH; depth++)
+  {
+    if(node >= this->nodeCount)
+    {
+      break;
+    }
+
+    if(this->nodes[node].input == DECISION_TREE_LEAF)
+    {
+      confidence = this->nodes[node].right / 255.0F;
+      return this->nodes[node].left;
+    }
+
+    if(inputs[this->nodes[node].input] <= this->nodes[node].threshold)
+    {
+      node = this->nodes[node].left;
+    }
+    else
+    {
+      node = this->nodes[node].right;
+    }
+  }
+
+  /* Only possible with a badly formed tree */
+  confidence = 0.0F;
+  return 0;
+}
+
+uint8_t Nano33BLEClassifierModel::classifyDense(const int8_t* inputs, float& confidence) const
+{
+  int8_t activations[2][CLASSIFIER_MAX_LAYER_SIZE];
+  int32_t scores[CLASSIFIER_MAX_LAYER_SIZE];
+  const int8_t* layerInputs;
+  const int8_t* weights;
+  const Nano33BLEDenseLayer* layer;
+  int32_t accumulator;
+  int64_t scaled;
+  uint32_t layerIndex;
+  uint32_t output;
+  uint32_t ii;
+  uint32_t classCount;
+  uint8_t best;
+  float sum;
+
+  /* Only possible with a badly formed model, which would give no scores */
+  if((this->layerCount == 0U) || (this->classCount == 0U))
+  {
+    confidence = 0.0F;
+    return 0;
+  }
+
+  /* Classes the last layer has no output for have no score */
+  classCount = this->classCount;
+  if(classCount > this->layers[this->layerCount - 1U].outputCount)
+  {
+    classCount = this->layers[this->layerCount - 1U].outputCount;
+  }
+  if(classCount > CLASSIFIER_MAX_LAYER_SIZE)
+  {
+    classCount = CLASSIFIER_MAX_LAYER_SIZE;
+  }
+
+  layerInputs = inputs;
+  for(layerIndex = 0; layerIndex < this->layerCount; layerIndex++)
+  {
+    layer = &this->layers[layerIndex];
+    for(output = 0; (output < layer->outputCount) && (output < CLASSIFIER_MAX_LAYER_SIZE); output++)
+    {
+      accumulator = layer->biases[output];
+      weights = &layer->weights[output * layer->inputCount];
+      for(ii = 0; ii < layer->inputCount; ii++)
+      {
+        accumulator += (int32_t)weights[ii] * layerInputs[ii];
+      }
+
+      if(layerIndex == (this->layerCount - 1U))
+      {
+        scores[output] = accumulator;
+        continue;
+      }
+
+      /* Scale back to int8, rounding to nearest */
+      scaled = (int64_t)accumulator * layer->multiplier;
+      if(layer->shift > 0U)
+      {
+        scaled = (scaled + ((int64_t)1 << (layer->shift - 1U))) >> layer->shift;
+      }
+      if(layer->relu && (scaled < 0))
+      {
+        scaled = 0;
+      }
+      if(scaled > INT8_MAX)
+      {
+        scaled = INT8_MAX;
+      }
+      else if(scaled < INT8_MIN)
+      {
+        scaled = INT8_MIN;
+      }
+      activations[layerIndex & 1U][output] = (int8_t)scaled;
+    }
+    layerInputs = activations[layerIndex & 1U];
+  }
+
+  best = 0;
+  for(ii = 1; ii < classCount; ii++)
+  {
+    if(scores[ii] > scores[best])
+    {
+      best = ii;
+    }
+  }
+
+  /* Softmax probability of the best class */
+  sum = 0.0F;
+  for(ii = 0; ii < classCount; ii++)
+  {
+    sum += expf((scores[ii] - scores[best]) * this->outputScale);
+  }
+  confidence = 1.0F / sum;
+
+  return best;
+}
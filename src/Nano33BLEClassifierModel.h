@@ -0,0 +1,173 @@
+/*
+  Nano33BLEClassifierModel.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file defines the compact int8 model format used by the
+  Nano33BLEClassifier class, the integer kernels that evaluate it, and
+  a reference model for classifying motion from accelerometer features.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLECLASSIFIERMODEL_H_
+#define NANO33BLECLASSIFIERMODEL_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Largest number of inputs, outputs or classes of any model or layer */
+#define CLASSIFIER_MAX_LAYER_SIZE         (32U)
+/* Input index of a decision tree leaf node */
+#define DECISION_TREE_LEAF                (-1)
+/* Upper limit on decision tree depth, so a bad model cannot loop forever */
+#define DECISION_TREE_MAX_DEPTH           (32U)
+
+/**
+ * Index of a statistic of one channel in the feature vector made from 
+ * Nano33BLEWindowFeaturesData. The vector holds every channel's mean, then
+ * every channel's variance, and so on in the order below.
+ */
+#define CLASSIFIER_FEATURE_INDEX(feature, channel, channelCount) \
+  (((feature) * (channelCount)) + (channel))
+#define FEATURE_MEAN                      (0U)
+#define FEATURE_VARIANCE                  (1U)
+#define FEATURE_MIN                       (2U)
+#define FEATURE_MAX                       (3U)
+#define FEATURE_RMS                       (4U)
+#define FEATURE_PEAK_TO_PEAK              (5U)
+#define FEATURE_ZERO_CROSSINGS            (6U)
+#define FEATURE_COUNT                     (7U)
+
+/* Classes of the reference motion model */
+#define MOTION_CLASS_STILL                (0U)
+#define MOTION_CLASS_TILTED               (1U)
+#define MOTION_CLASS_TAP                  (2U)
+#define MOTION_CLASS_SHAKE                (3U)
+#define MOTION_CLASS_COUNT                (4U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * One node of a decision tree. Branch nodes compare one quantised input
+ * against threshold and go to left if it is less than or equal, otherwise
+ * right. Leaf nodes have an input of DECISION_TREE_LEAF, and hold the class
+ * in left and the confidence (0 to 255 for 0.0 to 1.0) in right.
+ */
+class Nano33BLEDecisionTreeNode
+{
+  public:
+    int8_t input;
+    int8_t threshold;
+    uint8_t left;
+    uint8_t right;
+};
+
+/**
+ * One fully connected layer of a dense network. Inputs and weights are
+ * int8 with a zero point of 0, and are accumulated as int32 with the bias.
+ * The accumulator is then scaled to int8 for the next layer by
+ * (accumulator * multiplier) >> shift. The last layer is not scaled, its
+ * accumulators are the class scores.
+ */
+class Nano33BLEDenseLayer
+{
+  public:
+    uint8_t inputCount;
+    uint8_t outputCount;
+    /* outputCount rows of inputCount weights */
+    const int8_t* weights;
+    const int32_t* biases;
+    int32_t multiplier;
+    uint8_t shift;
+    bool relu;
+};
+
+/**
+ * @brief This class describes an int8 classifier model. It has no 
+ * constructor so models can be written as const initialisers and stay in
+ * flash. Each input is a feature picked from the feature vector and
+ * quantised as round(feature / inputScale) + inputZeroPoint.
+ */
+class Nano33BLEClassifierModel
+{
+  public:
+    enum MODEL_TYPE
+    {
+      MODEL_DECISION_TREE,
+      MODEL_DENSE
+    };
+
+    /**
+     * @brief Evaluates the model with integer kernels.
+     * 
+     * @param inputs inputCount quantised inputs.
+     * @param confidence how confident the model is in the class, from 0.0
+     * to 1.0. 0.0 if the model is badly formed (e.g. a dense model with no
+     * layers).
+     * @return the class.
+     */
+    uint8_t classify(const int8_t* inputs, float& confidence) const;
+
+    enum MODEL_TYPE type;
+    uint8_t inputCount;
+    /* Index of each input in the feature vector */
+    const uint8_t* inputFeatures;
+    const float* inputScales;
+    const int8_t* inputZeroPoints;
+    uint8_t classCount;
+
+    /* MODEL_DECISION_TREE only, the root is the first node */
+    const Nano33BLEDecisionTreeNode* nodes;
+    uint16_t nodeCount;
+
+    /* MODEL_DENSE only */
+    const Nano33BLEDenseLayer* layers;
+    uint8_t layerCount;
+    /* Scale of the last layer's accumulators, used for the confidence */
+    float outputScale;
+
+  private:
+    uint8_t classifyDecisionTree(const int8_t* inputs, float& confidence) const;
+    uint8_t classifyDense(const int8_t* inputs, float& confidence) const;
+};
+
+/**
+ * Reference decision tree for the window features of the accelerometer
+ * (Nano33BLEWindowFeatures<Nano33BLEAccelerometerData, N>). Classifies the
+ * window as MOTION_CLASS_STILL, MOTION_CLASS_TILTED, MOTION_CLASS_TAP or 
+ * MOTION_CLASS_SHAKE from the peak to peak, mean and variance of z.
+ */
+extern const Nano33BLEClassifierModel AccelerometerMotionModel;
+/**
+ * Reference dense model with the same inputs and classes as
+ * AccelerometerMotionModel: a hidden ReLU layer of 3 and an output layer of
+ * 4. It makes the same decisions as the tree away from its thresholds, but
+ * its confidence falls off near them.
+ */
+extern const Nano33BLEClassifierModel AccelerometerMotionDenseModel;
+
+#endif /* NANO33BLECLASSIFIERMODEL_H_ */
@@ -26,10 +26,36 @@
 /*****************************************************************************/
 #include "Nano33BLEColour.h"
 #include <Arduino_APDS9960.h>
+#include "Nano33BLEI2CDevice.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* APDS9960 enable register. Each engine has its own enable bit */
+#define APDS9960_ENABLE                   (0x80U)
+#define APDS9960_ENABLE_AEN               (0x02U)
+/* APDS9960 ALS integration time register. Each ATIME cycle is 2.78ms */
+#define APDS9960_ATIME                    (0x81U)
+#define APDS9960_ATIME_CYCLE_MS           (2.78F)
+#define APDS9960_ATIME_MAX_CYCLES         (256U)
+/* Each ATIME cycle adds 1025 to the full scale count, up to 65535 */
+#define APDS9960_ATIME_COUNTS_PER_CYCLE   (1025U)
+#define APDS9960_MAX_COUNT                (65535U)
+/* APDS9960 control register. AGAIN selects 1x, 4x, 16x or 64x ALS gain */
+#define APDS9960_CONTROL                  (0x8FU)
+#define APDS9960_CONTROL_AGAIN_MASK       (0x03U)
+
+/* 
+ * Lux and colour temperature coefficients from the AMS DN40 application note
+ * for an open air (no glass) sensor. The r, g and b lux coefficients are in
+ * Q10 fixed point.
+ */
+#define COLOUR_LUX_R_COEFFICIENT          (139)
+#define COLOUR_LUX_G_COEFFICIENT          (1024)
+#define COLOUR_LUX_B_COEFFICIENT          (-455)
+#define COLOUR_DEVICE_FACTOR              (310)
+#define COLOUR_CT_COEFFICIENT             (3810)
+#define COLOUR_CT_OFFSET                  (1391)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -50,6 +76,9 @@
  */
 void Nano33BLEColour::init()
 {
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+  uint8_t value;
+
   if (!APDS.begin())
   {
     /* Something went wrong... Put this thread to sleep indefinetely. */
@@ -59,6 +88,18 @@ void Nano33BLEColour::init()
    * boost results in more power consumption. 
    */
   APDS.setLEDBoost(IR_LED_BOOST_VALUE);
+
+  /* Start from the gain and integration time the Arduino library set up */
+  if(apds.readRegister(APDS9960_ATIME, value))
+  {
+    this->nominalCycles = APDS9960_ATIME_MAX_CYCLES - value;
+  }
+  this->cycles = this->nominalCycles;
+  if(apds.readRegister(APDS9960_CONTROL, value))
+  {
+    this->gain = 1U << (2U * (value & APDS9960_CONTROL_AGAIN_MASK));
+    this->range = 1U + (value & APDS9960_CONTROL_AGAIN_MASK);
+  }
   return;
 }
 
@@ -82,18 +123,195 @@ void Nano33BLEColour::read(void)
    */
   Nano33BLEColourData data;
 
-  /* If new proximity data is available on the APDS9960 get the data.*/
+  /* Picks up integration time changes made by setOutputDataRate() */
+  if(getRangeCycles(this->range) != this->cycles)
+  {
+    setRange(this->range);
+  }
+
+  /* If new colour data is available on the APDS9960 get the data.*/
   if (APDS.colorAvailable())
   {
     APDS.readColor(data.r, data.g, data.b, data.c);
-    data.timeStampMs = millis();
-    push(data);
+    if(this->rangeChanged)
+    {
+      /* May have been integrated partly in the old range, so drop it */
+      this->rangeChanged = false;
+    }
+    else
+    {
+      calculateLight(data);
+      publish(data);
+
+      if(this->autoRange)
+      {
+        updateRange(data.c);
+      }
+    }
+  }
+
+  return;
+}
+
+float Nano33BLEColour::setOutputDataRate(float rate_Hz)
+{
+  uint32_t cycles;
+  float actualRate_Hz;
+
+  if(rate_Hz <= 0.0F)
+  {
+    rate_Hz = 1.0F;
+  }
+
+  /* The ALS integration time sets the colour output data rate */
+  cycles = (uint32_t)(((1000.0F / rate_Hz) / APDS9960_ATIME_CYCLE_MS) + 0.5F);
+  if(cycles < 1U)
+  {
+    cycles = 1U;
+  }
+  else if(cycles > APDS9960_ATIME_MAX_CYCLES)
+  {
+    cycles = APDS9960_ATIME_MAX_CYCLES;
   }
+  /* The read thread writes it to the sensor, along with the auto range */
+  this->nominalCycles = cycles;
+
+  actualRate_Hz = 1000.0F / (cycles * APDS9960_ATIME_CYCLE_MS);
+  this->scheduler.setRate(actualRate_Hz);
+  return actualRate_Hz;
+}
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+void Nano33BLEColour::powerDown(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  /* 
+   * Only the ALS engine is turned off. The APDS9960 itself stays powered
+   * as the other engines may still be in use by other sensor classes.
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_AEN, 0);
+  return;
+}
+
+void Nano33BLEColour::powerUp(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_AEN, APDS9960_ENABLE_AEN);
+  return;
+}
+
+void Nano33BLEColour::setAutoRange(bool enable)
+{
+  this->autoRange = enable;
+  return;
+}
+
+uint32_t Nano33BLEColour::getRangeCycles(uint32_t rangeIndex)
+{
+  uint32_t rangeCycles;
+
+  rangeCycles = this->nominalCycles;
+  if(rangeIndex == 0U)
+  {
+    rangeCycles /= 4U;
+    if(rangeCycles < 1U)
+    {
+      rangeCycles = 1U;
+    }
+  }
+  return rangeCycles;
+}
+
+void Nano33BLEColour::setRange(uint32_t newRange)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+  uint32_t gainIndex;
+
+  gainIndex = (newRange == 0U) ? 0U : (newRange - 1U);
+  this->range = newRange;
+  this->gain = 1U << (2U * gainIndex);
+  this->cycles = getRangeCycles(newRange);
+
+  apds.updateRegister(APDS9960_CONTROL, APDS9960_CONTROL_AGAIN_MASK, (uint8_t)gainIndex);
+  apds.writeRegister(APDS9960_ATIME, (uint8_t)(APDS9960_ATIME_MAX_CYCLES - this->cycles));
+  this->rangeChanged = true;
+  return;
+}
+
+void Nano33BLEColour::updateRange(int clear)
+{
+  uint32_t fullScale;
+
+  fullScale = this->cycles * APDS9960_ATIME_COUNTS_PER_CYCLE;
+  if(fullScale > APDS9960_MAX_COUNT)
+  {
+    fullScale = APDS9960_MAX_COUNT;
+  }
+
+  /* 
+   * Each range is about 4x more sensitive than the one below it, so a 
+   * reading just under 15% of full scale lands at about 60% after stepping
+   * up. That leaves a gap below the 80% step down point.
+   */
+  if(((uint32_t)clear * 5U >= fullScale * 4U) && (this->range > 0U))
+  {
+    setRange(this->range - 1U);
+  }
+  else if(((uint32_t)clear * 20U < fullScale * 3U) && 
+    (this->range < (COLOUR_RANGE_COUNT - 1U)))
+  {
+    setRange(this->range + 1U);
+  }
+  return;
+}
+
+void Nano33BLEColour::calculateLight(Nano33BLEColourData& data)
+{
+  int32_t ir;
+  int32_t r;
+  int32_t g;
+  int32_t b;
+  int64_t weighted;
+  int64_t luxQ8;
+
+  /* Remove the IR content that all four channels see (DN40) */
+  ir = (data.r + data.g + data.b - data.c) / 2;
+  if(ir < 0)
+  {
+    ir = 0;
+  }
+  r = data.r - ir;
+  g = data.g - ir;
+  b = data.b - ir;
+
+  /* 
+   * lux = (weighted r, g, b) * device factor / (ATIME ms * gain). ATIME ms is
+   * cycles * 278 / 100, and the Q10 weighting is turned into Q8 lux, which
+   * leaves a factor of 100 * 256 / 1024 = 25 on top.
+   */
+  weighted = ((int64_t)COLOUR_LUX_R_COEFFICIENT * r) + 
+    ((int64_t)COLOUR_LUX_G_COEFFICIENT * g) + 
+    ((int64_t)COLOUR_LUX_B_COEFFICIENT * b);
+  luxQ8 = (weighted * COLOUR_DEVICE_FACTOR * 25) / 
+    ((int64_t)this->cycles * 278 * this->gain);
+  if(luxQ8 < 0)
+  {
+    luxQ8 = 0;
+  }
+  data.lux = (float)luxQ8 / 256.0F;
+
+  if((r > 0) && (b >= 0))
+  {
+    data.colourTemperature = 
+      (float)(((COLOUR_CT_COEFFICIENT * b) / r) + COLOUR_CT_OFFSET);
+  }
+  else
+  {
+    data.colourTemperature = 0.0F;
+  }
+
+  data.countScale = 100.0F / (this->gain * this->cycles * APDS9960_ATIME_CYCLE_MS);
   return;
 }
 
@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -49,6 +49,14 @@
  */
 #define DEFAULT_COLOUR_READ_PERIOD_MS                (20U)
 #define DEFAULT_COLOUR_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* APDS9960 ALS engine start up time, used when duty cycling the sensor */
+#define COLOUR_WAKE_UP_TIME_MS                    (6U)
+/* 
+ * Number of auto ranges. Range 0 is 1x gain at a quarter of the integration
+ * time set by setOutputDataRate(), for direct sunlight. Ranges 1 to 4 are
+ * 1x, 4x, 16x and 64x gain at the full integration time.
+ */
+#define COLOUR_RANGE_COUNT                        (5U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -69,37 +77,107 @@ class Nano33BLEColourData
     int g;
     int b;
     int c;
+    /* Illuminance in lux, worked out from r, g, b and c */
+    float lux;
+    /* Correlated colour temperature in Kelvin. 0 if it could not be worked out */
+    float colourTemperature;
+    /* 
+     * Multiplying r, g, b or c by this gives the counts the sensor would 
+     * have read at 1x gain and a 100ms integration time, so readings taken
+     * in different auto ranges can be compared.
+     */
+    float countScale;
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEColourData.
+ * Channels in order: r, g, b, c, lux, colourTemperature.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEColourData>
+{
+  public:
+    enum { CHANNEL_COUNT = 6 };
+    static float get(const Nano33BLEColourData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.r;
+        case 1:
+          return (float)data.g;
+        case 2:
+          return (float)data.b;
+        case 3:
+          return (float)data.c;
+        case 4:
+          return data.lux;
+        default:
+          return data.colourTemperature;
+      }
+    }
+};
+
 /**
  * @brief This class reads colour data from the on board Nano 33 BLE
  * Sense APDS9960 using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
  */
-class Nano33BLEColour: public Nano33BLESensorBuffer<Nano33BLEColourData>
+class Nano33BLEColour: public Nano33BLESensor<Nano33BLEColour, Nano33BLEColourData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEColour::readFunction, this));
-    }
-
     Nano33BLEColour(
       uint32_t readPeriod_ms = DEFAULT_COLOUR_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_COLOUR_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEColour, Nano33BLEColourData>(
+          "Colour",
+          TRACE_ID_COLOUR,
+          readPeriod_ms,
+          COLOUR_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize),
+        autoRange(false),
+        rangeChanged(false),
+        range(1),
+        gain(1),
+        cycles(1),
+        nominalCycles(1){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * rate set by the APDS9960 ALS integration time (ATIME)
+     * closest to rate_Hz. Changing the integration time also changes the
+     * full scale of the colour counts.
+     */
+    float setOutputDataRate(float rate_Hz);
+
+    /**
+     * @brief Turns auto ranging on or off. While on, the ALS gain and 
+     * integration time are stepped down when the clear count goes above 80%
+     * of full scale and stepped up when it drops below 15%, so the readings
+     * neither saturate in sunlight nor bottom out indoors. The integration
+     * time is only ever shortened from the one set by setOutputDataRate(),
+     * so the output data rate is kept. The reading after a range change is 
+     * dropped as it may have been integrated across both ranges.
+     * 
+     * When off, the range the sensor is in is kept. Use countScale in 
+     * Nano33BLEColourData to compare raw counts taken in different ranges.
+     * 
+     * @param enable true to turn auto ranging on.
+     */
+    void setAutoRange(bool enable);
+
   private:
+    friend class Nano33BLESensor<Nano33BLEColour, Nano33BLEColourData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -111,17 +189,45 @@ class Nano33BLEColour: public Nano33BLESensorBuffer<Nano33BLEColourData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Writes the gain and integration time of an auto range to 
+     * the sensor.
+     * 
+     */
+    void setRange(uint32_t newRange);
+    /**
+     * @return the integration time of an auto range in ATIME cycles.
+     */
+    uint32_t getRangeCycles(uint32_t rangeIndex);
+    /**
+     * @brief Steps the auto range up or down if the clear count is 
+     * outside the hysteresis band.
+     * 
+     */
+    void updateRange(int clear);
+    /**
+     * @brief Works out lux, colour temperature and the count scale for 
+     * a reading with the current gain and integration time.
+     * 
+     */
+    void calculateLight(Nano33BLEColourData& data);
 
-    static void readFunction(Nano33BLEColour *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    volatile bool autoRange;
+    bool rangeChanged;
+    uint32_t range;
+    uint32_t gain;
+    uint32_t cycles;
+    volatile uint32_t nominalCycles;
 };
 
 extern Nano33BLEColour Colour;
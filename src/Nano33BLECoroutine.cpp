@@ -0,0 +1,334 @@
+/*
+  Nano33BLECoroutine.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements a small C++20 coroutine scheduler for consuming
+  sensor data. Rather than a loop() that polls pop() on several sensors
+  and delays, each consumer is written as a coroutine that co_awaits the
+  next reading (or a batch of readings) from a sensor, or a sleep, and
+  is suspended until it arrives. Coroutine frames come from a small
+  static pool, so nothing is allocated from the heap.
+
+  This is only built by compilers with C++20 coroutine support, which
+  defines COROUTINES_SUPPORTED. On the host build the coroutines run on
+  a simulated clock.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLECoroutine.h"
+
+#ifdef COROUTINES_SUPPORTED
+#ifdef ARDUINO
+#include "Kernel.h"
+#include "CriticalSectionLock.h"
+#endif /* ARDUINO */
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+/* Defined before the scheduler that uses it */
+#ifdef ARDUINO
+static Nano33BLECoroutineKernelClock coroutineClock;
+#else
+static Nano33BLECoroutineSimulatedClock coroutineClock;
+#endif /* ARDUINO */
+Nano33BLECoroutineScheduler CoroutineScheduler(coroutineClock);
+
+/*
+ * The frame pool. uint64_t so every frame is 8 byte aligned. Static and
+ * zero initialised, so coroutines can be created by global objects
+ * constructed before CoroutineScheduler itself.
+ */
+static uint64_t frames[COROUTINE_FRAME_COUNT][COROUTINE_FRAME_SIZE_BYTES / sizeof(uint64_t)];
+uint32_t Nano33BLECoroutineScheduler::usedFrames;
+uint32_t Nano33BLECoroutineScheduler::frameFailures;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void* Nano33BLETask::promise_type::operator new(size_t size) noexcept
+{
+  return Nano33BLECoroutineScheduler::allocateFrame(size);
+}
+
+void Nano33BLETask::promise_type::operator delete(void* frame)
+{
+  Nano33BLECoroutineScheduler::freeFrame(frame);
+  return;
+}
+
+#ifdef ARDUINO
+uint64_t Nano33BLECoroutineKernelClock::getTime(void)
+{
+  return rtos::Kernel::get_ms_count();
+}
+
+void Nano33BLECoroutineKernelClock::sleepUntil(uint64_t deadline_ms)
+{
+  uint64_t now_ms;
+
+  now_ms = getTime();
+  if(deadline_ms <= now_ms)
+  {
+    return;
+  }
+
+  /* wake() sets the flag, so a wake before the sleep still ends it */
+  if(deadline_ms == COROUTINE_NO_DEADLINE)
+  {
+    this->wakeFlags.wait_any(COROUTINE_WAKE_FLAG);
+  }
+  else
+  {
+    this->wakeFlags.wait_any(COROUTINE_WAKE_FLAG, (uint32_t)(deadline_ms - now_ms));
+  }
+  return;
+}
+
+void Nano33BLECoroutineKernelClock::wake(void)
+{
+  this->wakeFlags.set(COROUTINE_WAKE_FLAG);
+  return;
+}
+#endif /* ARDUINO */
+
+bool Nano33BLESleepAwaiter::await_ready(void)
+{
+  return isReady(CoroutineScheduler.getTime());
+}
+
+void Nano33BLESleepAwaiter::await_suspend(std::coroutine_handle<> suspended)
+{
+  this->handle = suspended;
+  CoroutineScheduler.wait(this);
+  return;
+}
+
+bool Nano33BLECoroutineScheduler::start(Nano33BLETask task)
+{
+  Nano33BLECoroutineWaiter* waiter;
+
+  if(!task.isValid())
+  {
+    return false;
+  }
+
+  /* The scheduler owns the coroutine from now on */
+  waiter = &task.handle.promise().start;
+  waiter->handle = task.handle;
+  task.handle = nullptr;
+  this->taskCount++;
+  wait(waiter);
+  return true;
+}
+
+uint32_t Nano33BLECoroutineScheduler::runOnce(void)
+{
+  Nano33BLECoroutineWaiter* waiter;
+  Nano33BLECoroutineWaiter* nextWaiter;
+  std::coroutine_handle<> handle;
+  uint64_t now_ms;
+  uint32_t resumed;
+
+  /*
+   * Coroutines suspend on new waiters while they run, so the waiters are
+   * taken off the list first, and ones that are not ready are put back.
+   */
+  waiter = this->head;
+  this->head = NULL;
+  this->tail = NULL;
+  now_ms = getTime();
+  resumed = 0;
+  while(waiter != NULL)
+  {
+    /* The waiter is part of the coroutine's frame, so is gone once resumed */
+    nextWaiter = waiter->next;
+    waiter->next = NULL;
+    if(waiter->isReady(now_ms))
+    {
+      handle = waiter->handle;
+      handle.resume();
+      resumed++;
+      if(handle.done())
+      {
+        handle.destroy();
+        this->taskCount--;
+      }
+    }
+    else
+    {
+      wait(waiter);
+    }
+    waiter = nextWaiter;
+  }
+
+  return resumed;
+}
+
+#ifdef ARDUINO
+void Nano33BLECoroutineScheduler::run(void)
+{
+  while(1)
+  {
+    runOnce();
+
+    /* Sensors wake the clock when they push, so a push while the
+     * coroutines were running still ends this sleep straight away */
+    this->clock.sleepUntil(getEarliestDeadline());
+  }
+}
+#else
+void Nano33BLECoroutineScheduler::runFor(uint32_t elapsed_ms)
+{
+  uint64_t end_ms;
+  uint64_t deadline_ms;
+
+  end_ms = getTime() + elapsed_ms;
+  while(1)
+  {
+    /* Until nothing is resumed, as coroutines can push data for others */
+    while(runOnce() != 0U)
+    {
+    }
+
+    deadline_ms = getEarliestDeadline();
+    if(deadline_ms > end_ms)
+    {
+      break;
+    }
+    this->clock.sleepUntil(deadline_ms);
+  }
+
+  this->clock.sleepUntil(end_ms);
+  return;
+}
+#endif /* ARDUINO */
+
+uint64_t Nano33BLECoroutineScheduler::getTime(void)
+{
+  return this->clock.getTime();
+}
+
+void Nano33BLECoroutineScheduler::notify(void)
+{
+  this->clock.wake();
+  return;
+}
+
+void Nano33BLECoroutineScheduler::wait(Nano33BLECoroutineWaiter* waiter)
+{
+  /* Kept in order, so coroutines are resumed in the order they suspended */
+  waiter->next = NULL;
+  if(this->tail == NULL)
+  {
+    this->head = waiter;
+  }
+  else
+  {
+    this->tail->next = waiter;
+  }
+  this->tail = waiter;
+  return;
+}
+
+void* Nano33BLECoroutineScheduler::allocateFrame(size_t size)
+{
+#ifdef ARDUINO
+  /* Coroutines can be created from any thread. The host has only one */
+  mbed::CriticalSectionLock lock;
+#endif /* ARDUINO */
+  uint32_t ii;
+
+  if(size <= COROUTINE_FRAME_SIZE_BYTES)
+  {
+    for(ii = 0; ii < COROUTINE_FRAME_COUNT; ii++)
+    {
+      if((usedFrames & (1UL << ii)) == 0U)
+      {
+        usedFrames |= (1UL << ii);
+        return frames[ii];
+      }
+    }
+  }
+
+  frameFailures++;
+  return NULL;
+}
+
+void Nano33BLECoroutineScheduler::freeFrame(void* frame)
+{
+#ifdef ARDUINO
+  mbed::CriticalSectionLock lock;
+#endif /* ARDUINO */
+  uint32_t ii;
+
+  for(ii = 0; ii < COROUTINE_FRAME_COUNT; ii++)
+  {
+    if(frame == frames[ii])
+    {
+      usedFrames &= ~(1UL << ii);
+      break;
+    }
+  }
+  return;
+}
+
+uint32_t Nano33BLECoroutineScheduler::getFramesUsed(void)
+{
+  uint32_t used;
+  uint32_t ii;
+
+  used = 0;
+  for(ii = 0; ii < COROUTINE_FRAME_COUNT; ii++)
+  {
+    if((usedFrames & (1UL << ii)) != 0U)
+    {
+      used++;
+    }
+  }
+  return used;
+}
+
+uint32_t Nano33BLECoroutineScheduler::getFrameFailures(void)
+{
+  return frameFailures;
+}
+
+uint64_t Nano33BLECoroutineScheduler::getEarliestDeadline(void)
+{
+  Nano33BLECoroutineWaiter* waiter;
+  uint64_t earliest_ms;
+  uint64_t deadline_ms;
+
+  earliest_ms = COROUTINE_NO_DEADLINE;
+  for(waiter = this->head; waiter != NULL; waiter = waiter->next)
+  {
+    deadline_ms = waiter->getDeadline();
+    if(deadline_ms < earliest_ms)
+    {
+      earliest_ms = deadline_ms;
+    }
+  }
+  return earliest_ms;
+}
+
+#endif /* COROUTINES_SUPPORTED */
\ No newline at end of file
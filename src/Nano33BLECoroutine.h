@@ -0,0 +1,452 @@
+/*
+  Nano33BLECoroutine.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements a small C++20 coroutine scheduler for consuming
+  sensor data. Rather than a loop() that polls pop() on several sensors
+  and delays, each consumer is written as a coroutine that co_awaits the
+  next reading (or a batch of readings) from a sensor, or a sleep, and
+  is suspended until it arrives. Coroutine frames come from a small
+  static pool, so nothing is allocated from the heap.
+
+  This is only built by compilers with C++20 coroutine support, which
+  defines COROUTINES_SUPPORTED. The scheduler's time, and how it sleeps
+  and is woken, are behind Nano33BLECoroutineClock, so on the host build
+  the coroutines run on a simulated clock without Mbed OS.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLECOROUTINE_H_
+#define NANO33BLECOROUTINE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#ifdef ARDUINO
+#include "EventFlags.h"
+#endif /* ARDUINO */
+#endif /* __cpp_impl_coroutine */
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#if defined(__cpp_impl_coroutine)
+#define COROUTINES_SUPPORTED
+#endif /* __cpp_impl_coroutine */
+
+/* Number of coroutine frames in the static pool (at most 32) */
+#define COROUTINE_FRAME_COUNT                 (4U)
+/* Size of each coroutine frame. Locals kept across a co_await (e.g. a
+ * batch buffer) are stored in the frame, so must fit in this */
+#define COROUTINE_FRAME_SIZE_BYTES            (768U)
+#define COROUTINE_WAKE_FLAG                   (0x01U)
+/* No deadline, i.e. waiting only for data */
+#define COROUTINE_NO_DEADLINE                 (UINT64_MAX)
+
+#ifdef COROUTINES_SUPPORTED
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief The scheduler's time, and how it sleeps while no coroutine is
+ * ready and is woken when a sensor pushes data. This keeps the scheduler
+ * itself free of Mbed OS, so it runs on the host build with
+ * Nano33BLECoroutineSimulatedClock.
+ */
+class Nano33BLECoroutineClock
+{
+  public:
+    /**
+     * @return the time in milliseconds.
+     */
+    virtual uint64_t getTime(void) = 0;
+    /**
+     * @brief Sleeps until deadline_ms, or until wake() is called.
+     * COROUTINE_NO_DEADLINE sleeps until woken. A wake() while not
+     * sleeping ends the next sleep straight away.
+     *
+     */
+    virtual void sleepUntil(uint64_t deadline_ms) = 0;
+    /**
+     * @brief Wakes the scheduler. Called from sensor threads.
+     *
+     */
+    virtual void wake(void) = 0;
+};
+
+#ifdef ARDUINO
+/**
+ * @brief The board's clock: the Mbed OS kernel time, sleeping on an
+ * EventFlags that wake() sets.
+ */
+class Nano33BLECoroutineKernelClock: public Nano33BLECoroutineClock
+{
+  public:
+    uint64_t getTime(void);
+    void sleepUntil(uint64_t deadline_ms);
+    void wake(void);
+
+  private:
+    rtos::EventFlags wakeFlags;
+};
+#else
+/**
+ * @brief The host build's clock. There are no other threads to wake the
+ * scheduler, so time only moves when it sleeps, and a sleep jumps
+ * straight to its deadline.
+ */
+class Nano33BLECoroutineSimulatedClock: public Nano33BLECoroutineClock
+{
+  public:
+    Nano33BLECoroutineSimulatedClock() :
+      time_ms(0){};
+
+    uint64_t getTime(void)
+    {
+      return time_ms;
+    }
+    void sleepUntil(uint64_t deadline_ms)
+    {
+      /* Nothing can wake it, so a sleep with no deadline returns at once */
+      if((deadline_ms != COROUTINE_NO_DEADLINE) && (deadline_ms > time_ms))
+      {
+        time_ms = deadline_ms;
+      }
+      return;
+    }
+    void wake(void)
+    {
+      return;
+    }
+
+  private:
+    uint64_t time_ms;
+};
+#endif /* ARDUINO */
+
+/**
+ * @brief Something a suspended coroutine is waiting for, e.g. data from a
+ * sensor or a time. Awaiters derive from this and add themselves to the
+ * scheduler when the coroutine suspends. Each one lives in the frame of
+ * its coroutine while it is suspended.
+ */
+class Nano33BLECoroutineWaiter
+{
+  public:
+    Nano33BLECoroutineWaiter() :
+      next(NULL){};
+
+    /**
+     * @brief Called from the scheduler's thread to check whether the
+     * coroutine can be resumed.
+     *
+     * @param now_ms the scheduler's time.
+     */
+    virtual bool isReady(uint64_t now_ms) = 0;
+    /**
+     * @return the time the waiter is ready by whatever else happens, so the
+     * scheduler knows how long it can sleep.
+     */
+    virtual uint64_t getDeadline(void)
+    {
+      return COROUTINE_NO_DEADLINE;
+    }
+
+  protected:
+    friend class Nano33BLECoroutineScheduler;
+
+    std::coroutine_handle<> handle;
+
+  private:
+    Nano33BLECoroutineWaiter* next;
+};
+
+/**
+ * @brief A waiter that is always ready, used to run a coroutine for the
+ * first time.
+ */
+class Nano33BLECoroutineStart: public Nano33BLECoroutineWaiter
+{
+  public:
+    bool isReady(uint64_t now_ms)
+    {
+      (void)now_ms;
+      return true;
+    }
+};
+
+/**
+ * @brief The return type of a coroutine run by the scheduler, e.g.
+ *
+ *   Nano33BLETask printAccelerometer(void)
+ *   {
+ *     while(1)
+ *     {
+ *       Nano33BLEAccelerometerData data = co_await Accelerometer.next();
+ *       Serial.println(data.x);
+ *     }
+ *   }
+ *
+ *   CoroutineScheduler.start(printAccelerometer());
+ *
+ * The coroutine does not run until it is started. If the frame pool is
+ * full (or the frame is bigger than COROUTINE_FRAME_SIZE_BYTES) the task
+ * is not valid and start() fails.
+ */
+class Nano33BLETask
+{
+  public:
+    class promise_type
+    {
+      public:
+        Nano33BLETask get_return_object(void)
+        {
+          return Nano33BLETask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        static Nano33BLETask get_return_object_on_allocation_failure(void)
+        {
+          return Nano33BLETask();
+        }
+        std::suspend_always initial_suspend(void) noexcept
+        {
+          return std::suspend_always();
+        }
+        /* Suspended at the end so the scheduler sees done() and destroys it */
+        std::suspend_always final_suspend(void) noexcept
+        {
+          return std::suspend_always();
+        }
+        void return_void(void)
+        {
+          return;
+        }
+        void unhandled_exception(void)
+        {
+          std::terminate();
+        }
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* frame);
+
+      private:
+        friend class Nano33BLECoroutineScheduler;
+
+        Nano33BLECoroutineStart start;
+    };
+
+    Nano33BLETask(Nano33BLETask&& other) :
+      handle(other.handle)
+    {
+      other.handle = nullptr;
+    };
+    Nano33BLETask(const Nano33BLETask&) = delete;
+    Nano33BLETask& operator=(const Nano33BLETask&) = delete;
+    ~Nano33BLETask()
+    {
+      /* Only set if the task was never started */
+      if(handle)
+      {
+        handle.destroy();
+      }
+    };
+
+    /**
+     * @return false if there was no frame for the coroutine.
+     */
+    bool isValid(void)
+    {
+      return (bool)handle;
+    }
+
+  private:
+    friend class Nano33BLECoroutineScheduler;
+
+    Nano33BLETask() :
+      handle(nullptr){};
+    Nano33BLETask(std::coroutine_handle<promise_type> taskHandle) :
+      handle(taskHandle){};
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief Suspends a coroutine until a time, e.g.
+ * co_await CoroutineScheduler.sleep(50).
+ */
+class Nano33BLESleepAwaiter: public Nano33BLECoroutineWaiter
+{
+  public:
+    Nano33BLESleepAwaiter(uint64_t wakeTime_ms) :
+      deadline_ms(wakeTime_ms){};
+
+    bool await_ready(void);
+    void await_suspend(std::coroutine_handle<> suspended);
+    void await_resume(void)
+    {
+      return;
+    }
+
+    bool isReady(uint64_t now_ms)
+    {
+      return (now_ms >= deadline_ms);
+    }
+    uint64_t getDeadline(void)
+    {
+      return deadline_ms;
+    }
+
+  private:
+    uint64_t deadline_ms;
+};
+
+/**
+ * @brief This class runs coroutines (Nano33BLETask) on one thread. Each
+ * time a coroutine suspends on an awaiter, the awaiter is kept until it
+ * is ready, then the coroutine is resumed. Sensors wake the scheduler
+ * whenever they push data, and it sleeps until the next wake or the
+ * earliest sleep deadline, so waiting costs nothing.
+ *
+ * On the board, start the coroutines then call run() from the thread that
+ * will run them, e.g. at the end of setup(). On the host build there are
+ * no sensor threads. Time is simulated and only moves with runFor(), and
+ * a test pushes data (e.g. with replay()) between calls.
+ */
+class Nano33BLECoroutineScheduler
+{
+  public:
+    /**
+     * @param schedulerClock the clock the scheduler sleeps on. It must
+     * outlive the scheduler.
+     */
+    Nano33BLECoroutineScheduler(Nano33BLECoroutineClock& schedulerClock) :
+      head(NULL),
+      tail(NULL),
+      taskCount(0),
+      clock(schedulerClock){};
+
+    /**
+     * @brief Starts a coroutine. It first runs the next time the scheduler
+     * runs. Must be called from the scheduler's thread (e.g. from another
+     * coroutine) or before run().
+     *
+     * @return false if the task is not valid.
+     */
+    bool start(Nano33BLETask task);
+    /**
+     * @brief Resumes every coroutine whose awaiter is ready now, once.
+     *
+     * @return the number of coroutines resumed.
+     */
+    uint32_t runOnce(void);
+#ifdef ARDUINO
+    /**
+     * @brief Runs the coroutines forever on the calling thread, sleeping
+     * while none of them are ready.
+     *
+     */
+    void run(void);
+#else
+    /**
+     * @brief Runs the coroutines over elapsed_ms of simulated time. Time
+     * jumps from one sleep deadline to the next, and coroutines waiting
+     * for data are resumed as soon as data is there.
+     *
+     */
+    void runFor(uint32_t elapsed_ms);
+#endif /* ARDUINO */
+    /**
+     * @return the scheduler's time from its clock: the Mbed OS kernel time
+     * on the board, or the simulated time on the host build.
+     */
+    uint64_t getTime(void);
+    /**
+     * @return a sleep for co_await, e.g. co_await CoroutineScheduler.sleep(50).
+     */
+    Nano33BLESleepAwaiter sleep(uint32_t duration_ms)
+    {
+      return Nano33BLESleepAwaiter(getTime() + duration_ms);
+    }
+    /**
+     * @return a sleep until an absolute time from getTime(). Sleeping until
+     * deadlines a fixed period apart keeps a periodic coroutine from
+     * drifting.
+     */
+    Nano33BLESleepAwaiter sleepUntil(uint64_t wakeTime_ms)
+    {
+      return Nano33BLESleepAwaiter(wakeTime_ms);
+    }
+    /**
+     * @return the number of coroutines started that have not finished.
+     */
+    uint32_t getTaskCount(void)
+    {
+      return taskCount;
+    }
+    /**
+     * @brief Wakes the scheduler to check its waiters. Sensor buffers call
+     * this every time they push, from the sensor thread.
+     *
+     */
+    void notify(void);
+
+    /**
+     * @brief Adds a waiter of a suspended coroutine.
+     *
+     */
+    void wait(Nano33BLECoroutineWaiter* waiter);
+
+    /**
+     * @brief Takes a frame from the static pool.
+     *
+     * @return the frame, or NULL if size is too big or the pool is full.
+     */
+    static void* allocateFrame(size_t size);
+    static void freeFrame(void* frame);
+    /**
+     * @return the number of frames in use.
+     */
+    static uint32_t getFramesUsed(void);
+    /**
+     * @return the number of coroutines that could not get a frame.
+     */
+    static uint32_t getFrameFailures(void);
+
+  private:
+    uint64_t getEarliestDeadline(void);
+
+    Nano33BLECoroutineWaiter* head;
+    Nano33BLECoroutineWaiter* tail;
+    uint32_t taskCount;
+    Nano33BLECoroutineClock& clock;
+
+    /* Static and zero initialised, like the pool itself */
+    static uint32_t usedFrames;
+    static uint32_t frameFailures;
+};
+
+extern Nano33BLECoroutineScheduler CoroutineScheduler;
+
+#endif /* COROUTINES_SUPPORTED */
+#endif /* NANO33BLECOROUTINE_H_ */
\ No newline at end of file
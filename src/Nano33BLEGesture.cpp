@@ -25,10 +25,35 @@
 /*INLCUDES                                                                   */
 /*****************************************************************************/
 #include "Nano33BLEGesture.h"
+#include "Nano33BLEI2CDevice.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* APDS9960 enable register. Each engine has its own enable bit */
+#define APDS9960_ENABLE                   (0x80U)
+#define APDS9960_ENABLE_PON               (0x01U)
+#define APDS9960_ENABLE_PEN               (0x04U)
+#define APDS9960_ENABLE_GEN               (0x40U)
+/* 
+ * The gesture engine starts when proximity goes above GPENTH, and exits
+ * once U, D, L and R are all below GEXTH.
+ */
+#define APDS9960_GPENTH                   (0xA0U)
+#define APDS9960_GEXTH                    (0xA1U)
+#define APDS9960_GPENTH_VALUE             (40U)
+#define APDS9960_GEXTH_VALUE              (30U)
+/* Gesture FIFO threshold of 4 frames, exit after 1 frame below GEXTH */
+#define APDS9960_GCONF1                   (0xA2U)
+#define APDS9960_GCONF1_VALUE             (0x40U)
+/* GMODE is set while the gesture engine is running */
+#define APDS9960_GCONF4                   (0xABU)
+#define APDS9960_GCONF4_GMODE             (0x01U)
+#define APDS9960_GCONF4_GFIFO_CLR         (0x04U)
+/* Number of frames in the gesture FIFO, and the FIFO itself (U, D, L, R) */
+#define APDS9960_GFLVL                    (0xAEU)
+#define APDS9960_GFIFO_U                  (0xFCU)
+#define APDS9960_GFIFO_FRAME_SIZE         (4U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -49,6 +74,8 @@
  */
 void Nano33BLEGesture::init()
 {
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
   APDS.setGestureSensitivity(IR_GESTURE_SENSITIVITY);
   if (!APDS.begin())
   {
@@ -59,6 +86,21 @@ void Nano33BLEGesture::init()
    * boost results in more power consumption. 
    */
   APDS.setLEDBoost(IR_LED_BOOST_VALUE);
+
+  if(this->mode == GESTURE_MODE_FIFO)
+  {
+    /* 
+     * The gesture engine is set up here rather than by the library, which
+     * only does so from gestureAvailable().
+     */
+    apds.writeRegister(APDS9960_GPENTH, APDS9960_GPENTH_VALUE);
+    apds.writeRegister(APDS9960_GEXTH, APDS9960_GEXTH_VALUE);
+    apds.writeRegister(APDS9960_GCONF1, APDS9960_GCONF1_VALUE);
+    apds.updateRegister(APDS9960_GCONF4, APDS9960_GCONF4_GFIFO_CLR, APDS9960_GCONF4_GFIFO_CLR);
+    apds.updateRegister(APDS9960_ENABLE, 
+      APDS9960_ENABLE_PON | APDS9960_ENABLE_PEN | APDS9960_ENABLE_GEN,
+      APDS9960_ENABLE_PON | APDS9960_ENABLE_PEN | APDS9960_ENABLE_GEN);
+  }
   return;
 }
 
@@ -82,18 +124,181 @@ void Nano33BLEGesture::read(void)
    */
   Nano33BLEGestureData data;
 
-  /* If new proximity data is available on the APDS9960 get the data.*/
-  if (APDS.gestureAvailable())
+  if(this->mode == GESTURE_MODE_FIFO)
+  {
+    readFifo();
+  }
+  /* If new gesture data is available on the APDS9960 get the data.*/
+  else if (APDS.gestureAvailable())
   {
     data.gesture = (enum Nano33BLEGestureData::GESTURE)APDS.readGesture();
-    data.timeStampMs = millis();
-    push(data);
+    publish(data);
   }
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+  return;
+}
+
+float Nano33BLEGesture::setOutputDataRate(float rate_Hz)
+{
+  /* The APDS9960 gesture engine has no rate register. Only the read period
+   * can be changed.
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  this->scheduler.setRate(rate_Hz);
+  return this->scheduler.getRate();
+}
+
+void Nano33BLEGesture::powerDown(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  /* 
+   * Only the gesture engine is turned off. The APDS9960 itself stays powered
+   * as the other engines may still be in use by other sensor classes.
+   */
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_GEN, 0);
   return;
 }
 
+void Nano33BLEGesture::powerUp(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_GEN, APDS9960_ENABLE_GEN);
+  /* A gesture cut off by the power down is not finished */
+  this->tracking = false;
+  return;
+}
+
+void Nano33BLEGesture::readFifo(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+  uint8_t fifo[GESTURE_FIFO_BURST_FRAMES * APDS9960_GFIFO_FRAME_SIZE];
+  Nano33BLEGestureFrameData frame;
+  Nano33BLEGestureData data;
+  uint8_t level;
+  uint8_t gconf4;
+  uint32_t ii;
+
+  /* While no gesture is happening this single register read is all there is */
+  if(!apds.readRegister(APDS9960_GFLVL, level))
+  {
+    return;
+  }
+
+  if(level > 0U)
+  {
+    if(level > GESTURE_FIFO_BURST_FRAMES)
+    {
+      level = GESTURE_FIFO_BURST_FRAMES;
+    }
+
+    if(!this->tracking)
+    {
+      this->tracking = true;
+      this->validFrames = 0;
+    }
+
+    if(apds.readRegisters(APDS9960_GFIFO_U, fifo, level * APDS9960_GFIFO_FRAME_SIZE))
+    {
+      frame.timeStampMs = millis();
+      for(ii = 0; ii < level; ii++)
+      {
+        frame.up = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 0U];
+        frame.down = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 1U];
+        frame.left = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 2U];
+        frame.right = fifo[(ii * APDS9960_GFIFO_FRAME_SIZE) + 3U];
+        this->frames.push(frame);
+        addFrame(frame);
+      }
+    }
+    /* More may still be in the FIFO, or more may be on the way */
+    return;
+  }
+
+  if(!this->tracking)
+  {
+    return;
+  }
+
+  /* The FIFO is empty. The gesture is over once the engine has exited. */
+  if(!apds.readRegister(APDS9960_GCONF4, gconf4) || 
+    ((gconf4 & APDS9960_GCONF4_GMODE) != 0U))
+  {
+    return;
+  }
+
+  this->tracking = false;
+  if(decodeGesture(data.gesture))
+  {
+    publish(data);
+  }
+  return;
+}
+
+void Nano33BLEGesture::addFrame(const Nano33BLEGestureFrameData& frame)
+{
+  int32_t upDown;
+  int32_t leftRight;
+
+  /* Frames from the edge of the field of view are mostly noise */
+  if((frame.up <= GESTURE_FRAME_THRESHOLD) || (frame.down <= GESTURE_FRAME_THRESHOLD) ||
+    (frame.left <= GESTURE_FRAME_THRESHOLD) || (frame.right <= GESTURE_FRAME_THRESHOLD))
+  {
+    return;
+  }
+
+  upDown = (((int32_t)frame.up - (int32_t)frame.down) * 100) / 
+    ((int32_t)frame.up + (int32_t)frame.down);
+  leftRight = (((int32_t)frame.right - (int32_t)frame.left) * 100) / 
+    ((int32_t)frame.right + (int32_t)frame.left);
+
+  if(this->validFrames == 0U)
+  {
+    this->firstUpDown = upDown;
+    this->firstLeftRight = leftRight;
+  }
+  this->lastUpDown = upDown;
+  this->lastLeftRight = leftRight;
+  this->validFrames++;
+  return;
+}
+
+bool Nano33BLEGesture::decodeGesture(enum Nano33BLEGestureData::GESTURE& gesture)
+{
+  int32_t upDownDelta;
+  int32_t leftRightDelta;
+  int32_t threshold;
+
+  if(this->validFrames < 2U)
+  {
+    return false;
+  }
+
+  /* Same meaning as the sensitivity passed to APDS.setGestureSensitivity() */
+  threshold = 100 - (int32_t)IR_GESTURE_SENSITIVITY;
+  upDownDelta = this->firstUpDown - this->lastUpDown;
+  leftRightDelta = this->firstLeftRight - this->lastLeftRight;
+
+  /* 
+   * The same directions as APDS.readGesture() in GESTURE_MODE_LIBRARY: up
+   * when the balance moves from U to D, and left when it moves from L to R.
+   */
+  if(abs(upDownDelta) >= abs(leftRightDelta))
+  {
+    if(abs(upDownDelta) < threshold)
+    {
+      return false;
+    }
+    gesture = (upDownDelta > 0) ? Nano33BLEGestureData::UP : Nano33BLEGestureData::DOWN;
+  }
+  else
+  {
+    if(abs(leftRightDelta) < threshold)
+    {
+      return false;
+    }
+    gesture = (leftRightDelta > 0) ? Nano33BLEGestureData::RIGHT : Nano33BLEGestureData::LEFT;
+  }
+  return true;
+}
+
 Nano33BLEGesture Gesture;
\ No newline at end of file
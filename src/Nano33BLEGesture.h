@@ -31,9 +31,9 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 #include <Arduino_APDS9960.h>
-#include "Thread.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -58,6 +58,15 @@
  */
 #define DEFAULT_GESTURE_READ_PERIOD_MS                (10U)
 #define DEFAULT_GESTURE_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* APDS9960 gesture engine start up time, used when duty cycling the sensor */
+#define GESTURE_WAKE_UP_TIME_MS                    (6U)
+/* 
+ * Most gesture FIFO frames read in one I2C burst. The FIFO holds 32 frames
+ * of 4 bytes each.
+ */
+#define GESTURE_FIFO_BURST_FRAMES                  (32U)
+/* FIFO frames with any of U, D, L or R at or below this are ignored */
+#define GESTURE_FRAME_THRESHOLD                    (10U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -87,34 +96,159 @@ class Nano33BLEGestureData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEGestureData.
+ * Channels in order: gesture.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEGestureData>
+{
+  public:
+    enum { CHANNEL_COUNT = 1 };
+    static float get(const Nano33BLEGestureData& data, uint32_t channel)
+    {
+      (void)channel;
+      return (float)data.gesture;
+    }
+};
+
+/**
+ * One frame of the APDS9960 gesture FIFO: the IR reflected onto each of 
+ * the up, down, left and right photodiodes.
+ */
+class Nano33BLEGestureFrameData
+{
+  public:
+    uint8_t up;
+    uint8_t down;
+    uint8_t left;
+    uint8_t right;
+    /* 
+     * Time the frame was read from the FIFO. Frames read in the same 
+     * burst share a time stamp.
+     */
+    uint32_t timeStampMs;
+};
+
+/**
+ * Gives generic access to the values in Nano33BLEGestureFrameData.
+ * Channels in order: up, down, left, right.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEGestureFrameData>
+{
+  public:
+    enum { CHANNEL_COUNT = 4 };
+    static float get(const Nano33BLEGestureFrameData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.up;
+        case 1:
+          return (float)data.down;
+        case 2:
+          return (float)data.left;
+        default:
+          return (float)data.right;
+      }
+    }
+};
+
+/**
+ * @brief The buffer the raw gesture FIFO frames are pushed to. Only 
+ * Nano33BLEGesture pushes to it.
+ */
+class Nano33BLEGestureFrames: public Nano33BLESensorBuffer<Nano33BLEGestureFrameData>
+{
+  private:
+    friend class Nano33BLEGesture;
+};
+
 /**
  * @brief This class reads gesture data from the on board Nano 33 BLE
  * Sense APDS9960 using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
  */
-class Nano33BLEGesture: public Nano33BLESensorBuffer<Nano33BLEGestureData>
+class Nano33BLEGesture: public Nano33BLESensor<Nano33BLEGesture, Nano33BLEGestureData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
+    /**
+     * How gestures are read from the APDS9960.
      */
-    void begin()
+    enum GESTURE_MODE
     {
-      init();
-      readThread.start(mbed::callback(Nano33BLEGesture::readFunction, this));
-    }
+      /* 
+       * The gesture FIFO is drained in bursts each read period, and the 
+       * direction is decoded here once the gesture engine exits. A read
+       * never waits for the gesture to finish.
+       */
+      GESTURE_MODE_FIFO,
+      /* 
+       * APDS.readGesture() is used. It holds the thread and the I2C bus
+       * until the gesture has finished.
+       */
+      GESTURE_MODE_LIBRARY
+    };
 
     Nano33BLEGesture(
       uint32_t readPeriod_ms = DEFAULT_GESTURE_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_GESTURE_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEGesture, Nano33BLEGestureData>(
+          "Gesture",
+          TRACE_ID_GESTURE,
+          readPeriod_ms,
+          GESTURE_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize),
+        mode(GESTURE_MODE_FIFO),
+        tracking(false),
+        validFrames(0),
+        firstUpDown(0),
+        firstLeftRight(0),
+        lastUpDown(0),
+        lastLeftRight(0){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * rate the gesture sensor is read at. The APDS9960
+     * gesture engine has no rate register, so only the read period is
+     * changed.
+     */
+    float setOutputDataRate(float rate_Hz);
+
+    /**
+     * @brief Sets how gestures are read. GESTURE_MODE_FIFO is the default.
+     * Call before begin().
+     * 
+     */
+    void setMode(enum GESTURE_MODE gestureMode)
+    {
+      mode = gestureMode;
+    }
+
+    /**
+     * @brief Gives access to the raw up, down, left and right frames read 
+     * from the gesture FIFO in GESTURE_MODE_FIFO. A whole FIFO can be read
+     * at once, which is more than the buffer holds, so read the frames with
+     * their own Nano33BLESensorReader and expect overruns.
+     * 
+     */
+    Nano33BLESensorBuffer<Nano33BLEGestureFrameData>& getFrames(void)
+    {
+      return frames;
+    }
+
   private:
+    friend class Nano33BLESensor<Nano33BLEGesture, Nano33BLEGestureData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -126,17 +260,45 @@ class Nano33BLEGesture: public Nano33BLESensorBuffer<Nano33BLEGestureData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Drains the gesture FIFO and pushes a gesture once the gesture
+     * engine has exited. Never waits for the gesture to finish.
+     * 
+     */
+    void readFifo(void);
+    /**
+     * @brief Adds one FIFO frame to the gesture being tracked.
+     * 
+     */
+    void addFrame(const Nano33BLEGestureFrameData& frame);
+    /**
+     * @brief Decodes the direction of the tracked gesture from the change
+     * in the up/down and left/right balance between its first and last
+     * frames.
+     * 
+     * @return true if the change was large enough to be a gesture.
+     */
+    bool decodeGesture(enum Nano33BLEGestureData::GESTURE& gesture);
 
-    static void readFunction(Nano33BLEGesture *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    enum GESTURE_MODE mode;
+    Nano33BLEGestureFrames frames;
+    bool tracking;
+    uint32_t validFrames;
+    /* U - D and R - L balance of the first and last frames, from -100 to 100 */
+    int32_t firstUpDown;
+    int32_t firstLeftRight;
+    int32_t lastUpDown;
+    int32_t lastLeftRight;
 };
 
 
@@ -26,14 +26,25 @@
 /*****************************************************************************/
 #include "Nano33BLEGyroscope.h"
 #include <Arduino_LSM9DS1.h>
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLECalibration.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* LSM9DS1 registers used to set the gyroscope output data rate */
+#define LSM9DS1_CTRL_REG1_G         (0x10U)
+#define LSM9DS1_CTRL_REG6_XL        (0x20U)
+#define LSM9DS1_ODR_MASK            (0xE0U)
+#define LSM9DS1_ODR_SHIFT           (5U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
 /*****************************************************************************/
+/* LSM9DS1 gyroscope output data rates in Hz. Index + 1 is the ODR code */
+static const float gyroscopeOutputDataRates[] = 
+  {14.9F, 59.5F, 119.0F, 238.0F, 476.0F, 952.0F};
 
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
@@ -59,6 +70,13 @@ void Nano33BLEGyroscope::init()
     /* Something went wrong... Put this thread to sleep indefinetely. */
     osSignalWait(0x0001, osWaitForever);
   }
+  this->begun = true;
+  /* IMU.begin() sets its own default rate, so a rate set before begin has
+   * to be written after it */
+  if(this->configPending)
+  {
+    configure();
+  }
 
   return;
 }
@@ -83,17 +101,114 @@ void Nano33BLEGyroscope::read(void)
    */
   Nano33BLEGyroscopeData data;
 
+  if(this->configPending)
+  {
+    configure();
+  }
+
   if(IMU.gyroscopeAvailable())
   {
     IMU.readGyroscope(data.x, data.y, data.z);
-    data.timeStampMs = millis();
-    push(data);
+    Calibration.correctGyroscope(data.x, data.y, data.z);
+    publish(data);
+  }
+
+  return;
+}
+
+float Nano33BLEGyroscope::setOutputDataRate(float rate_Hz)
+{
+  const uint32_t rateCount = 
+    sizeof(gyroscopeOutputDataRates)/sizeof(gyroscopeOutputDataRates[0]);
+  uint8_t odr;
+  uint32_t ii;
+
+  /* Find the slowest supported rate that is at least as fast as requested */
+  for(ii = 0; ii < (rateCount - 1); ii++)
+  {
+    if(gyroscopeOutputDataRates[ii] >= rate_Hz)
+    {
+      break;
+    }
+  }
+  odr = (uint8_t)((ii + 1) << LSM9DS1_ODR_SHIFT);
+
+  /* The read thread writes it, as it also powers the gyroscope down and
+   * up, and a write from here could be lost between the two */
+  this->pendingOutputDataRate = odr;
+  this->configPending = true;
+  this->scheduler.setRate(gyroscopeOutputDataRates[ii]);
+  return gyroscopeOutputDataRates[ii];
+}
+
+void Nano33BLEGyroscope::configure(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+  uint8_t odr;
+
+  /* Cleared first so a rate set while this runs is written next time */
+  this->configPending = false;
+  odr = this->pendingOutputDataRate;
+  this->poweredOutputDataRate = odr;
+
+  imu.updateRegister(LSM9DS1_CTRL_REG1_G, LSM9DS1_ODR_MASK, odr);
+  /* The accelerometer follows the gyroscope output data rate while the
+   * gyroscope is powered. Keep its own setting the same so nothing changes
+   * if the gyroscope is later powered down, and read it at its new ODR too
+   * so it neither misses samples nor reads the same sample twice.
+   */
+  Accelerometer.followOutputDataRate(odr);
+  return;
+}
+
+void Nano33BLEGyroscope::followOutputDataRate(uint8_t odr)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+
+  if(!this->begun)
+  {
+    /* Nothing else writes the register, so it can be written here */
+    imu.updateRegister(LSM9DS1_CTRL_REG1_G, LSM9DS1_ODR_MASK, odr);
   }
+  else if(this->configPending || (this->poweredOutputDataRate != odr))
+  {
+    this->pendingOutputDataRate = odr;
+    this->configPending = true;
+  }
+  this->scheduler.setRate(
+    gyroscopeOutputDataRates[(odr >> LSM9DS1_ODR_SHIFT) - 1U]);
+  return;
+}
+
+void Nano33BLEGyroscope::powerDown(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+  uint8_t control;
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+  /* An ODR of 0 powers the gyroscope down. The accelerometer keeps running
+   * at its own ODR. 
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  if(imu.readRegister(LSM9DS1_CTRL_REG1_G, control))
+  {
+    this->poweredOutputDataRate = control & LSM9DS1_ODR_MASK;
+    imu.writeRegister(LSM9DS1_CTRL_REG1_G, control & ~LSM9DS1_ODR_MASK);
+  }
+  return;
+}
+
+void Nano33BLEGyroscope::powerUp(void)
+{
+  Nano33BLEI2CDevice imu(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS);
+
+  /* A rate set while powered down is written instead of the saved one */
+  if(this->configPending)
+  {
+    configure();
+  }
+  else
+  {
+    imu.updateRegister(LSM9DS1_CTRL_REG1_G, LSM9DS1_ODR_MASK, this->poweredOutputDataRate);
+  }
   return;
 }
 
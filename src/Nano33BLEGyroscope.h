@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -43,6 +43,8 @@
  */
 #define DEFAULT_GYROSCOPE_READ_PERIOD_MS                (8U)
 #define DEFAULT_GYROSCOPE_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* LSM9DS1 gyroscope turn on time, used when duty cycling the sensor */
+#define GYROSCOPE_WAKE_UP_TIME_MS                    (80U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -66,6 +68,29 @@ class Nano33BLEGyroscopeData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEGyroscopeData.
+ * Channels in order: x, y, z.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEGyroscopeData>
+{
+  public:
+    enum { CHANNEL_COUNT = 3 };
+    static float get(const Nano33BLEGyroscopeData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.x;
+        case 1:
+          return (float)data.y;
+        default:
+          return (float)data.z;
+      }
+    }
+};
+
 /**
  * @brief This class reads gyroscope data from the on board Nano 33 BLE
  * Sense IMU using Mbed OS. It stores the results in a ring 
@@ -73,28 +98,44 @@ class Nano33BLEGyroscopeData
  * in a manner with softer time constraints than other implementations. 
  * 
  */
-class Nano33BLEGyroscope: public Nano33BLESensorBuffer<Nano33BLEGyroscopeData>
+class Nano33BLEGyroscope: public Nano33BLESensor<Nano33BLEGyroscope, Nano33BLEGyroscopeData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEGyroscope::readFunction, this));
-    }
-
     Nano33BLEGyroscope(
       uint32_t readPeriod_ms = DEFAULT_GYROSCOPE_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_GYROSCOPE_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEGyroscope, Nano33BLEGyroscopeData>(
+          "Gyroscope",
+          TRACE_ID_GYROSCOPE,
+          readPeriod_ms,
+          GYROSCOPE_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize),
+        begun(false),
+        configPending(false),
+        pendingOutputDataRate(0),
+        poweredOutputDataRate(0){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running. The read thread writes
+     * it to the LSM9DS1 before its next read, or when it powers back up.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * closest rate the LSM9DS1 supports that is not slower than
+     * rate_Hz. The accelerometer and gyroscope share one output data rate
+     * while both are powered, so this also changes the accelerometer rate
+     * and the period the accelerometer is read at.
+     */
+    float setOutputDataRate(float rate_Hz);
+
   private:
+    friend class Nano33BLESensor<Nano33BLEGyroscope, Nano33BLEGyroscopeData>;
+    friend class Nano33BLEAccelerometer;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -106,17 +147,39 @@ class Nano33BLEGyroscope: public Nano33BLESensorBuffer<Nano33BLEGyroscopeData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Writes the pending output data rate. Only called from the read
+     * thread, which also powers the gyroscope down and up, so they never 
+     * write over each other.
+     * 
+     */
+    void configure(void);
+    /**
+     * @brief Changes the output data rate to match the accelerometer's, which 
+     * the two share while both are powered. The read thread writes it if 
+     * the gyroscope has begun, as it owns the register, and this writes it
+     * straight away otherwise.
+     * 
+     * @param odr the ODR bits of the LSM9DS1 control register.
+     */
+    void followOutputDataRate(uint8_t odr);
 
-    static void readFunction(Nano33BLEGyroscope *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    volatile bool begun;
+    /* The ODR bits from the setters, written by the read thread */
+    volatile bool configPending;
+    volatile uint8_t pendingOutputDataRate;
+    /* The ODR bits to restore when powering back up */
+    uint8_t poweredOutputDataRate;
 };
 
 extern Nano33BLEGyroscope Gyroscope;
@@ -0,0 +1,217 @@
+/*
+  Nano33BLEHeading.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class calculates a tilt compensated compass heading using Mbed OS,
+  from the magnetometer and the direction of gravity from the 
+  accelerometer. It stores the results in a ring buffer (within the 
+  Nano33BLESensorBuffer Class).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEHeading.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define HEADING_PI                            (3.14159265F)
+#define HEADING_RADIANS_TO_DEGREES            (180.0F / HEADING_PI)
+/* How long to wait for a magnetometer reading */
+#define HEADING_READ_TIMEOUT_MS               (200U)
+/* Weight of each accelerometer reading in the gravity direction estimate.
+ * Enough to smooth out vibration, without lagging a tilt by much. */
+#define HEADING_GRAVITY_WEIGHT                (0.1F)
+/* The LSM9DS1 magnetometer x axis points the opposite way to the 
+ * accelerometer's */
+#define HEADING_MAGNETIC_X_SIGN               (-1.0F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLEHeading Heading;
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief sqrt by Newton's method from a bit level first guess, to keep
+ * this free of library calls. Three iterations are within a float's 
+ * precision.
+ */
+static float sqrtNewton(float value)
+{
+  union
+  {
+    float f;
+    uint32_t i;
+  } guess;
+  float root;
+
+  if(value <= 0.0F)
+  {
+    return 0.0F;
+  }
+
+  /* Halving the exponent gives a root within a factor of about 1.5 */
+  guess.f = value;
+  guess.i = (guess.i >> 1) + 0x1FC00000U;
+  root = guess.f;
+  root = 0.5F * (root + (value / root));
+  root = 0.5F * (root + (value / root));
+  root = 0.5F * (root + (value / root));
+  return root;
+}
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLEHeading::setDeclination(float degrees)
+{
+  this->declination = degrees;
+  return;
+}
+
+float Nano33BLEHeading::getDeclination(void)
+{
+  return this->declination;
+}
+
+float Nano33BLEHeading::atan2Fast(float y, float x)
+{
+  float absoluteX;
+  float absoluteY;
+  float z;
+  float z2;
+  float angle;
+
+  absoluteX = (x < 0.0F) ? -x : x;
+  absoluteY = (y < 0.0F) ? -y : y;
+  if((absoluteX == 0.0F) && (absoluteY == 0.0F))
+  {
+    return 0.0F;
+  }
+
+  /* Fold into 0 to 45 degrees, where the polynomial is accurate */
+  if(absoluteX >= absoluteY)
+  {
+    z = absoluteY / absoluteX;
+  }
+  else
+  {
+    z = absoluteX / absoluteY;
+  }
+
+  /* Abramowitz and Stegun 4.4.49, within 1e-5 radians */
+  z2 = z * z;
+  angle = z * (0.9998660F + z2 * (-0.3302995F + z2 * (0.1801410F + 
+    z2 * (-0.0851330F + z2 * 0.0208351F))));
+
+  if(absoluteY > absoluteX)
+  {
+    angle = (HEADING_PI / 2.0F) - angle;
+  }
+  if(x < 0.0F)
+  {
+    angle = HEADING_PI - angle;
+  }
+  if(y < 0.0F)
+  {
+    angle = -angle;
+  }
+  return angle;
+}
+
+void Nano33BLEHeading::read(void)
+{
+  Nano33BLEAccelerometerData acceleration;
+  Nano33BLEMagneticData magnetic;
+  Nano33BLEHeadingData data;
+  float down[3];
+  float field[3];
+  float east[3];
+  float north[3];
+  float heading;
+
+  if(!this->magneticReader.popWait(magnetic, HEADING_READ_TIMEOUT_MS))
+  {
+    return;
+  }
+
+  /* Track the direction of gravity */
+  while(this->accelerometerReader.pop(acceleration))
+  {
+    if(!this->gravityValid)
+    {
+      this->gravity[0] = acceleration.x;
+      this->gravity[1] = acceleration.y;
+      this->gravity[2] = acceleration.z;
+      this->gravityValid = true;
+    }
+    else
+    {
+      this->gravity[0] += (acceleration.x - this->gravity[0]) * HEADING_GRAVITY_WEIGHT;
+      this->gravity[1] += (acceleration.y - this->gravity[1]) * HEADING_GRAVITY_WEIGHT;
+      this->gravity[2] += (acceleration.z - this->gravity[2]) * HEADING_GRAVITY_WEIGHT;
+    }
+  }
+
+  if(!this->gravityValid)
+  {
+    return;
+  }
+
+  /* At rest the accelerometer reads 1g up, so down is the opposite way */
+  down[0] = -this->gravity[0];
+  down[1] = -this->gravity[1];
+  down[2] = -this->gravity[2];
+  field[0] = HEADING_MAGNETIC_X_SIGN * magnetic.x;
+  field[1] = magnetic.y;
+  field[2] = magnetic.z;
+
+  /* 
+   * East is at right angles to down and the field, and north to east and 
+   * down, so both are horizontal however the board is tilted. Their 
+   * lengths do not matter to atan2, so neither is normalised.
+   */
+  east[0] = (down[1] * field[2]) - (down[2] * field[1]);
+  east[1] = (down[2] * field[0]) - (down[0] * field[2]);
+  east[2] = (down[0] * field[1]) - (down[1] * field[0]);
+  north[0] = (east[1] * down[2]) - (east[2] * down[1]);
+  north[1] = (east[2] * down[0]) - (east[0] * down[2]);
+  north[2] = (east[0] * down[1]) - (east[1] * down[0]);
+
+  /* The heading of the x axis is its angle from north towards east */
+  heading = (atan2Fast(east[0], north[0]) * HEADING_RADIANS_TO_DEGREES) + this->declination;
+  while(heading < 0.0F)
+  {
+    heading += 360.0F;
+  }
+  while(heading >= 360.0F)
+  {
+    heading -= 360.0F;
+  }
+
+  data.heading = heading;
+  data.pitch = atan2Fast(this->gravity[0], 
+    sqrtNewton((this->gravity[1] * this->gravity[1]) + (this->gravity[2] * this->gravity[2]))) * 
+    HEADING_RADIANS_TO_DEGREES;
+  data.roll = atan2Fast(this->gravity[1], this->gravity[2]) * HEADING_RADIANS_TO_DEGREES;
+  data.timeStampMs = magnetic.timeStampMs;
+  push(data);
+  return;
+}
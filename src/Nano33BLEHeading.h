@@ -0,0 +1,175 @@
+/*
+  Nano33BLEHeading.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class calculates a tilt compensated compass heading using Mbed OS,
+  from the magnetometer and the direction of gravity from the 
+  accelerometer. It stores the results in a ring buffer (within the 
+  Nano33BLESensorBuffer Class).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEHEADING_H_
+#define NANO33BLEHEADING_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEMagnetic.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_HEADING_THREAD_STACK_SIZE_BYTES       (1024U) 
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * This class defines the data the heading gives. All angles are in degrees.
+ */
+class Nano33BLEHeadingData
+{
+  public:
+    /* 0 to 360, clockwise from north to the board's x axis */
+    float heading;
+    /* -90 to 90, positive when the x axis points up */
+    float pitch;
+    /* -180 to 180, positive when the y axis points up */
+    float roll;
+    uint32_t timeStampMs;
+};
+
+/**
+ * Gives generic access to the values in Nano33BLEHeadingData.
+ * Channels in order: heading, pitch, roll.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEHeadingData>
+{
+  public:
+    enum { CHANNEL_COUNT = 3 };
+    static float get(const Nano33BLEHeadingData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.heading;
+        case 1:
+          return (float)data.pitch;
+        default:
+          return (float)data.roll;
+      }
+    }
+};
+
+/**
+ * @brief This class pushes a heading, pitch and roll for every
+ * magnetometer reading. The direction of gravity is tracked by low pass 
+ * filtering the accelerometer readings, and the heading is found from the
+ * horizontal part of the magnetic field, so it does not change as the 
+ * board is tilted. No trigonometric library functions are used: the
+ * horizontal field comes from cross products, and the angles from a
+ * polynomial atan2. Both the Accelerometer and Magnetic must be started 
+ * for this to work, and the magnetometer should be calibrated (see
+ * Nano33BLECalibration).
+ */
+class Nano33BLEHeading: public Nano33BLESensorBuffer<Nano33BLEHeadingData>
+{
+  public:
+    /**
+     * @brief Starts the Mbed OS Thread that calculates the heading.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEHeading::readFunction, this));
+    }
+
+    Nano33BLEHeading(
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_HEADING_THREAD_STACK_SIZE_BYTES) :
+        accelerometerReader(Accelerometer),
+        magneticReader(Magnetic),
+        declination(0.0F),
+        gravityValid(false),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "Heading"),
+        readStack("Heading", threadSize){};
+
+    /**
+     * @brief Sets the magnetic declination, the angle from true north to
+     * magnetic north where the board is, so the heading is from true 
+     * north. This can be called at any time.
+     * 
+     * @param degrees positive when magnetic north is east of true north.
+     */
+    void setDeclination(float degrees);
+    float getDeclination(void);
+
+    /**
+     * @brief A fast atan2, using a polynomial for atan on 0 to 1 that is
+     * within 0.001 degrees.
+     * 
+     * @return the angle of (x, y) from the x axis, in radians from -pi to
+     * pi.
+     */
+    static float atan2Fast(float y, float x);
+    /**
+     * @brief Waits up to 200ms for one magnetometer reading, applies any
+     * new accelerometer readings, and pushes the new heading. The heading 
+     * thread calls this over and over once begun. It can be called from 
+     * another thread instead of calling begin().
+     * 
+     */
+    void read(void);
+
+  private:
+
+    static void readFunction(Nano33BLEHeading *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<Nano33BLEAccelerometerData> accelerometerReader;
+    Nano33BLESensorReader<Nano33BLEMagneticData> magneticReader;
+    volatile float declination;
+    float gravity[3];
+    bool gravityValid;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+extern Nano33BLEHeading Heading;
+
+#endif /* NANO33BLEHEADING_H_ */
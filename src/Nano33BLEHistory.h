@@ -0,0 +1,490 @@
+/*
+  Nano33BLEHistory.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class keeps a tiered history of any sensor's data using Mbed OS: a
+  ring of the latest raw readings, plus rings of min/mean/max aggregates
+  over longer and longer periods (by default 1 second, 1 minute and 15
+  minutes). The aggregates are updated as each reading arrives, and each
+  tier can be queried by time range without going through the raw data.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEHISTORY_H_
+#define NANO33BLEHISTORY_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Mutex.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_HISTORY_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* How long to wait for data from the source sensor in one read. Once none
+ * has come for this long, periods that ended this long ago are closed */
+#define HISTORY_READ_TIMEOUT_MS                       (1000U)
+/* Number of aggregate tiers */
+#define HISTORY_TIER_COUNT                            (3U)
+/* Default number of raw readings kept */
+#define DEFAULT_HISTORY_RAW_SIZE                      (64U)
+/* Default number of aggregates kept in each tier (24 hours of 15 minutes) */
+#define DEFAULT_HISTORY_TIER_SIZE                     (96U)
+/* Default period of each tier */
+#define DEFAULT_HISTORY_TIER_0_PERIOD_MS              (1000U)
+#define DEFAULT_HISTORY_TIER_1_PERIOD_MS              (60000U)
+#define DEFAULT_HISTORY_TIER_2_PERIOD_MS              (900000U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * The min, mean and max of each channel of the source sensor's data (see
+ * Nano33BLESensorChannels) over one period of a tier.
+ */
+template<uint32_t CHANNEL_COUNT>
+class Nano33BLEHistoryAggregate
+{
+  public:
+    float min[CHANNEL_COUNT];
+    float mean[CHANNEL_COUNT];
+    float max[CHANNEL_COUNT];
+    /* Number of raw readings in the period */
+    uint32_t count;
+    /* Start of the period. Periods start at whole multiples of the period */
+    uint32_t startTimeMs;
+};
+
+/**
+ * @brief A ring of entries kept in time order. When it is full the oldest
+ * entry is overwritten.
+ */
+template<class E, uint32_t SIZE>
+class Nano33BLEHistoryRing
+{
+  public:
+    Nano33BLEHistoryRing() :
+      oldest(0),
+      count(0){};
+
+    void add(const E& entry)
+    {
+      entries[(oldest + count) % SIZE] = entry;
+      if(count < SIZE)
+      {
+        count++;
+      }
+      else
+      {
+        oldest = (oldest + 1U) % SIZE;
+      }
+    }
+
+    /**
+     * @return entry index, where 0 is the oldest.
+     */
+    const E& get(uint32_t index) const
+    {
+      return entries[(oldest + index) % SIZE];
+    }
+
+    uint32_t getCount(void) const
+    {
+      return count;
+    }
+
+  private:
+    E entries[SIZE];
+    uint32_t oldest;
+    uint32_t count;
+};
+
+/**
+ * @brief This class reads a source sensor through its own
+ * Nano33BLESensorReader and keeps its tiered history. Each reading is
+ * added to the raw ring and to the open period of tier 0. When a period
+ * closes its aggregate is stored in the tier and added to the open period
+ * of the next tier, so each tier is built from the one below it (the
+ * cascade) rather than from the raw data.
+ * 
+ * e.g. Nano33BLEHistory<Nano33BLEPressureData> pressureHistory(Pressure);
+ *
+ * Only closed periods are stored and returned by query(). A period is
+ * closed by the first reading after it, or, if the source stops, once no
+ * reading has come for HISTORY_READ_TIMEOUT_MS and the period ended at 
+ * least that long ago (allowing for readings that are time stamped a 
+ * little before they are pushed). Times are millis() time stamps, as in 
+ * the sensor data.
+ */
+template<class T, 
+  uint32_t RAW_SIZE = DEFAULT_HISTORY_RAW_SIZE, 
+  uint32_t TIER_SIZE = DEFAULT_HISTORY_TIER_SIZE>
+class Nano33BLEHistory
+{
+  public:
+    enum { CHANNEL_COUNT = Nano33BLESensorChannels<T>::CHANNEL_COUNT };
+    typedef Nano33BLEHistoryAggregate<CHANNEL_COUNT> Aggregate;
+
+    /**
+     * @brief Starts the Mbed OS Thread that reads the source sensor.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEHistory::readFunction, this));
+    }
+
+    /**
+     * @param tier0Period_ms the period of tier 0. Each tier's period 
+     * should be a whole multiple of the one below it.
+     */
+    Nano33BLEHistory(
+      Nano33BLESensorBuffer<T>& source,
+      uint32_t tier0Period_ms = DEFAULT_HISTORY_TIER_0_PERIOD_MS,
+      uint32_t tier1Period_ms = DEFAULT_HISTORY_TIER_1_PERIOD_MS,
+      uint32_t tier2Period_ms = DEFAULT_HISTORY_TIER_2_PERIOD_MS,
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_HISTORY_THREAD_STACK_SIZE_BYTES) :
+        sourceReader(source),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "History"),
+        readStack("History", threadSize)
+    {
+      uint32_t ii;
+
+      periods_ms[0] = tier0Period_ms;
+      periods_ms[1] = tier1Period_ms;
+      periods_ms[2] = tier2Period_ms;
+      for(ii = 0; ii < HISTORY_TIER_COUNT; ii++)
+      {
+        if(periods_ms[ii] == 0U)
+        {
+          periods_ms[ii] = 1U;
+        }
+        open[ii] = false;
+      }
+    };
+
+    /**
+     * @brief Copies the raw readings time stamped from from_ms up to (but
+     * not including) to_ms, oldest first.
+     * 
+     * @return the number of readings copied, at most size.
+     */
+    uint32_t queryRaw(uint32_t from_ms, uint32_t to_ms, T* buffer, uint32_t size);
+    /**
+     * @brief Copies the aggregates of one tier whose periods start from
+     * from_ms up to (but not including) to_ms, oldest first. The first one
+     * is found with a binary search, so the cost does not depend on how
+     * much history is kept.
+     * 
+     * @param tier 0 to HISTORY_TIER_COUNT - 1.
+     * @return the number of aggregates copied, at most size.
+     */
+    uint32_t query(uint32_t tier, uint32_t from_ms, uint32_t to_ms, Aggregate* buffer, uint32_t size);
+    /**
+     * @return the period of a tier in ms, or 0 if there is no such tier.
+     */
+    uint32_t getTierPeriod(uint32_t tier)
+    {
+      return (tier < HISTORY_TIER_COUNT) ? periods_ms[tier] : 0U;
+    }
+
+    /**
+     * @brief Waits up to HISTORY_READ_TIMEOUT_MS for one reading from the 
+     * source sensor and adds it to the history, or closes the periods that
+     * have ended if none came. The history thread calls this over and over
+     * once begun. It can be called from another thread instead of calling
+     * begin().
+     * 
+     */
+    void read(void);
+
+  private:
+    void add(const T& data);
+    /**
+     * @brief Adds an aggregate (a single reading, or a closed period of the
+     * tier below) to the open period of a tier.
+     * 
+     */
+    void merge(uint32_t tier, const Aggregate& aggregate);
+    void close(uint32_t tier);
+    /**
+     * @brief Closes the open period of each tier that ended by end_ms.
+     */
+    void closeEnded(uint32_t end_ms);
+    /**
+     * @return the index of the first entry in ring at or after time_ms.
+     */
+    template<class E, uint32_t SIZE>
+    static uint32_t findFirst(const Nano33BLEHistoryRing<E, SIZE>& ring, uint32_t time_ms);
+    static uint32_t getTime(const T& data)
+    {
+      return data.timeStampMs;
+    }
+    static uint32_t getTime(const Aggregate& aggregate)
+    {
+      return aggregate.startTimeMs;
+    }
+
+    static void readFunction(Nano33BLEHistory *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<T> sourceReader;
+    uint32_t periods_ms[HISTORY_TIER_COUNT];
+    Nano33BLEHistoryRing<T, RAW_SIZE> raw;
+    Nano33BLEHistoryRing<Aggregate, TIER_SIZE> tiers[HISTORY_TIER_COUNT];
+    /* The open period of each tier. Its mean holds the sum until it closes */
+    Aggregate current[HISTORY_TIER_COUNT];
+    bool open[HISTORY_TIER_COUNT];
+    rtos::Mutex historyMutex;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+uint32_t Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::queryRaw(
+  uint32_t from_ms, 
+  uint32_t to_ms, 
+  T* buffer, 
+  uint32_t size)
+{
+  uint32_t index;
+  uint32_t copied;
+
+  this->historyMutex.lock();
+  copied = 0;
+  for(index = findFirst(this->raw, from_ms); 
+    (index < this->raw.getCount()) && (copied < size); 
+    index++)
+  {
+    if((int32_t)(getTime(this->raw.get(index)) - to_ms) >= 0)
+    {
+      break;
+    }
+    buffer[copied] = this->raw.get(index);
+    copied++;
+  }
+  this->historyMutex.unlock();
+
+  return copied;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+uint32_t Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::query(
+  uint32_t tier, 
+  uint32_t from_ms, 
+  uint32_t to_ms, 
+  Aggregate* buffer, 
+  uint32_t size)
+{
+  uint32_t index;
+  uint32_t copied;
+
+  if(tier >= HISTORY_TIER_COUNT)
+  {
+    return 0;
+  }
+
+  this->historyMutex.lock();
+  copied = 0;
+  for(index = findFirst(this->tiers[tier], from_ms); 
+    (index < this->tiers[tier].getCount()) && (copied < size); 
+    index++)
+  {
+    if((int32_t)(getTime(this->tiers[tier].get(index)) - to_ms) >= 0)
+    {
+      break;
+    }
+    buffer[copied] = this->tiers[tier].get(index);
+    copied++;
+  }
+  this->historyMutex.unlock();
+
+  return copied;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+void Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::read(void)
+{
+  T data;
+
+  if(this->sourceReader.popWait(data, HISTORY_READ_TIMEOUT_MS))
+  {
+    add(data);
+  }
+  else
+  {
+    closeEnded((uint32_t)rtos::Kernel::get_ms_count() - HISTORY_READ_TIMEOUT_MS);
+  }
+  return;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+void Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::add(const T& data)
+{
+  Aggregate reading;
+  uint32_t ii;
+
+  for(ii = 0; ii < CHANNEL_COUNT; ii++)
+  {
+    reading.min[ii] = Nano33BLESensorChannels<T>::get(data, ii);
+    reading.mean[ii] = reading.min[ii];
+    reading.max[ii] = reading.min[ii];
+  }
+  reading.count = 1;
+  reading.startTimeMs = data.timeStampMs;
+
+  this->historyMutex.lock();
+  this->raw.add(data);
+  merge(0, reading);
+  this->historyMutex.unlock();
+  return;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+void Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::merge(uint32_t tier, const Aggregate& aggregate)
+{
+  Aggregate& period = this->current[tier];
+  uint32_t start_ms;
+  uint32_t ii;
+
+  start_ms = aggregate.startTimeMs - (aggregate.startTimeMs % this->periods_ms[tier]);
+  if(this->open[tier] && (period.startTimeMs != start_ms))
+  {
+    close(tier);
+  }
+
+  if(!this->open[tier])
+  {
+    for(ii = 0; ii < CHANNEL_COUNT; ii++)
+    {
+      period.min[ii] = aggregate.min[ii];
+      period.mean[ii] = 0.0F;
+      period.max[ii] = aggregate.max[ii];
+    }
+    period.count = 0;
+    period.startTimeMs = start_ms;
+    this->open[tier] = true;
+  }
+
+  for(ii = 0; ii < CHANNEL_COUNT; ii++)
+  {
+    if(aggregate.min[ii] < period.min[ii])
+    {
+      period.min[ii] = aggregate.min[ii];
+    }
+    if(aggregate.max[ii] > period.max[ii])
+    {
+      period.max[ii] = aggregate.max[ii];
+    }
+    /* Weighted by count so each tier's mean is the mean of the raw readings */
+    period.mean[ii] += aggregate.mean[ii] * aggregate.count;
+  }
+  period.count += aggregate.count;
+  return;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+void Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::close(uint32_t tier)
+{
+  Aggregate& period = this->current[tier];
+  uint32_t ii;
+
+  for(ii = 0; ii < CHANNEL_COUNT; ii++)
+  {
+    period.mean[ii] /= period.count;
+  }
+  this->tiers[tier].add(period);
+  this->open[tier] = false;
+
+  if((tier + 1U) < HISTORY_TIER_COUNT)
+  {
+    merge(tier + 1U, period);
+  }
+  return;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+void Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::closeEnded(uint32_t end_ms)
+{
+  uint32_t ii;
+
+  /* In tier order, so a period closed into the tier above is checked too */
+  this->historyMutex.lock();
+  for(ii = 0; ii < HISTORY_TIER_COUNT; ii++)
+  {
+    if(this->open[ii] && 
+      ((int32_t)(end_ms - (this->current[ii].startTimeMs + this->periods_ms[ii])) >= 0))
+    {
+      close(ii);
+    }
+  }
+  this->historyMutex.unlock();
+  return;
+}
+
+template<class T, uint32_t RAW_SIZE, uint32_t TIER_SIZE> 
+template<class E, uint32_t SIZE>
+uint32_t Nano33BLEHistory<T, RAW_SIZE, TIER_SIZE>::findFirst(
+  const Nano33BLEHistoryRing<E, SIZE>& ring, 
+  uint32_t time_ms)
+{
+  uint32_t low;
+  uint32_t high;
+  uint32_t middle;
+
+  /* Compared by subtraction so it still works when millis() wraps */
+  low = 0;
+  high = ring.getCount();
+  while(low < high)
+  {
+    middle = low + ((high - low) / 2U);
+    if((int32_t)(getTime(ring.get(middle)) - time_ms) < 0)
+    {
+      low = middle + 1U;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+#endif /* NANO33BLEHISTORY_H_ */
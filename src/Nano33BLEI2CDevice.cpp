@@ -0,0 +1,144 @@
+/*
+  Nano33BLEI2CDevice.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements simple register level access to the I2C sensors
+  on the Nano 33 BLE Sense. The Arduino sensor libraries keep their
+  register access private, so this is used whenever a sensor needs to be
+  configured in a way the Arduino libraries do not allow. The bus it uses
+  can be swapped, e.g. for the simulated devices in the host build.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEI2CDevice.h"
+#ifdef ARDUINO
+#include <Wire.h>
+#endif /* ARDUINO */
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+#ifdef ARDUINO
+/**
+ * @brief The internal Wire1 bus all of the on board sensors sit on.
+ */
+class Nano33BLEWire1Bus: public Nano33BLEI2CBus
+{
+  public:
+    bool read(uint8_t address, uint8_t reg, uint8_t* buffer, uint32_t size);
+    bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint32_t size);
+};
+#endif /* ARDUINO */
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+#ifdef ARDUINO
+static Nano33BLEWire1Bus wire1Bus;
+Nano33BLEI2CBus* Nano33BLEI2CDevice::bus = &wire1Bus;
+#else
+Nano33BLEI2CBus* Nano33BLEI2CDevice::bus = NULL;
+#endif /* ARDUINO */
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+bool Nano33BLEI2CDevice::readRegister(uint8_t reg, uint8_t& value)
+{
+  return readRegisters(reg, &value, 1);
+}
+
+bool Nano33BLEI2CDevice::readRegisters(uint8_t reg, uint8_t* buffer, uint32_t size)
+{
+  Nano33BLEI2CBus* i2cBus;
+
+  i2cBus = bus;
+  if(i2cBus == NULL)
+  {
+    return false;
+  }
+  return i2cBus->read(this->address, reg, buffer, size);
+}
+
+bool Nano33BLEI2CDevice::writeRegister(uint8_t reg, uint8_t value)
+{
+  Nano33BLEI2CBus* i2cBus;
+
+  i2cBus = bus;
+  if(i2cBus == NULL)
+  {
+    return false;
+  }
+  return i2cBus->write(this->address, reg, &value, 1);
+}
+
+bool Nano33BLEI2CDevice::updateRegister(uint8_t reg, uint8_t mask, uint8_t value)
+{
+  uint8_t current;
+
+  if(!readRegister(reg, current))
+  {
+    return false;
+  }
+
+  current = (current & ~mask) | (value & mask);
+  return writeRegister(reg, current);
+}
+
+#ifdef ARDUINO
+bool Nano33BLEWire1Bus::read(uint8_t address, uint8_t reg, uint8_t* buffer, uint32_t size)
+{
+  uint32_t ii;
+
+  Wire1.beginTransmission(address);
+  Wire1.write(reg);
+  if(Wire1.endTransmission(false) != 0)
+  {
+    return false;
+  }
+
+  if(Wire1.requestFrom(address, size) != size)
+  {
+    return false;
+  }
+
+  for(ii = 0; ii < size; ii++)
+  {
+    buffer[ii] = Wire1.read();
+  }
+
+  return true;
+}
+
+bool Nano33BLEWire1Bus::write(uint8_t address, uint8_t reg, const uint8_t* data, uint32_t size)
+{
+  uint32_t ii;
+
+  Wire1.beginTransmission(address);
+  Wire1.write(reg);
+  for(ii = 0; ii < size; ii++)
+  {
+    Wire1.write(data[ii]);
+  }
+  return (Wire1.endTransmission() == 0);
+}
+#endif /* ARDUINO */
\ No newline at end of file
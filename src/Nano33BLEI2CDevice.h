@@ -0,0 +1,137 @@
+/*
+  Nano33BLEI2CDevice.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements simple register level access to the I2C sensors
+  on the Nano 33 BLE Sense. The Arduino sensor libraries keep their
+  register access private, so this is used whenever a sensor needs to be
+  configured in a way the Arduino libraries do not allow. The bus it uses
+  can be swapped, e.g. for the simulated devices in the host build.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEI2CDEVICE_H_
+#define NANO33BLEI2CDEVICE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* I2C addresses of the on board sensors (all on the internal Wire1 bus) */
+#define LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS   (0x6BU)
+#define LSM9DS1_MAGNETIC_ADDRESS                  (0x1EU)
+#define APDS9960_ADDRESS                          (0x39U)
+#define LPS22HB_ADDRESS                           (0x5CU)
+#define HTS221_ADDRESS                            (0x5FU)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief The I2C bus Nano33BLEI2CDevice talks to. On the board this is the
+ * internal Wire1 bus. The host build has no bus until one is set with
+ * Nano33BLEI2CDevice::setBus(), e.g. a Nano33BLESimulatedBus.
+ */
+class Nano33BLEI2CBus
+{
+  public:
+    /**
+     * @brief Writes reg, then reads size bytes in the same transaction.
+     *
+     * @return true if the device acknowledged and all bytes were read.
+     */
+    virtual bool read(uint8_t address, uint8_t reg, uint8_t* buffer, uint32_t size) = 0;
+    /**
+     * @brief Writes reg followed by size bytes of data in one transaction.
+     *
+     * @return true if the device acknowledged.
+     */
+    virtual bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint32_t size) = 0;
+};
+
+/**
+ * @brief This class gives register level access to one of the on board I2C
+ * sensors. The sensor must have already been started by its Arduino
+ * library (IMU.begin(), APDS.begin() etc.) before it is used.
+ */
+class Nano33BLEI2CDevice
+{
+  public:
+    Nano33BLEI2CDevice(uint8_t deviceAddress) :
+      address(deviceAddress){};
+
+    /**
+     * @brief Reads one register.
+     *
+     * @param reg the register address.
+     * @param value the value read.
+     * @return true if the read succeeded.
+     */
+    bool readRegister(uint8_t reg, uint8_t& value);
+    /**
+     * @brief Reads size consecutive bytes starting at reg in one I2C
+     * transaction. Any auto increment flag the device needs must already
+     * be part of reg.
+     *
+     * @return true if the read succeeded.
+     */
+    bool readRegisters(uint8_t reg, uint8_t* buffer, uint32_t size);
+    /**
+     * @brief Writes one register.
+     *
+     * @return true if the write succeeded.
+     */
+    bool writeRegister(uint8_t reg, uint8_t value);
+    /**
+     * @brief Read-modify-write of the bits in mask, leaving the other bits
+     * of the register untouched.
+     *
+     * @return true if the read and write succeeded.
+     */
+    bool updateRegister(uint8_t reg, uint8_t mask, uint8_t value);
+
+    /**
+     * @brief Sets the bus every Nano33BLEI2CDevice talks to. Only register
+     * accesses made through this class use it. The Arduino sensor libraries
+     * always use Wire1.
+     *
+     * @param i2cBus the bus. NULL makes every access fail.
+     */
+    static void setBus(Nano33BLEI2CBus* i2cBus)
+    {
+      bus = i2cBus;
+    }
+    static Nano33BLEI2CBus* getBus(void)
+    {
+      return bus;
+    }
+
+  private:
+    uint8_t address;
+    static Nano33BLEI2CBus* bus;
+};
+
+#endif /* NANO33BLEI2CDEVICE_H_ */
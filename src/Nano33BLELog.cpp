@@ -0,0 +1,417 @@
+/*
+  Nano33BLELog.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class is the log that Nano33BLELogger writes sensor data to. It
+  keeps the records in storage that behaves like flash, in sectors used in
+  turn, and each record is protected by a CRC so the log can be recovered
+  after power is lost. It has no thread or locking of its own, so it builds
+  without Mbed OS.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLELog.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* "N3LG", marks a sector that has been started by the logger */
+#define LOG_SECTOR_MAGIC              (0x474C334EUL)
+/* Sector header: magic, sequence */
+#define LOG_SECTOR_HEADER_SIZE        (8U)
+/* Record header: size (2 bytes), stream id, reserved, CRC-32 */
+#define LOG_RECORD_HEADER_SIZE        (8U)
+#define LOG_RECORD_CRC_OFFSET         (4U)
+/* Size of a record header that has never been programmed */
+#define LOG_RECORD_ERASED_SIZE        (0xFFFFU)
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, uint32_t size)
+{
+  /* Half byte table, small enough to not matter in flash */
+  static const uint32_t table[16] =
+  {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+    0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+    0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+  };
+  uint32_t ii;
+
+  for(ii = 0; ii < size; ii++)
+  {
+    crc ^= data[ii];
+    crc = (crc >> 4) ^ table[crc & 0x0FU];
+    crc = (crc >> 4) ^ table[crc & 0x0FU];
+  }
+  return crc;
+}
+
+static uint32_t recordCrc(const uint8_t* record, uint32_t dataSize)
+{
+  uint32_t crc;
+
+  /* Covers the size and stream id, then the data, skipping the CRC itself */
+  crc = crc32Update(0xFFFFFFFFUL, record, LOG_RECORD_CRC_OFFSET);
+  crc = crc32Update(crc, &record[LOG_RECORD_HEADER_SIZE], dataSize);
+  return ~crc;
+}
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+bool Nano33BLELog::mount(Nano33BLELogStorage& logStorage)
+{
+  uint32_t sector;
+  uint32_t sequence;
+  uint32_t offset;
+  uint32_t recordSize;
+  uint16_t dataSize;
+  bool found;
+
+  if(!logStorage.init())
+  {
+    return false;
+  }
+
+  this->storage = &logStorage;
+  this->sectorSize = logStorage.getSectorSize();
+  this->alignment = logStorage.getProgramSize();
+  if(this->alignment == 0U)
+  {
+    this->alignment = 1;
+  }
+  if((this->sectorSize == 0U) || (this->alignment > LOGGER_MAX_PROGRAM_SIZE_BYTES))
+  {
+    this->storage = NULL;
+    return false;
+  }
+  this->sectorCount = logStorage.getSize() / this->sectorSize;
+  if(this->sectorCount < 2U)
+  {
+    /* One sector would have to be erased while it holds the whole log */
+    this->storage = NULL;
+    return false;
+  }
+
+  /* The newest sector has the highest sequence number */
+  found = false;
+  for(sector = 0; sector < this->sectorCount; sector++)
+  {
+    if(readSectorSequence(sector, sequence) && 
+      (!found || ((int32_t)(sequence - this->headSequence) > 0)))
+    {
+      found = true;
+      this->headSector = sector;
+      this->headSequence = sequence;
+    }
+  }
+
+  if(!found)
+  {
+    if(!startSector(0, 1))
+    {
+      this->storage = NULL;
+      return false;
+    }
+  }
+  else
+  {
+    /* Find the end of the newest sector */
+    offset = LOG_SECTOR_HEADER_SIZE;
+    while(offset < this->sectorSize)
+    {
+      recordSize = readRecord(this->headSector, offset);
+      if(recordSize == 0U)
+      {
+        break;
+      }
+      offset += recordSize;
+    }
+    this->writeOffset = offset;
+
+    memcpy(&dataSize, &this->record[0], sizeof(dataSize));
+    if((offset < this->sectorSize) && (dataSize != LOG_RECORD_ERASED_SIZE))
+    {
+      /* A record was not completely written. Nothing more can be 
+       * programmed over it, so carry on in the next sector.
+       */
+      this->writeOffset = this->sectorSize;
+    }
+  }
+
+  rewind();
+  return true;
+}
+
+bool Nano33BLELog::format(void)
+{
+  bool success;
+
+  success = false;
+  if(this->storage != NULL)
+  {
+    /* The first sector is erased when it is started */
+    success = this->storage->erase(this->sectorSize, (this->sectorCount - 1U) * this->sectorSize);
+    if(success)
+    {
+      this->eraseCount += this->sectorCount - 1U;
+      success = startSector(0, 1);
+    }
+    rewind();
+  }
+  return success;
+}
+
+bool Nano33BLELog::append(uint8_t streamId, const void* data, uint32_t size)
+{
+  uint32_t recordSize;
+  uint32_t crc;
+  uint16_t dataSize;
+  bool success;
+
+  if(size > LOGGER_MAX_RECORD_SIZE_BYTES)
+  {
+    this->droppedCount++;
+    return false;
+  }
+
+  if(this->storage == NULL)
+  {
+    this->droppedCount++;
+    return false;
+  }
+
+  recordSize = getAlignedSize(LOG_RECORD_HEADER_SIZE + size);
+  if((this->writeOffset + recordSize) > this->sectorSize)
+  {
+    if(!startSector((this->headSector + 1U) % this->sectorCount, this->headSequence + 1U))
+    {
+      this->droppedCount++;
+      return false;
+    }
+  }
+
+  dataSize = (uint16_t)size;
+  memset(this->record, 0xFF, recordSize);
+  memcpy(&this->record[0], &dataSize, sizeof(dataSize));
+  this->record[2] = streamId;
+  this->record[3] = 0;
+  memcpy(&this->record[LOG_RECORD_HEADER_SIZE], data, size);
+  crc = recordCrc(this->record, size);
+  memcpy(&this->record[LOG_RECORD_CRC_OFFSET], &crc, sizeof(crc));
+
+  success = this->storage->program(
+    (this->headSector * this->sectorSize) + this->writeOffset, 
+    this->record, 
+    recordSize);
+  /* Even a failed program may have cleared some bits, so never reuse it */
+  this->writeOffset += recordSize;
+  this->bytesProgrammed += recordSize;
+  if(success)
+  {
+    this->bytesLogged += size;
+  }
+  else
+  {
+    this->droppedCount++;
+  }
+  return success;
+}
+
+uint32_t Nano33BLELog::readNext(uint8_t& streamId, void* data, uint32_t maxSize)
+{
+  uint32_t recordSize;
+  uint32_t sequence;
+  uint16_t dataSize;
+
+  while(this->storage != NULL)
+  {
+    if((this->readSector == this->headSector) && (this->readOffset >= this->writeOffset))
+    {
+      break;
+    }
+
+    recordSize = 0;
+    if(this->readOffset < this->sectorSize)
+    {
+      recordSize = readRecord(this->readSector, this->readOffset);
+    }
+
+    if(recordSize != 0U)
+    {
+      this->readOffset += recordSize;
+      memcpy(&dataSize, &this->record[0], sizeof(dataSize));
+      streamId = this->record[2];
+      memcpy(data, &this->record[LOG_RECORD_HEADER_SIZE], (dataSize < maxSize) ? dataSize : maxSize);
+      return dataSize;
+    }
+
+    /* End of this sector, move on to the next one in sequence */
+    if(this->readSector == this->headSector)
+    {
+      break;
+    }
+    this->readSector = (this->readSector + 1U) % this->sectorCount;
+    this->readSequence++;
+    this->readOffset = LOG_SECTOR_HEADER_SIZE;
+    if(!readSectorSequence(this->readSector, sequence) || (sequence != this->readSequence))
+    {
+      break;
+    }
+  }
+  return 0;
+}
+
+uint32_t Nano33BLELog::getBytesLogged(void)
+{
+  return this->bytesLogged;
+}
+
+uint32_t Nano33BLELog::getBytesProgrammed(void)
+{
+  return this->bytesProgrammed;
+}
+
+uint32_t Nano33BLELog::getEraseCount(void)
+{
+  return this->eraseCount;
+}
+
+uint32_t Nano33BLELog::getDroppedCount(void)
+{
+  return this->droppedCount;
+}
+
+bool Nano33BLELog::readSectorSequence(uint32_t sector, uint32_t& sequence)
+{
+  uint32_t header[2];
+
+  if(!this->storage->read(sector * this->sectorSize, header, sizeof(header)))
+  {
+    return false;
+  }
+
+  sequence = header[1];
+  return ((header[0] == LOG_SECTOR_MAGIC) && (sequence != 0xFFFFFFFFUL));
+}
+
+bool Nano33BLELog::startSector(uint32_t sector, uint32_t sequence)
+{
+  uint32_t header[2];
+  bool success;
+
+  if(!this->storage->erase(sector * this->sectorSize, this->sectorSize))
+  {
+    return false;
+  }
+  this->eraseCount++;
+
+  header[0] = LOG_SECTOR_MAGIC;
+  header[1] = sequence;
+  success = this->storage->program(sector * this->sectorSize, header, sizeof(header));
+  this->bytesProgrammed += sizeof(header);
+
+  this->headSector = sector;
+  this->headSequence = sequence;
+  this->writeOffset = LOG_SECTOR_HEADER_SIZE;
+  if(!success)
+  {
+    /* Nothing can be appended to a sector without a valid header */
+    this->writeOffset = this->sectorSize;
+  }
+
+  if(this->readSector == sector)
+  {
+    /* The oldest data, which had not been read yet, has been erased */
+    rewind();
+  }
+  return success;
+}
+
+uint32_t Nano33BLELog::readRecord(uint32_t sector, uint32_t offset)
+{
+  uint32_t address;
+  uint32_t recordSize;
+  uint32_t crc;
+  uint16_t dataSize;
+
+  address = (sector * this->sectorSize) + offset;
+  if(((offset + LOG_RECORD_HEADER_SIZE) > this->sectorSize) ||
+    !this->storage->read(address, this->record, LOG_RECORD_HEADER_SIZE))
+  {
+    memset(this->record, 0xFF, LOG_RECORD_HEADER_SIZE);
+    return 0;
+  }
+
+  memcpy(&dataSize, &this->record[0], sizeof(dataSize));
+  if(dataSize > LOGGER_MAX_RECORD_SIZE_BYTES)
+  {
+    return 0;
+  }
+
+  recordSize = getAlignedSize(LOG_RECORD_HEADER_SIZE + dataSize);
+  if(((offset + recordSize) > this->sectorSize) ||
+    !this->storage->read(address + LOG_RECORD_HEADER_SIZE, 
+      &this->record[LOG_RECORD_HEADER_SIZE], dataSize))
+  {
+    return 0;
+  }
+
+  memcpy(&crc, &this->record[LOG_RECORD_CRC_OFFSET], sizeof(crc));
+  if(crc != recordCrc(this->record, dataSize))
+  {
+    return 0;
+  }
+  return recordSize;
+}
+
+uint32_t Nano33BLELog::getAlignedSize(uint32_t size)
+{
+  return (((size + this->alignment) - 1U) / this->alignment) * this->alignment;
+}
+
+void Nano33BLELog::rewind(void)
+{
+  uint32_t sector;
+  uint32_t sequence;
+
+  /* The oldest sector still in the log is the first valid one after the
+   * newest, as the sectors are used in turn.
+   */
+  this->readSector = this->headSector;
+  this->readSequence = this->headSequence;
+  if(this->storage != NULL)
+  {
+    for(sector = 1; sector < this->sectorCount; sector++)
+    {
+      if(readSectorSequence((this->headSector + sector) % this->sectorCount, sequence) &&
+        (sequence == (this->headSequence - this->sectorCount + sector)))
+      {
+        this->readSector = (this->headSector + sector) % this->sectorCount;
+        this->readSequence = sequence;
+        break;
+      }
+    }
+  }
+  this->readOffset = LOG_SECTOR_HEADER_SIZE;
+  return;
+}
+
@@ -0,0 +1,164 @@
+/*
+  Nano33BLELog.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class is the log that Nano33BLELogger writes sensor data to. It
+  keeps the records in storage that behaves like flash, in sectors used in
+  turn, and each record is protected by a CRC so the log can be recovered
+  after power is lost. It has no thread or locking of its own, so it builds
+  without Mbed OS.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLELOG_H_
+#define NANO33BLELOG_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLELogStorage.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Largest data that can be logged in one record */
+#define LOGGER_MAX_RECORD_SIZE_BYTES              (128U)
+/* Largest storage program size the log can be aligned to */
+#define LOGGER_MAX_PROGRAM_SIZE_BYTES             (8U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class appends records to a log in Nano33BLELogStorage. The
+ * storage is split into sectors that are used in turn, so every sector is
+ * erased equally often (wear levelling). When the log is full the oldest
+ * sector is erased and reused. Each sector starts with a header holding an
+ * increasing sequence number, and each record is aligned to the storage
+ * program size and never crosses a sector. On start up the newest sector
+ * is found from the sequence numbers and checked record by record; a
+ * record with a bad CRC (e.g. power lost while it was written) ends that
+ * sector and logging carries on in the next one.
+ *
+ * Only one thread may use it at a time. Nano33BLELogger wraps it with a
+ * mutex and a thread that drains sensor buffers to it.
+ */
+class Nano33BLELog
+{
+  public:
+    Nano33BLELog() :
+      storage(NULL),
+      sectorSize(0),
+      sectorCount(0),
+      alignment(1),
+      headSector(0),
+      headSequence(0),
+      writeOffset(0),
+      readSector(0),
+      readSequence(0),
+      readOffset(0),
+      bytesLogged(0),
+      bytesProgrammed(0),
+      eraseCount(0),
+      droppedCount(0){};
+
+    /**
+     * @brief Finds the end of the log in the storage, recovering from any
+     * record that was not completely written.
+     *
+     * @return false if the storage could not be used.
+     */
+    bool mount(Nano33BLELogStorage& logStorage);
+    /**
+     * @brief Erases the whole log.
+     */
+    bool format(void);
+    /**
+     * @brief Appends one record to the log.
+     *
+     * @return false if the record was too big or could not be written.
+     */
+    bool append(uint8_t streamId, const void* data, uint32_t size);
+
+    /**
+     * @brief Moves the read position back to the oldest record in the log.
+     */
+    void rewind(void);
+    /**
+     * @brief Reads the record at the read position and moves to the next.
+     *
+     * @param streamId the stream the record was logged with.
+     * @param data filled with up to maxSize bytes of the record.
+     * @return the size of the record, or 0 if there are no more records.
+     */
+    uint32_t readNext(uint8_t& streamId, void* data, uint32_t maxSize);
+
+    /**
+     * @return the bytes of data logged, not counting record headers.
+     */
+    uint32_t getBytesLogged(void);
+    /**
+     * @return the bytes programmed to the storage, including headers and
+     * padding. getBytesProgrammed() / getBytesLogged() is the write
+     * amplification.
+     */
+    uint32_t getBytesProgrammed(void);
+    uint32_t getEraseCount(void);
+    /**
+     * @return the number of records that could not be appended.
+     */
+    uint32_t getDroppedCount(void);
+
+  private:
+    bool readSectorSequence(uint32_t sector, uint32_t& sequence);
+    bool startSector(uint32_t sector, uint32_t sequence);
+    /**
+     * @brief Reads and checks the record at offset in sector.
+     *
+     * @return the record size including header and padding, or 0 if there
+     * is no valid record there.
+     */
+    uint32_t readRecord(uint32_t sector, uint32_t offset);
+    uint32_t getAlignedSize(uint32_t size);
+
+    Nano33BLELogStorage* storage;
+    uint32_t sectorSize;
+    uint32_t sectorCount;
+    uint32_t alignment;
+
+    uint32_t headSector;
+    uint32_t headSequence;
+    uint32_t writeOffset;
+    uint32_t readSector;
+    uint32_t readSequence;
+    uint32_t readOffset;
+
+    uint32_t bytesLogged;
+    uint32_t bytesProgrammed;
+    uint32_t eraseCount;
+    uint32_t droppedCount;
+
+    /* Used to build and check one record at a time */
+    uint8_t record[LOGGER_MAX_RECORD_SIZE_BYTES + (2U * LOGGER_MAX_PROGRAM_SIZE_BYTES)];
+};
+
+#endif /* NANO33BLELOG_H_ */
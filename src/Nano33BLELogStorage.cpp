@@ -0,0 +1,260 @@
+/*
+  Nano33BLELogStorage.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file implements the storage the Nano33BLELogger class writes its
+  log to. On the board this is an area at the end of the on board flash.
+  Host builds (without ARDUINO defined) instead get a file backed stand-in
+  that behaves like NOR flash, for testing the logger on a PC.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLELogStorage.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define FILE_STORAGE_COPY_SIZE_BYTES      (64U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+#if defined(ARDUINO)
+Nano33BLEFlashStorage FlashStorage;
+#endif
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+#if defined(ARDUINO)
+bool Nano33BLEFlashStorage::init(void)
+{
+  uint32_t flashEnd;
+
+  if(this->initialised)
+  {
+    return true;
+  }
+
+  if(this->flash.init() != 0)
+  {
+    return false;
+  }
+
+  flashEnd = this->flash.get_flash_start() + this->flash.get_flash_size();
+  this->start = flashEnd - this->offsetFromEnd - this->storageSize;
+  this->initialised = true;
+  return true;
+}
+
+uint32_t Nano33BLEFlashStorage::getSize(void)
+{
+  return this->storageSize;
+}
+
+uint32_t Nano33BLEFlashStorage::getSectorSize(void)
+{
+  return this->flash.get_sector_size(this->start);
+}
+
+uint32_t Nano33BLEFlashStorage::getProgramSize(void)
+{
+  return this->flash.get_page_size();
+}
+
+bool Nano33BLEFlashStorage::read(uint32_t address, void* buffer, uint32_t size)
+{
+  return (this->flash.read(buffer, this->start + address, size) == 0);
+}
+
+bool Nano33BLEFlashStorage::program(uint32_t address, const void* buffer, uint32_t size)
+{
+  return (this->flash.program(buffer, this->start + address, size) == 0);
+}
+
+bool Nano33BLEFlashStorage::erase(uint32_t address, uint32_t size)
+{
+  return (this->flash.erase(this->start + address, size) == 0);
+}
+#else
+Nano33BLEFileStorage::~Nano33BLEFileStorage()
+{
+  if(this->file != NULL)
+  {
+    fclose(this->file);
+  }
+}
+
+bool Nano33BLEFileStorage::init(void)
+{
+  if(this->file != NULL)
+  {
+    return true;
+  }
+
+  this->file = fopen(this->path, "r+b");
+  if(this->file == NULL)
+  {
+    this->file = fopen(this->path, "w+b");
+    if(this->file == NULL)
+    {
+      return false;
+    }
+    /* A new file starts as erased storage */
+    if(!erase(0, this->storageSize))
+    {
+      return false;
+    }
+    this->eraseCount = 0;
+  }
+  return true;
+}
+
+uint32_t Nano33BLEFileStorage::getSize(void)
+{
+  return this->storageSize;
+}
+
+uint32_t Nano33BLEFileStorage::getSectorSize(void)
+{
+  return this->sectorSize;
+}
+
+uint32_t Nano33BLEFileStorage::getProgramSize(void)
+{
+  return this->programSize;
+}
+
+bool Nano33BLEFileStorage::read(uint32_t address, void* buffer, uint32_t size)
+{
+  if((this->file == NULL) || ((address + size) > this->storageSize))
+  {
+    return false;
+  }
+
+  fflush(this->file);
+  if(fseek(this->file, address, SEEK_SET) != 0)
+  {
+    return false;
+  }
+  return (fread(buffer, 1, size, this->file) == size);
+}
+
+bool Nano33BLEFileStorage::program(uint32_t address, const void* buffer, uint32_t size)
+{
+  uint8_t current[FILE_STORAGE_COPY_SIZE_BYTES];
+  const uint8_t* data;
+  uint32_t chunk;
+  uint32_t ii;
+  bool cutShort;
+
+  if(this->powerLost || ((address % this->programSize) != 0U) || 
+    ((size % this->programSize) != 0U))
+  {
+    return false;
+  }
+
+  cutShort = false;
+  if(this->powerLossEnabled && (size > this->bytesUntilPowerLoss))
+  {
+    size = this->bytesUntilPowerLoss;
+    cutShort = true;
+  }
+
+  data = (const uint8_t*)buffer;
+  while(size > 0U)
+  {
+    chunk = (size < FILE_STORAGE_COPY_SIZE_BYTES) ? size : FILE_STORAGE_COPY_SIZE_BYTES;
+    if(!read(address, current, chunk))
+    {
+      return false;
+    }
+
+    /* NOR flash programming can only clear bits */
+    for(ii = 0; ii < chunk; ii++)
+    {
+      current[ii] &= data[ii];
+    }
+
+    if((fseek(this->file, address, SEEK_SET) != 0) ||
+      (fwrite(current, 1, chunk, this->file) != chunk))
+    {
+      return false;
+    }
+    this->programmedBytes += chunk;
+    this->bytesUntilPowerLoss -= chunk;
+    address += chunk;
+    data += chunk;
+    size -= chunk;
+  }
+
+  if(this->powerLossEnabled && (this->bytesUntilPowerLoss == 0U))
+  {
+    /* Power is lost just after the last byte, which did get written */
+    this->powerLost = true;
+  }
+  return !cutShort;
+}
+
+bool Nano33BLEFileStorage::erase(uint32_t address, uint32_t size)
+{
+  uint8_t erased[FILE_STORAGE_COPY_SIZE_BYTES];
+  uint32_t chunk;
+
+  if(this->powerLost || (this->file == NULL) || 
+    ((address % this->sectorSize) != 0U) || ((size % this->sectorSize) != 0U) ||
+    ((address + size) > this->storageSize))
+  {
+    return false;
+  }
+
+  memset(erased, 0xFF, sizeof(erased));
+  if(fseek(this->file, address, SEEK_SET) != 0)
+  {
+    return false;
+  }
+  this->eraseCount += size / this->sectorSize;
+  while(size > 0U)
+  {
+    chunk = (size < FILE_STORAGE_COPY_SIZE_BYTES) ? size : FILE_STORAGE_COPY_SIZE_BYTES;
+    if(fwrite(erased, 1, chunk, this->file) != chunk)
+    {
+      return false;
+    }
+    size -= chunk;
+  }
+  return true;
+}
+
+void Nano33BLEFileStorage::setPowerLossAfter(uint32_t bytes)
+{
+  this->powerLossEnabled = true;
+  this->bytesUntilPowerLoss = bytes;
+  return;
+}
+
+uint32_t Nano33BLEFileStorage::getProgrammedBytes(void)
+{
+  return this->programmedBytes;
+}
+
+uint32_t Nano33BLEFileStorage::getEraseCount(void)
+{
+  return this->eraseCount;
+}
+#endif
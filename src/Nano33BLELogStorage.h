@@ -0,0 +1,192 @@
+/*
+  Nano33BLELogStorage.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file implements the storage the Nano33BLELogger class writes its
+  log to. On the board this is an area at the end of the on board flash.
+  Host builds (without ARDUINO defined) instead get a file backed stand-in
+  that behaves like NOR flash, for testing the logger on a PC.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLELOGSTORAGE_H_
+#define NANO33BLELOGSTORAGE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#if defined(ARDUINO)
+#include "Arduino.h"
+#include "FlashIAP.h"
+#else
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Size of the log area at the end of the on board flash */
+#define DEFAULT_FLASH_STORAGE_SIZE_BYTES          (64U * 1024U)
+#define DEFAULT_FILE_STORAGE_SECTOR_SIZE_BYTES    (4096U)
+#define DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES   (4U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class is the interface to storage that behaves like NOR
+ * flash: it is erased a sector at a time (to 0xFF), and programmed in
+ * multiples of the program size. Addresses start at 0 for the beginning of
+ * the storage.
+ */
+class Nano33BLELogStorage
+{
+  public:
+    virtual ~Nano33BLELogStorage(){};
+
+    /**
+     * @return true if the storage is ready to use.
+     */
+    virtual bool init(void) = 0;
+    virtual uint32_t getSize(void) = 0;
+    /**
+     * @return the size of the blocks the storage is erased in.
+     */
+    virtual uint32_t getSectorSize(void) = 0;
+    /**
+     * @return the size of the blocks the storage is programmed in.
+     */
+    virtual uint32_t getProgramSize(void) = 0;
+    virtual bool read(uint32_t address, void* buffer, uint32_t size) = 0;
+    /**
+     * @brief Programs size bytes, which must only be written once after
+     * each erase. address and size must be multiples of the program size.
+     */
+    virtual bool program(uint32_t address, const void* buffer, uint32_t size) = 0;
+    /**
+     * @brief Erases whole sectors to 0xFF. address and size must be 
+     * multiples of the sector size.
+     */
+    virtual bool erase(uint32_t address, uint32_t size) = 0;
+};
+
+#if defined(ARDUINO)
+/**
+ * @brief This class stores the log in size bytes of the on board flash, 
+ * endOffset bytes from the end, using the Mbed OS FlashIAP driver. The 
+ * sketch must not reach into this area.
+ */
+class Nano33BLEFlashStorage: public Nano33BLELogStorage
+{
+  public:
+    Nano33BLEFlashStorage(
+      uint32_t size = DEFAULT_FLASH_STORAGE_SIZE_BYTES,
+      uint32_t endOffset = 0) :
+        start(0),
+        storageSize(size),
+        offsetFromEnd(endOffset),
+        initialised(false){};
+
+    bool init(void);
+    uint32_t getSize(void);
+    uint32_t getSectorSize(void);
+    uint32_t getProgramSize(void);
+    bool read(uint32_t address, void* buffer, uint32_t size);
+    bool program(uint32_t address, const void* buffer, uint32_t size);
+    bool erase(uint32_t address, uint32_t size);
+
+  private:
+    mbed::FlashIAP flash;
+    uint32_t start;
+    uint32_t storageSize;
+    uint32_t offsetFromEnd;
+    bool initialised;
+};
+
+extern Nano33BLEFlashStorage FlashStorage;
+#else
+/**
+ * @brief This class is a stand-in for the on board flash on host builds, 
+ * backed by a file. Programming can only clear bits, as on NOR flash. It 
+ * counts the bytes programmed and sectors erased, and can simulate power 
+ * being lost part way through programming.
+ */
+class Nano33BLEFileStorage: public Nano33BLELogStorage
+{
+  public:
+    Nano33BLEFileStorage(
+      const char* filePath,
+      uint32_t size,
+      uint32_t sectorSize = DEFAULT_FILE_STORAGE_SECTOR_SIZE_BYTES,
+      uint32_t programSize = DEFAULT_FILE_STORAGE_PROGRAM_SIZE_BYTES) :
+        path(filePath),
+        file(NULL),
+        storageSize(size),
+        sectorSize(sectorSize),
+        programSize(programSize),
+        programmedBytes(0),
+        eraseCount(0),
+        powerLossEnabled(false),
+        powerLost(false),
+        bytesUntilPowerLoss(0){};
+    ~Nano33BLEFileStorage();
+
+    /**
+     * @brief Opens the file, creating it as erased storage if it does not 
+     * exist.
+     */
+    bool init(void);
+    uint32_t getSize(void);
+    uint32_t getSectorSize(void);
+    uint32_t getProgramSize(void);
+    bool read(uint32_t address, void* buffer, uint32_t size);
+    bool program(uint32_t address, const void* buffer, uint32_t size);
+    bool erase(uint32_t address, uint32_t size);
+
+    /**
+     * @brief Simulates power being lost once bytes more bytes have been 
+     * programmed. A program that goes past the limit is cut short there 
+     * and fails, and every program and erase after the limit is reached 
+     * fails. Open the file with a new
+     * Nano33BLEFileStorage to simulate power coming back.
+     */
+    void setPowerLossAfter(uint32_t bytes);
+    uint32_t getProgrammedBytes(void);
+    uint32_t getEraseCount(void);
+
+  private:
+    const char* path;
+    FILE* file;
+    uint32_t storageSize;
+    uint32_t sectorSize;
+    uint32_t programSize;
+    uint32_t programmedBytes;
+    uint32_t eraseCount;
+    bool powerLossEnabled;
+    bool powerLost;
+    uint32_t bytesUntilPowerLoss;
+};
+#endif
+
+#endif /* NANO33BLELOGSTORAGE_H_ */
@@ -0,0 +1,141 @@
+/*
+  Nano33BLELogger.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class logs sensor data to on board flash using Mbed OS, so data is
+  not lost when it cannot be sent (e.g. while BLE is disconnected). Records
+  are appended to a log made of flash sectors used in turn, and each record
+  is protected by a CRC so the log can be recovered after power is lost.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLELogger.h"
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLELogger Logger;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+bool Nano33BLELogger::mount(Nano33BLELogStorage& logStorage)
+{
+  bool success;
+
+  this->logMutex.lock();
+  success = this->log.mount(logStorage);
+  this->logMutex.unlock();
+  return success;
+}
+
+bool Nano33BLELogger::format(void)
+{
+  bool success;
+
+  this->logMutex.lock();
+  success = this->log.format();
+  this->logMutex.unlock();
+  return success;
+}
+
+bool Nano33BLELogger::attach(Nano33BLELogStream& stream)
+{
+  if(this->streamCount >= LOGGER_MAX_STREAMS)
+  {
+    return false;
+  }
+
+  this->streams[this->streamCount] = &stream;
+  this->streamCount++;
+  return true;
+}
+
+uint32_t Nano33BLELogger::drain(void)
+{
+  uint32_t count;
+  uint32_t ii;
+
+  count = 0;
+  for(ii = 0; ii < this->streamCount; ii++)
+  {
+    count += this->streams[ii]->drain(*this);
+  }
+  return count;
+}
+
+bool Nano33BLELogger::append(uint8_t streamId, const void* data, uint32_t size)
+{
+  bool success;
+
+  this->logMutex.lock();
+  success = this->log.append(streamId, data, size);
+  this->logMutex.unlock();
+  return success;
+}
+
+void Nano33BLELogger::setDrainPeriod(uint32_t period_ms)
+{
+  this->drainPeriod_ms = period_ms;
+  return;
+}
+
+void Nano33BLELogger::rewind(void)
+{
+  this->logMutex.lock();
+  this->log.rewind();
+  this->logMutex.unlock();
+  return;
+}
+
+uint32_t Nano33BLELogger::readNext(uint8_t& streamId, void* data, uint32_t maxSize)
+{
+  uint32_t size;
+
+  this->logMutex.lock();
+  size = this->log.readNext(streamId, data, maxSize);
+  this->logMutex.unlock();
+  return size;
+}
+
+uint32_t Nano33BLELogger::getBytesLogged(void)
+{
+  return this->log.getBytesLogged();
+}
+
+uint32_t Nano33BLELogger::getBytesProgrammed(void)
+{
+  return this->log.getBytesProgrammed();
+}
+
+uint32_t Nano33BLELogger::getEraseCount(void)
+{
+  return this->log.getEraseCount();
+}
+
+uint32_t Nano33BLELogger::getDroppedCount(void)
+{
+  return this->log.getDroppedCount();
+}
+
+void Nano33BLELogger::write(void)
+{
+  drain();
+  rtos::ThisThread::sleep_for(this->drainPeriod_ms);
+  return;
+}
@@ -0,0 +1,250 @@
+/*
+  Nano33BLELogger.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class logs sensor data to on board flash using Mbed OS, so data is
+  not lost when it cannot be sent (e.g. while BLE is disconnected). Records
+  are appended to a log made of flash sectors used in turn, and each record
+  is protected by a CRC so the log can be recovered after power is lost.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLELOGGER_H_
+#define NANO33BLELOGGER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLELog.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+#include "Mutex.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* The most streams that can be attached to the logger */
+#define LOGGER_MAX_STREAMS                        (8U)
+/* How often the attached streams are written to the log */
+#define DEFAULT_LOGGER_DRAIN_PERIOD_MS            (100U)
+#define DEFAULT_LOGGER_THREAD_STACK_SIZE_BYTES    (1024U) 
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+class Nano33BLELogger;
+
+/**
+ * @brief This class is the interface the logger uses to write out the data
+ * of one stream. See Nano33BLELogSource.
+ */
+class Nano33BLELogStream
+{
+  public:
+    virtual ~Nano33BLELogStream(){};
+
+    /**
+     * @brief Appends all the data waiting in the stream to the log.
+     * 
+     * @return the number of records appended.
+     */
+    virtual uint32_t drain(Nano33BLELogger& logger) = 0;
+};
+
+/**
+ * @brief This class logs the data of one sensor buffer, read through its 
+ * own Nano33BLESensorReader so other consumers still get the data. Each 
+ * record holds one T, tagged with the stream id.
+ * 
+ * e.g. Nano33BLELogSource<Nano33BLEAccelerometerData> 
+ *        accelerometerLog(Accelerometer, 1);
+ *      Logger.attach(accelerometerLog);
+ */
+template<class T>
+class Nano33BLELogSource: public Nano33BLELogStream
+{
+  public:
+    Nano33BLELogSource(Nano33BLESensorBuffer<T>& buffer, uint8_t streamId) :
+      reader(buffer),
+      id(streamId){};
+
+    uint32_t drain(Nano33BLELogger& logger);
+    /**
+     * @return the number of values lost because the logger fell too far 
+     * behind the sensor.
+     */
+    uint32_t getOverrunCount(void)
+    {
+      return reader.getOverrunCount();
+    }
+
+  private:
+    Nano33BLESensorReader<T> reader;
+    uint8_t id;
+};
+
+/**
+ * @brief This class logs the attached streams to a Nano33BLELog from its
+ * own Mbed OS Thread. See Nano33BLELog for how the log is kept. Every 
+ * function can be called from any thread.
+ */
+class Nano33BLELogger
+{
+  public:
+    /**
+     * @brief Mounts the log and starts the Mbed OS Thread that drains the
+     * attached streams to it.
+     * 
+     * @return false if the log could not be mounted.
+     */
+    bool begin(Nano33BLELogStorage& logStorage)
+    {
+      if(!mount(logStorage))
+      {
+        return false;
+      }
+      writeStack.start(writeThread, mbed::callback(Nano33BLELogger::writeFunction, this));
+      return true;
+    }
+
+    Nano33BLELogger(
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_LOGGER_THREAD_STACK_SIZE_BYTES) :
+        streamCount(0),
+        drainPeriod_ms(DEFAULT_LOGGER_DRAIN_PERIOD_MS),
+        writeThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "Logger"),
+        writeStack("Logger", threadSize){};
+
+    /**
+     * @brief Finds the end of the log in the storage, recovering from any
+     * record that was not completely written. begin() does this, so this is
+     * only needed to use the logger without its thread (calling drain() or
+     * append() directly).
+     * 
+     * @return false if the storage could not be used.
+     */
+    bool mount(Nano33BLELogStorage& logStorage);
+    /**
+     * @brief Erases the whole log.
+     */
+    bool format(void);
+    /**
+     * @brief Adds a stream to be drained to the log.
+     * 
+     * @return false if LOGGER_MAX_STREAMS are already attached.
+     */
+    bool attach(Nano33BLELogStream& stream);
+    /**
+     * @brief Appends all data waiting in the attached streams to the log.
+     * 
+     * @return the number of records appended.
+     */
+    uint32_t drain(void);
+    /**
+     * @brief Appends one record to the log. This can be called from any
+     * thread.
+     * 
+     * @return false if the record was too big or could not be written.
+     */
+    bool append(uint8_t streamId, const void* data, uint32_t size);
+    void setDrainPeriod(uint32_t period_ms);
+
+    /**
+     * @brief Moves the read position back to the oldest record in the log.
+     */
+    void rewind(void);
+    /**
+     * @brief Reads the record at the read position and moves to the next.
+     * 
+     * @param streamId the stream the record was logged with.
+     * @param data filled with up to maxSize bytes of the record.
+     * @return the size of the record, or 0 if there are no more records.
+     */
+    uint32_t readNext(uint8_t& streamId, void* data, uint32_t maxSize);
+
+    /**
+     * @return the bytes of data logged, not counting record headers.
+     */
+    uint32_t getBytesLogged(void);
+    /**
+     * @return the bytes programmed to the storage, including headers and
+     * padding. getBytesProgrammed() / getBytesLogged() is the write 
+     * amplification.
+     */
+    uint32_t getBytesProgrammed(void);
+    uint32_t getEraseCount(void);
+    /**
+     * @return the number of records that could not be appended.
+     */
+    uint32_t getDroppedCount(void);
+
+  private:
+    /**
+     * @brief Drains the attached streams then sleeps for the drain period.
+     * 
+     */
+    void write(void);
+
+    static void writeFunction(Nano33BLELogger *instance)
+    {
+      while(1)
+      {
+          instance->write();
+      }
+    }
+
+    Nano33BLELog log;
+    Nano33BLELogStream* streams[LOGGER_MAX_STREAMS];
+    uint32_t streamCount;
+    volatile uint32_t drainPeriod_ms;
+    rtos::Mutex logMutex;
+    rtos::Thread writeThread;
+    Nano33BLEThreadStack writeStack;
+};
+
+extern Nano33BLELogger Logger;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+template<class T> uint32_t Nano33BLELogSource<T>::drain(Nano33BLELogger& logger)
+{
+  T data;
+  uint32_t count;
+
+  count = 0;
+  while(this->reader.pop(data))
+  {
+    if(logger.append(this->id, &data, sizeof(T)))
+    {
+      count++;
+    }
+  }
+  return count;
+}
+
+#endif /* NANO33BLELOGGER_H_ */
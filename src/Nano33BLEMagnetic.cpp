@@ -26,14 +26,27 @@
 /*****************************************************************************/
 #include "Nano33BLEMagnetic.h"
 #include <Arduino_LSM9DS1.h>
+#include "Nano33BLEI2CDevice.h"
+#include "Nano33BLECalibration.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* LSM9DS1 registers used to set the magnetometer output data rate and mode */
+#define LSM9DS1_CTRL_REG1_M         (0x20U)
+#define LSM9DS1_ODR_M_MASK          (0x1CU)
+#define LSM9DS1_ODR_M_SHIFT         (2U)
+#define LSM9DS1_CTRL_REG3_M         (0x22U)
+#define LSM9DS1_MD_MASK             (0x03U)
+#define LSM9DS1_MD_CONTINUOUS       (0x00U)
+#define LSM9DS1_MD_POWER_DOWN       (0x03U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
 /*****************************************************************************/
+/* LSM9DS1 magnetometer output data rates in Hz. Index is the ODR code */
+static const float magneticOutputDataRates[] = 
+  {0.625F, 1.25F, 2.5F, 5.0F, 10.0F, 20.0F, 40.0F, 80.0F};
 
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
@@ -85,14 +98,51 @@ void Nano33BLEMagnetic::read(void)
   if(IMU.magneticFieldAvailable())
   {
     IMU.readMagneticField(data.x, data.y, data.z);
-    data.timeStampMs = millis();
-    push(data);
+    Calibration.correctMagnetic(data.x, data.y, data.z);
+    publish(data);
   }
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
-   */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  return;
+}
+
+float Nano33BLEMagnetic::setOutputDataRate(float rate_Hz)
+{
+  Nano33BLEI2CDevice magnetometer(LSM9DS1_MAGNETIC_ADDRESS);
+  const uint32_t rateCount = 
+    sizeof(magneticOutputDataRates)/sizeof(magneticOutputDataRates[0]);
+  uint32_t ii;
+
+  /* Find the slowest supported rate that is at least as fast as requested */
+  for(ii = 0; ii < (rateCount - 1); ii++)
+  {
+    if(magneticOutputDataRates[ii] >= rate_Hz)
+    {
+      break;
+    }
+  }
+
+  magnetometer.updateRegister(
+    LSM9DS1_CTRL_REG1_M, 
+    LSM9DS1_ODR_M_MASK, 
+    (uint8_t)(ii << LSM9DS1_ODR_M_SHIFT));
+
+  this->scheduler.setRate(magneticOutputDataRates[ii]);
+  return magneticOutputDataRates[ii];
+}
+
+void Nano33BLEMagnetic::powerDown(void)
+{
+  Nano33BLEI2CDevice magnetometer(LSM9DS1_MAGNETIC_ADDRESS);
+
+  magnetometer.updateRegister(LSM9DS1_CTRL_REG3_M, LSM9DS1_MD_MASK, LSM9DS1_MD_POWER_DOWN);
+  return;
+}
+
+void Nano33BLEMagnetic::powerUp(void)
+{
+  Nano33BLEI2CDevice magnetometer(LSM9DS1_MAGNETIC_ADDRESS);
+
+  magnetometer.updateRegister(LSM9DS1_CTRL_REG3_M, LSM9DS1_MD_MASK, LSM9DS1_MD_CONTINUOUS);
   return;
 }
 
@@ -31,8 +31,8 @@
 /*INLCUDES                                                                   */
 /*****************************************************************************/
 /* These are required, do not remove them */
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -43,6 +43,8 @@
  */
 #define DEFAULT_MAGNETIC_READ_PERIOD_MS                (40U)
 #define DEFAULT_MAGNETIC_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* LSM9DS1 magnetometer turn on time, used when duty cycling the sensor */
+#define MAGNETIC_WAKE_UP_TIME_MS                    (10U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -66,34 +68,65 @@ class Nano33BLEMagneticData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEMagneticData.
+ * Channels in order: x, y, z.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEMagneticData>
+{
+  public:
+    enum { CHANNEL_COUNT = 3 };
+    static float get(const Nano33BLEMagneticData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.x;
+        case 1:
+          return (float)data.y;
+        default:
+          return (float)data.z;
+      }
+    }
+};
+
 /**
  * @brief This class reads magnetic data from the on board Nano 33 BLE
  * Sense IMU using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
  */
-class Nano33BLEMagnetic: public Nano33BLESensorBuffer<Nano33BLEMagneticData>
+class Nano33BLEMagnetic: public Nano33BLESensor<Nano33BLEMagnetic, Nano33BLEMagneticData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEMagnetic::readFunction, this));
-    }
-
     Nano33BLEMagnetic(
       uint32_t readPeriod_ms = DEFAULT_MAGNETIC_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_MAGNETIC_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEMagnetic, Nano33BLEMagneticData>(
+          "Magnetic",
+          TRACE_ID_MAGNETIC,
+          readPeriod_ms,
+          MAGNETIC_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * closest rate the LSM9DS1 magnetometer supports that is not
+     * slower than rate_Hz.
+     */
+    float setOutputDataRate(float rate_Hz);
+
   private:
+    friend class Nano33BLESensor<Nano33BLEMagnetic, Nano33BLEMagneticData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -105,17 +138,17 @@ class Nano33BLEMagnetic: public Nano33BLESensorBuffer<Nano33BLEMagneticData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
 
-    static void readFunction(Nano33BLEMagnetic *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
 };
 
 extern Nano33BLEMagnetic Magnetic;
@@ -108,8 +108,7 @@ void Nano33BLEMicrophoneRMS::read(void)
     sum = sum + pow(microphoneBuffer[i], 2);
   }
   data.RMSValue = sqrt(sum/MICROPHONE_BUFFER_SIZE_IN_WORDS);
-  data.timeStampMs = millis();
-  push(data);
+  publish(data);
 }
 
 void Nano33BLEMicrophoneRMS::PDM_callback(void)
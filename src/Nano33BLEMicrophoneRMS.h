@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -63,32 +63,47 @@ class Nano33BLEMicrophoneRMSData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEMicrophoneRMSData.
+ * Channels in order: RMSValue.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEMicrophoneRMSData>
+{
+  public:
+    enum { CHANNEL_COUNT = 1 };
+    static float get(const Nano33BLEMicrophoneRMSData& data, uint32_t channel)
+    {
+      (void)channel;
+      return (float)data.RMSValue;
+    }
+};
+
 /**
  * @brief This class reads rms microphone data from the on board Nano 33 BLE
  * Sense microphone using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
  */
-class Nano33BLEMicrophoneRMS: public Nano33BLESensorBuffer<Nano33BLEMicrophoneRMSData>
+class Nano33BLEMicrophoneRMS: public Nano33BLESensor<Nano33BLEMicrophoneRMS, Nano33BLEMicrophoneRMSData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEMicrophoneRMS::readFunction, this));
-    }
-
     Nano33BLEMicrophoneRMS(
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_MICROPHONE_THREAD_STACK_SIZE_BYTES) :
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEMicrophoneRMS, Nano33BLEMicrophoneRMSData>(
+          "MicrophoneRMS",
+          TRACE_ID_MICROPHONE_RMS,
+          0U,
+          0U,
+          threadPriority,
+          threadSize){};
   private:
+    friend class Nano33BLESensor<Nano33BLEMicrophoneRMS, Nano33BLEMicrophoneRMSData>;
+
+    /* read() waits for the PDM buffer itself */
+    enum { SCHEDULED = false };
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -101,15 +116,6 @@ class Nano33BLEMicrophoneRMS: public Nano33BLESensorBuffer<Nano33BLEMicrophoneRM
      */
     void read(void);
 
-    static void readFunction(Nano33BLEMicrophoneRMS *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    rtos::Thread readThread;
     static void PDM_callback(void);  
 };
 
@@ -0,0 +1,153 @@
+/*
+  Nano33BLEMotionGate.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class watches the accelerometer data from the on board Nano 33 BLE
+  Sense IMU using Mbed OS, and slows down or suspends the reading of other
+  sensors while the board is still. Full rate reading is restored as soon
+  as the board starts moving again.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEMotionGate.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* 
+ * The baseline follows the acceleration with this weight per sample, so
+ * slow changes in orientation do not count as motion.
+ */
+#define MOTION_GATE_BASELINE_WEIGHT       (0.0625F)
+/* How long to wait for accelerometer data before checking the still time */
+#define MOTION_GATE_READ_TIMEOUT_MS       (100U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+bool Nano33BLEMotionGate::attach(Nano33BLEPeriodicScheduler& scheduler)
+{
+  if(this->sensorCount >= MOTION_GATE_MAX_SENSORS)
+  {
+    return false;
+  }
+
+  this->sensors[this->sensorCount] = &scheduler;
+  this->sensorCount++;
+  return true;
+}
+
+void Nano33BLEMotionGate::setThreshold(float threshold_g)
+{
+  this->threshold_g = threshold_g;
+  return;
+}
+
+void Nano33BLEMotionGate::setStillTime(uint32_t stillTime_ms)
+{
+  this->stillTime_ms = stillTime_ms;
+  return;
+}
+
+void Nano33BLEMotionGate::setStillSlowdown(uint32_t factor)
+{
+  this->stillSlowdown = factor;
+  return;
+}
+
+bool Nano33BLEMotionGate::isMoving(void)
+{
+  return this->moving;
+}
+
+uint32_t Nano33BLEMotionGate::getTransitionCount(void)
+{
+  return this->transitionCount;
+}
+
+void Nano33BLEMotionGate::read(void)
+{
+  Nano33BLEAccelerometerData data;
+  float change_g;
+
+  if(this->accelerometerReader.popWait(data, MOTION_GATE_READ_TIMEOUT_MS))
+  {
+    if(!this->baselineValid)
+    {
+      this->baseline = data;
+      this->baselineValid = true;
+      this->lastMotion_ms = data.timeStampMs;
+    }
+
+    change_g = fabsf(data.x - this->baseline.x) + 
+      fabsf(data.y - this->baseline.y) + 
+      fabsf(data.z - this->baseline.z);
+
+    this->baseline.x += (data.x - this->baseline.x) * MOTION_GATE_BASELINE_WEIGHT;
+    this->baseline.y += (data.y - this->baseline.y) * MOTION_GATE_BASELINE_WEIGHT;
+    this->baseline.z += (data.z - this->baseline.z) * MOTION_GATE_BASELINE_WEIGHT;
+
+    if(change_g > this->threshold_g)
+    {
+      this->lastMotion_ms = data.timeStampMs;
+      setMoving(true);
+      return;
+    }
+  }
+
+  if(this->moving && ((millis() - this->lastMotion_ms) >= this->stillTime_ms))
+  {
+    setMoving(false);
+  }
+  return;
+}
+
+void Nano33BLEMotionGate::setMoving(bool isMoving)
+{
+  uint32_t slowdown;
+  uint32_t ii;
+
+  if(isMoving == this->moving)
+  {
+    return;
+  }
+
+  if(isMoving)
+  {
+    slowdown = 1U;
+  }
+  else
+  {
+    slowdown = this->stillSlowdown;
+  }
+
+  for(ii = 0; ii < this->sensorCount; ii++)
+  {
+    this->sensors[ii]->setSlowdown(slowdown);
+  }
+
+  this->moving = isMoving;
+  this->transitionCount++;
+  return;
+}
+
+Nano33BLEMotionGate MotionGate;
@@ -0,0 +1,162 @@
+/*
+  Nano33BLEMotionGate.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class watches the accelerometer data from the on board Nano 33 BLE
+  Sense IMU using Mbed OS, and slows down or suspends the reading of other
+  sensors while the board is still. Full rate reading is restored as soon
+  as the board starts moving again.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEMOTIONGATE_H_
+#define NANO33BLEMOTIONGATE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEAccelerometer.h"
+#include "Nano33BLEPeriodicScheduler.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* The most sensors that can be attached to the gate */
+#define MOTION_GATE_MAX_SENSORS                       (8U)
+/* Change in acceleration (sum of all axes, in g) that counts as motion */
+#define DEFAULT_MOTION_GATE_THRESHOLD_G               (0.05F)
+/* How long without motion before the board is considered still */
+#define DEFAULT_MOTION_GATE_STILL_TIME_MS             (5000U)
+/* How much attached sensors are slowed down by while still. 0 suspends them */
+#define DEFAULT_MOTION_GATE_STILL_SLOWDOWN            (0U)
+#define DEFAULT_MOTION_GATE_THREAD_STACK_SIZE_BYTES   (1024U) 
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class detects motion from the Accelerometer data, using the 
+ * change in acceleration from a slowly moving baseline. While the board is
+ * still, every attached sensor is slowed down (or suspended). As soon as a
+ * sample shows motion the attached sensors are woken and return to their full
+ * rate, so they resume within one of their own read periods. The Accelerometer
+ * itself is never slowed down, and must be started for the gate to work.
+ */
+class Nano33BLEMotionGate
+{
+  public:
+    /**
+     * @brief Starts the Mbed OS Thread that watches the accelerometer data.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEMotionGate::readFunction, this));
+    }
+
+    Nano33BLEMotionGate(
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_MOTION_GATE_THREAD_STACK_SIZE_BYTES) :
+        accelerometerReader(Accelerometer),
+        sensorCount(0),
+        threshold_g(DEFAULT_MOTION_GATE_THRESHOLD_G),
+        stillTime_ms(DEFAULT_MOTION_GATE_STILL_TIME_MS),
+        stillSlowdown(DEFAULT_MOTION_GATE_STILL_SLOWDOWN),
+        moving(true),
+        baselineValid(false),
+        lastMotion_ms(0),
+        transitionCount(0),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "MotionGate"),
+        readStack("MotionGate", threadSize){};
+
+    /**
+     * @brief Adds a sensor to be slowed down while the board is still, e.g.
+     * MotionGate.attach(Pressure.getScheduler()).
+     * 
+     * @return false if MOTION_GATE_MAX_SENSORS are already attached.
+     */
+    bool attach(Nano33BLEPeriodicScheduler& scheduler);
+    /**
+     * @param threshold_g change in acceleration (sum of all axes, in g) from
+     * the baseline that counts as motion.
+     */
+    void setThreshold(float threshold_g);
+    /**
+     * @param stillTime_ms how long without motion before the board is 
+     * considered still.
+     */
+    void setStillTime(uint32_t stillTime_ms);
+    /**
+     * @param factor how much attached sensors are slowed down by while the
+     * board is still. 0 suspends them.
+     */
+    void setStillSlowdown(uint32_t factor);
+    bool isMoving(void);
+    /**
+     * @return the number of times the gate has changed between moving and
+     * still.
+     */
+    uint32_t getTransitionCount(void);
+    /**
+     * @brief Waits up to 100ms for and processes one accelerometer reading,
+     * then checks the still time. The gate's thread calls this over and
+     * over once begun. It can be called from another thread instead of
+     * calling begin().
+     * 
+     */
+    void read(void);
+
+  private:
+    void setMoving(bool isMoving);
+
+    static void readFunction(Nano33BLEMotionGate *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<Nano33BLEAccelerometerData> accelerometerReader;
+    Nano33BLEPeriodicScheduler* sensors[MOTION_GATE_MAX_SENSORS];
+    uint32_t sensorCount;
+    volatile float threshold_g;
+    volatile uint32_t stillTime_ms;
+    volatile uint32_t stillSlowdown;
+    volatile bool moving;
+    bool baselineValid;
+    Nano33BLEAccelerometerData baseline;
+    uint32_t lastMotion_ms;
+    volatile uint32_t transitionCount;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+extern Nano33BLEMotionGate MotionGate;
+
+#endif /* NANO33BLEMOTIONGATE_H_ */
@@ -0,0 +1,320 @@
+/*
+  Nano33BLEPeriodicScheduler.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements the periodic timing of the sensor read threads.
+  Rather than sleeping for a fixed time after each read (which makes the
+  real period the sleep time plus however long the read took), it sleeps
+  until absolute deadlines calculated from the time the sensor was started.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEPeriodicScheduler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLEPeriodicScheduler::start(void)
+{
+  restart(rtos::Kernel::get_ms_count());
+  this->started_ms = this->epoch_ms;
+  this->poweredSince_ms = this->epoch_ms;
+  this->activeTime_ms = 0;
+  this->powered = true;
+  return;
+}
+
+void Nano33BLEPeriodicScheduler::waitForNextPeriod(void)
+{
+  uint64_t now_ms;
+  uint64_t nextDeadline_ms;
+  uint64_t nextCycle;
+
+  if(this->slowdown == 0U)
+  {
+    /* Suspended until setSlowdown() is called with a non zero factor */
+    this->wakeFlags.wait_any(SCHEDULER_WAKE_FLAG);
+    restart(rtos::Kernel::get_ms_count());
+    /* A duty cycled sensor reads a whole burst from now, rather than once
+     * then sleeping until the burst it would have been in */
+    this->dutyEpoch_ms = this->epoch_ms;
+    return;
+  }
+
+  /*
+   * A new period is applied from the deadline just passed, so changing it
+   * does not cause a jump in timing.
+   */
+  if((this->requestedPeriod_us != this->period_us) ||
+    (this->slowdown != this->activeSlowdown))
+  {
+    restart(getDeadline(this->cycles));
+  }
+
+  /* Duty cycle bursts are timed from the deadline just passed */
+  if(this->dutyCycleChanged)
+  {
+    this->dutyCycleChanged = false;
+    this->burst_ms = this->requestedBurst_ms;
+    this->interval_ms = this->requestedInterval_ms;
+    this->dutyEpoch_ms = getDeadline(this->cycles);
+  }
+
+  this->cycles++;
+  nextDeadline_ms = getDeadline(this->cycles);
+  now_ms = rtos::Kernel::get_ms_count();
+
+  if(now_ms > nextDeadline_ms)
+  {
+    if(this->overrunPolicy == OVERRUN_CATCH_UP)
+    {
+      /* Read again straight away, the next call will check the next deadline */
+      this->overrunCount++;
+      return;
+    }
+
+    /* Skip to the first deadline that is still in the future */
+    nextCycle = (((now_ms - this->epoch_ms) * 1000U) / 
+      ((uint64_t)this->period_us * this->activeSlowdown)) + 1U;
+    this->overrunCount += (uint32_t)(nextCycle - this->cycles);
+    this->cycles = nextCycle;
+    nextDeadline_ms = getDeadline(this->cycles);
+  }
+
+  if((this->interval_ms != 0U) &&
+    (((nextDeadline_ms - this->dutyEpoch_ms) % this->interval_ms) >= this->burst_ms))
+  {
+    /* The next deadline falls between bursts */
+    sleepUntilNextBurst(nextDeadline_ms);
+    return;
+  }
+
+  if(sleepUntil(nextDeadline_ms))
+  {
+    /* Woken early because the reads were sped up. Read now, and time the
+     * following reads from now.
+     */
+    restart(rtos::Kernel::get_ms_count());
+  }
+  return;
+}
+
+void Nano33BLEPeriodicScheduler::setPeriod(uint32_t period_us)
+{
+  if(period_us > 0U)
+  {
+    this->requestedPeriod_us = period_us;
+  }
+  return;
+}
+
+void Nano33BLEPeriodicScheduler::setRate(float rate_Hz)
+{
+  if(rate_Hz > 0.0F)
+  {
+    setPeriod((uint32_t)((1000000.0F / rate_Hz) + 0.5F));
+  }
+  return;
+}
+
+uint32_t Nano33BLEPeriodicScheduler::getPeriod(void)
+{
+  return this->requestedPeriod_us;
+}
+
+float Nano33BLEPeriodicScheduler::getRate(void)
+{
+  return (1000000.0F / this->requestedPeriod_us);
+}
+
+void Nano33BLEPeriodicScheduler::setOverrunPolicy(enum OVERRUN_POLICY policy)
+{
+  this->overrunPolicy = policy;
+  return;
+}
+
+uint32_t Nano33BLEPeriodicScheduler::getOverrunCount(void)
+{
+  return this->overrunCount;
+}
+
+void Nano33BLEPeriodicScheduler::setPowerCallbacks(
+  mbed::Callback<void()> powerDown,
+  mbed::Callback<void()> powerUp,
+  uint32_t wakeUpTime_ms)
+{
+  this->powerDownCallback = powerDown;
+  this->powerUpCallback = powerUp;
+  this->wakeUp_ms = wakeUpTime_ms;
+  return;
+}
+
+void Nano33BLEPeriodicScheduler::setDutyCycle(uint32_t burst_ms, uint32_t interval_ms)
+{
+  if(burst_ms >= interval_ms)
+  {
+    interval_ms = 0;
+  }
+
+  this->requestedBurst_ms = burst_ms;
+  this->requestedInterval_ms = interval_ms;
+  this->dutyCycleChanged = true;
+  return;
+}
+
+uint32_t Nano33BLEPeriodicScheduler::getActiveTime(void)
+{
+  uint32_t activeTime_ms;
+
+  activeTime_ms = this->activeTime_ms;
+  if(this->powered)
+  {
+    activeTime_ms += (uint32_t)(rtos::Kernel::get_ms_count() - this->poweredSince_ms);
+  }
+
+  return activeTime_ms;
+}
+
+float Nano33BLEPeriodicScheduler::getActiveRatio(void)
+{
+  uint64_t elapsed_ms;
+
+  elapsed_ms = rtos::Kernel::get_ms_count() - this->started_ms;
+  if(elapsed_ms == 0U)
+  {
+    return 1.0F;
+  }
+
+  return ((float)getActiveTime() / (float)elapsed_ms);
+}
+
+void Nano33BLEPeriodicScheduler::sleepUntilNextBurst(uint64_t deadline_ms)
+{
+  uint64_t burstStart_ms;
+  uint64_t wakeUpAt_ms;
+  uint64_t now_ms;
+  bool wokenEarly;
+
+  burstStart_ms = deadline_ms - ((deadline_ms - this->dutyEpoch_ms) % this->interval_ms) 
+    + this->interval_ms;
+
+  now_ms = rtos::Kernel::get_ms_count();
+  if(this->powerDownCallback)
+  {
+    this->powerDownCallback();
+  }
+  this->activeTime_ms += (uint32_t)(now_ms - this->poweredSince_ms);
+  this->powered = false;
+
+  /* Wake the sensor just early enough for its first reading of the burst
+   * to be ready: its wake up time plus one read period.
+   */
+  wakeUpAt_ms = burstStart_ms - this->wakeUp_ms - (this->period_us / 1000U);
+  wokenEarly = sleepUntil(wakeUpAt_ms);
+  if(wokenEarly)
+  {
+    /* The reads were sped up (e.g. a Nano33BLEMotionGate saw motion), so
+     * the burst starts as soon as the sensor is awake rather than at the
+     * next interval.
+     */
+    burstStart_ms = rtos::Kernel::get_ms_count() + this->wakeUp_ms;
+  }
+
+  this->poweredSince_ms = rtos::Kernel::get_ms_count();
+  this->powered = true;
+  if(this->powerUpCallback)
+  {
+    this->powerUpCallback();
+  }
+  if(sleepUntil(burstStart_ms))
+  {
+    wokenEarly = true;
+    burstStart_ms = rtos::Kernel::get_ms_count();
+  }
+
+  /* An early burst starts the duty cycle again from itself */
+  if(wokenEarly)
+  {
+    this->dutyEpoch_ms = burstStart_ms;
+  }
+  /* Reads in the burst are timed from its start */
+  restart(burstStart_ms);
+  return;
+}
+
+void Nano33BLEPeriodicScheduler::setSlowdown(uint32_t factor)
+{
+  uint32_t previousFactor;
+
+  previousFactor = this->slowdown;
+  this->slowdown = factor;
+
+  if((factor != 0U) && ((previousFactor == 0U) || (factor < previousFactor)))
+  {
+    this->wakeFlags.set(SCHEDULER_WAKE_FLAG);
+  }
+  return;
+}
+
+uint32_t Nano33BLEPeriodicScheduler::getSlowdown(void)
+{
+  return this->slowdown;
+}
+
+uint64_t Nano33BLEPeriodicScheduler::getDeadline(uint64_t cycle)
+{
+  return this->epoch_ms + 
+    ((cycle * this->period_us * this->activeSlowdown) / 1000U);
+}
+
+void Nano33BLEPeriodicScheduler::restart(uint64_t now_ms)
+{
+  /* The slowdown is applied here, so a wake for it is no longer needed.
+   * Cleared first, so a setSlowdown() from now on wakes the next sleep.
+   */
+  this->wakeFlags.clear(SCHEDULER_WAKE_FLAG);
+  this->epoch_ms = now_ms;
+  this->cycles = 0;
+  this->period_us = this->requestedPeriod_us;
+  this->activeSlowdown = this->slowdown;
+  return;
+}
+
+bool Nano33BLEPeriodicScheduler::sleepUntil(uint64_t deadline_ms)
+{
+  uint64_t now_ms;
+  uint32_t flags;
+
+  now_ms = rtos::Kernel::get_ms_count();
+  if(deadline_ms <= now_ms)
+  {
+    return false;
+  }
+
+  /* Sleeps like sleep_until(), but can be woken early by setSlowdown() */
+  flags = this->wakeFlags.wait_any(SCHEDULER_WAKE_FLAG, (uint32_t)(deadline_ms - now_ms));
+  return ((flags & osFlagsError) == 0U);
+}
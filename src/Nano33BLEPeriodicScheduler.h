@@ -0,0 +1,222 @@
+/*
+  Nano33BLEPeriodicScheduler.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements the periodic timing of the sensor read threads.
+  Rather than sleeping for a fixed time after each read (which makes the
+  real period the sleep time plus however long the read took), it sleeps
+  until absolute deadlines calculated from the time the sensor was started.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEPERIODICSCHEDULER_H_
+#define NANO33BLEPERIODICSCHEDULER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Thread.h"
+#include "EventFlags.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define SCHEDULER_WAKE_FLAG     (0x01U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class keeps a sensor read thread on a fixed period. Deadlines
+ * are calculated as epoch + (cycles * period), so time spent reading the
+ * sensor and scheduling delays do not accumulate. The period is kept in
+ * microseconds so rates that are not a whole number of milliseconds (e.g.
+ * 119Hz) are still met on average.
+ *
+ * The scheduler can also duty cycle the sensor: reads only happen during a
+ * burst at the start of each duty cycle interval, and the sensor is powered
+ * down for the rest of the interval.
+ *
+ * Reads can also be slowed down or suspended with setSlowdown(), e.g. by a
+ * Nano33BLEMotionGate while the board is still.
+ */
+class Nano33BLEPeriodicScheduler
+{
+  public:
+    /**
+     * What to do when a deadline has already passed by the time the
+     * thread is ready to wait for it.
+     */
+    enum OVERRUN_POLICY
+    {
+      /* Drop the missed deadlines and wait for the next one in the future */
+      OVERRUN_SKIP,
+      /* Return immediately for each missed deadline until caught up */
+      OVERRUN_CATCH_UP
+    };
+
+    Nano33BLEPeriodicScheduler(
+      uint32_t period_ms,
+      enum OVERRUN_POLICY policy = OVERRUN_SKIP) :
+        epoch_ms(0),
+        cycles(0),
+        period_us(period_ms * 1000U),
+        requestedPeriod_us(period_ms * 1000U),
+        overrunPolicy(policy),
+        overrunCount(0),
+        slowdown(1),
+        activeSlowdown(1),
+        dutyEpoch_ms(0),
+        burst_ms(0),
+        interval_ms(0),
+        requestedBurst_ms(0),
+        requestedInterval_ms(0),
+        dutyCycleChanged(false),
+        wakeUp_ms(0),
+        started_ms(0),
+        poweredSince_ms(0),
+        activeTime_ms(0),
+        powered(true){};
+
+    /**
+     * @brief Sets the epoch that all deadlines are calculated from to now.
+     *
+     */
+    void start(void);
+    /**
+     * @brief Sleeps the calling thread until the next deadline. Must only
+     * be called from the thread being scheduled.
+     *
+     */
+    void waitForNextPeriod(void);
+    /**
+     * @brief Sets the period. This can be called from any thread, and
+     * takes effect from the next deadline.
+     *
+     * @param period_us the new period in microseconds.
+     */
+    void setPeriod(uint32_t period_us);
+    /**
+     * @brief Sets the period from a rate. Rates of 0 or less are ignored.
+     *
+     * @param rate_Hz the new rate in Hz.
+     */
+    void setRate(float rate_Hz);
+    /**
+     * @return the period in microseconds.
+     */
+    uint32_t getPeriod(void);
+    /**
+     * @return the rate in Hz.
+     */
+    float getRate(void);
+    void setOverrunPolicy(enum OVERRUN_POLICY policy);
+    /**
+     * @return the number of deadlines that had already passed when the
+     * thread was ready to wait for them.
+     */
+    uint32_t getOverrunCount(void);
+    /**
+     * @brief Sets the functions used to power the sensor down between duty
+     * cycle bursts and back up again before the next burst. This is done by
+     * the sensor itself before it is started.
+     *
+     * @param powerDown powers the sensor down. May be empty.
+     * @param powerUp powers the sensor up. May be empty.
+     * @param wakeUpTime_ms how long the sensor takes to start converting
+     * once powered up. The sensor is powered up this long plus one read
+     * period before each burst, so the first read of a burst gets new data.
+     */
+    void setPowerCallbacks(
+      mbed::Callback<void()> powerDown,
+      mbed::Callback<void()> powerUp,
+      uint32_t wakeUpTime_ms);
+    /**
+     * @brief Duty cycles the sensor. Every interval_ms the sensor is read as
+     * normal for burst_ms, then powered down until just before the next
+     * burst. This can be called from any thread, and takes effect from the
+     * next deadline.
+     *
+     * @param burst_ms how long each burst of reads lasts.
+     * @param interval_ms the time from the start of one burst to the start
+     * of the next. 0, or a burst_ms of interval_ms or more, turns duty
+     * cycling off.
+     */
+    void setDutyCycle(uint32_t burst_ms, uint32_t interval_ms);
+    /**
+     * @return how long the sensor has been powered up since it was started.
+     * This is an estimate, as it assumes the sensor draws no power while
+     * powered down.
+     */
+    uint32_t getActiveTime(void);
+    /**
+     * @return the fraction of the time since the sensor was started that
+     * it has been powered up.
+     */
+    float getActiveRatio(void);
+    /**
+     * @brief Slows the reads down by a factor. This can be called from any
+     * thread. If the reads are made faster, the sleeping thread is woken
+     * and reads straight away rather than waiting out a slow period. If
+     * the sensor is duty cycled and powered down between bursts, a burst
+     * starts as soon as the sensor has woken up.
+     *
+     * @param factor the period is multiplied by this. 1 is full rate, and 0
+     * suspends the reads completely.
+     */
+    void setSlowdown(uint32_t factor);
+    uint32_t getSlowdown(void);
+
+  private:
+    uint64_t getDeadline(uint64_t cycle);
+    void restart(uint64_t now_ms);
+    bool sleepUntil(uint64_t deadline_ms);
+    void sleepUntilNextBurst(uint64_t deadline_ms);
+
+    uint64_t epoch_ms;
+    uint64_t cycles;
+    uint32_t period_us;
+    volatile uint32_t requestedPeriod_us;
+    volatile enum OVERRUN_POLICY overrunPolicy;
+    uint32_t overrunCount;
+
+    volatile uint32_t slowdown;
+    uint32_t activeSlowdown;
+    rtos::EventFlags wakeFlags;
+
+    uint64_t dutyEpoch_ms;
+    uint32_t burst_ms;
+    uint32_t interval_ms;
+    volatile uint32_t requestedBurst_ms;
+    volatile uint32_t requestedInterval_ms;
+    volatile bool dutyCycleChanged;
+    mbed::Callback<void()> powerDownCallback;
+    mbed::Callback<void()> powerUpCallback;
+    uint32_t wakeUp_ms;
+    uint64_t started_ms;
+    volatile uint64_t poweredSince_ms;
+    volatile uint32_t activeTime_ms;
+    volatile bool powered;
+};
+
+#endif /* NANO33BLEPERIODICSCHEDULER_H_ */
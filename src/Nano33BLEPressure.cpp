@@ -26,14 +26,51 @@
 /*****************************************************************************/
 #include "Nano33BLEPressure.h"
 #include <Arduino_LPS22HB.h>
+#include "Nano33BLEI2CDevice.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* LPS22HB FIFO control. Stream mode keeps the newest 32 samples */
+#define LPS22HB_FIFO_CTRL                 (0x14U)
+#define LPS22HB_FIFO_CTRL_BYPASS          (0x00U)
+#define LPS22HB_FIFO_CTRL_STREAM          (0x40U)
+/* LPS22HB control register 1: ODR, low pass filter and block data update */
+#define LPS22HB_CTRL_REG1                 (0x10U)
+#define LPS22HB_CTRL_REG1_ODR_MASK        (0x70U)
+#define LPS22HB_CTRL_REG1_ODR_SHIFT       (4U)
+#define LPS22HB_CTRL_REG1_EN_LPFP         (0x08U)
+#define LPS22HB_CTRL_REG1_LPFP_CFG        (0x04U)
+#define LPS22HB_CTRL_REG1_BDU             (0x02U)
+/* LPS22HB control register 2 */
+#define LPS22HB_CTRL_REG2                 (0x11U)
+#define LPS22HB_CTRL_REG2_FIFO_EN         (0x40U)
+#define LPS22HB_CTRL_REG2_IF_ADD_INC      (0x10U)
+#define LPS22HB_CTRL_REG2_ONE_SHOT        (0x01U)
+#define LPS22HB_FIFO_STATUS               (0x26U)
+#define LPS22HB_FIFO_STATUS_OVR           (0x40U)
+#define LPS22HB_FIFO_STATUS_FSS_MASK      (0x3FU)
+#define LPS22HB_STATUS                    (0x27U)
+#define LPS22HB_STATUS_P_DA               (0x01U)
+#define LPS22HB_STATUS_T_DA               (0x02U)
+/* 
+ * Pressure (3 bytes) then temperature (2 bytes), low byte first. With the
+ * FIFO enabled the address rolls back from the last of these to the first,
+ * so the whole FIFO can be read in one burst.
+ */
+#define LPS22HB_PRESS_OUT_XL              (0x28U)
+#define LPS22HB_SAMPLE_SIZE               (5U)
+/* Reading this register restarts the low pass filter */
+#define LPS22HB_LPFP_RES                  (0x33U)
+/* 4096 LSB/hPa, and 100 LSB/degree */
+#define LPS22HB_LSB_PER_KPA               (40960.0F)
+#define LPS22HB_LSB_PER_CELSIUS           (100.0F)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
 /*****************************************************************************/
+/* LPS22HB continuous output data rates in Hz. Index + 1 is the ODR code */
+static const float pressureOutputDataRates[] = {1.0F, 10.0F, 25.0F, 50.0F, 75.0F};
 
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
@@ -50,14 +87,14 @@
  */
 void Nano33BLEPressure::init()
 {
-  /* default setup has all sensors active in continous mode. Sample rates
-   *  are as follows: accelerationSampleRate = 109Hz 
-   */
   if (!BARO.begin())
   {
     /* Something went wrong... Put this thread to sleep indefinetely. */
     osSignalWait(0x0001, osWaitForever);
   }
+
+  setOutputDataRate(this->requestedRate_Hz);
+  configure();
   return;
 }
 
@@ -80,16 +117,236 @@ void Nano33BLEPressure::read(void)
    * once here.
    */
   Nano33BLEPressureData data;
+  Nano33BLEI2CDevice baro(LPS22HB_ADDRESS);
+  uint8_t status;
+  uint8_t output[LPS22HB_SAMPLE_SIZE];
+
+  /* Settings changed by setOutputDataRate() or setLowPassFilter() */
+  if(this->configPending)
+  {
+    configure();
+  }
+
+  if(!this->oneShot)
+  {
+    readFifo();
+    return;
+  }
+
+  /* Only read once both values are ready, and read them in one burst */
+  if(baro.readRegister(LPS22HB_STATUS, status) &&
+    ((status & (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) == 
+      (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) &&
+    baro.readRegisters(LPS22HB_PRESS_OUT_XL, output, sizeof(output)))
+  {
+    convert(output, data);
+    publish(data);
+  }
 
+  /* Start the conversion for the next read, so it is ready by then */
+  baro.writeRegister(LPS22HB_CTRL_REG2, LPS22HB_CTRL_REG2_IF_ADD_INC | LPS22HB_CTRL_REG2_ONE_SHOT);
+  return;
+}
 
-  data.barometricPressure = BARO.readPressure();
-  data.timeStampMs = millis();
-  push(data);
+float Nano33BLEPressure::setOutputDataRate(float rate_Hz)
+{
+  const uint32_t rateCount = 
+    sizeof(pressureOutputDataRates)/sizeof(pressureOutputDataRates[0]);
+  uint32_t ii;
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+  this->requestedRate_Hz = rate_Hz;
+  if(rate_Hz < pressureOutputDataRates[0])
+  {
+    /* One shot conversions, triggered by each read, so the LPS22HB does no
+     * more conversions than needed and only the read period needs 
+     * changing.
+     */
+    this->scheduler.setRate(rate_Hz);
+    this->pendingOneShot = true;
+    this->pendingOutputDataRateCode = 0;
+    this->pendingOutputDataRate = this->scheduler.getRate();
+  }
+  else
+  {
+    /* Find the slowest supported rate that is at least as fast as requested */
+    for(ii = 0; ii < (rateCount - 1); ii++)
+    {
+      if(pressureOutputDataRates[ii] >= rate_Hz)
+      {
+        break;
+      }
+    }
+
+    this->pendingOneShot = false;
+    this->pendingOutputDataRateCode = (uint8_t)(ii + 1U);
+    this->pendingOutputDataRate = pressureOutputDataRates[ii];
+    /* Drained often enough that samples are never older than the latency */
+    if(pressureOutputDataRates[ii] > (1000.0F / PRESSURE_FIFO_MAX_LATENCY_MS))
+    {
+      this->scheduler.setRate(1000.0F / PRESSURE_FIFO_MAX_LATENCY_MS);
+    }
+    else
+    {
+      this->scheduler.setRate(pressureOutputDataRates[ii]);
+    }
+  }
+
+  /* The read thread writes it to the sensor */
+  this->configPending = true;
+  return this->pendingOutputDataRate;
+}
+
+void Nano33BLEPressure::setLowPassFilter(enum PRESSURE_LPF filter)
+{
+  /* The read thread writes it to the sensor */
+  this->lowPassFilter = filter;
+  this->configPending = true;
+  return;
+}
+
+uint32_t Nano33BLEPressure::getFifoOverrunCount(void)
+{
+  return this->fifoOverrunCount;
+}
+
+void Nano33BLEPressure::powerDown(void)
+{
+  Nano33BLEI2CDevice baro(LPS22HB_ADDRESS);
+
+  /* In one shot mode it is already powered down between conversions */
+  if(!this->oneShot)
+  {
+    baro.updateRegister(LPS22HB_CTRL_REG1, LPS22HB_CTRL_REG1_ODR_MASK, 0);
+  }
+  return;
+}
+
+void Nano33BLEPressure::powerUp(void)
+{
+  Nano33BLEI2CDevice baro(LPS22HB_ADDRESS);
+
+  if(!this->oneShot)
+  {
+    baro.updateRegister(
+      LPS22HB_CTRL_REG1, 
+      LPS22HB_CTRL_REG1_ODR_MASK, 
+      (uint8_t)(this->outputDataRateCode << LPS22HB_CTRL_REG1_ODR_SHIFT));
+    /* Sampling restarts, so the time stamps do too */
+    this->fifoTimeValid = false;
+  }
+  return;
+}
+
+void Nano33BLEPressure::readFifo(void)
+{
+  Nano33BLEPressureData data;
+  Nano33BLEI2CDevice baro(LPS22HB_ADDRESS);
+  uint8_t fifo[PRESSURE_FIFO_SIZE * LPS22HB_SAMPLE_SIZE];
+  uint8_t status;
+  uint32_t level;
+  uint32_t now_ms;
+  uint32_t newest_ms;
+  float period_ms;
+  uint32_t ii;
+
+  if(!baro.readRegister(LPS22HB_FIFO_STATUS, status))
+  {
+    return;
+  }
+
+  if((status & LPS22HB_FIFO_STATUS_OVR) != 0U)
+  {
+    this->fifoOverrunCount++;
+  }
+
+  level = status & LPS22HB_FIFO_STATUS_FSS_MASK;
+  if(level > PRESSURE_FIFO_SIZE)
+  {
+    level = PRESSURE_FIFO_SIZE;
+  }
+  if((level == 0U) || 
+    !baro.readRegisters(LPS22HB_PRESS_OUT_XL, fifo, level * LPS22HB_SAMPLE_SIZE))
+  {
+    return;
+  }
+
+  /* 
+   * The samples are one period apart, carrying on from the newest sample
+   * of the last read. The newest sample was taken in the last period, so
+   * if that puts it anywhere else (e.g. samples were lost) it is taken as
+   * now instead.
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  now_ms = millis();
+  period_ms = 1000.0F / this->outputDataRate;
+  newest_ms = this->lastSample_ms + (uint32_t)(level * period_ms);
+  if(!this->fifoTimeValid || ((int32_t)(now_ms - newest_ms) < 0) ||
+    ((float)(now_ms - newest_ms) >= period_ms))
+  {
+    newest_ms = now_ms;
+  }
+  for(ii = 0; ii < level; ii++)
+  {
+    convert(&fifo[ii * LPS22HB_SAMPLE_SIZE], data);
+    publish(data, newest_ms - (uint32_t)(((level - 1U) - ii) * period_ms));
+  }
+  this->lastSample_ms = newest_ms;
+  this->fifoTimeValid = true;
+  return;
+}
+
+void Nano33BLEPressure::configure(void)
+{
+  Nano33BLEI2CDevice baro(LPS22HB_ADDRESS);
+  uint8_t control;
+  uint8_t reset;
+
+  /* Cleared first, so a change made while writing is written next time */
+  this->configPending = false;
+  this->oneShot = this->pendingOneShot;
+  this->outputDataRateCode = this->pendingOutputDataRateCode;
+  this->outputDataRate = this->pendingOutputDataRate;
+  this->fifoTimeValid = false;
+
+  control = (uint8_t)(this->outputDataRateCode << LPS22HB_CTRL_REG1_ODR_SHIFT) | 
+    LPS22HB_CTRL_REG1_BDU;
+  if(this->lowPassFilter != PRESSURE_LPF_OFF)
+  {
+    control |= LPS22HB_CTRL_REG1_EN_LPFP;
+  }
+  if(this->lowPassFilter == PRESSURE_LPF_ODR_20)
+  {
+    control |= LPS22HB_CTRL_REG1_LPFP_CFG;
+  }
+
+  /* Bypass mode empties the FIFO of samples taken with the old settings */
+  baro.writeRegister(LPS22HB_FIFO_CTRL, LPS22HB_FIFO_CTRL_BYPASS);
+  baro.writeRegister(LPS22HB_CTRL_REG1, control);
+  baro.readRegister(LPS22HB_LPFP_RES, reset);
+
+  if(this->oneShot)
+  {
+    baro.writeRegister(LPS22HB_CTRL_REG2, LPS22HB_CTRL_REG2_IF_ADD_INC | LPS22HB_CTRL_REG2_ONE_SHOT);
+  }
+  else
+  {
+    baro.writeRegister(LPS22HB_CTRL_REG2, LPS22HB_CTRL_REG2_IF_ADD_INC | LPS22HB_CTRL_REG2_FIFO_EN);
+    baro.writeRegister(LPS22HB_FIFO_CTRL, LPS22HB_FIFO_CTRL_STREAM);
+  }
+  return;
+}
+
+void Nano33BLEPressure::convert(const uint8_t* output, Nano33BLEPressureData& data)
+{
+  int32_t pressure;
+  int16_t temperature;
+
+  /* 24 bit two's complement, sign extended through the top byte */
+  pressure = (int32_t)(((uint32_t)output[2] << 24) | ((uint32_t)output[1] << 16) | 
+    ((uint32_t)output[0] << 8)) >> 8;
+  temperature = (int16_t)((output[4] << 8) | output[3]);
+
+  data.barometricPressure = pressure / LPS22HB_LSB_PER_KPA;
+  data.temperatureCelsius = temperature / LPS22HB_LSB_PER_CELSIUS;
   return;
 }
 
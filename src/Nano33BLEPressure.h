@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -43,6 +43,14 @@
  */
 #define DEFAULT_PRESSURE_READ_PERIOD_MS                (40U)
 #define DEFAULT_PRESSURE_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* 
+ * In continuous mode the LPS22HB FIFO is drained at least this often (or
+ * every sample, if they are further apart), so no sample is older than
+ * this when it is published.
+ */
+#define PRESSURE_FIFO_MAX_LATENCY_MS                   (100U)
+/* The LPS22HB FIFO depth, and the most samples read in one I2C burst */
+#define PRESSURE_FIFO_SIZE                             (32U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -60,9 +68,33 @@
 class Nano33BLEPressureData
 {
   public:
+    /* In kPa */
     float barometricPressure;
+    /* The LPS22HB die temperature. It runs a little warmer than the air */
+    float temperatureCelsius;
     uint32_t timeStampMs;
 };
+
+/**
+ * Gives generic access to the values in Nano33BLEPressureData.
+ * Channels in order: barometricPressure, temperatureCelsius.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEPressureData>
+{
+  public:
+    enum { CHANNEL_COUNT = 2 };
+    static float get(const Nano33BLEPressureData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.barometricPressure;
+        default:
+          return (float)data.temperatureCelsius;
+      }
+    }
+};
 /**
  * This class declares the init and read functions your sensor will use to 
  * initialise the sensor and get the data. All you have to do is change the
@@ -70,29 +102,86 @@ class Nano33BLEPressureData
  * (currently "Nano33BLEPressure"), and update the 
  * "Nano33BLEPressureData" name to the name you defined in 
  * the section above.
+ * 
+ * The LPS22HB is configured directly. At 1Hz and above it converts 
+ * continuously into its FIFO, optionally through its low pass filter, and
+ * the FIFO is drained in one I2C burst every PRESSURE_FIFO_MAX_LATENCY_MS
+ * (or every sample at 1Hz). Each sample is time stamped with when it was
+ * taken. Below 1Hz 
+ * it converts once per read (one shot) and powers down in between.
  */
-class Nano33BLEPressure: public Nano33BLESensorBuffer<Nano33BLEPressureData>
+class Nano33BLEPressure: public Nano33BLESensor<Nano33BLEPressure, Nano33BLEPressureData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEPressure::readFunction, this));
-    }
-
     Nano33BLEPressure(
       uint32_t readPeriod_ms = DEFAULT_PRESSURE_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_PRESSURE_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEPressure, Nano33BLEPressureData>(
+          "Pressure",
+          TRACE_ID_PRESSURE,
+          readPeriod_ms,
+          0U,
+          threadPriority,
+          threadSize),
+        requestedRate_Hz(1000.0F / readPeriod_ms),
+        configPending(false),
+        pendingOneShot(true),
+        pendingOutputDataRate(0.0F),
+        pendingOutputDataRateCode(0),
+        lowPassFilter(PRESSURE_LPF_ODR_9),
+        oneShot(true),
+        outputDataRate(0.0F),
+        outputDataRateCode(0),
+        fifoOverrunCount(0),
+        fifoTimeValid(false),
+        lastSample_ms(0){};
+
+    /**
+     * Bandwidths of the LPS22HB low pass filter, as a fraction of the 
+     * output data rate. It has no effect on one shot conversions.
+     */
+    enum PRESSURE_LPF
+    {
+      PRESSURE_LPF_OFF,
+      PRESSURE_LPF_ODR_9,
+      PRESSURE_LPF_ODR_20
+    };
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running. The read thread writes
+     * it to the LPS22HB before its next read.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the closest rate
+     * the LPS22HB supports (1Hz, 10Hz, 25Hz, 50Hz or 75Hz) that is not 
+     * slower than rate_Hz, and the FIFO is read every 
+     * PRESSURE_FIFO_MAX_LATENCY_MS, or every sample at 1Hz. Rates below 
+     * 1Hz use one shot conversions at exactly rate_Hz.
+     */
+    float setOutputDataRate(float rate_Hz);
+    /**
+     * @brief Sets the bandwidth of the LPS22HB's low pass filter. The
+     * filter is restarted, so the first few samples after a change settle.
+     * This can be called at any time, including while the sensor thread 
+     * is running. The read thread writes it to the LPS22HB before its next
+     * read.
+     *
+     */
+    void setLowPassFilter(enum PRESSURE_LPF filter);
+    /**
+     * @return the number of FIFO reads that found the LPS22HB FIFO had 
+     * overflowed since the read before. Each counts once, however many 
+     * samples were lost, and the samples after the gap are time stamped
+     * from when they were read.
+     */
+    uint32_t getFifoOverrunCount(void);
+
   private:
+    friend class Nano33BLESensor<Nano33BLEPressure, Nano33BLEPressureData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -104,17 +193,45 @@ class Nano33BLEPressure: public Nano33BLESensorBuffer<Nano33BLEPressureData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Drains the FIFO in continuous mode.
+     * 
+     */
+    void readFifo(void);
+    /**
+     * @brief Writes the output data rate and low pass filter settings.
+     * Only called from init() and the read thread, so it never writes
+     * while the FIFO is being read.
+     * 
+     */
+    void configure(void);
+    void convert(const uint8_t* output, Nano33BLEPressureData& data);
 
-    static void readFunction(Nano33BLEPressure *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    float requestedRate_Hz;
+    /* Settings from the setters, written by the read thread */
+    volatile bool configPending;
+    volatile bool pendingOneShot;
+    volatile float pendingOutputDataRate;
+    volatile uint8_t pendingOutputDataRateCode;
+    volatile enum PRESSURE_LPF lowPassFilter;
+    /* The settings the LPS22HB is running with */
+    bool oneShot;
+    float outputDataRate;
+    uint8_t outputDataRateCode;
+    uint32_t fifoOverrunCount;
+    /* The time stamp of the newest sample read from the FIFO */
+    bool fifoTimeValid;
+    uint32_t lastSample_ms;
 };
 
 extern Nano33BLEPressure Pressure;
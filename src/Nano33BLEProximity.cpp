@@ -26,10 +26,14 @@
 /*****************************************************************************/
 #include "Nano33BLEProximity.h"
 #include <Arduino_APDS9960.h>
+#include "Nano33BLEI2CDevice.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* APDS9960 enable register. Each engine has its own enable bit */
+#define APDS9960_ENABLE                   (0x80U)
+#define APDS9960_ENABLE_PEN               (0x04U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -86,14 +90,38 @@ void Nano33BLEProximity::read(void)
   if (APDS.proximityAvailable())
   {
     data.proximity = APDS.readProximity();
-    data.timeStampMs = millis();
-    push(data);
+    publish(data);
   }
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
+  return;
+}
+
+float Nano33BLEProximity::setOutputDataRate(float rate_Hz)
+{
+  /* The APDS9960 proximity engine has no rate register. Only the read period
+   * can be changed.
    */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+  this->scheduler.setRate(rate_Hz);
+  return this->scheduler.getRate();
+}
+
+void Nano33BLEProximity::powerDown(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  /* 
+   * Only the proximity engine is turned off. The APDS9960 itself stays powered
+   * as the other engines may still be in use by other sensor classes.
+   */
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_PEN, 0);
+  return;
+}
+
+void Nano33BLEProximity::powerUp(void)
+{
+  Nano33BLEI2CDevice apds(APDS9960_ADDRESS);
+
+  apds.updateRegister(APDS9960_ENABLE, APDS9960_ENABLE_PEN, APDS9960_ENABLE_PEN);
   return;
 }
 
@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -49,6 +49,8 @@
  */
 #define DEFAULT_PROXIMITY_READ_PERIOD_MS                (40U)
 #define DEFAULT_PROXIMITY_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* APDS9960 proximity engine start up time, used when duty cycling the sensor */
+#define PROXIMITY_WAKE_UP_TIME_MS                    (6U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -70,6 +72,22 @@ class Nano33BLEProximityData
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLEProximityData.
+ * Channels in order: proximity.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLEProximityData>
+{
+  public:
+    enum { CHANNEL_COUNT = 1 };
+    static float get(const Nano33BLEProximityData& data, uint32_t channel)
+    {
+      (void)channel;
+      return (float)data.proximity;
+    }
+};
+
 /**
  * This class declares the init and read functions your sensor will use to 
  * initialise the sensor and get the data. All you have to do is change the
@@ -78,28 +96,37 @@ class Nano33BLEProximityData
  * "Nano33BLEYOURDATACLASSNAMEHERE" name to the name you defined in 
  * the section above.
  */
-class Nano33BLEProximity: public Nano33BLESensorBuffer<Nano33BLEProximityData>
+class Nano33BLEProximity: public Nano33BLESensor<Nano33BLEProximity, Nano33BLEProximityData>
 {
   public:
-   /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLEProximity::readFunction, this));
-    }
-
     Nano33BLEProximity(
       uint32_t readPeriod_ms = DEFAULT_PROXIMITY_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_PROXIMITY_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLEProximity, Nano33BLEProximityData>(
+          "Proximity",
+          TRACE_ID_PROXIMITY,
+          readPeriod_ms,
+          PROXIMITY_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * rate the proximity sensor is read at. The APDS9960
+     * proximity engine has no rate register, so only the read period is
+     * changed.
+     */
+    float setOutputDataRate(float rate_Hz);
+
   private:
+    friend class Nano33BLESensor<Nano33BLEProximity, Nano33BLEProximityData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -111,17 +138,17 @@ class Nano33BLEProximity: public Nano33BLESensorBuffer<Nano33BLEProximityData>
      * 
      */
     void read(void);
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
 
-    static void readFunction(Nano33BLEProximity *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
 };
 
 extern Nano33BLEProximity Proximity;
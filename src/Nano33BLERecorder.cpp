@@ -0,0 +1,218 @@
+/*
+  Nano33BLERecorder.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class records every piece of data pushed by the sensors into a
+  trace, and replays a trace back through the same sensor classes, so a
+  session captured in the field can be re-run through the full pipeline
+  on the bench.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLERecorder.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLERecorder Recorder;
+Nano33BLEReplay Replay;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLERecorder::begin(Nano33BLELogger& log)
+{
+  if(this->attachedLog != &log)
+  {
+    if(!log.attach(*this))
+    {
+      return;
+    }
+    this->attachedLog = &log;
+  }
+  this->traceLog = &log;
+  TraceSink = this;
+  return;
+}
+
+void Nano33BLERecorder::end(void)
+{
+  if(TraceSink == this)
+  {
+    TraceSink = NULL;
+  }
+  this->traceLog = NULL;
+  return;
+}
+
+void Nano33BLERecorder::trace(uint8_t traceId, const void* data, uint32_t size)
+{
+  struct Record* record;
+  uint32_t timeStamp_ms;
+
+  if((this->traceLog == NULL) || 
+    ((size + TRACE_TIME_STAMP_SIZE_BYTES) > RECORDER_MAX_RECORD_SIZE_BYTES))
+  {
+    this->droppedCount++;
+    return;
+  }
+
+  timeStamp_ms = (uint32_t)rtos::Kernel::get_ms_count();
+  this->queueMutex.lock();
+  if(this->queued >= RECORDER_QUEUE_SIZE)
+  {
+    this->queueMutex.unlock();
+    this->droppedCount++;
+    return;
+  }
+
+  record = &this->queue[(this->head + this->queued) % RECORDER_QUEUE_SIZE];
+  record->traceId = traceId;
+  record->size = (uint8_t)(size + TRACE_TIME_STAMP_SIZE_BYTES);
+  memcpy(&record->data[0], &timeStamp_ms, TRACE_TIME_STAMP_SIZE_BYTES);
+  memcpy(&record->data[TRACE_TIME_STAMP_SIZE_BYTES], data, size);
+  this->queued++;
+  this->queueMutex.unlock();
+  return;
+}
+
+uint32_t Nano33BLERecorder::drain(Nano33BLELogger& logger)
+{
+  struct Record record;
+  uint32_t count;
+
+  /* Only the last logger begun with takes the records */
+  if(&logger != this->attachedLog)
+  {
+    return 0;
+  }
+
+  count = 0;
+  while(1)
+  {
+    /* Copied out so the log is written without holding up the sensors */
+    this->queueMutex.lock();
+    if(this->queued == 0U)
+    {
+      this->queueMutex.unlock();
+      break;
+    }
+    record = this->queue[this->head];
+    this->head = (this->head + 1U) % RECORDER_QUEUE_SIZE;
+    this->queued--;
+    this->queueMutex.unlock();
+
+    if(logger.append(record.traceId, record.data, record.size))
+    {
+      this->recordedCount++;
+      count++;
+    }
+    else
+    {
+      this->droppedCount++;
+    }
+  }
+  return count;
+}
+
+uint32_t Nano33BLERecorder::getRecordedCount(void)
+{
+  return this->recordedCount;
+}
+
+uint32_t Nano33BLERecorder::getDroppedCount(void)
+{
+  return this->droppedCount;
+}
+
+bool Nano33BLEReplay::attach(Nano33BLETraceTarget& target)
+{
+  if(this->targetCount >= REPLAY_MAX_TARGETS)
+  {
+    return false;
+  }
+
+  this->targets[this->targetCount] = &target;
+  this->targetCount++;
+  return true;
+}
+
+uint32_t Nano33BLEReplay::replay(Nano33BLELogger& traceLog, float speed)
+{
+  uint8_t record[LOGGER_MAX_RECORD_SIZE_BYTES];
+  uint64_t start_ms;
+  uint32_t firstTimeStamp_ms;
+  uint32_t timeStamp_ms;
+  uint32_t size;
+  uint32_t count;
+  uint32_t ii;
+  uint8_t traceId;
+  bool first;
+  Nano33BLETraceSink* sink;
+
+  count = 0;
+  first = true;
+  firstTimeStamp_ms = 0;
+  /* The replayed pushes must not be recorded, least of all into the log 
+   * being replayed */
+  sink = TraceSink;
+  TraceSink = NULL;
+  start_ms = rtos::Kernel::get_ms_count();
+
+  traceLog.rewind();
+  while((size = traceLog.readNext(traceId, record, sizeof(record))) != 0U)
+  {
+    if((size < TRACE_TIME_STAMP_SIZE_BYTES) || (size > sizeof(record)))
+    {
+      continue;
+    }
+
+    memcpy(&timeStamp_ms, &record[0], TRACE_TIME_STAMP_SIZE_BYTES);
+    if(first)
+    {
+      first = false;
+      firstTimeStamp_ms = timeStamp_ms;
+    }
+
+    /* Keep the recorded spacing, scaled by the speed */
+    if(speed > 0.0F)
+    {
+      rtos::ThisThread::sleep_until(start_ms + 
+        (uint64_t)((float)(timeStamp_ms - firstTimeStamp_ms) / speed));
+    }
+
+    for(ii = 0; ii < this->targetCount; ii++)
+    {
+      if(this->targets[ii]->getTraceId() == traceId)
+      {
+        if(this->targets[ii]->replay(&record[TRACE_TIME_STAMP_SIZE_BYTES], 
+          size - TRACE_TIME_STAMP_SIZE_BYTES))
+        {
+          count++;
+        }
+        break;
+      }
+    }
+  }
+  TraceSink = sink;
+  return count;
+}
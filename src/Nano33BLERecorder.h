@@ -0,0 +1,161 @@
+/*
+  Nano33BLERecorder.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class records every piece of data pushed by the sensors into a
+  trace, and replays a trace back through the same sensor classes, so a
+  session captured in the field can be re-run through the full pipeline
+  on the bench.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLERECORDER_H_
+#define NANO33BLERECORDER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLETrace.h"
+#include "Nano33BLELogger.h"
+#include "Mutex.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Each trace record holds the time pushed (ms) followed by the data */
+#define TRACE_TIME_STAMP_SIZE_BYTES     (4U)
+/* The biggest trace record, time stamp included. Pushes of more data are 
+ * dropped */
+#define RECORDER_MAX_RECORD_SIZE_BYTES  (64U)
+/* How many records can wait for the logger thread. This should hold all
+ * the pushes made in one logger drain period */
+#define RECORDER_QUEUE_SIZE             (32U)
+/* The most sensors a trace can be replayed into */
+#define REPLAY_MAX_TARGETS              (16U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class records every push to every traced sensor buffer into
+ * a Nano33BLELogger, as records tagged with the sensor's trace id and 
+ * holding the time of the push and the data. The pushing sensor's thread 
+ * only copies the record into a queue of RECORDER_QUEUE_SIZE records, and 
+ * the logger's thread drains the queue to the log, so a slow write or a 
+ * flash erase never holds up a sensor. A push made while the queue is full
+ * is dropped and counted.
+ */
+class Nano33BLERecorder: public Nano33BLETraceSink, public Nano33BLELogStream
+{
+  public:
+    Nano33BLERecorder() :
+      traceLog(NULL),
+      attachedLog(NULL),
+      head(0),
+      queued(0),
+      recordedCount(0),
+      droppedCount(0){};
+
+    /**
+     * @brief Starts recording into traceLog, which must already be begun so
+     * its thread drains the records to it (or mounted, with log.drain() 
+     * called to write them).
+     */
+    void begin(Nano33BLELogger& log);
+    /**
+     * @brief Stops recording. Records still queued are written by the next
+     * drain.
+     */
+    void end(void);
+    void trace(uint8_t traceId, const void* data, uint32_t size);
+    /**
+     * @brief Appends the queued records to the log. Called by the logger.
+     * 
+     * @return the number of records appended.
+     */
+    uint32_t drain(Nano33BLELogger& logger);
+    uint32_t getRecordedCount(void);
+    /**
+     * @return the number of pushes that could not be recorded, because the
+     * queue was full, the data was too big or the log could not take it.
+     */
+    uint32_t getDroppedCount(void);
+
+  private:
+    struct Record
+    {
+      uint8_t traceId;
+      uint8_t size;
+      uint8_t data[RECORDER_MAX_RECORD_SIZE_BYTES];
+    };
+
+    Nano33BLELogger* volatile traceLog;
+    /* The logger this is attached to as a stream, which cannot be undone */
+    Nano33BLELogger* attachedLog;
+    struct Record queue[RECORDER_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t queued;
+    rtos::Mutex queueMutex;
+    volatile uint32_t recordedCount;
+    volatile uint32_t droppedCount;
+};
+
+/**
+ * @brief This class replays a trace made by Nano33BLERecorder back into the
+ * sensor classes, at the speed it was recorded or faster. Only sensors 
+ * attached to it are replayed into, and they should not also be begun, so
+ * their own threads do not push real readings.
+ */
+class Nano33BLEReplay
+{
+  public:
+    Nano33BLEReplay() :
+      targetCount(0){};
+
+    /**
+     * @brief Adds a sensor to replay into, e.g. Replay.attach(Accelerometer).
+     * Records are matched to it by its trace id.
+     * 
+     * @return false if REPLAY_MAX_TARGETS are already attached.
+     */
+    bool attach(Nano33BLETraceTarget& target);
+    /**
+     * @brief Replays the whole trace, blocking the calling thread until it 
+     * is done. Tracing is paused while it runs, so the replayed pushes are
+     * not recorded again.
+     * 
+     * @param traceLog the log the trace was recorded into.
+     * @param speed how much faster than recorded to replay, e.g. 1.0 for 
+     * real time or 10.0 for ten times faster. 0 replays as fast as possible.
+     * @return the number of records replayed.
+     */
+    uint32_t replay(Nano33BLELogger& traceLog, float speed = 1.0F);
+
+  private:
+    Nano33BLETraceTarget* targets[REPLAY_MAX_TARGETS];
+    uint32_t targetCount;
+};
+
+extern Nano33BLERecorder Recorder;
+extern Nano33BLEReplay Replay;
+
+#endif /* NANO33BLERECORDER_H_ */
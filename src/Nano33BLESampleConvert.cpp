@@ -0,0 +1,107 @@
+/*
+  Nano33BLESampleConvert.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements block conversion of raw sensor samples, e.g. int16
+  register or microphone samples, to the scaled floats DSP code works on.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESampleConvert.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLESampleConvert::int16ToFloat(
+  const int16_t* input, 
+  float* output, 
+  uint32_t count, 
+  float scale)
+{
+  uint32_t pair[2];
+  uint32_t ii;
+
+  /* Line the input up on a word so the pairs below are single loads */
+  if((count > 0U) && ((((uintptr_t)input) & 0x02U) != 0U))
+  {
+    *output++ = (float)(*input++) * scale;
+    count--;
+  }
+
+  for(ii = 0; (ii + 4U) <= count; ii += 4U)
+  {
+    memcpy(pair, &input[ii], sizeof(pair));
+    /* Little endian: the first sample of each pair is the low half */
+    output[ii + 0U] = (float)((int32_t)(pair[0] << 16) >> 16) * scale;
+    output[ii + 1U] = (float)((int32_t)pair[0] >> 16) * scale;
+    output[ii + 2U] = (float)((int32_t)(pair[1] << 16) >> 16) * scale;
+    output[ii + 3U] = (float)((int32_t)pair[1] >> 16) * scale;
+  }
+
+  for(; ii < count; ii++)
+  {
+    output[ii] = (float)input[ii] * scale;
+  }
+  return;
+}
+
+void Nano33BLESampleConvert::deinterleaveInt16ToFloat(
+  const int16_t* input, 
+  float* const* channels, 
+  uint32_t channelCount, 
+  uint32_t count, 
+  float scale)
+{
+  const int16_t* sample;
+  float* output;
+  uint32_t channel;
+  uint32_t ii;
+
+  for(channel = 0; channel < channelCount; channel++)
+  {
+    output = channels[channel];
+    if(output == NULL)
+    {
+      continue;
+    }
+
+    sample = &input[channel];
+    for(ii = 0; (ii + 4U) <= count; ii += 4U)
+    {
+      output[ii + 0U] = (float)sample[0] * scale;
+      output[ii + 1U] = (float)sample[channelCount] * scale;
+      output[ii + 2U] = (float)sample[2U * channelCount] * scale;
+      output[ii + 3U] = (float)sample[3U * channelCount] * scale;
+      sample += 4U * channelCount;
+    }
+    for(; ii < count; ii++)
+    {
+      output[ii] = (float)sample[0] * scale;
+      sample += channelCount;
+    }
+  }
+  return;
+}
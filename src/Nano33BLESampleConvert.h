@@ -0,0 +1,74 @@
+/*
+  Nano33BLESampleConvert.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements block conversion of raw sensor samples, e.g. int16
+  register or microphone samples, to the scaled floats DSP code works on.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESAMPLECONVERT_H_
+#define NANO33BLESAMPLECONVERT_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief Block conversions between raw samples and floats. The Cortex-M4F
+ * has no vector floating point, so these are written to keep its single
+ * cycle load/convert/multiply pipeline full instead: two int16 samples
+ * per 32 bit load, and four samples per loop iteration.
+ */
+class Nano33BLESampleConvert
+{
+  public:
+    /**
+     * @brief output[i] = input[i] * scale, for count samples. input and
+     * output must not overlap.
+     *
+     * @param scale e.g. the sensitivity of the range the samples were
+     * taken at, such as 0.061F / 1000.0F for g from the LSM9DS1 at +/-2g.
+     */
+    static void int16ToFloat(const int16_t* input, float* output, uint32_t count, float scale);
+    /**
+     * @brief Converts count samples that are interleaved in input (e.g. 
+     * x, y, z, x, y, z... from a FIFO burst) into one output array per
+     * channel.
+     *
+     * @param input count * channelCount samples.
+     * @param channels channelCount pointers, each to room for count floats.
+     * A NULL pointer skips that channel.
+     */
+    static void deinterleaveInt16ToFloat(const int16_t* input, float* const* channels, 
+      uint32_t channelCount, uint32_t count, float scale);
+};
+
+#endif /* NANO33BLESAMPLECONVERT_H_ */
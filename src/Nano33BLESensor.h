@@ -0,0 +1,271 @@
+/*
+  Nano33BLESensor.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements everything a sensor needs apart from talking to
+  the sensor itself: the read thread, the periodic scheduling, buffering,
+  time stamping and read statistics. Each sensor class (including your own
+  I2C or SPI sensors) derives from it and only provides init() and read().
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESENSOR_H_
+#define NANO33BLESENSOR_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLEPeriodicScheduler.h"
+#include "Nano33BLEStackProfiler.h"
+#include "Thread.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief The base of every sensor class. SENSOR is the sensor class itself
+ * (the curiously recurring template pattern), so the calls to the sensor's
+ * own functions are resolved at compile time and there are no virtual calls
+ * in the read loop. T is the sensor's data class, which must have a
+ * uint32_t timeStampMs member.
+ *
+ * A sensor class provides these (usually private, with
+ * friend class Nano33BLESensor<SENSOR, T> so they can be called):
+ *
+ *   void init(void);      sets the sensor up. Called by begin().
+ *   void read(void);      takes one reading and passes it to publish().
+ *   void powerDown(void); optional, powers the sensor down between duty
+ *                         cycle bursts.
+ *   void powerUp(void);   optional, powers the sensor back up.
+ *   enum { SCHEDULED = false };
+ *                         optional, for sensors whose read() blocks until
+ *                         new data arrives (e.g. the microphone). By default
+ *                         read() is called once per scheduler period.
+ */
+template<class SENSOR, class T>
+class Nano33BLESensor: public Nano33BLESensorBuffer<T>
+{
+  public:
+    enum { SCHEDULED = true };
+
+    /**
+     * @brief Initialises the sensor and starts the Mbed OS Thread.
+     *
+     */
+    void begin()
+    {
+      beginPolled();
+      readStack.start(readThread, mbed::callback(Nano33BLESensor::readFunction, this));
+    }
+
+    /**
+     * @brief Initialises the sensor and starts its scheduler like begin(),
+     * but without the Mbed OS Thread. poll() must then be called in a loop
+     * instead, e.g. from loop() or by a host test.
+     *
+     */
+    void beginPolled()
+    {
+      static_cast<SENSOR*>(this)->init();
+      if(SENSOR::SCHEDULED)
+      {
+        scheduler.setPowerCallbacks(
+          mbed::callback(this, &Nano33BLESensor::powerDownSensor),
+          mbed::callback(this, &Nano33BLESensor::powerUpSensor),
+          wakeUpTime_ms);
+        scheduler.start();
+      }
+    }
+
+    /**
+     * @brief Does what the read thread does each time round its loop: one
+     * read(), then a wait for the next period. Only for sensors started
+     * with beginPolled().
+     *
+     */
+    void poll(void)
+    {
+      readOnce();
+    }
+
+    /**
+     * @brief Gives access to the scheduler that times the sensor reads,
+     * e.g. to change what happens when a read overruns its period, or to
+     * duty cycle the sensor with setDutyCycle().
+     *
+     */
+    Nano33BLEPeriodicScheduler& getScheduler(void)
+    {
+      return scheduler;
+    }
+
+    /**
+     * @return the number of times read() has been called.
+     */
+    uint32_t getReadCount(void)
+    {
+      return readCount;
+    }
+
+    /**
+     * @return the number of readings published.
+     */
+    uint32_t getPublishCount(void)
+    {
+      return publishCount;
+    }
+
+    /**
+     * @return the longest time one read() has taken in microseconds. For
+     * sensors that are not SCHEDULED this includes waiting for the data.
+     */
+    uint32_t getMaxReadTime(void)
+    {
+      return maxReadTime_us;
+    }
+
+    /**
+     * @brief Gives access to the read thread's stack, e.g. to check its 
+     * peak usage (see Nano33BLEStackProfiler).
+     *
+     */
+    Nano33BLEThreadStack& getStack(void)
+    {
+      return readStack;
+    }
+
+    /**
+     * @brief Starts the read statistics again.
+     *
+     */
+    void resetStats(void)
+    {
+      readCount = 0;
+      publishCount = 0;
+      maxReadTime_us = 0;
+    }
+
+  protected:
+    Nano33BLESensor(
+      const char* sensorName,
+      uint8_t sensorTraceId,
+      uint32_t readPeriod_ms,
+      uint32_t sensorWakeUpTime_ms,
+      osPriority threadPriority,
+      uint32_t threadSize) :
+        Nano33BLESensorBuffer<T>(sensorTraceId),
+        scheduler(readPeriod_ms),
+        wakeUpTime_ms(sensorWakeUpTime_ms),
+        readCount(0),
+        publishCount(0),
+        maxReadTime_us(0),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        sensorName),
+        readStack(sensorName, threadSize){};
+
+    /**
+     * @brief Time stamps a reading and pushes it to the buffer. Sensors
+     * call this from read().
+     *
+     */
+    void publish(T& data)
+    {
+      data.timeStampMs = millis();
+      publishCount++;
+      this->push(data);
+    }
+    /**
+     * @brief Pushes a reading with a time stamp it already has, e.g. one
+     * of several drained from a hardware FIFO, which were taken before
+     * now.
+     *
+     */
+    void publish(T& data, uint32_t timeStampMs)
+    {
+      data.timeStampMs = timeStampMs;
+      publishCount++;
+      this->push(data);
+    }
+
+    /* Sensors that can be powered down hide these with their own */
+    void powerDown(void){}
+    void powerUp(void){}
+
+    Nano33BLEPeriodicScheduler scheduler;
+
+  private:
+    static void readFunction(Nano33BLESensor *instance)
+    {
+      while(1)
+      {
+          instance->readOnce();
+      }
+    }
+
+    void readOnce(void)
+    {
+      uint32_t start_us;
+      uint32_t readTime_us;
+
+      start_us = micros();
+      static_cast<SENSOR*>(this)->read();
+      readTime_us = micros() - start_us;
+
+      readCount++;
+      if(readTime_us > maxReadTime_us)
+      {
+        maxReadTime_us = readTime_us;
+      }
+
+      if(SENSOR::SCHEDULED)
+      {
+        scheduler.waitForNextPeriod();
+      }
+    }
+
+    void powerDownSensor(void)
+    {
+      static_cast<SENSOR*>(this)->powerDown();
+    }
+
+    void powerUpSensor(void)
+    {
+      static_cast<SENSOR*>(this)->powerUp();
+    }
+
+    uint32_t wakeUpTime_ms;
+    volatile uint32_t readCount;
+    volatile uint32_t publishCount;
+    volatile uint32_t maxReadTime_us;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+#endif /* NANO33BLESENSOR_H_ */
@@ -25,11 +25,16 @@
 #ifndef NANO33BLESENSORBUFFER_H_
 #define NANO33BLESENSORBUFFER_H_
 
+
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
 #include "Arduino.h"
-#include <CircularBuffer.h>
+#include "Mutex.h"
+#include "ConditionVariable.h"
+#include "Nano33BLETrace.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLECoroutine.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -43,39 +48,536 @@
 /*****************************************************************************/
 /*CLASS DECLARATION                                                          */
 /*****************************************************************************/
+template<class T> class Nano33BLESensorReader;
+#ifdef COROUTINES_SUPPORTED
+template<class T> class Nano33BLEBufferAwaiter;
+template<class T> class Nano33BLENextAwaiter;
+template<class T> class Nano33BLEBatchAwaiter;
+#endif /* COROUTINES_SUPPORTED */
+
+/**
+ * @brief Decides which data a sensor buffer keeps, e.g. 
+ * Nano33BLEChangeFilter. Set with Nano33BLESensorBuffer::setPushFilter().
+ */
 template<class T>
-class Nano33BLESensorBuffer
+class Nano33BLEPushFilter
 {
     public:
+        /**
+         * @brief Called from the sensor thread with every piece of data
+         * before it is pushed.
+         *
+         * @return true to push the data, false to drop it.
+         */
+        virtual bool accept(const T& data) = 0;
+};
+
+/**
+ * The buffer is a ring of BUFFER_SIZE entries. When it is full the oldest
+ * entry is overwritten. Every consumer has its own read cursor into the
+ * ring: pop() and friends use the buffer's own cursor, and any number of
+ * Nano33BLESensorReader objects can be added, each with their own cursor,
+ * so several consumers can read the same data without copying it.
+ */
+template<class T>
+class Nano33BLESensorBuffer: public Nano33BLETraceTarget
+{
+    public:
+        Nano33BLESensorBuffer(uint8_t sensorTraceId = TRACE_ID_NONE) :
+            traceId(sensorTraceId),
+            writeCount(0),
+            writeIndex(0),
+            readCount(0),
+            overrunCount(0),
+            dataPushed(bufferMutex),
+            pushFilter(NULL){};
+
         uint32_t getAvailableDataSize(void);
         bool pop(T& data);
-        uint32_t popMultiple(T& buffer, uint32_t size);
+        uint32_t popMultiple(T* buffer, uint32_t size);
+        /**
+         * @brief Pops up to size pieces of data straight into one array per
+         * channel (structure of arrays), e.g. contiguous x[], y[] and z[]
+         * for DSP code, instead of popping structs and transposing them.
+         * The channels are those of Nano33BLESensorChannels<T>, which must
+         * be specialised for T.
+         *
+         * @param channels CHANNEL_COUNT pointers, each to room for size
+         * floats. A NULL pointer skips that channel.
+         * @param timeStamps room for size time stamps, or NULL.
+         * @param size the most data to pop.
+         * @return the number of pieces of data popped.
+         */
+        uint32_t popChannels(float* const* channels, uint32_t* timeStamps, uint32_t size);
+        /**
+         * @brief Pops one piece of data, blocking the calling thread until
+         * data is available or the timeout expires.
+         *
+         * @param data where the popped data is placed.
+         * @param timeout_ms the longest time to wait. osWaitForever waits
+         * forever.
+         * @return true if data was popped.
+         */
+        bool popWait(T& data, uint32_t timeout_ms = osWaitForever);
+        /**
+         * @brief Blocks the calling thread until at least size pieces of data
+         * are available or the timeout expires. Sizes larger than the buffer
+         * are limited to the buffer size.
+         *
+         * @param size the amount of data to wait for.
+         * @param timeout_ms the longest time to wait. osWaitForever waits
+         * forever.
+         * @return true if at least size pieces of data are available.
+         */
+        bool waitForAtLeast(uint32_t size, uint32_t timeout_ms = osWaitForever);
+#ifdef COROUTINES_SUPPORTED
+        /**
+         * @brief For co_await in a Nano33BLETask. Pops the next piece of
+         * data as pop() does, suspending the coroutine until there is some.
+         * e.g. Nano33BLEAccelerometerData data = co_await Accelerometer.next();
+         *
+         */
+        Nano33BLENextAwaiter<T> next(void);
+        /**
+         * @brief For co_await in a Nano33BLETask. Pops size pieces of data
+         * into buffer, suspending the coroutine until they have all
+         * arrived. Data is popped as it arrives, so size can be larger
+         * than the buffer. co_await gives the number popped (always size).
+         *
+         * @param buffer room for size pieces of data. Like any other local
+         * kept across a co_await, a local array is part of the coroutine's
+         * frame.
+         */
+        Nano33BLEBatchAwaiter<T> batch(T* buffer, uint32_t size);
+#endif /* COROUTINES_SUPPORTED */
+        /**
+         * @brief Sets a function to be called each time data is pushed. It is
+         * called from the sensor thread, so keep it short. To handle data in
+         * another thread pass an EventQueue event, e.g.
+         * onPush(queue.event(handler)).
+         *
+         * @param callback the function to call. An empty callback removes it.
+         */
+        void onPush(mbed::Callback<void()> callback);
+        /**
+         * @brief Sets a filter that decides which data is pushed. Data the
+         * filter drops is never stored, recorded or passed to the onPush()
+         * callback. It is called from the sensor thread.
+         *
+         * @param filter the filter to use. NULL removes it.
+         */
+        void setPushFilter(Nano33BLEPushFilter<T>* filter);
+        /**
+         * @return the number of pieces of data that were overwritten before
+         * they were popped.
+         */
+        uint32_t getOverrunCount(void);
+        /**
+         * @brief Sets the id pushes are recorded with (see 
+         * Nano33BLERecorder). The sensors already have their own 
+         * TRACE_ID_..., and TRACE_ID_NONE stops the buffer being recorded.
+         */
+        void setTraceId(uint8_t id);
+        uint8_t getTraceId(void);
+        bool replay(const void* data, uint32_t size);
     protected:
         void push(T& data);
     private:
-        mbed::CircularBuffer<T, BUFFER_SIZE> buffer;
+        friend class Nano33BLESensorReader<T>;
+#ifdef COROUTINES_SUPPORTED
+        friend class Nano33BLEBufferAwaiter<T>;
+#endif /* COROUTINES_SUPPORTED */
+
+        /* These must be called with bufferMutex locked */
+        uint32_t catchUp(uint32_t& cursor, uint32_t& overruns);
+        T& getEntry(uint32_t cursor);
+
+        /* These are the implementation shared by every cursor */
+        uint32_t getAvailableDataSize(uint32_t& cursor, uint32_t& overruns);
+        uint32_t popMultiple(uint32_t& cursor, uint32_t& overruns, T* buffer, uint32_t size);
+        uint32_t popChannels(uint32_t& cursor, uint32_t& overruns, 
+            float* const* channels, uint32_t* timeStamps, uint32_t size);
+        bool waitForAtLeast(uint32_t& cursor, uint32_t size, uint32_t timeout_ms);
+
+        uint8_t traceId;
+        T buffer[BUFFER_SIZE];
+        /* Total pushes. Cursors count pushes too, so they are compared
+         * with this by subtraction, which still works when it wraps. */
+        volatile uint32_t writeCount;
+        uint32_t writeIndex;
+        uint32_t readCount;
+        uint32_t overrunCount;
+        rtos::Mutex bufferMutex;
+        rtos::ConditionVariable dataPushed;
+        mbed::Callback<void()> pushCallback;
+        Nano33BLEPushFilter<T>* volatile pushFilter;
 };
 
+/**
+ * @brief An extra read cursor over a sensor's buffer. Each reader sees every
+ * piece of data pushed after it was created, independently of pop() and of
+ * any other reader, e.g. one for a serial logger and one for a BLE stream.
+ * If a reader falls more than BUFFER_SIZE behind, the oldest data it missed
+ * is counted as an overrun.
+ */
+template<class T>
+class Nano33BLESensorReader
+{
+    public:
+        Nano33BLESensorReader(Nano33BLESensorBuffer<T>& sensor) :
+            source(sensor),
+            cursor(sensor.writeCount),
+            overrunCount(0){};
+
+        /**
+         * @return how far behind the sensor this reader is.
+         */
+        uint32_t getAvailableDataSize(void)
+        {
+            return source.getAvailableDataSize(cursor, overrunCount);
+        }
+        bool pop(T& data)
+        {
+            return (source.popMultiple(cursor, overrunCount, &data, 1) == 1);
+        }
+        uint32_t popMultiple(T* buffer, uint32_t size)
+        {
+            return source.popMultiple(cursor, overrunCount, buffer, size);
+        }
+        uint32_t popChannels(float* const* channels, uint32_t* timeStamps, uint32_t size)
+        {
+            return source.popChannels(cursor, overrunCount, channels, timeStamps, size);
+        }
+        bool popWait(T& data, uint32_t timeout_ms = osWaitForever)
+        {
+            return (waitForAtLeast(1, timeout_ms) && pop(data));
+        }
+        bool waitForAtLeast(uint32_t size, uint32_t timeout_ms = osWaitForever)
+        {
+            return source.waitForAtLeast(cursor, size, timeout_ms);
+        }
+#ifdef COROUTINES_SUPPORTED
+        Nano33BLENextAwaiter<T> next(void)
+        {
+            return Nano33BLENextAwaiter<T>(source, cursor, overrunCount);
+        }
+        Nano33BLEBatchAwaiter<T> batch(T* buffer, uint32_t size)
+        {
+            return Nano33BLEBatchAwaiter<T>(source, cursor, overrunCount, buffer, size);
+        }
+#endif /* COROUTINES_SUPPORTED */
+        /**
+         * @return the number of pieces of data this reader missed because
+         * they were overwritten before it read them.
+         */
+        uint32_t getOverrunCount(void)
+        {
+            return overrunCount;
+        }
+
+    private:
+        Nano33BLESensorBuffer<T>& source;
+        uint32_t cursor;
+        uint32_t overrunCount;
+};
+
+#ifdef COROUTINES_SUPPORTED
+/**
+ * @brief Suspends a coroutine until data has been popped from a sensor
+ * buffer through one of its cursors. The scheduler checks it each time a
+ * sensor pushes.
+ */
+template<class T>
+class Nano33BLEBufferAwaiter: public Nano33BLECoroutineWaiter
+{
+    public:
+        Nano33BLEBufferAwaiter(
+            Nano33BLESensorBuffer<T>& sensor,
+            uint32_t& readCursor,
+            uint32_t& readOverruns,
+            T* data,
+            uint32_t size) :
+                source(sensor),
+                cursor(readCursor),
+                overruns(readOverruns),
+                buffer(data),
+                wanted(size),
+                popped(0){};
+        /* The buffer can point into the awaiter itself, so it is never copied */
+        Nano33BLEBufferAwaiter(const Nano33BLEBufferAwaiter&) = delete;
+
+        bool await_ready(void)
+        {
+            return isReady(0);
+        }
+        void await_suspend(std::coroutine_handle<> suspended)
+        {
+            this->handle = suspended;
+            CoroutineScheduler.wait(this);
+            return;
+        }
+
+        bool isReady(uint64_t now_ms)
+        {
+            (void)now_ms;
+            this->popped += this->source.popMultiple(
+                this->cursor, 
+                this->overruns, 
+                &this->buffer[this->popped], 
+                this->wanted - this->popped);
+            return (this->popped >= this->wanted);
+        }
+
+    protected:
+        uint32_t getPopped(void)
+        {
+            return this->popped;
+        }
+
+    private:
+        Nano33BLESensorBuffer<T>& source;
+        uint32_t& cursor;
+        uint32_t& overruns;
+        T* buffer;
+        uint32_t wanted;
+        uint32_t popped;
+};
+
+/**
+ * @brief The awaiter of next(). co_await gives the data.
+ */
+template<class T>
+class Nano33BLENextAwaiter: public Nano33BLEBufferAwaiter<T>
+{
+    public:
+        Nano33BLENextAwaiter(
+            Nano33BLESensorBuffer<T>& sensor,
+            uint32_t& readCursor,
+            uint32_t& readOverruns) :
+                Nano33BLEBufferAwaiter<T>(sensor, readCursor, readOverruns, &data, 1){};
+
+        T await_resume(void)
+        {
+            return this->data;
+        }
+
+    private:
+        T data;
+};
+
+/**
+ * @brief The awaiter of batch(). co_await gives the number popped.
+ */
+template<class T>
+class Nano33BLEBatchAwaiter: public Nano33BLEBufferAwaiter<T>
+{
+    public:
+        Nano33BLEBatchAwaiter(
+            Nano33BLESensorBuffer<T>& sensor,
+            uint32_t& readCursor,
+            uint32_t& readOverruns,
+            T* buffer,
+            uint32_t size) :
+                Nano33BLEBufferAwaiter<T>(sensor, readCursor, readOverruns, buffer, size){};
+
+        uint32_t await_resume(void)
+        {
+            return this->getPopped();
+        }
+};
+#endif /* COROUTINES_SUPPORTED */
+
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
 /*****************************************************************************/
 template<class T> uint32_t Nano33BLESensorBuffer<T>::getAvailableDataSize(void)
 {
-    return this->buffer.size();
+    return getAvailableDataSize(this->readCount, this->overrunCount);
 }
 
 template<class T> bool Nano33BLESensorBuffer<T>::pop(T& buffer)
 {
-    return this->buffer.pop(buffer);
+    return (popMultiple(this->readCount, this->overrunCount, &buffer, 1) == 1);
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::popMultiple(T* buffer, uint32_t size)
+{
+    return popMultiple(this->readCount, this->overrunCount, buffer, size);
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::popChannels(float* const* channels, uint32_t* timeStamps, uint32_t size)
+{
+    return popChannels(this->readCount, this->overrunCount, channels, timeStamps, size);
+}
+
+template<class T> bool Nano33BLESensorBuffer<T>::popWait(T& data, uint32_t timeout_ms)
+{
+    if(!waitForAtLeast(1, timeout_ms))
+    {
+        return false;
+    }
+    return pop(data);
+}
+
+template<class T> bool Nano33BLESensorBuffer<T>::waitForAtLeast(uint32_t size, uint32_t timeout_ms)
+{
+    return waitForAtLeast(this->readCount, size, timeout_ms);
+}
+
+#ifdef COROUTINES_SUPPORTED
+template<class T> Nano33BLENextAwaiter<T> Nano33BLESensorBuffer<T>::next(void)
+{
+    return Nano33BLENextAwaiter<T>(*this, this->readCount, this->overrunCount);
+}
+
+template<class T> Nano33BLEBatchAwaiter<T> Nano33BLESensorBuffer<T>::batch(T* buffer, uint32_t size)
+{
+    return Nano33BLEBatchAwaiter<T>(*this, this->readCount, this->overrunCount, buffer, size);
+}
+#endif /* COROUTINES_SUPPORTED */
+
+template<class T> void Nano33BLESensorBuffer<T>::onPush(mbed::Callback<void()> callback)
+{
+    this->bufferMutex.lock();
+    this->pushCallback = callback;
+    this->bufferMutex.unlock();
+    return;
+}
+
+template<class T> void Nano33BLESensorBuffer<T>::setPushFilter(Nano33BLEPushFilter<T>* filter)
+{
+    this->pushFilter = filter;
+    return;
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::getOverrunCount(void)
+{
+    uint32_t overruns;
+
+    this->bufferMutex.lock();
+    catchUp(this->readCount, this->overrunCount);
+    overruns = this->overrunCount;
+    this->bufferMutex.unlock();
+
+    return overruns;
+}
+
+template<class T> void Nano33BLESensorBuffer<T>::setTraceId(uint8_t id)
+{
+    this->traceId = id;
+    return;
 }
 
-template<class T> uint32_t Nano33BLESensorBuffer<T>::popMultiple(T& buffer, uint32_t size)
+template<class T> uint8_t Nano33BLESensorBuffer<T>::getTraceId(void)
+{
+    return this->traceId;
+}
+
+template<class T> bool Nano33BLESensorBuffer<T>::replay(const void* data, uint32_t size)
+{
+    T replayed;
+
+    if(size != sizeof(T))
+    {
+        return false;
+    }
+
+    memcpy(&replayed, data, sizeof(T));
+    push(replayed);
+    return true;
+}
+
+template<class T> void Nano33BLESensorBuffer<T>::push(T& data)
+{
+    mbed::Callback<void()> callback;
+    Nano33BLETraceSink* sink;
+    Nano33BLEPushFilter<T>* filter;
+
+    filter = this->pushFilter;
+    if((filter != NULL) && !filter->accept(data))
+    {
+        return;
+    }
+
+    this->bufferMutex.lock();
+    this->buffer[this->writeIndex] = data;
+    this->writeIndex++;
+    if(this->writeIndex >= BUFFER_SIZE)
+    {
+        this->writeIndex = 0;
+    }
+    this->writeCount++;
+    this->dataPushed.notify_all();
+    callback = this->pushCallback;
+    this->bufferMutex.unlock();
+
+#ifdef COROUTINES_SUPPORTED
+    CoroutineScheduler.notify();
+#endif /* COROUTINES_SUPPORTED */
+
+    /* Called outside the lock so the callback is free to pop the data */
+    if(callback)
+    {
+        callback();
+    }
+
+    sink = TraceSink;
+    if((sink != NULL) && (this->traceId != TRACE_ID_NONE))
+    {
+        sink->trace(this->traceId, &data, sizeof(T));
+    }
+    return;
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::catchUp(uint32_t& cursor, uint32_t& overruns)
+{
+    uint32_t available;
+
+    available = this->writeCount - cursor;
+    if(available > BUFFER_SIZE)
+    {
+        /* The oldest data this cursor had not read has been overwritten */
+        overruns += available - BUFFER_SIZE;
+        cursor = this->writeCount - BUFFER_SIZE;
+        available = BUFFER_SIZE;
+    }
+
+    return available;
+}
+
+template<class T> T& Nano33BLESensorBuffer<T>::getEntry(uint32_t cursor)
+{
+    uint32_t index;
+
+    /* writeIndex is where entry writeCount will go, so step back from it */
+    index = this->writeIndex + BUFFER_SIZE - (this->writeCount - cursor);
+    if(index >= BUFFER_SIZE)
+    {
+        index -= BUFFER_SIZE;
+    }
+
+    return this->buffer[index];
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::getAvailableDataSize(uint32_t& cursor, uint32_t& overruns)
+{
+    uint32_t available;
+
+    this->bufferMutex.lock();
+    available = catchUp(cursor, overruns);
+    this->bufferMutex.unlock();
+
+    return available;
+}
+
+template<class T> uint32_t Nano33BLESensorBuffer<T>::popMultiple(uint32_t& cursor, uint32_t& overruns, T* buffer, uint32_t size)
 {
     uint32_t availableData;
     uint32_t readData;
     uint32_t ii;
 
-    availableData = this->buffer.size();
+    this->bufferMutex.lock();
+    availableData = catchUp(cursor, overruns);
     if(availableData < size)
     {
         readData = availableData;
@@ -87,16 +589,120 @@ template<class T> uint32_t Nano33BLESensorBuffer<T>::popMultiple(T& buffer, uint
 
     for(ii = 0; ii < readData; ii++)
     {
-        this->buffer.pop(buffer);
+        buffer[ii] = getEntry(cursor);
+        cursor++;
     }
+    this->bufferMutex.unlock();
 
     return readData;
 }
 
-template<class T> void Nano33BLESensorBuffer<T>::push(T& data)
+template<class T> uint32_t Nano33BLESensorBuffer<T>::popChannels(
+    uint32_t& cursor, 
+    uint32_t& overruns, 
+    float* const* channels, 
+    uint32_t* timeStamps, 
+    uint32_t size)
 {
-    this->buffer.push(data);
-    return;
+    const T* segment;
+    float* output;
+    uint32_t availableData;
+    uint32_t readData;
+    uint32_t segmentSize;
+    uint32_t done;
+    uint32_t channel;
+    uint32_t ii;
+
+    this->bufferMutex.lock();
+    availableData = catchUp(cursor, overruns);
+    if(availableData < size)
+    {
+        readData = availableData;
+    }
+    else
+    {
+        readData = size;
+    }
+
+    /* 
+     * The data is in at most two contiguous runs of the ring. Each run is
+     * copied one channel at a time, so every output array is written in
+     * order and the channel is the same all the way through the inner loop.
+     */
+    done = 0;
+    while(done < readData)
+    {
+        segment = &getEntry(cursor);
+        segmentSize = BUFFER_SIZE - (uint32_t)(segment - this->buffer);
+        if(segmentSize > (readData - done))
+        {
+            segmentSize = readData - done;
+        }
+
+        for(channel = 0; channel < (uint32_t)Nano33BLESensorChannels<T>::CHANNEL_COUNT; channel++)
+        {
+            output = channels[channel];
+            if(output == NULL)
+            {
+                continue;
+            }
+            output += done;
+            for(ii = 0; ii < segmentSize; ii++)
+            {
+                output[ii] = Nano33BLESensorChannels<T>::get(segment[ii], channel);
+            }
+        }
+
+        if(timeStamps != NULL)
+        {
+            for(ii = 0; ii < segmentSize; ii++)
+            {
+                timeStamps[done + ii] = segment[ii].timeStampMs;
+            }
+        }
+
+        done += segmentSize;
+        cursor += segmentSize;
+    }
+    this->bufferMutex.unlock();
+
+    return readData;
+}
+
+template<class T> bool Nano33BLESensorBuffer<T>::waitForAtLeast(uint32_t& cursor, uint32_t size, uint32_t timeout_ms)
+{
+    uint64_t deadline_ms;
+    uint64_t now_ms;
+    bool sizeReached;
+
+    if(size > BUFFER_SIZE)
+    {
+        size = BUFFER_SIZE;
+    }
+
+    deadline_ms = rtos::Kernel::get_ms_count() + timeout_ms;
+
+    this->bufferMutex.lock();
+    while((this->writeCount - cursor) < size)
+    {
+        if(timeout_ms == osWaitForever)
+        {
+            this->dataPushed.wait();
+        }
+        else
+        {
+            now_ms = rtos::Kernel::get_ms_count();
+            if(now_ms >= deadline_ms)
+            {
+                break;
+            }
+            this->dataPushed.wait_for((uint32_t)(deadline_ms - now_ms));
+        }
+    }
+    sizeReached = ((this->writeCount - cursor) >= size);
+    this->bufferMutex.unlock();
+
+    return sizeReached;
 }
 
 #endif /* NANO33BLESENSORBUFFER_H_ */
@@ -0,0 +1,58 @@
+/*
+  Nano33BLESensorChannels.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class gives generic access to the individual values (channels) held
+  in each sensor's data class, so processing can be written once for any
+  sensor rather than once per data class.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESENSORCHANNELS_H_
+#define NANO33BLESENSORCHANNELS_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief Each sensor header specialises this class for its data class,
+ * next to the data class itself. A specialisation must provide:
+ *
+ *   enum { CHANNEL_COUNT = <number of values> };
+ *   static float get(const DataClass& data, uint32_t channel);
+ *
+ * If you add your own sensor, specialise this for its data class so it can
+ * be used with the generic processing classes (e.g. Nano33BLEWindowFeatures).
+ */
+template<class T>
+class Nano33BLESensorChannels;
+
+#endif /* NANO33BLESENSORCHANNELS_H_ */
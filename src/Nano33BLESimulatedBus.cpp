@@ -0,0 +1,283 @@
+/*
+  Nano33BLESimulatedBus.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements a simulated I2C bus for the host build. Simulated
+  devices are attached to it, and Nano33BLEI2CDevice is pointed at it with
+  Nano33BLEI2CDevice::setBus(). The bus counts every transaction and can
+  inject faults, so tests can check how the library uses the bus (e.g.
+  one burst read per IMU sample) as well as what it reads.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESimulatedBus.h"
+
+#ifndef ARDUINO
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+void Nano33BLESimulatedSignal::set(
+  float signalOffset, 
+  float signalAmplitude, 
+  uint32_t signalPeriod_ms, 
+  float signalNoise)
+{
+  this->offset = signalOffset;
+  this->amplitude = signalAmplitude;
+  this->period_ms = (signalPeriod_ms == 0U) ? 1U : signalPeriod_ms;
+  this->noise = signalNoise;
+  return;
+}
+
+float Nano33BLESimulatedSignal::get(uint32_t time_ms)
+{
+  float value;
+
+  value = this->offset;
+  if(this->amplitude != 0.0F)
+  {
+    value += this->amplitude * 
+      sinf((6.2831853F * (float)(time_ms % this->period_ms)) / (float)this->period_ms);
+  }
+  if(this->noise != 0.0F)
+  {
+    /* Numerical Recipes LCG, top 24 bits scaled to -1..1 */
+    this->seed = (this->seed * 1664525U) + 1013904223U;
+    value += this->noise * ((((float)(this->seed >> 8) / 8388608.0F)) - 1.0F);
+  }
+  return value;
+}
+
+uint32_t Nano33BLESimulatedClock::getSamplesDue(uint32_t now_ms, float rate_Hz)
+{
+  uint32_t due;
+
+  if(rate_Hz <= 0.0F)
+  {
+    this->running = false;
+    return 0;
+  }
+
+  if(!this->running)
+  {
+    /* The first sample comes one period after the device is started */
+    this->running = true;
+    this->last_ms = now_ms;
+    this->phase = 0.0F;
+    return 0;
+  }
+
+  this->phase += ((float)(now_ms - this->last_ms) * rate_Hz) / 1000.0F;
+  this->last_ms = now_ms;
+  due = (uint32_t)this->phase;
+  this->phase -= (float)due;
+  return due;
+}
+
+Nano33BLESimulatedDevice::Nano33BLESimulatedDevice(uint8_t deviceAddress) :
+  frozen(false),
+  address(deviceAddress),
+  transactionCount(0),
+  byteCount(0)
+{
+  memset(this->registers, 0, sizeof(this->registers));
+}
+
+void Nano33BLESimulatedDevice::setInt16(uint8_t reg, float value)
+{
+  int32_t raw;
+
+  if(value > 32767.0F)
+  {
+    raw = 32767;
+  }
+  else if(value < -32768.0F)
+  {
+    raw = -32768;
+  }
+  else
+  {
+    raw = (int32_t)lroundf(value);
+  }
+  this->registers[reg] = (uint8_t)(raw & 0xFF);
+  this->registers[(uint8_t)(reg + 1U)] = (uint8_t)((raw >> 8) & 0xFF);
+  return;
+}
+
+uint32_t Nano33BLESimulatedDevice::getSamplesDue(
+  Nano33BLESimulatedClock& clock, 
+  uint32_t now_ms, 
+  float rate_Hz)
+{
+  uint32_t due;
+
+  due = clock.getSamplesDue(now_ms, rate_Hz);
+  if(this->frozen)
+  {
+    return 0;
+  }
+  if(due > SIMULATED_MAX_SAMPLES_PER_UPDATE)
+  {
+    due = SIMULATED_MAX_SAMPLES_PER_UPDATE;
+  }
+  return due;
+}
+
+bool Nano33BLESimulatedBus::attach(Nano33BLESimulatedDevice& device)
+{
+  if(this->deviceCount >= SIMULATED_BUS_MAX_DEVICES)
+  {
+    return false;
+  }
+  this->devices[this->deviceCount] = &device;
+  this->deviceCount++;
+  return true;
+}
+
+bool Nano33BLESimulatedBus::read(uint8_t address, uint8_t reg, uint8_t* buffer, uint32_t size)
+{
+  Nano33BLESimulatedDevice* device;
+  bool increment;
+  uint32_t ii;
+
+  this->readCount++;
+  device = find(address);
+  if((device == NULL) || isNacked(address))
+  {
+    return false;
+  }
+
+  device->transactionCount++;
+  device->byteCount += size;
+  this->byteCount += size;
+  device->update(this->time_ms);
+
+  increment = device->decodeAddress(reg);
+  for(ii = 0; ii < size; ii++)
+  {
+    buffer[ii] = device->readRegister(reg);
+    if(increment)
+    {
+      reg = device->getNextRegister(reg);
+    }
+  }
+
+  if((this->corruptCount > 0U) && (this->corruptAddress == address))
+  {
+    this->corruptCount--;
+    for(ii = 0; ii < size; ii++)
+    {
+      buffer[ii] ^= 0x01U;
+    }
+  }
+  return true;
+}
+
+bool Nano33BLESimulatedBus::write(uint8_t address, uint8_t reg, const uint8_t* data, uint32_t size)
+{
+  Nano33BLESimulatedDevice* device;
+  bool increment;
+  uint32_t ii;
+
+  this->writeCount++;
+  device = find(address);
+  if((device == NULL) || isNacked(address))
+  {
+    return false;
+  }
+
+  device->transactionCount++;
+  device->byteCount += size;
+  this->byteCount += size;
+  device->update(this->time_ms);
+
+  increment = device->decodeAddress(reg);
+  for(ii = 0; ii < size; ii++)
+  {
+    device->writeRegister(reg, data[ii]);
+    if(increment)
+    {
+      reg = device->getNextRegister(reg);
+    }
+  }
+
+  /* A new output data rate is timed from when it was written */
+  device->update(this->time_ms);
+  return true;
+}
+
+void Nano33BLESimulatedBus::resetCounts(void)
+{
+  uint32_t ii;
+
+  this->readCount = 0;
+  this->writeCount = 0;
+  this->byteCount = 0;
+  for(ii = 0; ii < this->deviceCount; ii++)
+  {
+    this->devices[ii]->resetCounts();
+  }
+  return;
+}
+
+void Nano33BLESimulatedBus::injectNack(uint8_t address, uint32_t count)
+{
+  this->nackAddress = address;
+  this->nackCount = count;
+  return;
+}
+
+void Nano33BLESimulatedBus::injectCorruption(uint8_t address, uint32_t count)
+{
+  this->corruptAddress = address;
+  this->corruptCount = count;
+  return;
+}
+
+Nano33BLESimulatedDevice* Nano33BLESimulatedBus::find(uint8_t address)
+{
+  uint32_t ii;
+
+  for(ii = 0; ii < this->deviceCount; ii++)
+  {
+    if(this->devices[ii]->getAddress() == address)
+    {
+      return this->devices[ii];
+    }
+  }
+  return NULL;
+}
+
+bool Nano33BLESimulatedBus::isNacked(uint8_t address)
+{
+  if((this->nackCount > 0U) && (this->nackAddress == address))
+  {
+    this->nackCount--;
+    return true;
+  }
+  return false;
+}
+#endif /* ARDUINO */
@@ -0,0 +1,375 @@
+/*
+  Nano33BLESimulatedBus.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements a simulated I2C bus for the host build. Simulated
+  devices are attached to it, and Nano33BLEI2CDevice is pointed at it with
+  Nano33BLEI2CDevice::setBus(). The bus counts every transaction and can
+  inject faults, so tests can check how the library uses the bus (e.g.
+  one burst read per IMU sample) as well as what it reads.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESIMULATEDBUS_H_
+#define NANO33BLESIMULATEDBUS_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Nano33BLEI2CDevice.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define SIMULATED_BUS_MAX_DEVICES               (8U)
+#define SIMULATED_DEVICE_REGISTER_COUNT         (256U)
+/* Most samples a device generates in one update, after a long gap in time */
+#define SIMULATED_MAX_SAMPLES_PER_UPDATE        (64U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+#ifndef ARDUINO
+/**
+ * @brief A simulated physical signal for a simulated sensor channel:
+ * offset + amplitude * sin(2 * pi * t / period) + uniform noise. The noise
+ * comes from a fixed seed, so tests are repeatable.
+ */
+class Nano33BLESimulatedSignal
+{
+  public:
+    Nano33BLESimulatedSignal(
+      float signalOffset = 0.0F,
+      float signalAmplitude = 0.0F,
+      uint32_t signalPeriod_ms = 1000U,
+      float signalNoise = 0.0F) :
+        offset(signalOffset),
+        amplitude(signalAmplitude),
+        period_ms(signalPeriod_ms),
+        noise(signalNoise),
+        seed(0x12345678U){};
+
+    /**
+     * @brief Sets the signal.
+     *
+     * @param noise the largest noise added, either side of the signal.
+     */
+    void set(float signalOffset, float signalAmplitude = 0.0F, 
+      uint32_t signalPeriod_ms = 1000U, float signalNoise = 0.0F);
+    /**
+     * @return the value of the signal at time_ms.
+     */
+    float get(uint32_t time_ms);
+
+  private:
+    float offset;
+    float amplitude;
+    uint32_t period_ms;
+    float noise;
+    uint32_t seed;
+};
+
+/**
+ * @brief Works out how many samples a simulated device's output data rate
+ * has produced since it was last asked.
+ */
+class Nano33BLESimulatedClock
+{
+  public:
+    Nano33BLESimulatedClock() :
+      last_ms(0),
+      phase(0.0F),
+      running(false){};
+
+    /**
+     * @return the number of samples due at rate_Hz between the last call
+     * and now_ms. A rate of 0 stops the clock.
+     */
+    uint32_t getSamplesDue(uint32_t now_ms, float rate_Hz);
+
+  private:
+    uint32_t last_ms;
+    float phase;
+    bool running;
+};
+
+/**
+ * @brief A simple FIFO for the simulated devices' hardware FIFOs.
+ */
+template<class E, uint32_t SIZE>
+class Nano33BLESimulatedFifo
+{
+  public:
+    Nano33BLESimulatedFifo() :
+      oldest(0),
+      count(0){};
+
+    /**
+     * @return false if the FIFO was full. If overwrite is set the oldest
+     * entry is dropped to make room, otherwise the new entry is dropped.
+     */
+    bool push(const E& entry, bool overwrite)
+    {
+      if(count == SIZE)
+      {
+        if(overwrite)
+        {
+          entries[oldest] = entry;
+          oldest = (oldest + 1U) % SIZE;
+        }
+        return false;
+      }
+      entries[(oldest + count) % SIZE] = entry;
+      count++;
+      return true;
+    }
+    void pop(void)
+    {
+      if(count > 0U)
+      {
+        oldest = (oldest + 1U) % SIZE;
+        count--;
+      }
+    }
+    const E& peek(void) const
+    {
+      return entries[oldest];
+    }
+    uint32_t getCount(void) const
+    {
+      return count;
+    }
+    void clear(void)
+    {
+      count = 0;
+    }
+
+  private:
+    E entries[SIZE];
+    uint32_t oldest;
+    uint32_t count;
+};
+
+/**
+ * @brief The base of every simulated device. A device has a register map,
+ * decides how its register address auto increments in a burst, and is
+ * updated with the bus time before every transaction so it can produce
+ * samples at its output data rate.
+ */
+class Nano33BLESimulatedDevice
+{
+  public:
+    Nano33BLESimulatedDevice(uint8_t deviceAddress);
+    virtual ~Nano33BLESimulatedDevice(){};
+
+    uint8_t getAddress(void)
+    {
+      return address;
+    }
+    /**
+     * @return the number of transactions addressed to this device.
+     */
+    uint32_t getTransactionCount(void)
+    {
+      return transactionCount;
+    }
+    /**
+     * @return the number of data bytes read from or written to this device.
+     */
+    uint32_t getByteCount(void)
+    {
+      return byteCount;
+    }
+    void resetCounts(void)
+    {
+      transactionCount = 0;
+      byteCount = 0;
+    }
+    /**
+     * @brief Injects a stalled sensor: while frozen no new samples are
+     * produced, so data ready flags are never set.
+     *
+     */
+    void setFrozen(bool isFrozen)
+    {
+      frozen = isFrozen;
+    }
+    /**
+     * @brief Direct access to the register map, e.g. to check what the
+     * library wrote.
+     *
+     */
+    uint8_t peekRegister(uint8_t reg)
+    {
+      return registers[reg];
+    }
+
+  protected:
+    friend class Nano33BLESimulatedBus;
+
+    /**
+     * @brief Called by the bus before each transaction to this device.
+     *
+     */
+    virtual void update(uint32_t now_ms) = 0;
+    /**
+     * @brief Removes any auto increment flag from the register address.
+     *
+     * @return true if the address increments after each byte of a burst.
+     */
+    virtual bool decodeAddress(uint8_t& reg) = 0;
+    virtual uint8_t readRegister(uint8_t reg)
+    {
+      return registers[reg];
+    }
+    virtual void writeRegister(uint8_t reg, uint8_t value)
+    {
+      registers[reg] = value;
+    }
+    /**
+     * @return the register after reg in an auto incrementing burst.
+     */
+    virtual uint8_t getNextRegister(uint8_t reg)
+    {
+      return (uint8_t)(reg + 1U);
+    }
+
+    /* Stores a 16 bit two's complement value, low byte first, clamped */
+    void setInt16(uint8_t reg, float value);
+    uint32_t getSamplesDue(Nano33BLESimulatedClock& clock, uint32_t now_ms, float rate_Hz);
+
+    uint8_t registers[SIMULATED_DEVICE_REGISTER_COUNT];
+    bool frozen;
+
+  private:
+    uint8_t address;
+    uint32_t transactionCount;
+    uint32_t byteCount;
+};
+
+/**
+ * @brief The simulated bus. Time only moves when the test moves it, with
+ * setTime() or advance(), so tests are repeatable.
+ * 
+ * e.g.
+ *   Nano33BLESimulatedBus bus;
+ *   Nano33BLESimulatedHTS221 hts221;
+ *   bus.attach(hts221);
+ *   Nano33BLEI2CDevice::setBus(&bus);
+ */
+class Nano33BLESimulatedBus: public Nano33BLEI2CBus
+{
+  public:
+    Nano33BLESimulatedBus() :
+      deviceCount(0),
+      time_ms(0),
+      readCount(0),
+      writeCount(0),
+      byteCount(0),
+      nackAddress(0),
+      nackCount(0),
+      corruptAddress(0),
+      corruptCount(0){};
+
+    /**
+     * @return false if the bus already has SIMULATED_BUS_MAX_DEVICES
+     * devices.
+     */
+    bool attach(Nano33BLESimulatedDevice& device);
+
+    void setTime(uint32_t now_ms)
+    {
+      time_ms = now_ms;
+    }
+    void advance(uint32_t elapsed_ms)
+    {
+      time_ms += elapsed_ms;
+    }
+    uint32_t getTime(void)
+    {
+      return time_ms;
+    }
+
+    bool read(uint8_t address, uint8_t reg, uint8_t* buffer, uint32_t size);
+    bool write(uint8_t address, uint8_t reg, const uint8_t* data, uint32_t size);
+
+    /**
+     * @return the number of transactions on the bus, including ones that
+     * were not acknowledged.
+     */
+    uint32_t getTransactionCount(void)
+    {
+      return readCount + writeCount;
+    }
+    uint32_t getReadCount(void)
+    {
+      return readCount;
+    }
+    uint32_t getWriteCount(void)
+    {
+      return writeCount;
+    }
+    /**
+     * @return the number of data bytes moved, not counting addresses.
+     */
+    uint32_t getByteCount(void)
+    {
+      return byteCount;
+    }
+    /**
+     * @brief Resets the bus counts and the counts of every device.
+     *
+     */
+    void resetCounts(void);
+
+    /**
+     * @brief Makes the next count transactions to address fail as if the
+     * device did not acknowledge.
+     *
+     */
+    void injectNack(uint8_t address, uint32_t count);
+    /**
+     * @brief Flips the lowest bit of every byte read in the next count
+     * reads from address.
+     *
+     */
+    void injectCorruption(uint8_t address, uint32_t count);
+
+  private:
+    Nano33BLESimulatedDevice* find(uint8_t address);
+    bool isNacked(uint8_t address);
+
+    Nano33BLESimulatedDevice* devices[SIMULATED_BUS_MAX_DEVICES];
+    uint32_t deviceCount;
+    uint32_t time_ms;
+    uint32_t readCount;
+    uint32_t writeCount;
+    uint32_t byteCount;
+    uint8_t nackAddress;
+    uint32_t nackCount;
+    uint8_t corruptAddress;
+    uint32_t corruptCount;
+};
+#endif /* ARDUINO */
+
+#endif /* NANO33BLESIMULATEDBUS_H_ */
@@ -0,0 +1,993 @@
+/*
+  Nano33BLESimulatedDevices.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file implements register level simulators of the I2C sensors on the
+  Nano 33 BLE Sense, for the host build. Each one models the registers the
+  library uses: identity, configuration, status flags, output data at the
+  configured rate and range, auto increment, and the hardware FIFOs.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESimulatedDevices.h"
+
+#ifndef ARDUINO
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* LSM9DS1 accelerometer and gyroscope registers */
+#define LSM9DS1_WHO_AM_I                  (0x0FU)
+#define LSM9DS1_WHO_AM_I_AG_VALUE         (0x68U)
+#define LSM9DS1_CTRL_REG1_G               (0x10U)
+#define LSM9DS1_STATUS_REG_G              (0x17U)
+#define LSM9DS1_OUT_X_L_G                 (0x18U)
+#define LSM9DS1_OUT_Z_H_G                 (0x1DU)
+#define LSM9DS1_CTRL_REG6_XL              (0x20U)
+#define LSM9DS1_CTRL_REG8                 (0x22U)
+#define LSM9DS1_CTRL_REG8_IF_ADD_INC      (0x04U)
+#define LSM9DS1_CTRL_REG9                 (0x23U)
+#define LSM9DS1_CTRL_REG9_FIFO_EN         (0x02U)
+#define LSM9DS1_STATUS_REG                (0x27U)
+#define LSM9DS1_STATUS_XLDA               (0x01U)
+#define LSM9DS1_STATUS_GDA                (0x02U)
+#define LSM9DS1_OUT_X_L_XL                (0x28U)
+#define LSM9DS1_OUT_Z_H_XL                (0x2DU)
+#define LSM9DS1_FIFO_CTRL                 (0x2EU)
+#define LSM9DS1_FIFO_MODE_FIFO            (0x01U)
+#define LSM9DS1_FIFO_SRC                  (0x2FU)
+#define LSM9DS1_FIFO_SRC_FTH              (0x80U)
+#define LSM9DS1_FIFO_SRC_OVRN             (0x40U)
+
+/* LSM9DS1 magnetometer registers */
+#define LSM9DS1_WHO_AM_I_M_VALUE          (0x3DU)
+#define LSM9DS1_CTRL_REG1_M               (0x20U)
+#define LSM9DS1_CTRL_REG2_M               (0x21U)
+#define LSM9DS1_CTRL_REG3_M               (0x22U)
+#define LSM9DS1_CTRL_REG3_M_MD_MASK       (0x03U)
+#define LSM9DS1_CTRL_REG3_M_CONTINUOUS    (0x00U)
+#define LSM9DS1_CTRL_REG3_M_SINGLE        (0x01U)
+#define LSM9DS1_CTRL_REG3_M_POWER_DOWN    (0x03U)
+#define LSM9DS1_STATUS_REG_M              (0x27U)
+#define LSM9DS1_STATUS_M_ZYXDA            (0x0FU)
+#define LSM9DS1_OUT_X_L_M                 (0x28U)
+#define LSM9DS1_OUT_Z_H_M                 (0x2DU)
+
+/* APDS9960 registers */
+#define APDS9960_ENABLE                   (0x80U)
+#define APDS9960_ENABLE_PON               (0x01U)
+#define APDS9960_ENABLE_AEN               (0x02U)
+#define APDS9960_ENABLE_PEN               (0x04U)
+#define APDS9960_ENABLE_GEN               (0x40U)
+#define APDS9960_ATIME                    (0x81U)
+#define APDS9960_ATIME_CYCLE_MS           (2.78F)
+#define APDS9960_CONTROL                  (0x8FU)
+#define APDS9960_CONTROL_AGAIN_MASK       (0x03U)
+#define APDS9960_ID                       (0x92U)
+#define APDS9960_ID_VALUE                 (0xABU)
+#define APDS9960_STATUS                   (0x93U)
+#define APDS9960_STATUS_AVALID            (0x01U)
+#define APDS9960_STATUS_PVALID            (0x02U)
+#define APDS9960_STATUS_GINT              (0x04U)
+#define APDS9960_CDATAL                   (0x94U)
+#define APDS9960_RDATAL                   (0x96U)
+#define APDS9960_GDATAL                   (0x98U)
+#define APDS9960_BDATAL                   (0x9AU)
+#define APDS9960_BDATAH                   (0x9BU)
+#define APDS9960_PDATA                    (0x9CU)
+#define APDS9960_GCONF1                   (0xA2U)
+#define APDS9960_GCONF4                   (0xABU)
+#define APDS9960_GCONF4_GMODE             (0x01U)
+#define APDS9960_GCONF4_GFIFO_CLR         (0x04U)
+#define APDS9960_GFLVL                    (0xAEU)
+#define APDS9960_GSTATUS                  (0xAFU)
+#define APDS9960_GSTATUS_GVALID           (0x01U)
+#define APDS9960_GSTATUS_GFOV             (0x02U)
+#define APDS9960_GFIFO_U                  (0xFCU)
+#define APDS9960_GFIFO_R                  (0xFFU)
+/* 
+ * Gesture photodiode counts with no hand in view, then added while the hand
+ * is in view, and added while it covers the photodiode. The hand is in
+ * view for the middle of the gesture, and covers the first photodiode for
+ * the first part of that and the second for the last part.
+ */
+#define APDS9960_GESTURE_BACKGROUND       (5.0F)
+#define APDS9960_GESTURE_IN_VIEW          (40.0F)
+#define APDS9960_GESTURE_PEAK             (220.0F)
+#define APDS9960_GESTURE_ENTER            (0.1F)
+#define APDS9960_GESTURE_FIRST_LEAVES     (0.6F)
+#define APDS9960_GESTURE_SECOND_COVERED   (0.4F)
+#define APDS9960_GESTURE_EXIT             (0.9F)
+
+/* LPS22HB registers */
+#define LPS22HB_FIFO_CTRL                 (0x14U)
+#define LPS22HB_FIFO_CTRL_WTM_MASK        (0x1FU)
+#define LPS22HB_FIFO_MODE_FIFO            (0x01U)
+#define LPS22HB_WHO_AM_I                  (0x0FU)
+#define LPS22HB_WHO_AM_I_VALUE            (0xB1U)
+#define LPS22HB_CTRL_REG1                 (0x10U)
+#define LPS22HB_CTRL_REG1_EN_LPFP         (0x08U)
+#define LPS22HB_CTRL_REG1_LPFP_CFG        (0x04U)
+#define LPS22HB_CTRL_REG2                 (0x11U)
+#define LPS22HB_CTRL_REG2_FIFO_EN         (0x40U)
+#define LPS22HB_CTRL_REG2_IF_ADD_INC      (0x10U)
+#define LPS22HB_CTRL_REG2_ONE_SHOT        (0x01U)
+#define LPS22HB_FIFO_STATUS               (0x26U)
+#define LPS22HB_FIFO_STATUS_FTH           (0x80U)
+#define LPS22HB_FIFO_STATUS_OVR           (0x40U)
+#define LPS22HB_STATUS                    (0x27U)
+#define LPS22HB_STATUS_P_DA               (0x01U)
+#define LPS22HB_STATUS_T_DA               (0x02U)
+#define LPS22HB_PRESS_OUT_XL              (0x28U)
+#define LPS22HB_PRESS_OUT_H               (0x2AU)
+#define LPS22HB_TEMP_OUT_L                (0x2BU)
+#define LPS22HB_TEMP_OUT_H                (0x2CU)
+#define LPS22HB_LPFP_RES                  (0x33U)
+/* 4096 LSB/hPa, so 40960 LSB/kPa, and 100 LSB/degree */
+#define LPS22HB_PRESSURE_LSB_PER_KPA      (40960.0F)
+#define LPS22HB_TEMPERATURE_LSB_PER_C     (100.0F)
+
+/* HTS221 registers */
+#define HTS221_WHO_AM_I                   (0x0FU)
+#define HTS221_WHO_AM_I_VALUE             (0xBCU)
+#define HTS221_AV_CONF                    (0x10U)
+#define HTS221_AV_CONF_VALUE              (0x1BU)
+#define HTS221_CTRL_REG1                  (0x20U)
+#define HTS221_CTRL_REG1_PD               (0x80U)
+#define HTS221_CTRL_REG2                  (0x21U)
+#define HTS221_CTRL_REG2_ONE_SHOT         (0x01U)
+#define HTS221_STATUS                     (0x27U)
+#define HTS221_STATUS_T_DA                (0x01U)
+#define HTS221_STATUS_H_DA                (0x02U)
+#define HTS221_HUMIDITY_OUT_L             (0x28U)
+#define HTS221_HUMIDITY_OUT_H             (0x29U)
+#define HTS221_TEMP_OUT_L                 (0x2AU)
+#define HTS221_TEMP_OUT_H                 (0x2BU)
+#define HTS221_AUTO_INCREMENT             (0x80U)
+/* 
+ * Calibration: H0 = 20%rH at H0_T0_OUT = 0, H1 = 80%rH at H1_T0_OUT = 12000,
+ * T0 = 10C at T0_OUT = 0, T1 = 40C at T1_OUT = 3000.
+ */
+#define HTS221_H0_RH_X2                   (0x30U)
+#define HTS221_H1_RH_X2                   (0x31U)
+#define HTS221_T0_DEGC_X8                 (0x32U)
+#define HTS221_T1_DEGC_X8                 (0x33U)
+#define HTS221_T1_T0_MSB                  (0x35U)
+#define HTS221_H0_T0_OUT                  (0x36U)
+#define HTS221_H1_T0_OUT                  (0x3AU)
+#define HTS221_T0_OUT                     (0x3CU)
+#define HTS221_T1_OUT                     (0x3EU)
+#define HTS221_H0_RH                      (20.0F)
+#define HTS221_H1_RH                      (80.0F)
+#define HTS221_H1_T0_OUT_VALUE            (12000.0F)
+#define HTS221_T0_DEGC                    (10.0F)
+#define HTS221_T1_DEGC                    (40.0F)
+#define HTS221_T1_OUT_VALUE               (3000.0F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+/* Output data rates, indexed by the ODR bits of each configuration register */
+static const float lsm9ds1GyroscopeRates[8] = {0.0F, 14.9F, 59.5F, 119.0F, 238.0F, 476.0F, 952.0F, 0.0F};
+static const float lsm9ds1AccelerationRates[8] = {0.0F, 10.0F, 50.0F, 119.0F, 238.0F, 476.0F, 952.0F, 0.0F};
+static const float lsm9ds1MagneticRates[8] = {0.625F, 1.25F, 2.5F, 5.0F, 10.0F, 20.0F, 40.0F, 80.0F};
+static const float lps22hbRates[8] = {0.0F, 1.0F, 10.0F, 25.0F, 50.0F, 75.0F, 0.0F, 0.0F};
+static const float hts221Rates[4] = {0.0F, 1.0F, 7.0F, 12.5F};
+
+/* Sensitivities, indexed by the full scale bits of each configuration register */
+static const float lsm9ds1AccelerationSensitivity_mg[4] = {0.061F, 0.732F, 0.122F, 0.244F};
+static const float lsm9ds1GyroscopeSensitivity_mdps[4] = {8.75F, 17.5F, 17.5F, 70.0F};
+static const float lsm9ds1MagneticSensitivity_mgauss[4] = {0.14F, 0.29F, 0.43F, 0.58F};
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+static float clampValue(float value, float low, float high)
+{
+  if(value < low)
+  {
+    return low;
+  }
+  if(value > high)
+  {
+    return high;
+  }
+  return value;
+}
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+Nano33BLESimulatedLSM9DS1::Nano33BLESimulatedLSM9DS1() :
+  Nano33BLESimulatedDevice(LSM9DS1_ACCELEROMETER_GYROSCOPE_ADDRESS),
+  overrun(false)
+{
+  /* Lying flat and still */
+  this->acceleration[2].set(1.0F);
+  this->registers[LSM9DS1_WHO_AM_I] = LSM9DS1_WHO_AM_I_AG_VALUE;
+  this->registers[LSM9DS1_CTRL_REG8] = LSM9DS1_CTRL_REG8_IF_ADD_INC;
+}
+
+void Nano33BLESimulatedLSM9DS1::update(uint32_t now_ms)
+{
+  struct Sample sample;
+  float rate_Hz;
+  float accelerationScale;
+  float gyroscopeScale;
+  uint32_t due;
+  uint32_t time_ms;
+  uint32_t ii;
+  uint32_t jj;
+
+  /* The gyroscope sets the rate when both are on */
+  rate_Hz = getGyroscopeRate();
+  if(rate_Hz == 0.0F)
+  {
+    rate_Hz = getAccelerationRate();
+  }
+
+  due = getSamplesDue(this->clock, now_ms, rate_Hz);
+  accelerationScale = 1000.0F / 
+    lsm9ds1AccelerationSensitivity_mg[(this->registers[LSM9DS1_CTRL_REG6_XL] >> 3) & 0x03U];
+  gyroscopeScale = 1000.0F / 
+    lsm9ds1GyroscopeSensitivity_mdps[(this->registers[LSM9DS1_CTRL_REG1_G] >> 3) & 0x03U];
+
+  for(ii = 0; ii < due; ii++)
+  {
+    time_ms = now_ms - (uint32_t)(((float)(due - 1U - ii) * 1000.0F) / rate_Hz);
+    for(jj = 0; jj < 3U; jj++)
+    {
+      sample.acceleration[jj] = (int16_t)lroundf(clampValue(
+        this->acceleration[jj].get(time_ms) * accelerationScale, -32768.0F, 32767.0F));
+      sample.gyroscope[jj] = (int16_t)lroundf(clampValue(
+        this->gyroscope[jj].get(time_ms) * gyroscopeScale, -32768.0F, 32767.0F));
+    }
+
+    if(isFifoEnabled())
+    {
+      if(this->fifo.getCount() == 0U)
+      {
+        loadOutput(sample);
+      }
+      /* FIFO mode stops when full, the other modes overwrite the oldest */
+      if(!this->fifo.push(sample, 
+        ((this->registers[LSM9DS1_FIFO_CTRL] >> 5) != LSM9DS1_FIFO_MODE_FIFO)))
+      {
+        this->overrun = true;
+      }
+    }
+    else
+    {
+      loadOutput(sample);
+    }
+  }
+
+  if(due > 0U)
+  {
+    this->registers[LSM9DS1_STATUS_REG] |= 
+      ((getAccelerationRate() > 0.0F) ? LSM9DS1_STATUS_XLDA : 0U) |
+      ((getGyroscopeRate() > 0.0F) ? LSM9DS1_STATUS_GDA : 0U);
+    this->registers[LSM9DS1_STATUS_REG_G] = this->registers[LSM9DS1_STATUS_REG];
+  }
+  return;
+}
+
+bool Nano33BLESimulatedLSM9DS1::decodeAddress(uint8_t& reg)
+{
+  (void)reg;
+  return ((this->registers[LSM9DS1_CTRL_REG8] & LSM9DS1_CTRL_REG8_IF_ADD_INC) != 0U);
+}
+
+uint8_t Nano33BLESimulatedLSM9DS1::readRegister(uint8_t reg)
+{
+  uint8_t value;
+  uint32_t count;
+
+  value = this->registers[reg];
+  switch(reg)
+  {
+    case LSM9DS1_FIFO_SRC:
+      count = this->fifo.getCount();
+      value = (uint8_t)count |
+        ((count >= (uint32_t)(this->registers[LSM9DS1_FIFO_CTRL] & 0x1FU)) ? LSM9DS1_FIFO_SRC_FTH : 0U) |
+        (this->overrun ? LSM9DS1_FIFO_SRC_OVRN : 0U);
+      break;
+
+    case LSM9DS1_OUT_Z_H_G:
+      this->registers[LSM9DS1_STATUS_REG] &= ~LSM9DS1_STATUS_GDA;
+      this->registers[LSM9DS1_STATUS_REG_G] = this->registers[LSM9DS1_STATUS_REG];
+      break;
+
+    case LSM9DS1_OUT_Z_H_XL:
+      this->registers[LSM9DS1_STATUS_REG] &= ~LSM9DS1_STATUS_XLDA;
+      this->registers[LSM9DS1_STATUS_REG_G] = this->registers[LSM9DS1_STATUS_REG];
+      if(isFifoEnabled() && (this->fifo.getCount() > 0U))
+      {
+        this->fifo.pop();
+        this->overrun = false;
+        if(this->fifo.getCount() > 0U)
+        {
+          loadOutput(this->fifo.peek());
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+  return value;
+}
+
+void Nano33BLESimulatedLSM9DS1::writeRegister(uint8_t reg, uint8_t value)
+{
+  if(reg == LSM9DS1_WHO_AM_I)
+  {
+    return;
+  }
+
+  this->registers[reg] = value;
+  /* Bypass mode empties the FIFO */
+  if((reg == LSM9DS1_FIFO_CTRL) && ((value >> 5) == 0U))
+  {
+    this->fifo.clear();
+    this->overrun = false;
+  }
+  return;
+}
+
+float Nano33BLESimulatedLSM9DS1::getAccelerationRate(void)
+{
+  return lsm9ds1AccelerationRates[(this->registers[LSM9DS1_CTRL_REG6_XL] >> 5) & 0x07U];
+}
+
+float Nano33BLESimulatedLSM9DS1::getGyroscopeRate(void)
+{
+  return lsm9ds1GyroscopeRates[(this->registers[LSM9DS1_CTRL_REG1_G] >> 5) & 0x07U];
+}
+
+bool Nano33BLESimulatedLSM9DS1::isFifoEnabled(void)
+{
+  return (((this->registers[LSM9DS1_CTRL_REG9] & LSM9DS1_CTRL_REG9_FIFO_EN) != 0U) &&
+    ((this->registers[LSM9DS1_FIFO_CTRL] >> 5) != 0U));
+}
+
+void Nano33BLESimulatedLSM9DS1::loadOutput(const struct Sample& sample)
+{
+  uint32_t ii;
+
+  for(ii = 0; ii < 3U; ii++)
+  {
+    setInt16(LSM9DS1_OUT_X_L_G + (ii * 2U), sample.gyroscope[ii]);
+    setInt16(LSM9DS1_OUT_X_L_XL + (ii * 2U), sample.acceleration[ii]);
+  }
+  return;
+}
+
+Nano33BLESimulatedLSM9DS1Magnetic::Nano33BLESimulatedLSM9DS1Magnetic() :
+  Nano33BLESimulatedDevice(LSM9DS1_MAGNETIC_ADDRESS)
+{
+  /* Roughly the earth's field */
+  this->magnetic[0].set(20.0F);
+  this->magnetic[2].set(-40.0F);
+  this->registers[LSM9DS1_WHO_AM_I] = LSM9DS1_WHO_AM_I_M_VALUE;
+  this->registers[LSM9DS1_CTRL_REG3_M] = LSM9DS1_CTRL_REG3_M_POWER_DOWN;
+}
+
+void Nano33BLESimulatedLSM9DS1Magnetic::update(uint32_t now_ms)
+{
+  uint8_t mode;
+  uint32_t due;
+
+  mode = this->registers[LSM9DS1_CTRL_REG3_M] & LSM9DS1_CTRL_REG3_M_MD_MASK;
+  if(mode == LSM9DS1_CTRL_REG3_M_SINGLE)
+  {
+    /* One conversion, then back to power down */
+    if(!this->frozen)
+    {
+      sample(now_ms);
+    }
+    this->registers[LSM9DS1_CTRL_REG3_M] |= LSM9DS1_CTRL_REG3_M_POWER_DOWN;
+    return;
+  }
+
+  due = getSamplesDue(this->clock, now_ms, (mode == LSM9DS1_CTRL_REG3_M_CONTINUOUS) ?
+    lsm9ds1MagneticRates[(this->registers[LSM9DS1_CTRL_REG1_M] >> 2) & 0x07U] : 0.0F);
+  if(due > 0U)
+  {
+    /* Only the latest sample is visible, there is no FIFO */
+    sample(now_ms);
+  }
+  return;
+}
+
+bool Nano33BLESimulatedLSM9DS1Magnetic::decodeAddress(uint8_t& reg)
+{
+  reg &= 0x7FU;
+  return true;
+}
+
+uint8_t Nano33BLESimulatedLSM9DS1Magnetic::readRegister(uint8_t reg)
+{
+  if(reg == LSM9DS1_OUT_Z_H_M)
+  {
+    this->registers[LSM9DS1_STATUS_REG_M] &= ~LSM9DS1_STATUS_M_ZYXDA;
+  }
+  return this->registers[reg];
+}
+
+void Nano33BLESimulatedLSM9DS1Magnetic::sample(uint32_t time_ms)
+{
+  float scale;
+  uint32_t ii;
+
+  /* 1uT is 10mgauss */
+  scale = 10.0F / 
+    lsm9ds1MagneticSensitivity_mgauss[(this->registers[LSM9DS1_CTRL_REG2_M] >> 5) & 0x03U];
+  for(ii = 0; ii < 3U; ii++)
+  {
+    setInt16(LSM9DS1_OUT_X_L_M + (ii * 2U), this->magnetic[ii].get(time_ms) * scale);
+  }
+  this->registers[LSM9DS1_STATUS_REG_M] |= LSM9DS1_STATUS_M_ZYXDA;
+  return;
+}
+
+Nano33BLESimulatedAPDS9960::Nano33BLESimulatedAPDS9960() :
+  Nano33BLESimulatedDevice(APDS9960_ADDRESS),
+  overflow(false),
+  gestureDirection(SIMULATED_GESTURE_UP),
+  gestureStart_ms(0),
+  gestureDuration_ms(0)
+{
+  /* A dimly lit room with nothing near the sensor */
+  this->clear.set(400.0F);
+  this->red.set(150.0F);
+  this->green.set(140.0F);
+  this->blue.set(100.0F);
+  this->registers[APDS9960_ATIME] = 0xFFU;
+  this->registers[APDS9960_ID] = APDS9960_ID_VALUE;
+}
+
+void Nano33BLESimulatedAPDS9960::injectGesture(
+  enum SIMULATED_GESTURE direction, 
+  uint32_t start_ms, 
+  uint32_t duration_ms)
+{
+  this->gestureDirection = direction;
+  this->gestureStart_ms = start_ms;
+  this->gestureDuration_ms = duration_ms;
+  return;
+}
+
+void Nano33BLESimulatedAPDS9960::update(uint32_t now_ms)
+{
+  uint8_t enable;
+  float value;
+
+  enable = this->registers[APDS9960_ENABLE];
+  if((enable & APDS9960_ENABLE_PON) == 0U)
+  {
+    /* Powered off, stop every engine's clock */
+    enable = 0;
+  }
+
+  if((enable & APDS9960_ENABLE_AEN) != 0U)
+  {
+    updateColour(now_ms);
+  }
+  else
+  {
+    (void)getSamplesDue(this->colourClock, now_ms, 0.0F);
+  }
+
+  /* A proximity reading every 10ms */
+  if(getSamplesDue(this->proximityClock, now_ms, 
+    ((enable & APDS9960_ENABLE_PEN) != 0U) ? 100.0F : 0.0F) > 0U)
+  {
+    value = clampValue(this->proximity.get(now_ms), 0.0F, 255.0F);
+    this->registers[APDS9960_PDATA] = (uint8_t)value;
+    this->registers[APDS9960_STATUS] |= APDS9960_STATUS_PVALID;
+  }
+
+  if((enable & (APDS9960_ENABLE_GEN | APDS9960_ENABLE_PEN)) == 
+    (APDS9960_ENABLE_GEN | APDS9960_ENABLE_PEN))
+  {
+    updateGesture(now_ms);
+  }
+  else
+  {
+    (void)getSamplesDue(this->gestureClock, now_ms, 0.0F);
+    this->registers[APDS9960_GCONF4] &= ~APDS9960_GCONF4_GMODE;
+  }
+  return;
+}
+
+bool Nano33BLESimulatedAPDS9960::decodeAddress(uint8_t& reg)
+{
+  (void)reg;
+  return true;
+}
+
+uint8_t Nano33BLESimulatedAPDS9960::readRegister(uint8_t reg)
+{
+  uint8_t value;
+  uint32_t count;
+  uint32_t threshold;
+
+  value = this->registers[reg];
+  /* The four photodiode registers end the register map */
+  if(reg >= APDS9960_GFIFO_U)
+  {
+    if(this->fifo.getCount() == 0U)
+    {
+      return 0;
+    }
+    value = this->fifo.peek().photodiode[reg - APDS9960_GFIFO_U];
+    /* Reading the last byte of a frame removes it */
+    if(reg == APDS9960_GFIFO_R)
+    {
+      this->fifo.pop();
+    }
+    return value;
+  }
+
+  switch(reg)
+  {
+    case APDS9960_GFLVL:
+      value = (uint8_t)this->fifo.getCount();
+      break;
+
+    case APDS9960_GSTATUS:
+      count = this->fifo.getCount();
+      threshold = 1U << (((this->registers[APDS9960_GCONF1] >> 6) & 0x03U) * 2U);
+      value = ((count > 0U) && (count >= threshold) ? APDS9960_GSTATUS_GVALID : 0U) |
+        (this->overflow ? APDS9960_GSTATUS_GFOV : 0U);
+      break;
+
+    case APDS9960_BDATAH:
+      this->registers[APDS9960_STATUS] &= ~APDS9960_STATUS_AVALID;
+      break;
+
+    case APDS9960_PDATA:
+      this->registers[APDS9960_STATUS] &= ~APDS9960_STATUS_PVALID;
+      break;
+
+    default:
+      break;
+  }
+  return value;
+}
+
+void Nano33BLESimulatedAPDS9960::writeRegister(uint8_t reg, uint8_t value)
+{
+  switch(reg)
+  {
+    case APDS9960_ID:
+    case APDS9960_STATUS:
+    case APDS9960_GFLVL:
+    case APDS9960_GSTATUS:
+      /* Read only */
+      break;
+
+    case APDS9960_GCONF4:
+      if((value & APDS9960_GCONF4_GFIFO_CLR) != 0U)
+      {
+        this->fifo.clear();
+        this->overflow = false;
+      }
+      /* GFIFO_CLR clears itself, and GMODE follows the simulated hand */
+      this->registers[reg] = (value & ~(APDS9960_GCONF4_GFIFO_CLR | APDS9960_GCONF4_GMODE)) |
+        (this->registers[reg] & APDS9960_GCONF4_GMODE);
+      break;
+
+    default:
+      this->registers[reg] = value;
+      break;
+  }
+  return;
+}
+
+uint8_t Nano33BLESimulatedAPDS9960::getNextRegister(uint8_t reg)
+{
+  /* Bursts from the gesture FIFO wrap around the four photodiode registers */
+  if(reg == APDS9960_GFIFO_R)
+  {
+    return APDS9960_GFIFO_U;
+  }
+  return (uint8_t)(reg + 1U);
+}
+
+void Nano33BLESimulatedAPDS9960::updateColour(uint32_t now_ms)
+{
+  static const float gains[4] = {1.0F, 4.0F, 16.0F, 64.0F};
+  uint32_t cycles;
+  float scale;
+  float rate_Hz;
+
+  cycles = 256U - (uint32_t)this->registers[APDS9960_ATIME];
+  rate_Hz = 1000.0F / ((float)cycles * APDS9960_ATIME_CYCLE_MS);
+  if(getSamplesDue(this->colourClock, now_ms, rate_Hz) == 0U)
+  {
+    return;
+  }
+
+  /* Counts grow with gain and integration time, and saturate at full scale */
+  scale = gains[this->registers[APDS9960_CONTROL] & APDS9960_CONTROL_AGAIN_MASK] * 
+    ((float)cycles / 256.0F);
+  setColourChannel(APDS9960_CDATAL, this->clear.get(now_ms), scale);
+  setColourChannel(APDS9960_RDATAL, this->red.get(now_ms), scale);
+  setColourChannel(APDS9960_GDATAL, this->green.get(now_ms), scale);
+  setColourChannel(APDS9960_BDATAL, this->blue.get(now_ms), scale);
+  this->registers[APDS9960_STATUS] |= APDS9960_STATUS_AVALID;
+  return;
+}
+
+void Nano33BLESimulatedAPDS9960::updateGesture(uint32_t now_ms)
+{
+  struct Frame frame;
+  float position;
+  float first;
+  float second;
+  float across;
+  uint32_t due;
+  uint32_t time_ms;
+  uint32_t ii;
+
+  if((now_ms - this->gestureStart_ms) >= this->gestureDuration_ms)
+  {
+    /* The hand has gone, so the gesture engine exits */
+    this->registers[APDS9960_GCONF4] &= ~APDS9960_GCONF4_GMODE;
+    (void)getSamplesDue(this->gestureClock, now_ms, 0.0F);
+    return;
+  }
+
+  this->registers[APDS9960_GCONF4] |= APDS9960_GCONF4_GMODE;
+  due = getSamplesDue(this->gestureClock, now_ms, SIMULATED_APDS9960_GESTURE_RATE_HZ);
+  for(ii = 0; ii < due; ii++)
+  {
+    time_ms = now_ms - (uint32_t)(((float)(due - 1U - ii) * 1000.0F) / 
+      SIMULATED_APDS9960_GESTURE_RATE_HZ);
+    position = (float)(time_ms - this->gestureStart_ms) / (float)this->gestureDuration_ms;
+    position = clampValue(position, 0.0F, 1.0F);
+
+    first = APDS9960_GESTURE_BACKGROUND;
+    second = APDS9960_GESTURE_BACKGROUND;
+    across = APDS9960_GESTURE_BACKGROUND;
+    if((position >= APDS9960_GESTURE_ENTER) && (position < APDS9960_GESTURE_EXIT))
+    {
+      first += (position < APDS9960_GESTURE_FIRST_LEAVES) ? 
+        APDS9960_GESTURE_PEAK : APDS9960_GESTURE_IN_VIEW;
+      second += (position >= APDS9960_GESTURE_SECOND_COVERED) ? 
+        APDS9960_GESTURE_PEAK : APDS9960_GESTURE_IN_VIEW;
+      across += (APDS9960_GESTURE_PEAK + APDS9960_GESTURE_IN_VIEW) / 2.0F;
+    }
+
+    /* 
+     * Frames in the convention of the Arduino_APDS9960 library, which
+     * reports up when the hand covers U then D, and left when it covers
+     * L then R.
+     */
+    switch(this->gestureDirection)
+    {
+      case SIMULATED_GESTURE_UP:
+        frame.photodiode[0] = (uint8_t)first;
+        frame.photodiode[1] = (uint8_t)second;
+        frame.photodiode[2] = (uint8_t)across;
+        frame.photodiode[3] = (uint8_t)across;
+        break;
+      case SIMULATED_GESTURE_DOWN:
+        frame.photodiode[0] = (uint8_t)second;
+        frame.photodiode[1] = (uint8_t)first;
+        frame.photodiode[2] = (uint8_t)across;
+        frame.photodiode[3] = (uint8_t)across;
+        break;
+      case SIMULATED_GESTURE_LEFT:
+        frame.photodiode[0] = (uint8_t)across;
+        frame.photodiode[1] = (uint8_t)across;
+        frame.photodiode[2] = (uint8_t)first;
+        frame.photodiode[3] = (uint8_t)second;
+        break;
+      default:
+        frame.photodiode[0] = (uint8_t)across;
+        frame.photodiode[1] = (uint8_t)across;
+        frame.photodiode[2] = (uint8_t)second;
+        frame.photodiode[3] = (uint8_t)first;
+        break;
+    }
+
+    if(!this->fifo.push(frame, false))
+    {
+      this->overflow = true;
+    }
+  }
+  return;
+}
+
+void Nano33BLESimulatedAPDS9960::setColourChannel(uint8_t reg, float counts, float scale)
+{
+  uint32_t raw;
+
+  /* Unsigned, so it does not go through setInt16() */
+  raw = (uint32_t)lroundf(clampValue(counts * scale, 0.0F, 65535.0F));
+  this->registers[reg] = (uint8_t)(raw & 0xFFU);
+  this->registers[reg + 1U] = (uint8_t)(raw >> 8);
+  return;
+}
+
+Nano33BLESimulatedLPS22HB::Nano33BLESimulatedLPS22HB() :
+  Nano33BLESimulatedDevice(LPS22HB_ADDRESS),
+  overrun(false),
+  filteredPressure(0.0F),
+  filterPrimed(false)
+{
+  this->pressure.set(101.325F);
+  this->temperature.set(25.0F);
+  this->registers[LPS22HB_WHO_AM_I] = LPS22HB_WHO_AM_I_VALUE;
+  this->registers[LPS22HB_CTRL_REG2] = LPS22HB_CTRL_REG2_IF_ADD_INC;
+}
+
+void Nano33BLESimulatedLPS22HB::update(uint32_t now_ms)
+{
+  float rate_Hz;
+  uint32_t due;
+  uint32_t ii;
+
+  rate_Hz = lps22hbRates[(this->registers[LPS22HB_CTRL_REG1] >> 4) & 0x07U];
+  if((rate_Hz == 0.0F) && 
+    ((this->registers[LPS22HB_CTRL_REG2] & LPS22HB_CTRL_REG2_ONE_SHOT) != 0U))
+  {
+    /* One conversion while powered down, then ONE_SHOT clears itself */
+    if(!this->frozen)
+    {
+      sample(now_ms);
+    }
+    this->registers[LPS22HB_CTRL_REG2] &= ~LPS22HB_CTRL_REG2_ONE_SHOT;
+  }
+
+  due = getSamplesDue(this->clock, now_ms, rate_Hz);
+  for(ii = 0; ii < due; ii++)
+  {
+    sample(now_ms - (uint32_t)(((float)(due - 1U - ii) * 1000.0F) / rate_Hz));
+  }
+  return;
+}
+
+bool Nano33BLESimulatedLPS22HB::decodeAddress(uint8_t& reg)
+{
+  (void)reg;
+  return ((this->registers[LPS22HB_CTRL_REG2] & LPS22HB_CTRL_REG2_IF_ADD_INC) != 0U);
+}
+
+uint8_t Nano33BLESimulatedLPS22HB::readRegister(uint8_t reg)
+{
+  uint8_t value;
+  uint32_t count;
+  uint32_t watermark;
+
+  value = this->registers[reg];
+  switch(reg)
+  {
+    case LPS22HB_FIFO_STATUS:
+      count = this->fifo.getCount();
+      watermark = this->registers[LPS22HB_FIFO_CTRL] & LPS22HB_FIFO_CTRL_WTM_MASK;
+      value = (uint8_t)count |
+        (((watermark > 0U) && (count >= watermark)) ? LPS22HB_FIFO_STATUS_FTH : 0U) |
+        (this->overrun ? LPS22HB_FIFO_STATUS_OVR : 0U);
+      break;
+
+    case LPS22HB_PRESS_OUT_H:
+      this->registers[LPS22HB_STATUS] &= ~LPS22HB_STATUS_P_DA;
+      break;
+
+    case LPS22HB_LPFP_RES:
+      this->filterPrimed = false;
+      break;
+
+    case LPS22HB_TEMP_OUT_H:
+      this->registers[LPS22HB_STATUS] &= ~LPS22HB_STATUS_T_DA;
+      if(isFifoEnabled() && (this->fifo.getCount() > 0U))
+      {
+        this->fifo.pop();
+        this->overrun = false;
+        if(this->fifo.getCount() > 0U)
+        {
+          loadOutput(this->fifo.peek());
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+  return value;
+}
+
+void Nano33BLESimulatedLPS22HB::writeRegister(uint8_t reg, uint8_t value)
+{
+  if(reg == LPS22HB_WHO_AM_I)
+  {
+    return;
+  }
+
+  /* Enabling the filter starts it from the next sample */
+  if((reg == LPS22HB_CTRL_REG1) && 
+    (((value ^ this->registers[reg]) & LPS22HB_CTRL_REG1_EN_LPFP) != 0U))
+  {
+    this->filterPrimed = false;
+  }
+
+  this->registers[reg] = value;
+  /* Bypass mode empties the FIFO */
+  if((reg == LPS22HB_FIFO_CTRL) && ((value >> 5) == 0U))
+  {
+    this->fifo.clear();
+    this->overrun = false;
+  }
+  return;
+}
+
+uint8_t Nano33BLESimulatedLPS22HB::getNextRegister(uint8_t reg)
+{
+  /* With the FIFO on, bursts roll back to the start of the next sample */
+  if((reg == LPS22HB_TEMP_OUT_H) && isFifoEnabled())
+  {
+    return LPS22HB_PRESS_OUT_XL;
+  }
+  return (uint8_t)(reg + 1U);
+}
+
+void Nano33BLESimulatedLPS22HB::sample(uint32_t time_ms)
+{
+  struct Sample sample;
+  float value;
+  float divider;
+
+  value = this->pressure.get(time_ms);
+  if((this->registers[LPS22HB_CTRL_REG1] & LPS22HB_CTRL_REG1_EN_LPFP) != 0U)
+  {
+    /* A first order low pass filter with a bandwidth of ODR/9 or ODR/20 */
+    divider = ((this->registers[LPS22HB_CTRL_REG1] & LPS22HB_CTRL_REG1_LPFP_CFG) != 0U) ? 
+      20.0F : 9.0F;
+    if(!this->filterPrimed)
+    {
+      this->filteredPressure = value;
+      this->filterPrimed = true;
+    }
+    this->filteredPressure += (value - this->filteredPressure) / divider;
+    value = this->filteredPressure;
+  }
+
+  sample.pressure = lroundf(value * LPS22HB_PRESSURE_LSB_PER_KPA);
+  sample.temperature = (int16_t)lroundf(clampValue(
+    this->temperature.get(time_ms) * LPS22HB_TEMPERATURE_LSB_PER_C, -32768.0F, 32767.0F));
+
+  if(isFifoEnabled())
+  {
+    if(this->fifo.getCount() == 0U)
+    {
+      loadOutput(sample);
+    }
+    /* FIFO mode stops when full, the other modes overwrite the oldest */
+    if(!this->fifo.push(sample, 
+      ((this->registers[LPS22HB_FIFO_CTRL] >> 5) != LPS22HB_FIFO_MODE_FIFO)))
+    {
+      this->overrun = true;
+    }
+  }
+  else
+  {
+    loadOutput(sample);
+  }
+  this->registers[LPS22HB_STATUS] |= LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA;
+  return;
+}
+
+bool Nano33BLESimulatedLPS22HB::isFifoEnabled(void)
+{
+  return (((this->registers[LPS22HB_CTRL_REG2] & LPS22HB_CTRL_REG2_FIFO_EN) != 0U) &&
+    ((this->registers[LPS22HB_FIFO_CTRL] >> 5) != 0U));
+}
+
+void Nano33BLESimulatedLPS22HB::loadOutput(const struct Sample& sample)
+{
+  this->registers[LPS22HB_PRESS_OUT_XL] = (uint8_t)(sample.pressure & 0xFF);
+  this->registers[LPS22HB_PRESS_OUT_XL + 1U] = (uint8_t)((sample.pressure >> 8) & 0xFF);
+  this->registers[LPS22HB_PRESS_OUT_H] = (uint8_t)((sample.pressure >> 16) & 0xFF);
+  setInt16(LPS22HB_TEMP_OUT_L, sample.temperature);
+  return;
+}
+
+Nano33BLESimulatedHTS221::Nano33BLESimulatedHTS221() :
+  Nano33BLESimulatedDevice(HTS221_ADDRESS)
+{
+  this->humidity.set(45.0F);
+  this->temperature.set(22.0F);
+  this->registers[HTS221_WHO_AM_I] = HTS221_WHO_AM_I_VALUE;
+  this->registers[HTS221_AV_CONF] = HTS221_AV_CONF_VALUE;
+
+  this->registers[HTS221_H0_RH_X2] = (uint8_t)(HTS221_H0_RH * 2.0F);
+  this->registers[HTS221_H1_RH_X2] = (uint8_t)(HTS221_H1_RH * 2.0F);
+  this->registers[HTS221_T0_DEGC_X8] = (uint8_t)(HTS221_T0_DEGC * 8.0F);
+  /* T1 x 8 is 320, so its top two bits go in T1_T0_MSB */
+  this->registers[HTS221_T1_DEGC_X8] = (uint8_t)((uint32_t)(HTS221_T1_DEGC * 8.0F) & 0xFFU);
+  this->registers[HTS221_T1_T0_MSB] = (uint8_t)(((uint32_t)(HTS221_T1_DEGC * 8.0F) >> 8) << 2);
+  setInt16(HTS221_H0_T0_OUT, 0.0F);
+  setInt16(HTS221_H1_T0_OUT, HTS221_H1_T0_OUT_VALUE);
+  setInt16(HTS221_T0_OUT, 0.0F);
+  setInt16(HTS221_T1_OUT, HTS221_T1_OUT_VALUE);
+}
+
+void Nano33BLESimulatedHTS221::update(uint32_t now_ms)
+{
+  float rate_Hz;
+
+  if((this->registers[HTS221_CTRL_REG1] & HTS221_CTRL_REG1_PD) == 0U)
+  {
+    (void)getSamplesDue(this->clock, now_ms, 0.0F);
+    return;
+  }
+
+  rate_Hz = hts221Rates[this->registers[HTS221_CTRL_REG1] & 0x03U];
+  if((rate_Hz == 0.0F) && 
+    ((this->registers[HTS221_CTRL_REG2] & HTS221_CTRL_REG2_ONE_SHOT) != 0U))
+  {
+    if(!this->frozen)
+    {
+      sample(now_ms);
+    }
+    this->registers[HTS221_CTRL_REG2] &= ~HTS221_CTRL_REG2_ONE_SHOT;
+  }
+
+  if(getSamplesDue(this->clock, now_ms, rate_Hz) > 0U)
+  {
+    /* Only the latest sample is visible, there is no FIFO */
+    sample(now_ms);
+  }
+  return;
+}
+
+bool Nano33BLESimulatedHTS221::decodeAddress(uint8_t& reg)
+{
+  bool increment;
+
+  increment = ((reg & HTS221_AUTO_INCREMENT) != 0U);
+  reg &= ~HTS221_AUTO_INCREMENT;
+  return increment;
+}
+
+uint8_t Nano33BLESimulatedHTS221::readRegister(uint8_t reg)
+{
+  if(reg == HTS221_HUMIDITY_OUT_H)
+  {
+    this->registers[HTS221_STATUS] &= ~HTS221_STATUS_H_DA;
+  }
+  else if(reg == HTS221_TEMP_OUT_H)
+  {
+    this->registers[HTS221_STATUS] &= ~HTS221_STATUS_T_DA;
+  }
+  return this->registers[reg];
+}
+
+void Nano33BLESimulatedHTS221::sample(uint32_t time_ms)
+{
+  setInt16(HTS221_HUMIDITY_OUT_L, (this->humidity.get(time_ms) - HTS221_H0_RH) * 
+    (HTS221_H1_T0_OUT_VALUE / (HTS221_H1_RH - HTS221_H0_RH)));
+  setInt16(HTS221_TEMP_OUT_L, (this->temperature.get(time_ms) - HTS221_T0_DEGC) * 
+    (HTS221_T1_OUT_VALUE / (HTS221_T1_DEGC - HTS221_T0_DEGC)));
+  this->registers[HTS221_STATUS] |= HTS221_STATUS_T_DA | HTS221_STATUS_H_DA;
+  return;
+}
+#endif /* ARDUINO */
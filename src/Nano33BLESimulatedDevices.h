@@ -0,0 +1,244 @@
+/*
+  Nano33BLESimulatedDevices.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file implements register level simulators of the I2C sensors on the
+  Nano 33 BLE Sense, for the host build. Each one models the registers the
+  library uses: identity, configuration, status flags, output data at the
+  configured rate and range, auto increment, and the hardware FIFOs.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESIMULATEDDEVICES_H_
+#define NANO33BLESIMULATEDDEVICES_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Nano33BLESimulatedBus.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define SIMULATED_LSM9DS1_FIFO_SIZE             (32U)
+#define SIMULATED_LPS22HB_FIFO_SIZE             (32U)
+#define SIMULATED_APDS9960_FIFO_SIZE            (32U)
+/* Rate gesture frames are added to the APDS9960 FIFO during a gesture */
+#define SIMULATED_APDS9960_GESTURE_RATE_HZ      (250.0F)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+#ifndef ARDUINO
+/**
+ * @brief The LSM9DS1 accelerometer and gyroscope. The signals are in g and
+ * degrees per second. The FIFO is used when FIFO_EN is set in CTRL_REG9 and
+ * FIFO_CTRL is not in bypass mode, and a sample is removed from it when the
+ * last accelerometer output register (OUT_Z_H_XL) is read.
+ */
+class Nano33BLESimulatedLSM9DS1
+  : public Nano33BLESimulatedDevice
+{
+  public:
+    Nano33BLESimulatedLSM9DS1();
+
+    Nano33BLESimulatedSignal acceleration[3];
+    Nano33BLESimulatedSignal gyroscope[3];
+
+  protected:
+    void update(uint32_t now_ms);
+    bool decodeAddress(uint8_t& reg);
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+
+  private:
+    struct Sample
+    {
+      int16_t gyroscope[3];
+      int16_t acceleration[3];
+    };
+
+    float getAccelerationRate(void);
+    float getGyroscopeRate(void);
+    bool isFifoEnabled(void);
+    void loadOutput(const struct Sample& sample);
+
+    Nano33BLESimulatedClock clock;
+    Nano33BLESimulatedFifo<struct Sample, SIMULATED_LSM9DS1_FIFO_SIZE> fifo;
+    bool overrun;
+};
+
+/**
+ * @brief The LSM9DS1 magnetometer. The signals are in microtesla. Register
+ * addresses always auto increment, with or without the MSB set.
+ */
+class Nano33BLESimulatedLSM9DS1Magnetic
+  : public Nano33BLESimulatedDevice
+{
+  public:
+    Nano33BLESimulatedLSM9DS1Magnetic();
+
+    Nano33BLESimulatedSignal magnetic[3];
+
+  protected:
+    void update(uint32_t now_ms);
+    bool decodeAddress(uint8_t& reg);
+    uint8_t readRegister(uint8_t reg);
+
+  private:
+    void sample(uint32_t time_ms);
+
+    Nano33BLESimulatedClock clock;
+};
+
+/**
+ * @brief The APDS9960 colour, proximity and gesture sensor. The light
+ * signals are counts at 1x gain and the reset integration time, and
+ * proximity is 0 to 255. Gestures are injected with injectGesture(), and
+ * fill the gesture FIFO while gesture mode is enabled.
+ */
+class Nano33BLESimulatedAPDS9960
+  : public Nano33BLESimulatedDevice
+{
+  public:
+    enum SIMULATED_GESTURE
+    {
+      SIMULATED_GESTURE_UP,
+      SIMULATED_GESTURE_DOWN,
+      SIMULATED_GESTURE_LEFT,
+      SIMULATED_GESTURE_RIGHT
+    };
+
+    Nano33BLESimulatedAPDS9960();
+
+    /**
+     * @brief Passes a hand over the sensor.
+     *
+     * @param direction the direction the hand moves in.
+     * @param start_ms the bus time the hand arrives.
+     * @param duration_ms how long the hand is over the sensor.
+     */
+    void injectGesture(enum SIMULATED_GESTURE direction, uint32_t start_ms, uint32_t duration_ms);
+
+    Nano33BLESimulatedSignal clear;
+    Nano33BLESimulatedSignal red;
+    Nano33BLESimulatedSignal green;
+    Nano33BLESimulatedSignal blue;
+    Nano33BLESimulatedSignal proximity;
+
+  protected:
+    void update(uint32_t now_ms);
+    bool decodeAddress(uint8_t& reg);
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t getNextRegister(uint8_t reg);
+
+  private:
+    struct Frame
+    {
+      uint8_t photodiode[4];
+    };
+
+    void updateColour(uint32_t now_ms);
+    void updateGesture(uint32_t now_ms);
+    void setColourChannel(uint8_t reg, float counts, float scale);
+
+    Nano33BLESimulatedClock colourClock;
+    Nano33BLESimulatedClock proximityClock;
+    Nano33BLESimulatedClock gestureClock;
+    Nano33BLESimulatedFifo<struct Frame, SIMULATED_APDS9960_FIFO_SIZE> fifo;
+    bool overflow;
+    enum SIMULATED_GESTURE gestureDirection;
+    uint32_t gestureStart_ms;
+    uint32_t gestureDuration_ms;
+};
+
+/**
+ * @brief The LPS22HB barometer. The signals are in kPa and degrees
+ * celsius. The optional low pass filter is applied to every pressure
+ * sample, and the FIFO is used when FIFO_EN is set in CTRL_REG2 and
+ * FIFO_CTRL is not in bypass mode. A sample is removed from the FIFO when
+ * TEMP_OUT_H is read, and bursts then roll back to PRESS_OUT_XL.
+ */
+class Nano33BLESimulatedLPS22HB
+  : public Nano33BLESimulatedDevice
+{
+  public:
+    Nano33BLESimulatedLPS22HB();
+
+    Nano33BLESimulatedSignal pressure;
+    Nano33BLESimulatedSignal temperature;
+
+  protected:
+    void update(uint32_t now_ms);
+    bool decodeAddress(uint8_t& reg);
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t getNextRegister(uint8_t reg);
+
+  private:
+    struct Sample
+    {
+      int32_t pressure;
+      int16_t temperature;
+    };
+
+    void sample(uint32_t time_ms);
+    bool isFifoEnabled(void);
+    void loadOutput(const struct Sample& sample);
+
+    Nano33BLESimulatedClock clock;
+    Nano33BLESimulatedFifo<struct Sample, SIMULATED_LPS22HB_FIFO_SIZE> fifo;
+    bool overrun;
+    float filteredPressure;
+    bool filterPrimed;
+};
+
+/**
+ * @brief The HTS221 humidity and temperature sensor. The signals are in
+ * percent relative humidity and degrees celsius, and are converted with
+ * fixed calibration registers. Register addresses only auto increment with
+ * the MSB set.
+ */
+class Nano33BLESimulatedHTS221
+  : public Nano33BLESimulatedDevice
+{
+  public:
+    Nano33BLESimulatedHTS221();
+
+    Nano33BLESimulatedSignal humidity;
+    Nano33BLESimulatedSignal temperature;
+
+  protected:
+    void update(uint32_t now_ms);
+    bool decodeAddress(uint8_t& reg);
+    uint8_t readRegister(uint8_t reg);
+
+  private:
+    void sample(uint32_t time_ms);
+
+    Nano33BLESimulatedClock clock;
+};
+#endif /* ARDUINO */
+
+#endif /* NANO33BLESIMULATEDDEVICES_H_ */
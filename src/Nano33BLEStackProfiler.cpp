@@ -0,0 +1,183 @@
+/*
+  Nano33BLEStackProfiler.cpp
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements stack profiling for the library's Mbed OS threads.
+  Mbed OS fills each thread's stack with a magic word when the thread
+  starts, so the peak stack usage can be found later from how much of it
+  has been overwritten. From this a recommended stack size is given for
+  each thread's constructor.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLEStackProfiler.h"
+#include "CriticalSectionLock.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+Nano33BLEThreadStack* Nano33BLEStackProfiler::head = NULL;
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+Nano33BLEThreadStack::Nano33BLEThreadStack(const char* threadName, uint32_t size) :
+  name(threadName),
+  stackSize(size),
+  thread(NULL),
+  next(NULL)
+{
+}
+
+Nano33BLEThreadStack::~Nano33BLEThreadStack()
+{
+  if(this->thread != NULL)
+  {
+    Nano33BLEStackProfiler::remove(this);
+  }
+}
+
+osStatus Nano33BLEThreadStack::start(rtos::Thread& stackThread, mbed::Callback<void()> task)
+{
+  osStatus status;
+
+  status = stackThread.start(task);
+  if((status == osOK) && (this->thread == NULL))
+  {
+    this->thread = &stackThread;
+    Nano33BLEStackProfiler::add(this);
+  }
+  return status;
+}
+
+uint32_t Nano33BLEThreadStack::getPeakUsage(void)
+{
+  if(this->thread == NULL)
+  {
+    return 0;
+  }
+
+  /* 
+   * Mbed OS scans up from the bottom of the stack for the words still
+   * holding its magic word. The guard word is counted as unused.
+   */
+  return this->thread->max_stack();
+}
+
+uint32_t Nano33BLEThreadStack::getRecommendedSize(uint32_t margin_percent)
+{
+  uint32_t recommended;
+
+  /* The guard bytes at the bottom are needed whatever the usage */
+  recommended = getPeakUsage();
+  recommended += ((recommended * margin_percent) + 99U) / 100U;
+  recommended += STACK_GUARD_BYTES;
+  recommended = ((recommended + STACK_SIZE_ALIGNMENT_BYTES - 1U) / 
+    STACK_SIZE_ALIGNMENT_BYTES) * STACK_SIZE_ALIGNMENT_BYTES;
+  if(recommended < STACK_MIN_RECOMMENDED_BYTES)
+  {
+    recommended = STACK_MIN_RECOMMENDED_BYTES;
+  }
+
+  return recommended;
+}
+
+uint32_t Nano33BLEStackProfiler::getCount(void)
+{
+  mbed::CriticalSectionLock lock;
+  Nano33BLEThreadStack* stack;
+  uint32_t count;
+
+  count = 0;
+  for(stack = head; stack != NULL; stack = stack->next)
+  {
+    count++;
+  }
+  return count;
+}
+
+Nano33BLEThreadStack* Nano33BLEStackProfiler::getStack(uint32_t index)
+{
+  mbed::CriticalSectionLock lock;
+  Nano33BLEThreadStack* stack;
+
+  stack = head;
+  while((stack != NULL) && (index > 0U))
+  {
+    stack = stack->next;
+    index--;
+  }
+  return stack;
+}
+
+void Nano33BLEStackProfiler::report(Print& out, uint32_t margin_percent)
+{
+  Nano33BLEThreadStack* stack;
+  uint32_t ii;
+
+  /* Printing can block, so the list is walked by index rather than locked */
+  for(ii = 0; (stack = getStack(ii)) != NULL; ii++)
+  {
+    out.print(stack->getName());
+    out.print(": size ");
+    out.print((unsigned long)stack->getSize());
+    out.print(", peak ");
+    out.print((unsigned long)stack->getPeakUsage());
+    out.print(", recommended ");
+    out.println((unsigned long)stack->getRecommendedSize(margin_percent));
+  }
+  return;
+}
+
+void Nano33BLEStackProfiler::add(Nano33BLEThreadStack* stack)
+{
+  mbed::CriticalSectionLock lock;
+  Nano33BLEThreadStack** last;
+
+  /* Added to the end so the report is in construction order */
+  last = &head;
+  while(*last != NULL)
+  {
+    last = &((*last)->next);
+  }
+  *last = stack;
+  stack->next = NULL;
+  return;
+}
+
+void Nano33BLEStackProfiler::remove(Nano33BLEThreadStack* stack)
+{
+  mbed::CriticalSectionLock lock;
+  Nano33BLEThreadStack** link;
+
+  for(link = &head; *link != NULL; link = &((*link)->next))
+  {
+    if(*link == stack)
+    {
+      *link = stack->next;
+      break;
+    }
+  }
+  return;
+}
+
+Nano33BLEStackProfiler StackProfiler;
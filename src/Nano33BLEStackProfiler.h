@@ -0,0 +1,170 @@
+/*
+  Nano33BLEStackProfiler.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements stack profiling for the library's Mbed OS threads.
+  Mbed OS fills each thread's stack with a magic word when the thread
+  starts, so the peak stack usage can be found later from how much of it
+  has been overwritten. From this a recommended stack size is given for
+  each thread's constructor.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLESTACKPROFILER_H_
+#define NANO33BLESTACKPROFILER_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+#include "Thread.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* 
+ * Bytes at the bottom of the stack that are never used. Mbed OS (RTX) keeps
+ * a magic word there to detect overflows.
+ */
+#define STACK_GUARD_BYTES                       (8U)
+/* Default safety margin added to the peak usage, in percent */
+#define DEFAULT_STACK_MARGIN_PERCENT            (25U)
+/* Recommended sizes are rounded up to this, as Mbed OS stacks are 8 byte aligned */
+#define STACK_SIZE_ALIGNMENT_BYTES              (8U)
+/* Smallest stack size recommended, e.g. for a thread that has not run yet */
+#define STACK_MIN_RECOMMENDED_BYTES             (256U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief Profiles the stack of one thread. The thread is given no stack
+ * memory, so Mbed OS only allocates it from the heap when the thread is
+ * started, and the thread is started with start() rather than its own, e.g.
+ *
+ *   readThread(threadPriority, threadSize, NULL, "Accelerometer"),
+ *   readStack("Accelerometer", threadSize)
+ *   ...
+ *   readStack.start(readThread, mbed::callback(readFunction, this));
+ *
+ * It must be declared after the thread so it is removed from the list
+ * reported by Nano33BLEStackProfiler before the thread is destroyed. Only
+ * started threads are in the list.
+ */
+class Nano33BLEThreadStack
+{
+  public:
+    Nano33BLEThreadStack(const char* threadName, uint32_t size);
+    ~Nano33BLEThreadStack();
+
+    /**
+     * @brief Starts the thread and adds its stack to the profiler's list.
+     *
+     * @return the thread's start() status, e.g. osErrorNoMemory if there
+     * was no heap left for the stack.
+     */
+    osStatus start(rtos::Thread& stackThread, mbed::Callback<void()> task);
+
+    uint32_t getSize(void)
+    {
+      return stackSize;
+    }
+    const char* getName(void)
+    {
+      return name;
+    }
+    /**
+     * @return the most stack the thread has used so far, in bytes, or 0 if
+     * it has not been started. This is found by scanning the stack, so
+     * takes a little time.
+     */
+    uint32_t getPeakUsage(void);
+    /**
+     * @return the stack size to give the thread's constructor: the peak
+     * usage so far plus a safety margin, rounded up to 8 bytes, and no
+     * less than STACK_MIN_RECOMMENDED_BYTES.
+     *
+     * @param margin_percent the safety margin as a percentage of the peak
+     * usage.
+     */
+    uint32_t getRecommendedSize(uint32_t margin_percent = DEFAULT_STACK_MARGIN_PERCENT);
+
+  private:
+    friend class Nano33BLEStackProfiler;
+
+    /* Not copyable, the profiler's list points to it */
+    Nano33BLEThreadStack(const Nano33BLEThreadStack&);
+    Nano33BLEThreadStack& operator=(const Nano33BLEThreadStack&);
+
+    const char* name;
+    uint32_t stackSize;
+    /* NULL until started */
+    rtos::Thread* thread;
+    Nano33BLEThreadStack* next;
+};
+
+/**
+ * @brief Reports the peak stack usage of every thread started with a
+ * Nano33BLEThreadStack, which is every sensor and processing thread in the
+ * library that has been started with begin(). Run the application through its heaviest use (all sensors it
+ * uses running, BLE connected etc.) before reporting, then use the
+ * recommended sizes in the constructors to recover RAM.
+ */
+class Nano33BLEStackProfiler
+{
+  public:
+    /**
+     * @return the number of stacks being profiled, one per started
+     * thread.
+     */
+    uint32_t getCount(void);
+    /**
+     * @return one of the stacks being profiled, or NULL if index is
+     * getCount() or more.
+     */
+    Nano33BLEThreadStack* getStack(uint32_t index);
+    /**
+     * @brief Prints one line per thread: its name, stack size, peak usage
+     * and recommended stack size, e.g. 
+     * "Accelerometer: size 1024, peak 296, recommended 376".
+     *
+     * @param out where to print the report, e.g. Serial.
+     * @param margin_percent the safety margin as a percentage of the peak
+     * usage.
+     */
+    void report(Print& out, uint32_t margin_percent = DEFAULT_STACK_MARGIN_PERCENT);
+
+  private:
+    friend class Nano33BLEThreadStack;
+
+    static void add(Nano33BLEThreadStack* stack);
+    static void remove(Nano33BLEThreadStack* stack);
+
+    /* 
+     * Static and zero initialised, so stacks can be added by global
+     * objects constructed before StackProfiler itself.
+     */
+    static Nano33BLEThreadStack* head;
+};
+
+extern Nano33BLEStackProfiler StackProfiler;
+#endif /* NANO33BLESTACKPROFILER_H_ */
@@ -31,8 +31,8 @@
 /*****************************************************************************/
 /*INLCUDES                                                                   */
 /*****************************************************************************/
-#include "Nano33BLESensorBuffer.h"
-#include "Thread.h"
+#include "Nano33BLESensor.h"
+#include "Nano33BLESensorChannels.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
@@ -43,6 +43,11 @@
  */
 #define DEFAULT_TEMPERATURE_READ_PERIOD_MS                (2000U)
 #define DEFAULT_TEMPERATURE_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* HTS221 turn on time, used when duty cycling the sensor */
+#define TEMPERATURE_WAKE_UP_TIME_MS                    (5U)
+/* Samples the HTS221 averages for each reading */
+#define DEFAULT_TEMPERATURE_AVERAGE_SAMPLES            (16U)
+#define DEFAULT_HUMIDITY_AVERAGE_SAMPLES               (32U)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
@@ -61,39 +66,104 @@ class Nano33BLETemperatureData
 {
   public:
     float temperatureCelsius;
+    /* Relative humidity in % */
     float humidity;
+    float dewPointCelsius;
+    /* Grams of water per cubic metre of air */
+    float absoluteHumidity;
     uint32_t timeStampMs;
 };
 
+/**
+ * Gives generic access to the values in Nano33BLETemperatureData.
+ * Channels in order: temperatureCelsius, humidity, dewPointCelsius,
+ * absoluteHumidity.
+ */
+template<>
+class Nano33BLESensorChannels<Nano33BLETemperatureData>
+{
+  public:
+    enum { CHANNEL_COUNT = 4 };
+    static float get(const Nano33BLETemperatureData& data, uint32_t channel)
+    {
+      switch(channel)
+      {
+        case 0:
+          return (float)data.temperatureCelsius;
+        case 1:
+          return (float)data.humidity;
+        case 2:
+          return (float)data.dewPointCelsius;
+        default:
+          return (float)data.absoluteHumidity;
+      }
+    }
+};
+
 /**
  * @brief This class reads temperature data from the on board Nano 33 BLE
  * Sense temperature sensor using Mbed OS. It stores the results in a ring 
  * buffer (within the Nano33BLESensorBuffer Class) which can be accessed
  * in a manner with softer time constraints than other implementations. 
+ * 
+ * The HTS221 is configured directly: it averages several samples for each
+ * reading, and both temperature and humidity are read in one I2C burst 
+ * once its status says they are ready, and converted with its own 
+ * calibration. For read rates below 1Hz it converts once per read (one 
+ * shot) and powers down in between.
  */
-class Nano33BLETemperature: public Nano33BLESensorBuffer<Nano33BLETemperatureData>
+class Nano33BLETemperature: public Nano33BLESensor<Nano33BLETemperature, Nano33BLETemperatureData>
 {
   public:
-    /**
-     * @brief Initialises the sensor and starts the Mbed OS Thread.
-     * 
-     */
-    void begin()
-    {
-      init();
-      readThread.start(mbed::callback(Nano33BLETemperature::readFunction, this));
-    }
-
     Nano33BLETemperature(
       uint32_t readPeriod_ms = DEFAULT_TEMPERATURE_READ_PERIOD_MS,
       osPriority threadPriority = osPriorityNormal,
       uint32_t threadSize = DEFAULT_TEMPERATURE_THREAD_STACK_SIZE_BYTES) :
-        readPeriod(readPeriod_ms),
-        readThread(
-        threadPriority,
-        threadSize){};
+        Nano33BLESensor<Nano33BLETemperature, Nano33BLETemperatureData>(
+          "Temperature",
+          TRACE_ID_TEMPERATURE,
+          readPeriod_ms,
+          TEMPERATURE_WAKE_UP_TIME_MS,
+          threadPriority,
+          threadSize),
+        calibrated(false),
+        temperatureSlope(0.0F),
+        temperatureOffset(0.0F),
+        humiditySlope(0.0F),
+        humidityOffset(0.0F),
+        configPending(false),
+        outputDataRateCode(0),
+        averageConfiguration(0),
+        oneShot(true){};
+
+    /**
+     * @brief Sets the output data rate of the sensor and the period the
+     * sensor is read at to match it. This can be called at any time, 
+     * including while the sensor thread is running; the sensor thread 
+     * writes the new rate to the HTS221 before its next read.
+     * 
+     * @param rate_Hz the requested output data rate in Hz.
+     * @return the output data rate actually set. This is the
+     * closest rate the HTS221 supports (1Hz, 7Hz or 12.5Hz) that is not
+     * slower than rate_Hz. Rates below 1Hz use one shot conversions at 
+     * exactly rate_Hz.
+     */
+    float setOutputDataRate(float rate_Hz);
+    /**
+     * @brief Sets how many samples the HTS221 averages for each reading.
+     * More samples give less noise, but take longer and use more power; 
+     * the largest settings are too slow for 12.5Hz. The closest supported
+     * counts that are not smaller are used. Like setOutputDataRate(), the
+     * sensor thread writes them to the HTS221 before its next read.
+     * 
+     * @param temperatureSamples 2 to 256.
+     * @param humiditySamples 4 to 512.
+     */
+    void setAveraging(uint32_t temperatureSamples, uint32_t humiditySamples);
 
   private:
+    friend class Nano33BLESensor<Nano33BLETemperature, Nano33BLETemperatureData>;
+
     /**
      * @brief Initialises the accelerometer sensor.
      * 
@@ -105,17 +175,41 @@ class Nano33BLETemperature: public Nano33BLESensorBuffer<Nano33BLETemperatureDat
      * 
      */
     void read(void);
-
-    static void readFunction(Nano33BLETemperature *instance)
-    {
-      while(1)
-      {
-          instance->read();
-      }
-    }
-
-    uint32_t readPeriod;
-    rtos::Thread readThread;
+    /**
+     * @brief Powers the sensor down between duty cycle bursts.
+     * 
+     */
+    void powerDown(void);
+    /**
+     * @brief Powers the sensor back up before a duty cycle burst.
+     * 
+     */
+    void powerUp(void);
+    /**
+     * @brief Reads the HTS221's own calibration, used to convert its raw
+     * output.
+     * 
+     * @return true if the calibration was read.
+     */
+    bool readCalibration(void);
+    /**
+     * @brief Writes the output data rate and averaging asked for by 
+     * setOutputDataRate() and setAveraging() to the HTS221. Only called 
+     * from init() and the read thread, so the writes never land between
+     * reading the status and the output.
+     * 
+     */
+    void configure(void);
+
+    bool calibrated;
+    float temperatureSlope;
+    float temperatureOffset;
+    float humiditySlope;
+    float humidityOffset;
+    volatile bool configPending;
+    volatile uint8_t outputDataRateCode;
+    volatile uint8_t averageConfiguration;
+    bool oneShot;
 };
 
 extern Nano33BLETemperature Temperature;
@@ -26,14 +26,76 @@
 /*****************************************************************************/
 #include "Nano33BLETemperature.h"
 #include <Arduino_HTS221.h>
+#include "Nano33BLEI2CDevice.h"
 
 /*****************************************************************************/
 /*MACROS                                                                     */
 /*****************************************************************************/
+/* HTS221 control register, containing the power down bit */
+#define HTS221_CTRL_REG1                  (0x20U)
+#define HTS221_CTRL_REG1_PD               (0x80U)
+/* Block data update, so the low and high bytes always match */
+#define HTS221_CTRL_REG1_BDU              (0x04U)
+#define HTS221_CTRL_REG1_ODR_MASK         (0x03U)
+#define HTS221_CTRL_REG2                  (0x21U)
+#define HTS221_CTRL_REG2_ONE_SHOT         (0x01U)
+#define HTS221_AV_CONF                    (0x10U)
+#define HTS221_AV_CONF_AVGT_SHIFT         (3U)
+#define HTS221_AV_CONF_MASK               (0x3FU)
+#define HTS221_AV_CONF_MAX_CODE           (7U)
+#define HTS221_STATUS_REG                 (0x27U)
+#define HTS221_STATUS_H_DA                (0x02U)
+#define HTS221_STATUS_T_DA                (0x01U)
+/* Humidity then temperature, low byte first */
+#define HTS221_HUMIDITY_OUT_L             (0x28U)
+#define HTS221_OUTPUT_SIZE                (4U)
+#define HTS221_CALIBRATION_START          (0x30U)
+#define HTS221_CALIBRATION_SIZE           (16U)
+/* Set in the register address to read several registers in one go */
+#define HTS221_AUTO_INCREMENT             (0x80U)
+
+/* Magnus formula constants (over water, -45C to 60C) */
+#define MAGNUS_B                          (17.62F)
+#define MAGNUS_C_CELSIUS                  (243.12F)
+#define MAGNUS_SATURATION_HPA             (6.112F)
+/* Grams per cubic metre per (hPa / K), from the gas constant of water */
+#define ABSOLUTE_HUMIDITY_SCALE           (216.74F)
 
 /*****************************************************************************/
 /*GLOBAL Data                                                                */
 /*****************************************************************************/
+/* HTS221 continuous output data rates in Hz. Index + 1 is the ODR code */
+static const float temperatureOutputDataRates[] = {1.0F, 7.0F, 12.5F};
+
+/*****************************************************************************/
+/*LOCAL FUNCTION IMPLEMENTATION                                              */
+/*****************************************************************************/
+/**
+ * @brief Calculates the dew point and absolute humidity from the 
+ * temperature and relative humidity.
+ */
+static void calculateHumidity(Nano33BLETemperatureData& data)
+{
+  float humidity;
+  float gamma;
+  float saturation;
+
+  humidity = data.humidity;
+  if(humidity < 0.1F)
+  {
+    humidity = 0.1F;
+  }
+
+  gamma = logf(humidity / 100.0F) + 
+    ((MAGNUS_B * data.temperatureCelsius) / (MAGNUS_C_CELSIUS + data.temperatureCelsius));
+  data.dewPointCelsius = (MAGNUS_C_CELSIUS * gamma) / (MAGNUS_B - gamma);
+
+  saturation = MAGNUS_SATURATION_HPA * 
+    expf((MAGNUS_B * data.temperatureCelsius) / (MAGNUS_C_CELSIUS + data.temperatureCelsius));
+  data.absoluteHumidity = (ABSOLUTE_HUMIDITY_SCALE * saturation * (data.humidity / 100.0F)) / 
+    (273.15F + data.temperatureCelsius);
+  return;
+}
 
 /*****************************************************************************/
 /*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
@@ -55,6 +117,22 @@ void Nano33BLETemperature::init()
     /* Something went wrong... Put this thread to sleep indefinetely. */
     osSignalWait(0x0001, osWaitForever);
   }
+
+  /* Without the calibration the Arduino library is used to read instead */
+  this->calibrated = readCalibration();
+  if(this->calibrated)
+  {
+    Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+
+    hts.updateRegister(HTS221_CTRL_REG1, HTS221_CTRL_REG1_BDU, HTS221_CTRL_REG1_BDU);
+    setAveraging(DEFAULT_TEMPERATURE_AVERAGE_SAMPLES, DEFAULT_HUMIDITY_AVERAGE_SAMPLES);
+    setOutputDataRate(this->scheduler.getRate());
+    configure();
+    if(this->oneShot)
+    {
+      hts.writeRegister(HTS221_CTRL_REG2, HTS221_CTRL_REG2_ONE_SHOT);
+    }
+  }
   return;
 }
 
@@ -77,16 +155,184 @@ void Nano33BLETemperature::read(void)
    * once here.
    */
   Nano33BLETemperatureData data;
+  Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+  uint8_t status;
+  uint8_t output[HTS221_OUTPUT_SIZE];
 
-  data.humidity = HTS.readHumidity();
-  data.temperatureCelsius = HTS.readTemperature();
-  data.timeStampMs = millis();
-  push(data);
+  if(!this->calibrated)
+  {
+    data.humidity = HTS.readHumidity();
+    data.temperatureCelsius = HTS.readTemperature();
+    calculateHumidity(data);
+    publish(data);
+  }
+  else
+  {
+    /* Settings changed by setOutputDataRate() or setAveraging() */
+    if(this->configPending)
+    {
+      configure();
+    }
 
-  /* This is required for the timing of the reading of
-   * the sensor. Do not delete it.
-   */
-  rtos::ThisThread::sleep_for(this->readPeriod);
+    /* Only read once both values are ready, and read them in one burst */
+    if(hts.readRegister(HTS221_STATUS_REG, status) &&
+      ((status & (HTS221_STATUS_H_DA | HTS221_STATUS_T_DA)) == 
+        (HTS221_STATUS_H_DA | HTS221_STATUS_T_DA)) &&
+      hts.readRegisters(HTS221_AUTO_INCREMENT | HTS221_HUMIDITY_OUT_L, output, sizeof(output)))
+    {
+      data.humidity = (this->humiditySlope * (int16_t)((output[1] << 8) | output[0])) + 
+        this->humidityOffset;
+      if(data.humidity < 0.0F)
+      {
+        data.humidity = 0.0F;
+      }
+      else if(data.humidity > 100.0F)
+      {
+        data.humidity = 100.0F;
+      }
+      data.temperatureCelsius = (this->temperatureSlope * (int16_t)((output[3] << 8) | output[2])) + 
+        this->temperatureOffset;
+      calculateHumidity(data);
+      publish(data);
+    }
+
+    /* Start the conversion for the next read, so it is ready by then */
+    if(this->oneShot)
+    {
+      hts.writeRegister(HTS221_CTRL_REG2, HTS221_CTRL_REG2_ONE_SHOT);
+    }
+  }
+
+  return;
+}
+
+float Nano33BLETemperature::setOutputDataRate(float rate_Hz)
+{
+  const uint32_t rateCount = 
+    sizeof(temperatureOutputDataRates)/sizeof(temperatureOutputDataRates[0]);
+  uint32_t ii;
+
+  if(!this->calibrated || (rate_Hz < temperatureOutputDataRates[0]))
+  {
+    /* One shot conversions, triggered by each read, so the HTS221 does no
+     * more conversions than needed and only the read period needs 
+     * changing.
+     */
+    this->outputDataRateCode = 0;
+    this->configPending = true;
+    this->scheduler.setRate(rate_Hz);
+    return this->scheduler.getRate();
+  }
+
+  /* Find the slowest supported rate that is at least as fast as requested */
+  for(ii = 0; ii < (rateCount - 1); ii++)
+  {
+    if(temperatureOutputDataRates[ii] >= rate_Hz)
+    {
+      break;
+    }
+  }
+
+  /* The read thread writes it to the sensor */
+  this->outputDataRateCode = (uint8_t)(ii + 1U);
+  this->configPending = true;
+  this->scheduler.setRate(temperatureOutputDataRates[ii]);
+  return temperatureOutputDataRates[ii];
+}
+
+void Nano33BLETemperature::setAveraging(uint32_t temperatureSamples, uint32_t humiditySamples)
+{
+  uint8_t temperatureCode;
+  uint8_t humidityCode;
+
+  /* Temperature averages 2 << code samples, humidity 4 << code */
+  temperatureCode = 0;
+  while((temperatureCode < HTS221_AV_CONF_MAX_CODE) && 
+    ((2UL << temperatureCode) < temperatureSamples))
+  {
+    temperatureCode++;
+  }
+  humidityCode = 0;
+  while((humidityCode < HTS221_AV_CONF_MAX_CODE) && 
+    ((4UL << humidityCode) < humiditySamples))
+  {
+    humidityCode++;
+  }
+
+  /* The read thread writes it to the sensor */
+  this->averageConfiguration = 
+    (uint8_t)((temperatureCode << HTS221_AV_CONF_AVGT_SHIFT) | humidityCode);
+  this->configPending = true;
+  return;
+}
+
+void Nano33BLETemperature::powerDown(void)
+{
+  Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+
+  hts.updateRegister(HTS221_CTRL_REG1, HTS221_CTRL_REG1_PD, 0);
+  return;
+}
+
+void Nano33BLETemperature::powerUp(void)
+{
+  Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+
+  hts.updateRegister(HTS221_CTRL_REG1, HTS221_CTRL_REG1_PD, HTS221_CTRL_REG1_PD);
+  return;
+}
+
+bool Nano33BLETemperature::readCalibration(void)
+{
+  Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+  uint8_t calibration[HTS221_CALIBRATION_SIZE];
+  float humidity0;
+  float humidity1;
+  float temperature0;
+  float temperature1;
+  int16_t humidity0Output;
+  int16_t humidity1Output;
+  int16_t temperature0Output;
+  int16_t temperature1Output;
+
+  if(!hts.readRegisters(HTS221_AUTO_INCREMENT | HTS221_CALIBRATION_START, calibration, sizeof(calibration)))
+  {
+    return false;
+  }
+
+  /* Register layout from 0x30, see the HTS221 datasheet */
+  humidity0 = calibration[0] / 2.0F;
+  humidity1 = calibration[1] / 2.0F;
+  temperature0 = (((calibration[5] & 0x03U) << 8) | calibration[2]) / 8.0F;
+  temperature1 = (((calibration[5] & 0x0CU) << 6) | calibration[3]) / 8.0F;
+  humidity0Output = (int16_t)((calibration[7] << 8) | calibration[6]);
+  humidity1Output = (int16_t)((calibration[11] << 8) | calibration[10]);
+  temperature0Output = (int16_t)((calibration[13] << 8) | calibration[12]);
+  temperature1Output = (int16_t)((calibration[15] << 8) | calibration[14]);
+
+  if((humidity1Output == humidity0Output) || (temperature1Output == temperature0Output))
+  {
+    return false;
+  }
+
+  this->humiditySlope = (humidity1 - humidity0) / (humidity1Output - humidity0Output);
+  this->humidityOffset = humidity0 - (this->humiditySlope * humidity0Output);
+  this->temperatureSlope = (temperature1 - temperature0) / (temperature1Output - temperature0Output);
+  this->temperatureOffset = temperature0 - (this->temperatureSlope * temperature0Output);
+  return true;
+}
+
+void Nano33BLETemperature::configure(void)
+{
+  Nano33BLEI2CDevice hts(HTS221_ADDRESS);
+  uint8_t outputDataRate;
+
+  /* Cleared first, so a change made while writing is written next time */
+  this->configPending = false;
+  outputDataRate = this->outputDataRateCode;
+  hts.updateRegister(HTS221_AV_CONF, HTS221_AV_CONF_MASK, this->averageConfiguration);
+  hts.updateRegister(HTS221_CTRL_REG1, HTS221_CTRL_REG1_ODR_MASK, outputDataRate);
+  this->oneShot = (outputDataRate == 0U);
   return;
 }
 
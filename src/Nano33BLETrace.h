@@ -0,0 +1,94 @@
+/*
+  Nano33BLETrace.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This file defines the ids each sensor is traced with, and the interfaces
+  that let every push to a Nano33BLESensorBuffer be recorded and replayed
+  (see Nano33BLERecorder).
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLETRACE_H_
+#define NANO33BLETRACE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Arduino.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+/* Buffers with this id are not traced, e.g. stages derived from sensors */
+#define TRACE_ID_NONE                 (0U)
+#define TRACE_ID_ACCELEROMETER        (1U)
+#define TRACE_ID_GYROSCOPE            (2U)
+#define TRACE_ID_MAGNETIC             (3U)
+#define TRACE_ID_PROXIMITY            (4U)
+#define TRACE_ID_COLOUR               (5U)
+#define TRACE_ID_GESTURE              (6U)
+#define TRACE_ID_PRESSURE             (7U)
+#define TRACE_ID_TEMPERATURE          (8U)
+#define TRACE_ID_MICROPHONE_RMS       (9U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief This class is the interface to something that records every push
+ * to every traced buffer. Only one can be active at a time, set in 
+ * TraceSink.
+ */
+class Nano33BLETraceSink
+{
+  public:
+    virtual ~Nano33BLETraceSink(){};
+
+    /**
+     * @brief Called from the pushing thread, after the data is in the 
+     * buffer.
+     */
+    virtual void trace(uint8_t traceId, const void* data, uint32_t size) = 0;
+};
+
+/**
+ * @brief This class is the interface a traced buffer gives to replay 
+ * recorded data into it.
+ */
+class Nano33BLETraceTarget
+{
+  public:
+    virtual ~Nano33BLETraceTarget(){};
+
+    virtual uint8_t getTraceId(void) = 0;
+    /**
+     * @brief Pushes recorded data as if it had just been read.
+     * 
+     * @return false if size does not match the buffer's data.
+     */
+    virtual bool replay(const void* data, uint32_t size) = 0;
+};
+
+/* The active sink, or NULL when nothing is being recorded */
+extern Nano33BLETraceSink* volatile TraceSink;
+
+#endif /* NANO33BLETRACE_H_ */
@@ -0,0 +1,516 @@
+/*
+  Nano33BLETriggerCapture.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class implements oscilloscope style event capture for any sensor's
+  data using Mbed OS. It keeps the latest readings of a sensor, and when a
+  trigger condition is met (e.g. an impact or a loud sound) it freezes the
+  readings from just before the trigger and just after it into a capture
+  slot, without stopping the sensor.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLETRIGGERCAPTURE_H_
+#define NANO33BLETRIGGERCAPTURE_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Nano33BLEHistory.h"
+#include "Mutex.h"
+#include "ConditionVariable.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_TRIGGER_CAPTURE_THREAD_STACK_SIZE_BYTES   (1024U)
+/* How long to wait for data from the source sensor in one read */
+#define TRIGGER_CAPTURE_READ_TIMEOUT_MS                   (1000U)
+/* Default number of readings kept from before and after the trigger */
+#define DEFAULT_TRIGGER_CAPTURE_PRE_SIZE                  (32U)
+#define DEFAULT_TRIGGER_CAPTURE_POST_SIZE                 (32U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * @brief Decides when a Nano33BLETriggerCapture triggers, for conditions
+ * the built in level and slope triggers cannot express. Set with
+ * Nano33BLETriggerCapture::setTrigger().
+ */
+template<class T>
+class Nano33BLETriggerCondition
+{
+  public:
+    /**
+     * @brief Called from the capture thread with every reading.
+     *
+     * @param previous the reading before data.
+     * @param data the new reading.
+     * @return true if data is the trigger.
+     */
+    virtual bool triggered(const T& previous, const T& data) = 0;
+};
+
+/**
+ * @brief This class reads a source sensor through its own
+ * Nano33BLESensorReader, so it sees every reading however the sensor's own
+ * buffer is popped, and keeps the last PRE_SIZE readings. When a reading
+ * meets the trigger condition, the kept readings, the trigger reading and
+ * the next POST_SIZE readings are copied into the capture slot, which is
+ * then frozen until it is read with getCapture().
+ *
+ * e.g. capture impacts on the x axis of the accelerometer:
+ *
+ *   Nano33BLETriggerCapture<Nano33BLEAccelerometerData> impact(Accelerometer);
+ *   impact.setLevelTrigger(0, 2.0F, Nano33BLETriggerCapture<Nano33BLEAccelerometerData>::TRIGGER_EITHER);
+ *   impact.begin();
+ *
+ * Triggers while a capture is being filled or is frozen are not captured,
+ * and are counted as missed. Channels are those of
+ * Nano33BLESensorChannels<T>. PRE_SIZE must be at least 1, as the trigger
+ * compares each reading with the one before.
+ */
+template<class T,
+  uint32_t PRE_SIZE = DEFAULT_TRIGGER_CAPTURE_PRE_SIZE,
+  uint32_t POST_SIZE = DEFAULT_TRIGGER_CAPTURE_POST_SIZE>
+class Nano33BLETriggerCapture
+{
+  static_assert(PRE_SIZE >= 1U, "PRE_SIZE must be at least 1");
+
+  public:
+    enum { CHANNEL_COUNT = Nano33BLESensorChannels<T>::CHANNEL_COUNT };
+    /* The most readings in one capture */
+    enum { CAPTURE_SIZE = PRE_SIZE + 1U + POST_SIZE };
+
+    enum TRIGGER_EDGE
+    {
+      /* The channel goes up through the level, or rises by the slope */
+      TRIGGER_RISING,
+      /* The channel goes down through the level, or falls by the slope */
+      TRIGGER_FALLING,
+      /* Either of the above */
+      TRIGGER_EITHER
+    };
+
+    /**
+     * @brief Starts the Mbed OS Thread that reads the source sensor.
+     *
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLETriggerCapture::readFunction, this));
+    }
+
+    Nano33BLETriggerCapture(
+      Nano33BLESensorBuffer<T>& source,
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_TRIGGER_CAPTURE_THREAD_STACK_SIZE_BYTES) :
+        sourceReader(source),
+        triggerType(TRIGGER_LEVEL),
+        triggerChannel(0),
+        triggerEdge(TRIGGER_RISING),
+        triggerAmount(0.0F),
+        condition(NULL),
+        hasPrevious(false),
+        state(CAPTURE_ARMED),
+        captureCount(0),
+        triggerIndex(0),
+        postRemaining(0),
+        captureStartOverrunCount(0),
+        captureOverrunCount(0),
+        triggerCount(0),
+        missedTriggerCount(0),
+        captureFrozen(captureMutex),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "Trigger"),
+        readStack("Trigger", threadSize){};
+
+    /**
+     * @brief Triggers when a channel crosses a level. A reading exactly on
+     * the level counts as having crossed it.
+     *
+     * @param channel the channel, in the order given by its
+     * Nano33BLESensorChannels specialisation.
+     * @param level the level in the channel's units.
+     * @param edge which direction of crossing triggers.
+     */
+    void setLevelTrigger(uint32_t channel, float level, enum TRIGGER_EDGE edge = TRIGGER_RISING)
+    {
+      setTrigger(TRIGGER_LEVEL, channel, level, edge);
+      return;
+    }
+
+    /**
+     * @brief Triggers when a channel changes by at least slope from one
+     * reading to the next, e.g. the sharp edge of an impact.
+     *
+     * @param slope the change between consecutive readings in the
+     * channel's units. This is per reading rather than per second, so it
+     * depends on the sensor's output data rate.
+     * @param edge which direction of change triggers.
+     */
+    void setSlopeTrigger(uint32_t channel, float slope, enum TRIGGER_EDGE edge = TRIGGER_RISING)
+    {
+      setTrigger(TRIGGER_SLOPE, channel, fabsf(slope), edge);
+      return;
+    }
+
+    /**
+     * @brief Sets a trigger condition of your own in place of the level or
+     * slope trigger.
+     *
+     * @param triggerCondition the condition. NULL goes back to the last
+     * level or slope trigger set.
+     */
+    void setTrigger(Nano33BLETriggerCondition<T>* triggerCondition)
+    {
+      this->captureMutex.lock();
+      this->condition = triggerCondition;
+      this->captureMutex.unlock();
+      return;
+    }
+
+    /**
+     * @brief Blocks the calling thread until a capture is frozen or the
+     * timeout expires.
+     *
+     * @param timeout_ms the longest time to wait. osWaitForever waits
+     * forever.
+     * @return true if a capture is frozen and ready for getCapture().
+     */
+    bool waitForCapture(uint32_t timeout_ms = osWaitForever);
+    /**
+     * @brief Copies the frozen capture, oldest reading first, and re-arms
+     * the trigger. There are fewer than PRE_SIZE readings before the
+     * trigger if it happened soon after begin(). If the capture thread fell
+     * more than the source sensor's buffer behind, the readings it missed
+     * are not in the capture, so it covers a longer time.
+     *
+     * @param buffer room for size readings. At most CAPTURE_SIZE are
+     * copied.
+     * @param index set to the index of the trigger reading in buffer.
+     * @param overruns set to the number of readings missing from between
+     * the first and last readings of the capture. 0 if it is complete.
+     * @return the number of readings copied, or 0 if no capture is frozen.
+     */
+    uint32_t getCapture(T* buffer, uint32_t size, uint32_t& index, uint32_t& overruns);
+    uint32_t getCapture(T* buffer, uint32_t size, uint32_t& index)
+    {
+      uint32_t overruns;
+
+      return getCapture(buffer, size, index, overruns);
+    }
+    /**
+     * @return the number of captures started.
+     */
+    uint32_t getTriggerCount(void)
+    {
+      return this->triggerCount;
+    }
+    /**
+     * @return the number of triggers while a capture was being filled or
+     * was frozen waiting for getCapture().
+     */
+    uint32_t getMissedTriggerCount(void)
+    {
+      return this->missedTriggerCount;
+    }
+    /**
+     * @brief Waits up to TRIGGER_CAPTURE_READ_TIMEOUT_MS for one reading
+     * from the source sensor and adds it to the capture. The capture's
+     * thread calls this over and over once begun. It can be called from
+     * another thread instead of calling begin().
+     *
+     */
+    void read(void);
+
+  private:
+    enum TRIGGER_TYPE
+    {
+      TRIGGER_LEVEL,
+      TRIGGER_SLOPE
+    };
+
+    enum CAPTURE_STATE
+    {
+      /* Waiting for a trigger */
+      CAPTURE_ARMED,
+      /* Triggered, filling in the readings after the trigger */
+      CAPTURE_POST_TRIGGER,
+      /* Complete, waiting for getCapture() */
+      CAPTURE_FROZEN
+    };
+
+    void setTrigger(enum TRIGGER_TYPE type, uint32_t channel, float amount, enum TRIGGER_EDGE edge);
+    /**
+     * @param overruns the source reader's overrun count when data was
+     * read.
+     */
+    void add(const T& data, uint32_t overruns);
+    /* Must be called with captureMutex locked */
+    bool isTrigger(const T& data);
+
+    static void readFunction(Nano33BLETriggerCapture *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<T> sourceReader;
+    enum TRIGGER_TYPE triggerType;
+    uint32_t triggerChannel;
+    enum TRIGGER_EDGE triggerEdge;
+    float triggerAmount;
+    Nano33BLETriggerCondition<T>* condition;
+    T previous;
+    bool hasPrevious;
+    Nano33BLEHistoryRing<T, PRE_SIZE> preTrigger;
+    /* The source reader's overrun count when each preTrigger reading was read */
+    Nano33BLEHistoryRing<uint32_t, PRE_SIZE> preTriggerOverruns;
+    volatile enum CAPTURE_STATE state;
+    T capture[CAPTURE_SIZE];
+    uint32_t captureCount;
+    uint32_t triggerIndex;
+    uint32_t postRemaining;
+    /* The source overrun count at the first reading of the capture */
+    uint32_t captureStartOverrunCount;
+    uint32_t captureOverrunCount;
+    volatile uint32_t triggerCount;
+    volatile uint32_t missedTriggerCount;
+    rtos::Mutex captureMutex;
+    rtos::ConditionVariable captureFrozen;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+bool Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::waitForCapture(uint32_t timeout_ms)
+{
+  uint64_t deadline_ms;
+  uint64_t now_ms;
+  bool frozen;
+
+  deadline_ms = rtos::Kernel::get_ms_count() + timeout_ms;
+
+  this->captureMutex.lock();
+  while(this->state != CAPTURE_FROZEN)
+  {
+    if(timeout_ms == osWaitForever)
+    {
+      this->captureFrozen.wait();
+    }
+    else
+    {
+      now_ms = rtos::Kernel::get_ms_count();
+      if(now_ms >= deadline_ms)
+      {
+        break;
+      }
+      this->captureFrozen.wait_for((uint32_t)(deadline_ms - now_ms));
+    }
+  }
+  frozen = (this->state == CAPTURE_FROZEN);
+  this->captureMutex.unlock();
+
+  return frozen;
+}
+
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+uint32_t Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::getCapture(
+  T* buffer,
+  uint32_t size,
+  uint32_t& index,
+  uint32_t& overruns)
+{
+  uint32_t copied;
+  uint32_t ii;
+
+  this->captureMutex.lock();
+  if(this->state != CAPTURE_FROZEN)
+  {
+    this->captureMutex.unlock();
+    return 0;
+  }
+
+  copied = (this->captureCount < size) ? this->captureCount : size;
+  for(ii = 0; ii < copied; ii++)
+  {
+    buffer[ii] = this->capture[ii];
+  }
+  index = this->triggerIndex;
+  overruns = this->captureOverrunCount;
+  this->state = CAPTURE_ARMED;
+  this->captureMutex.unlock();
+
+  return copied;
+}
+
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+void Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::setTrigger(
+  enum TRIGGER_TYPE type,
+  uint32_t channel,
+  float amount,
+  enum TRIGGER_EDGE edge)
+{
+  if(channel >= CHANNEL_COUNT)
+  {
+    return;
+  }
+
+  this->captureMutex.lock();
+  this->triggerType = type;
+  this->triggerChannel = channel;
+  this->triggerAmount = amount;
+  this->triggerEdge = edge;
+  this->condition = NULL;
+  this->captureMutex.unlock();
+  return;
+}
+
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+void Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::read(void)
+{
+  T data;
+
+  if(this->sourceReader.popWait(data, TRIGGER_CAPTURE_READ_TIMEOUT_MS))
+  {
+    add(data, this->sourceReader.getOverrunCount());
+  }
+  return;
+}
+
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+void Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::add(const T& data, uint32_t overruns)
+{
+  uint32_t ii;
+  bool trigger;
+
+  this->captureMutex.lock();
+  trigger = this->hasPrevious && isTrigger(data);
+
+  if(this->state == CAPTURE_POST_TRIGGER)
+  {
+    this->capture[this->captureCount] = data;
+    this->captureCount++;
+    this->postRemaining--;
+    if(this->postRemaining == 0U)
+    {
+      this->captureOverrunCount = overruns - this->captureStartOverrunCount;
+      this->state = CAPTURE_FROZEN;
+      this->captureFrozen.notify_all();
+    }
+  }
+
+  if(trigger)
+  {
+    if(this->state == CAPTURE_ARMED)
+    {
+      /* Freeze the readings before the trigger, then fill in the rest */
+      for(ii = 0; ii < this->preTrigger.getCount(); ii++)
+      {
+        this->capture[ii] = this->preTrigger.get(ii);
+      }
+      this->triggerIndex = this->preTrigger.getCount();
+      this->capture[this->triggerIndex] = data;
+      this->captureCount = this->triggerIndex + 1U;
+      this->captureStartOverrunCount = (this->triggerIndex > 0U) ? 
+        this->preTriggerOverruns.get(0) : overruns;
+      this->postRemaining = POST_SIZE;
+      this->triggerCount++;
+      if(POST_SIZE == 0U)
+      {
+        this->captureOverrunCount = overruns - this->captureStartOverrunCount;
+        this->state = CAPTURE_FROZEN;
+        this->captureFrozen.notify_all();
+      }
+      else
+      {
+        this->state = CAPTURE_POST_TRIGGER;
+      }
+    }
+    else
+    {
+      this->missedTriggerCount++;
+    }
+  }
+  this->captureMutex.unlock();
+
+  /* Kept whatever the state, so the next capture has its pre trigger
+   * readings as soon as it is armed again */
+  this->preTrigger.add(data);
+  this->preTriggerOverruns.add(overruns);
+  this->previous = data;
+  this->hasPrevious = true;
+  return;
+}
+
+template<class T, uint32_t PRE_SIZE, uint32_t POST_SIZE>
+bool Nano33BLETriggerCapture<T, PRE_SIZE, POST_SIZE>::isTrigger(const T& data)
+{
+  float before;
+  float after;
+  bool rising;
+  bool falling;
+
+  if(this->condition != NULL)
+  {
+    return this->condition->triggered(this->previous, data);
+  }
+
+  before = Nano33BLESensorChannels<T>::get(this->previous, this->triggerChannel);
+  after = Nano33BLESensorChannels<T>::get(data, this->triggerChannel);
+  if(this->triggerType == TRIGGER_LEVEL)
+  {
+    rising = (before < this->triggerAmount) && (after >= this->triggerAmount);
+    falling = (before > this->triggerAmount) && (after <= this->triggerAmount);
+  }
+  else
+  {
+    rising = ((after - before) >= this->triggerAmount);
+    falling = ((before - after) >= this->triggerAmount);
+  }
+
+  switch(this->triggerEdge)
+  {
+    case TRIGGER_RISING:
+      return rising;
+    case TRIGGER_FALLING:
+      return falling;
+    default:
+      return (rising || falling);
+  }
+}
+
+#endif /* NANO33BLETRIGGERCAPTURE_H_ */
\ No newline at end of file
@@ -0,0 +1,388 @@
+/*
+  Nano33BLEWindowFeatures.h
+  Copyright (c) 2020 Dale Giancono. All rights reserved..
+
+  This class calculates statistics over a sliding window of any sensor's
+  data using Mbed OS. The statistics are updated as each reading arrives
+  rather than recalculated for every window, and are stored in a ring
+  buffer (within the Nano33BLESensorBuffer Class) every hop size readings.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*****************************************************************************/
+/*INLCUDE GUARD                                                              */
+/*****************************************************************************/
+#ifndef NANO33BLEWINDOWFEATURES_H_
+#define NANO33BLEWINDOWFEATURES_H_
+
+/*****************************************************************************/
+/*INLCUDES                                                                   */
+/*****************************************************************************/
+#include "Nano33BLESensorBuffer.h"
+#include "Nano33BLESensorChannels.h"
+#include "Thread.h"
+#include "Nano33BLEStackProfiler.h"
+
+/*****************************************************************************/
+/*MACROS                                                                     */
+/*****************************************************************************/
+#define DEFAULT_WINDOW_FEATURES_THREAD_STACK_SIZE_BYTES       (1024U) 
+/* How long to wait for data from the source sensor in one read */
+#define WINDOW_FEATURES_READ_TIMEOUT_MS                       (1000U)
+
+/*****************************************************************************/
+/*GLOBAL Data                                                                */
+/*****************************************************************************/
+
+/*****************************************************************************/
+/*CLASS DECLARATION                                                          */
+/*****************************************************************************/
+/**
+ * This class holds the statistics of one window, for each channel of the
+ * source sensor's data (see Nano33BLESensorChannels).
+ */
+template<uint32_t CHANNEL_COUNT>
+class Nano33BLEWindowFeaturesData
+{
+  public:
+    float mean[CHANNEL_COUNT];
+    float variance[CHANNEL_COUNT];
+    float min[CHANNEL_COUNT];
+    float max[CHANNEL_COUNT];
+    float rms[CHANNEL_COUNT];
+    float peakToPeak[CHANNEL_COUNT];
+    uint32_t zeroCrossings[CHANNEL_COUNT];
+    /* Time stamp of the newest reading in the window */
+    uint32_t timeStampMs;
+};
+
+/**
+ * @brief This class keeps the sliding window statistics of one channel. Each
+ * reading is added in O(1): sums are updated by adding the new value and 
+ * subtracting the one leaving the window, and min/max are kept with 
+ * monotonic deques. The sums are recalculated from the window once every
+ * WINDOW_SIZE readings so float rounding errors cannot build up.
+ */
+template<uint32_t WINDOW_SIZE>
+class Nano33BLEWindowChannel
+{
+  public:
+    Nano33BLEWindowChannel() :
+      count(0),
+      newest(0),
+      sum(0.0F),
+      sumOfSquares(0.0F),
+      zeroCrossings(0),
+      sequence(0),
+      minHead(0),
+      minSize(0),
+      maxHead(0),
+      maxSize(0){};
+
+    void add(float value);
+    bool isFull(void) { return (count == WINDOW_SIZE); }
+    float getMean(void) { return (sum / count); }
+    float getVariance(void);
+    float getRMS(void) { return sqrtf(sumOfSquares / count); }
+    float getMin(void) { return minDeque[minHead].value; }
+    float getMax(void) { return maxDeque[maxHead].value; }
+    uint32_t getZeroCrossings(void) { return zeroCrossings; }
+
+  private:
+    class Entry
+    {
+      public:
+        float value;
+        uint32_t sequence;
+    };
+
+    static bool isCrossing(float a, float b)
+    {
+      return ((a < 0.0F) != (b < 0.0F));
+    }
+    static void pushDeque(Entry* deque, uint32_t& head, uint32_t& size, 
+      float value, uint32_t sequence, bool keepMin);
+    static void expireDeque(Entry* deque, uint32_t& head, uint32_t& size,
+      uint32_t oldestSequence);
+
+    float values[WINDOW_SIZE];
+    uint32_t count;
+    /* Index of the newest value in values */
+    uint32_t newest;
+    float sum;
+    float sumOfSquares;
+    uint32_t zeroCrossings;
+    uint32_t sequence;
+    Entry minDeque[WINDOW_SIZE];
+    uint32_t minHead;
+    uint32_t minSize;
+    Entry maxDeque[WINDOW_SIZE];
+    uint32_t maxHead;
+    uint32_t maxSize;
+};
+
+/**
+ * @brief This class calculates mean, variance, min, max, RMS, peak to peak 
+ * and zero crossing count over the last WINDOW_SIZE readings of any sensor,
+ * for each channel of its data. Every hop size readings (once the window is
+ * full) the statistics are pushed to this class's own buffer, so they can be
+ * popped like any other sensor data. It reads the source sensor through its
+ * own Nano33BLESensorReader, so it does not take data from other consumers.
+ * 
+ * e.g. Nano33BLEWindowFeatures<Nano33BLEAccelerometerData, 64> 
+ *        accelerometerFeatures(Accelerometer, 32);
+ */
+template<class T, uint32_t WINDOW_SIZE>
+class Nano33BLEWindowFeatures: 
+  public Nano33BLESensorBuffer<Nano33BLEWindowFeaturesData<Nano33BLESensorChannels<T>::CHANNEL_COUNT> >
+{
+  public:
+    typedef Nano33BLEWindowFeaturesData<Nano33BLESensorChannels<T>::CHANNEL_COUNT> Data;
+
+    /**
+     * @brief Starts the Mbed OS Thread that reads the source sensor.
+     * 
+     */
+    void begin()
+    {
+      readStack.start(readThread, mbed::callback(Nano33BLEWindowFeatures::readFunction, this));
+    }
+
+    Nano33BLEWindowFeatures(
+      Nano33BLESensorBuffer<T>& source,
+      uint32_t hopSize = WINDOW_SIZE,
+      osPriority threadPriority = osPriorityNormal,
+      uint32_t threadSize = DEFAULT_WINDOW_FEATURES_THREAD_STACK_SIZE_BYTES) :
+        sourceReader(source),
+        hop(hopSize),
+        readingsSinceOutput(0),
+        readThread(
+        threadPriority,
+        threadSize,
+        NULL,
+        "WindowFeatures"),
+        readStack("WindowFeatures", threadSize){};
+
+    /**
+     * @param hopSize how many new readings between each output of the
+     * statistics. A hop size of WINDOW_SIZE gives windows that do not
+     * overlap.
+     */
+    void setHopSize(uint32_t hopSize)
+    {
+      hop = hopSize;
+    }
+
+  private:
+    enum { CHANNEL_COUNT = Nano33BLESensorChannels<T>::CHANNEL_COUNT };
+
+    /**
+     * @brief Waits for one reading from the source sensor and adds it to 
+     * the window.
+     * 
+     */
+    void read(void);
+
+    static void readFunction(Nano33BLEWindowFeatures *instance)
+    {
+      while(1)
+      {
+          instance->read();
+      }
+    }
+
+    Nano33BLESensorReader<T> sourceReader;
+    Nano33BLEWindowChannel<WINDOW_SIZE> channels[CHANNEL_COUNT];
+    volatile uint32_t hop;
+    uint32_t readingsSinceOutput;
+    rtos::Thread readThread;
+    Nano33BLEThreadStack readStack;
+};
+
+/*****************************************************************************/
+/*CLASS MEMBER FUNCTION IMPLEMENTATION                                       */
+/*****************************************************************************/
+template<uint32_t WINDOW_SIZE> void Nano33BLEWindowChannel<WINDOW_SIZE>::add(float value)
+{
+  uint32_t oldest;
+  float leaving;
+  uint32_t ii;
+
+  if(this->count == WINDOW_SIZE)
+  {
+    /* The oldest value is the one after the newest, and leaves the window */
+    oldest = this->newest + 1U;
+    if(oldest >= WINDOW_SIZE)
+    {
+      oldest = 0;
+    }
+    leaving = this->values[oldest];
+    this->sum -= leaving;
+    this->sumOfSquares -= leaving * leaving;
+
+    /* Remove the crossing between the leaving value and the one after it */
+    ii = oldest + 1U;
+    if(ii >= WINDOW_SIZE)
+    {
+      ii = 0;
+    }
+    if(isCrossing(leaving, this->values[ii]))
+    {
+      this->zeroCrossings--;
+    }
+
+    this->newest = oldest;
+  }
+  else
+  {
+    if(this->count != 0U)
+    {
+      this->newest++;
+    }
+    this->count++;
+  }
+
+  if((this->count > 1U) && 
+    isCrossing(this->values[(this->newest + WINDOW_SIZE - 1U) % WINDOW_SIZE], value))
+  {
+    this->zeroCrossings++;
+  }
+  this->values[this->newest] = value;
+  this->sum += value;
+  this->sumOfSquares += value * value;
+
+  /* 
+   * The value leaving the window is expired before the new one is pushed,
+   * so a deque never holds more than WINDOW_SIZE entries (e.g. every value
+   * of a rising ramp in the min deque).
+   */
+  this->sequence++;
+  expireDeque(this->minDeque, this->minHead, this->minSize, this->sequence - (this->count - 1U));
+  expireDeque(this->maxDeque, this->maxHead, this->maxSize, this->sequence - (this->count - 1U));
+  pushDeque(this->minDeque, this->minHead, this->minSize, value, this->sequence, true);
+  pushDeque(this->maxDeque, this->maxHead, this->maxSize, value, this->sequence, false);
+
+  /* Stop float rounding errors in the running sums from building up */
+  if((this->sequence % WINDOW_SIZE) == 0U)
+  {
+    this->sum = 0.0F;
+    this->sumOfSquares = 0.0F;
+    for(ii = 0; ii < this->count; ii++)
+    {
+      this->sum += this->values[ii];
+      this->sumOfSquares += this->values[ii] * this->values[ii];
+    }
+  }
+  return;
+}
+
+template<uint32_t WINDOW_SIZE> float Nano33BLEWindowChannel<WINDOW_SIZE>::getVariance(void)
+{
+  float mean;
+  float variance;
+
+  mean = getMean();
+  variance = (this->sumOfSquares / this->count) - (mean * mean);
+  if(variance < 0.0F)
+  {
+    /* Only possible through rounding */
+    variance = 0.0F;
+  }
+  return variance;
+}
+
+template<uint32_t WINDOW_SIZE> void Nano33BLEWindowChannel<WINDOW_SIZE>::pushDeque(
+  Entry* deque, 
+  uint32_t& head, 
+  uint32_t& size, 
+  float value, 
+  uint32_t sequence, 
+  bool keepMin)
+{
+  uint32_t tail;
+
+  /* Drop values from the back that can never be the min (or max) again */
+  while(size > 0U)
+  {
+    tail = (head + size - 1U) % WINDOW_SIZE;
+    if((keepMin && (deque[tail].value < value)) || 
+      (!keepMin && (deque[tail].value > value)))
+    {
+      break;
+    }
+    size--;
+  }
+
+  tail = (head + size) % WINDOW_SIZE;
+  deque[tail].value = value;
+  deque[tail].sequence = sequence;
+  size++;
+  return;
+}
+
+template<uint32_t WINDOW_SIZE> void Nano33BLEWindowChannel<WINDOW_SIZE>::expireDeque(
+  Entry* deque, 
+  uint32_t& head, 
+  uint32_t& size,
+  uint32_t oldestSequence)
+{
+  /* Compared by subtraction so it still works when the sequence wraps */
+  while((size > 0U) && ((int32_t)(deque[head].sequence - oldestSequence) < 0))
+  {
+    head = (head + 1U) % WINDOW_SIZE;
+    size--;
+  }
+  return;
+}
+
+template<class T, uint32_t WINDOW_SIZE> void Nano33BLEWindowFeatures<T, WINDOW_SIZE>::read(void)
+{
+  T reading;
+  Data data;
+  uint32_t ii;
+
+  if(!this->sourceReader.popWait(reading, WINDOW_FEATURES_READ_TIMEOUT_MS))
+  {
+    return;
+  }
+
+  for(ii = 0; ii < CHANNEL_COUNT; ii++)
+  {
+    this->channels[ii].add(Nano33BLESensorChannels<T>::get(reading, ii));
+  }
+  this->readingsSinceOutput++;
+
+  if(!this->channels[0].isFull() || (this->readingsSinceOutput < this->hop))
+  {
+    return;
+  }
+  this->readingsSinceOutput = 0;
+
+  for(ii = 0; ii < CHANNEL_COUNT; ii++)
+  {
+    data.mean[ii] = this->channels[ii].getMean();
+    data.variance[ii] = this->channels[ii].getVariance();
+    data.min[ii] = this->channels[ii].getMin();
+    data.max[ii] = this->channels[ii].getMax();
+    data.rms[ii] = this->channels[ii].getRMS();
+    data.peakToPeak[ii] = data.max[ii] - data.min[ii];
+    data.zeroCrossings[ii] = this->channels[ii].getZeroCrossings();
+  }
+  data.timeStampMs = reading.timeStampMs;
+  this->push(data);
+  return;
+}
+
+#endif /* NANO33BLEWINDOWFEATURES_H_ */